@@ -0,0 +1,318 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#include "../src/include/HVCFReaderPool.h"
+
+using namespace std;
+using namespace sph_umich_edu;
+
+/*
+ * Replays a query workload against HVCF file and reports latency percentiles, throughput and bytes read per query type.
+ *
+ * Usage: hvcfbench <file.h5> <workload> [threads (default 1)] [repeats (default 1)]
+ *
+ * Workload has one query per line (fields separated by whitespace, '#' starts a comment):
+ *   ld <subset> <chromosome> <start> <end>
+ *   ld_lead <subset> <chromosome> <lead variant> <start> <end>
+ *   frequencies <subset> <chromosome> <start> <end>
+ *   variants <chromosome> <start> <end>
+ *   variant_haplotypes <subset> <chromosome> <variant>
+ *   sample_haplotypes <sample> <chromosome> <start> <end>
+ *   haplotypes <subset> <chromosome> <start> <end>
+ *   selection_ld <first>:<step>:<n> <chromosome> <start> <end>
+ *   selection_frequencies <first>:<step>:<n> <chromosome> <start> <end>
+ *
+ * Selection queries use ad-hoc sample selection of n samples with offsets first, first + step, first + 2 * step, ... Step 1 gives contiguous selection,
+ * larger steps give fragmented selections of the same size, which are read in blocks and gathered (see HVCFConfiguration::gather_max_gap).
+ *
+ * Queries are taken in workload order by <threads> threads, each using its own reader from HVCFReaderPool.
+ * Bytes read are taken from the per-thread "rchar" counter in /proc/thread-self/io (Linux only; zero elsewhere),
+ * which counts every byte HDF5 read from the file, whether or not it came from the page cache.
+ */
+
+typedef struct Query {
+	string type;
+	string subset; // subset or sample
+	string chromosome;
+	string variant;
+	unsigned long long int start;
+	unsigned long long int end;
+	unsigned int line;
+	vector<hsize_t> samples; // ad-hoc selection of selection_* queries
+} query;
+
+typedef struct Measurement {
+	double seconds;
+	unsigned long long int bytes;
+	size_t n_results;
+} measurement;
+
+vector<query> read_workload(const string& name) {
+	vector<query> queries;
+	ifstream workload(name);
+	string line;
+	unsigned int line_number = 0u;
+
+	if (!workload.is_open()) {
+		throw runtime_error("Error while opening workload file '" + name + "'.");
+	}
+
+	while (getline(workload, line)) {
+		++line_number;
+		size_t comment = line.find('#');
+		if (comment != string::npos) {
+			line.erase(comment);
+		}
+
+		istringstream fields(line);
+		query q{"", "", "", "", 0ull, 0ull, line_number, {}};
+
+		if (!(fields >> q.type)) {
+			continue;
+		}
+
+		bool parsed = false;
+		if ((q.type.compare("ld") == 0) || (q.type.compare("frequencies") == 0) || (q.type.compare("sample_haplotypes") == 0) || (q.type.compare("haplotypes") == 0)) {
+			parsed = static_cast<bool>(fields >> q.subset >> q.chromosome >> q.start >> q.end);
+		} else if (q.type.compare("ld_lead") == 0) {
+			parsed = static_cast<bool>(fields >> q.subset >> q.chromosome >> q.variant >> q.start >> q.end);
+		} else if (q.type.compare("variants") == 0) {
+			parsed = static_cast<bool>(fields >> q.chromosome >> q.start >> q.end);
+		} else if (q.type.compare("variant_haplotypes") == 0) {
+			parsed = static_cast<bool>(fields >> q.subset >> q.chromosome >> q.variant);
+		} else if ((q.type.compare("selection_ld") == 0) || (q.type.compare("selection_frequencies") == 0)) {
+			hsize_t first = 0u;
+			hsize_t step = 0u;
+			hsize_t n = 0u;
+			char separator1 = '\0';
+			char separator2 = '\0';
+			parsed = static_cast<bool>(fields >> q.subset >> q.chromosome >> q.start >> q.end);
+			istringstream selection(q.subset);
+			parsed = parsed && (selection >> first >> separator1 >> step >> separator2 >> n) && (separator1 == ':') && (separator2 == ':') && (step > 0u);
+			for (hsize_t i = 0u; parsed && (i < n); ++i) {
+				q.samples.push_back(first + i * step);
+			}
+		}
+
+		if (!parsed) {
+			throw runtime_error("Error while parsing workload line " + to_string(line_number) + ": '" + line + "'.");
+		}
+
+		queries.push_back(std::move(q));
+	}
+
+	return queries;
+}
+
+unsigned long long int get_thread_bytes_read() {
+	ifstream io("/proc/thread-self/io");
+	string key;
+	unsigned long long int value = 0ull;
+
+	while (io >> key >> value) {
+		if (key.compare("rchar:") == 0) {
+			return value;
+		}
+	}
+	return 0ull;
+}
+
+// Selection queries are reported per selection, so that contiguous and fragmented selections of the same size can be compared.
+string get_label(const query& q) {
+	if (q.samples.empty()) {
+		return q.type;
+	}
+	return q.type + " " + q.subset;
+}
+
+size_t run_query(HVCFReaderPool& pool, const query& q) {
+	if (q.type.compare("ld") == 0) {
+		vector<ld_query_result> result;
+		pool.compute_ld(q.subset, q.chromosome, q.start, q.end, result);
+		return result.size();
+	} else if (q.type.compare("ld_lead") == 0) {
+		vector<ld_query_result> result;
+		pool.compute_ld(q.subset, q.chromosome, q.variant, q.start, q.end, result);
+		return result.size();
+	} else if (q.type.compare("frequencies") == 0) {
+		vector<frequency_query_result> result;
+		pool.compute_frequencies(q.subset, q.chromosome, q.start, q.end, result);
+		return result.size();
+	} else if (q.type.compare("selection_ld") == 0) {
+		ld_query_columns result;
+		pool.compute_ld(sample_selection(q.samples), q.chromosome, q.start, q.end, result);
+		return result.r.size();
+	} else if (q.type.compare("selection_frequencies") == 0) {
+		frequency_query_columns result;
+		pool.compute_frequencies(sample_selection(q.samples), q.chromosome, q.start, q.end, result);
+		return result.size();
+	} else if (q.type.compare("variants") == 0) {
+		vector<variant_query_result> result;
+		pool.extract_variants(q.chromosome, q.start, q.end, result);
+		return result.size();
+	} else if (q.type.compare("variant_haplotypes") == 0) {
+		vector<variant_haplotypes_query_result> result;
+		pool.extract_haplotypes(q.subset, q.chromosome, q.variant, result);
+		return result.size();
+	} else if (q.type.compare("sample_haplotypes") == 0) {
+		vector<sample_haplotypes_query_result> result;
+		pool.extract_haplotypes(q.subset, q.chromosome, q.start, q.end, result);
+		return result.size();
+	} else {
+		haplotypes_query_columns result;
+		pool.extract_haplotypes(q.subset, q.chromosome, q.start, q.end, result);
+		return result.haplotypes.size();
+	}
+}
+
+double get_percentile(const vector<double>& sorted_values, double percentile) {
+	if (sorted_values.empty()) {
+		return 0.0;
+	}
+	size_t rank = static_cast<size_t>(percentile * (sorted_values.size() - 1u) + 0.5);
+	return sorted_values[rank];
+}
+
+void print_report(const map<string, vector<measurement>>& measurements, double wall_seconds) {
+	cout << left << setw(32) << "QUERY" << right
+			<< setw(10) << "N"
+			<< setw(12) << "P50_MS"
+			<< setw(12) << "P95_MS"
+			<< setw(12) << "P99_MS"
+			<< setw(12) << "MEAN_MS"
+			<< setw(12) << "QPS"
+			<< setw(16) << "BYTES/QUERY"
+			<< setw(16) << "RESULTS/QUERY" << endl;
+
+	for (auto&& type : measurements) {
+		vector<double> latencies;
+		double total_seconds = 0.0;
+		unsigned long long int total_bytes = 0ull;
+		unsigned long long int total_results = 0ull;
+
+		for (auto&& m : type.second) {
+			latencies.push_back(m.seconds * 1000.0);
+			total_seconds += m.seconds;
+			total_bytes += m.bytes;
+			total_results += m.n_results;
+		}
+		sort(latencies.begin(), latencies.end());
+
+		size_t n = type.second.size();
+		cout << left << setw(32) << type.first << right << fixed << setprecision(3)
+				<< setw(10) << n
+				<< setw(12) << get_percentile(latencies, 0.50)
+				<< setw(12) << get_percentile(latencies, 0.95)
+				<< setw(12) << get_percentile(latencies, 0.99)
+				<< setw(12) << (total_seconds * 1000.0 / n)
+				<< setw(12) << (n / wall_seconds)
+				<< setw(16) << (total_bytes / n)
+				<< setw(16) << (total_results / n) << endl;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if ((argc < 3) || (argc > 5)) {
+		cerr << "Usage: " << argv[0] << " <file.h5> <workload> [threads] [repeats]" << endl;
+		return 1;
+	}
+
+	string hvcf_name(argv[1]);
+	string workload_name(argv[2]);
+	unsigned int n_threads = (argc > 3) ? strtoul(argv[3], nullptr, 10) : 1u;
+	unsigned int n_repeats = (argc > 4) ? strtoul(argv[4], nullptr, 10) : 1u;
+
+	if ((n_threads == 0u) || (n_repeats == 0u)) {
+		cerr << "Number of threads and repeats must be positive." << endl;
+		return 1;
+	}
+
+	try {
+		vector<query> queries = read_workload(workload_name);
+
+		HVCFReaderPool pool(n_threads);
+		pool.open(hvcf_name);
+
+		size_t n_tasks = queries.size() * n_repeats;
+		atomic<size_t> next_task(0u);
+		mutex measurements_mutex;
+		map<string, vector<measurement>> measurements;
+		vector<string> errors;
+
+		auto worker = [&]() {
+			map<string, vector<measurement>> local_measurements;
+			size_t task = 0u;
+
+			while ((task = next_task.fetch_add(1u)) < n_tasks) {
+				const query& q = queries[task % queries.size()];
+
+				try {
+					unsigned long long int bytes_before = get_thread_bytes_read();
+					auto start = chrono::steady_clock::now();
+					size_t n_results = run_query(pool, q);
+					chrono::duration<double> elapsed_seconds = chrono::steady_clock::now() - start;
+					unsigned long long int bytes_after = get_thread_bytes_read();
+
+					local_measurements[get_label(q)].push_back(measurement{elapsed_seconds.count(), bytes_after - bytes_before, n_results});
+				} catch (HVCFException &e) {
+					lock_guard<mutex> lock(measurements_mutex);
+					errors.push_back("line " + to_string(q.line) + ": " + e.what());
+				}
+			}
+
+			lock_guard<mutex> lock(measurements_mutex);
+			for (auto&& type : local_measurements) {
+				vector<measurement>& all = measurements[type.first];
+				all.insert(all.end(), type.second.begin(), type.second.end());
+			}
+		};
+
+		auto start = chrono::steady_clock::now();
+
+		vector<thread> threads;
+		for (unsigned int i = 0u; i < n_threads; ++i) {
+			threads.emplace_back(worker);
+		}
+		for (auto&& t : threads) {
+			t.join();
+		}
+
+		chrono::duration<double> wall_seconds = chrono::steady_clock::now() - start;
+
+		pool.close();
+
+		cout << "File: " << hvcf_name << endl;
+		cout << "Workload: " << workload_name << " (" << queries.size() << " queries x " << n_repeats << " repeats)" << endl;
+		cout << "Threads: " << n_threads << endl;
+		cout << "Wall time: " << fixed << setprecision(3) << wall_seconds.count() << " s, " << (n_tasks / wall_seconds.count()) << " queries/s" << endl;
+		cout << endl;
+		print_report(measurements, wall_seconds.count());
+
+		if (!errors.empty()) {
+			cerr << errors.size() << " queries failed:" << endl;
+			for (auto&& error : errors) {
+				cerr << "  " << error << endl;
+			}
+			return 2;
+		}
+	} catch (HVCFException &e) {
+		cerr << e.what() << endl;
+		return 1;
+	} catch (exception &e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
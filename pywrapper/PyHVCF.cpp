@@ -4,8 +4,11 @@
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 #include <boost/python/exception_translator.hpp>
 #include <python2.7/Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
 
 #include "../src/include/HVCF.h"
+#include "../src/include/HVCFReaderPool.h"
 
 using namespace sph_umich_edu;
 using namespace boost::python;
@@ -14,13 +17,369 @@ void translator(const HVCFException& e) {
 	PyErr_SetString(PyExc_UserWarning, e.what());
 }
 
-void (HVCF::*compute_region_ld)(const string& chromosome, const string& subset, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) = &HVCF::compute_ld;
-void (HVCF::*compute_lead_ld)(const string& chromosome, const string& subset, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) = &HVCF::compute_ld;
-void (HVCF::*extract_haplotypes_for_variant)(const string& subset, const string& chromosome, const string& variant_name, vector<variant_haplotypes_query_result>& result) = &HVCF::extract_haplotypes;
-void (HVCF::*extract_haplotypes_for_sample)(const string& sample, const string& chromosome, unsigned long long int start, unsigned long long int end, vector<sample_haplotypes_query_result>& result) = &HVCF::extract_haplotypes;
+
+// Releases Python GIL while HVCF runs a query, so that other Python threads (and queries from several Python threads to a reader pool) make progress.
+class ScopedGILRelease {
+private:
+	PyThreadState* thread_state;
+public:
+	ScopedGILRelease() : thread_state(PyEval_SaveThread()) {}
+	~ScopedGILRelease() { PyEval_RestoreThread(thread_state); }
+};
+
+// Wraps member function f, so that it is called without GIL. Arguments are converted before and result after the call, both with GIL held.
+template <typename F, F f> struct gil_released;
+
+template <typename C, typename R, typename... Args, R (C::*f)(Args...)>
+struct gil_released<R (C::*)(Args...), f> {
+	static R call(C& self, Args... args) {
+		ScopedGILRelease release;
+		return (self.*f)(args...);
+	}
+};
+
+template <typename C, typename R, typename... Args, R (C::*f)(Args...) const>
+struct gil_released<R (C::*)(Args...) const, f> {
+	static R call(const C& self, Args... args) {
+		ScopedGILRelease release;
+		return (self.*f)(args...);
+	}
+};
+
+#define GIL_RELEASED(type, f) &gil_released<type, f>::call
+
+typedef void (HVCF::*import_vcf_type)(const string& name);
+typedef void (HVCF::*import_vcf_in_sample_order_type)(const string& name, const vector<string>& sample_order);
+typedef void (HVCF::*compute_region_ld_type)(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result);
+typedef void (HVCF::*compute_region_ld_pairs_type)(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, const ld_options& options, vector<ld_query_result>& result);
+typedef void (HVCF::*compute_batch_ld_type)(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, vector<ld_query_result>& result);
+typedef void (HVCF::*compute_lead_ld_type)(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result);
+typedef void (HVCF::*compute_frequencies_type)(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result);
+typedef void (HVCF::*extract_variants_type)(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<variant_query_result>& result);
+typedef void (HVCF::*extract_haplotypes_for_variant_type)(const string& subset, const string& chromosome, const string& variant_name, vector<variant_haplotypes_query_result>& result);
+typedef void (HVCF::*extract_haplotypes_for_sample_type)(const string& sample, const string& chromosome, unsigned long long int start, unsigned long long int end, vector<sample_haplotypes_query_result>& result);
+
+typedef void (HVCFReaderPool::*pool_compute_region_ld_type)(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result);
+typedef void (HVCFReaderPool::*pool_compute_region_ld_pairs_type)(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, const ld_options& options, vector<ld_query_result>& result);
+typedef void (HVCFReaderPool::*pool_compute_batch_ld_type)(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, vector<ld_query_result>& result);
+typedef void (HVCFReaderPool::*pool_compute_lead_ld_type)(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result);
+typedef void (HVCFReaderPool::*pool_compute_frequencies_type)(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result);
+typedef void (HVCFReaderPool::*pool_extract_variants_type)(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<variant_query_result>& result);
+typedef void (HVCFReaderPool::*pool_extract_haplotypes_for_variant_type)(const string& subset, const string& chromosome, const string& variant_name, vector<variant_haplotypes_query_result>& result);
+typedef void (HVCFReaderPool::*pool_extract_haplotypes_for_sample_type)(const string& sample, const string& chromosome, unsigned long long int start, unsigned long long int end, vector<sample_haplotypes_query_result>& result);
+
+// BEGIN: columnar results as NumPy arrays.
+// Every query returns a new columns object. Arrays don't copy data: they point to the columns object's buffers and keep it alive through their base object.
+// Arrays are read-only, and since the columns object is never passed to another query, its buffers are never reallocated under them.
+template <typename T> struct numpy_type;
+template <> struct numpy_type<double> { static const int value = NPY_DOUBLE; };
+template <> struct numpy_type<unsigned char> { static const int value = NPY_UINT8; };
+template <> struct numpy_type<unsigned int> { static const int value = NPY_UINT32; };
+template <> struct numpy_type<unsigned long int> { static const int value = NPY_ULONG; };
+template <> struct numpy_type<unsigned long long int> { static const int value = NPY_ULONGLONG; };
+
+template <typename T>
+object as_array(PyObject* owner, const T* data, int n_dims, npy_intp* dims) {
+	PyObject* array = PyArray_SimpleNewFromData(n_dims, dims, numpy_type<T>::value, const_cast<T*>(data));
+	if (array == nullptr) {
+		throw_error_already_set();
+	}
+	PyArray_CLEARFLAGS(reinterpret_cast<PyArrayObject*>(array), NPY_ARRAY_WRITEABLE);
+	if (PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array), incref(owner)) < 0) {
+		Py_DECREF(array);
+		throw_error_already_set();
+	}
+	return object(handle<>(array));
+}
+
+template <typename T>
+object as_array(PyObject* owner, const vector<T>& data) {
+	npy_intp dims[1]{static_cast<npy_intp>(data.size())};
+	return as_array(owner, data.data(), 1, dims);
+}
+
+template <typename T>
+object as_array(PyObject* owner, const vector<T>& data, size_t n_rows, size_t n_columns) {
+	npy_intp dims[2]{static_cast<npy_intp>(n_rows), static_cast<npy_intp>(n_columns)};
+	return as_array(owner, data.data(), 2, dims);
+}
+
+// Strings can't be viewed as NumPy array without padding them to the same width, so they are returned as list.
+boost::python::list as_list(const vector<char>& strings, const vector<size_t>& offsets) {
+	boost::python::list result;
+	for (auto&& offset : offsets) {
+		result.append(str(strings.data() + offset));
+	}
+	return result;
+}
+
+object variants_positions(back_reference<variants_columns&> columns) { return as_array(columns.source().ptr(), columns.get().positions); }
+boost::python::list variants_names(const variants_columns& columns) { return as_list(columns.names, columns.name_offsets); }
+boost::python::list variants_refs(const variants_columns& columns) { return as_list(columns.refs, columns.ref_offsets); }
+boost::python::list variants_alts(const variants_columns& columns) { return as_list(columns.alts, columns.alt_offsets); }
+
+object frequencies_positions(back_reference<frequency_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().variants.positions); }
+boost::python::list frequencies_names(const frequency_query_columns& columns) { return as_list(columns.variants.names, columns.variants.name_offsets); }
+boost::python::list frequencies_refs(const frequency_query_columns& columns) { return as_list(columns.variants.refs, columns.variants.ref_offsets); }
+boost::python::list frequencies_alts(const frequency_query_columns& columns) { return as_list(columns.variants.alts, columns.variants.alt_offsets); }
+object frequencies_ref_af(back_reference<frequency_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().ref_af); }
+object frequencies_alt_af(back_reference<frequency_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().alt_af); }
+object frequencies_alt_counts(back_reference<frequency_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().alt_counts); }
+
+object ld_positions(back_reference<ld_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().variants.positions); }
+boost::python::list ld_names(const ld_query_columns& columns) { return as_list(columns.variants.names, columns.variants.name_offsets); }
+object ld_rows(back_reference<ld_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().rows); }
+object ld_r(back_reference<ld_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().r, columns.get().get_n_rows(), columns.get().get_n_columns()); }
+object ld_rsquare(back_reference<ld_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().rsquare, columns.get().get_n_rows(), columns.get().get_n_columns()); }
+
+object ld_pairs_positions(back_reference<ld_pairs_columns&> columns) { return as_array(columns.source().ptr(), columns.get().variants.positions); }
+boost::python::list ld_pairs_names(const ld_pairs_columns& columns) { return as_list(columns.variants.names, columns.variants.name_offsets); }
+object ld_pairs_index1(back_reference<ld_pairs_columns&> columns) { return as_array(columns.source().ptr(), columns.get().index1); }
+object ld_pairs_index2(back_reference<ld_pairs_columns&> columns) { return as_array(columns.source().ptr(), columns.get().index2); }
+object ld_pairs_r(back_reference<ld_pairs_columns&> columns) { return as_array(columns.source().ptr(), columns.get().r); }
+object ld_pairs_rsquare(back_reference<ld_pairs_columns&> columns) { return as_array(columns.source().ptr(), columns.get().rsquare); }
+
+object ld_batch_positions(back_reference<ld_batch_columns&> columns) { return as_array(columns.source().ptr(), columns.get().variants.positions); }
+boost::python::list ld_batch_names(const ld_batch_columns& columns) { return as_list(columns.variants.names, columns.variants.name_offsets); }
+object ld_batch_leads(back_reference<ld_batch_columns&> columns) { return as_array(columns.source().ptr(), columns.get().leads); }
+object ld_batch_requests(back_reference<ld_batch_columns&> columns) { return as_array(columns.source().ptr(), columns.get().requests); }
+object ld_batch_window_starts(back_reference<ld_batch_columns&> columns) { return as_array(columns.source().ptr(), columns.get().window_starts); }
+object ld_batch_offsets(back_reference<ld_batch_columns&> columns) { return as_array(columns.source().ptr(), columns.get().offsets); }
+object ld_batch_r(back_reference<ld_batch_columns&> columns) { return as_array(columns.source().ptr(), columns.get().r); }
+object ld_batch_rsquare(back_reference<ld_batch_columns&> columns) { return as_array(columns.source().ptr(), columns.get().rsquare); }
+
+object haplotypes_positions(back_reference<haplotypes_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().variants.positions); }
+boost::python::list haplotypes_names(const haplotypes_query_columns& columns) { return as_list(columns.variants.names, columns.variants.name_offsets); }
+object haplotypes_matrix(back_reference<haplotypes_query_columns&> columns) { return as_array(columns.source().ptr(), columns.get().haplotypes, columns.get().size(), columns.get().n_haplotypes); }
+
+// Sample table is shared by reader and Python object: names list is built on access, subset offsets are viewed without copying.
+boost::python::list sample_table_names(const sample_table& table) { return as_list(table.names, table.name_offsets); }
+long long int sample_table_get_offset(const sample_table& table, const string& name) { return table.get_offset(name.c_str()); }
+
+boost::python::list sample_table_subsets(const sample_table& table) {
+	boost::python::list result;
+	for (auto&& subset : table.subsets) {
+		result.append(subset.first);
+	}
+	result.sort();
+	return result;
+}
+
+object sample_table_subset_offsets(back_reference<sample_table&> table, const string& name) {
+	static const vector<hsize_t> empty;
+	const vector<hsize_t>* offsets = table.get().get_subset(name);
+	return as_array(table.source().ptr(), (offsets == nullptr) ? empty : *offsets);
+}
+
+template <typename Reader>
+boost::shared_ptr<sample_table> get_sample_table(Reader& reader) {
+	shared_ptr<const sample_table> table;
+	{
+		ScopedGILRelease release;
+		table = reader.get_sample_table();
+	}
+	if (!table) {
+		table.reset(new sample_table());
+	}
+	// boost.python holds boost::shared_ptr: it keeps a copy of std::shared_ptr alive in its deleter
+	return boost::shared_ptr<sample_table>(const_cast<sample_table*>(table.get()), [table] (sample_table*) {});
+}
+
+// Samples of columnar queries are either subset name or ad-hoc selection: iterable (e.g. NumPy array) of sample offsets, or of booleans over all samples.
+// Returns true for ad-hoc selection.
+bool as_sample_selection(object samples, string& subset, sample_selection& selection) {
+	extract<string> name(samples);
+	if (name.check()) {
+		subset = name();
+		return false;
+	}
+
+	bool mask = PyArray_Check(samples.ptr()) && (PyArray_TYPE(reinterpret_cast<PyArrayObject*>(samples.ptr())) == NPY_BOOL);
+	hsize_t i = 0u;
+	for (stl_input_iterator<object> item(samples), end; item != end; ++item, ++i) {
+		object value = *item;
+		if (mask || PyBool_Check(value.ptr())) {
+			if (PyObject_IsTrue(value.ptr())) {
+				selection.offsets.push_back(i);
+			}
+		} else {
+			selection.offsets.push_back(extract<unsigned long long int>(value));
+		}
+	}
+	return true;
+}
+
+template <typename Reader>
+boost::shared_ptr<ld_query_columns> compute_region_ld_columns(Reader& reader, object samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position) {
+	boost::shared_ptr<ld_query_columns> result(new ld_query_columns());
+	string subset;
+	sample_selection selection;
+	bool adhoc = as_sample_selection(samples, subset, selection);
+	ScopedGILRelease release;
+	if (adhoc) {
+		reader.compute_ld(selection, chromosome, start_position, end_position, *result);
+	} else {
+		reader.compute_ld(subset, chromosome, start_position, end_position, *result);
+	}
+	return result;
+}
+
+template <typename Reader>
+boost::shared_ptr<ld_pairs_columns> compute_ld_pairs_columns(Reader& reader, object samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options) {
+	boost::shared_ptr<ld_pairs_columns> result(new ld_pairs_columns());
+	string subset;
+	sample_selection selection;
+	bool adhoc = as_sample_selection(samples, subset, selection);
+	ScopedGILRelease release;
+	if (adhoc) {
+		reader.compute_ld(selection, chromosome, start_position, end_position, options, *result);
+	} else {
+		reader.compute_ld(subset, chromosome, start_position, end_position, options, *result);
+	}
+	return result;
+}
+
+template <typename Reader>
+boost::shared_ptr<ld_query_columns> compute_lead_ld_columns(Reader& reader, object samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position) {
+	boost::shared_ptr<ld_query_columns> result(new ld_query_columns());
+	string subset;
+	sample_selection selection;
+	bool adhoc = as_sample_selection(samples, subset, selection);
+	ScopedGILRelease release;
+	if (adhoc) {
+		reader.compute_ld(selection, chromosome, lead_variant_name, start_position, end_position, *result);
+	} else {
+		reader.compute_ld(subset, chromosome, lead_variant_name, start_position, end_position, *result);
+	}
+	return result;
+}
+
+// Lead variant names can be any iterable of strings (e.g. list or NamesVector).
+template <typename Reader>
+boost::shared_ptr<ld_batch_columns> compute_ld_batch_columns(Reader& reader, const string& subset, const string& chromosome, object lead_variant_names, const ld_window& window) {
+	boost::shared_ptr<ld_batch_columns> result(new ld_batch_columns());
+	vector<string> names{stl_input_iterator<string>(lead_variant_names), stl_input_iterator<string>()};
+	ScopedGILRelease release;
+	reader.compute_ld(subset, chromosome, names, window, *result);
+	return result;
+}
+
+// Passes every LD tile to Python callable as callback(row_start, column_start, r), where r is a NumPy array copy of the tile.
+// Called from HVCF worker threads, so GIL is acquired for each tile. Python exception raised by callback stops the query.
+class CallbackLDSink : public HVCFLDSink {
+private:
+	object callback;
+	variants_columns& variants;
+public:
+	CallbackLDSink(object callback, variants_columns& variants) : callback(callback), variants(variants) {}
+
+	void begin(const variants_columns& variants) {
+		this->variants = variants;
+	}
+
+	void consume(const ld_tile& tile) {
+		PyGILState_STATE state = PyGILState_Ensure();
+		try {
+			npy_intp dims[2]{static_cast<npy_intp>(tile.n_rows), static_cast<npy_intp>(tile.n_columns)};
+			PyObject* array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+			if (array == nullptr) {
+				throw_error_already_set();
+			}
+			memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)), tile.r, tile.n_rows * tile.n_columns * sizeof(double));
+			callback(tile.row_start, tile.column_start, object(handle<>(array)));
+		} catch (error_already_set&) {
+			PyErr_Print();
+			PyGILState_Release(state);
+			throw runtime_error("LD tile callback failed.");
+		}
+		PyGILState_Release(state);
+	}
+};
+
+// Returns variants of the region; tiles refer to them by ordinals.
+template <typename Reader>
+boost::shared_ptr<variants_columns> compute_ld_tiles(Reader& reader, object samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, object callback) {
+	boost::shared_ptr<variants_columns> result(new variants_columns());
+	CallbackLDSink sink(callback, *result);
+	string subset;
+	sample_selection selection;
+	bool adhoc = as_sample_selection(samples, subset, selection);
+	ScopedGILRelease release;
+	if (adhoc) {
+		reader.compute_ld(selection, chromosome, start_position, end_position, sink);
+	} else {
+		reader.compute_ld(subset, chromosome, start_position, end_position, sink);
+	}
+	return result;
+}
+
+template <typename Reader>
+boost::shared_ptr<frequency_query_columns> compute_frequencies_columns(Reader& reader, object samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position) {
+	boost::shared_ptr<frequency_query_columns> result(new frequency_query_columns());
+	string subset;
+	sample_selection selection;
+	bool adhoc = as_sample_selection(samples, subset, selection);
+	ScopedGILRelease release;
+	if (adhoc) {
+		reader.compute_frequencies(selection, chromosome, start_position, end_position, *result);
+	} else {
+		reader.compute_frequencies(subset, chromosome, start_position, end_position, *result);
+	}
+	return result;
+}
+
+template <typename Reader>
+boost::shared_ptr<variants_columns> extract_variants_columns(Reader& reader, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position) {
+	boost::shared_ptr<variants_columns> result(new variants_columns());
+	ScopedGILRelease release;
+	reader.extract_variants(chromosome, start_position, end_position, *result);
+	return result;
+}
+
+template <typename Reader>
+boost::shared_ptr<haplotypes_query_columns> extract_haplotypes_columns(Reader& reader, const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position) {
+	boost::shared_ptr<haplotypes_query_columns> result(new haplotypes_query_columns());
+	ScopedGILRelease release;
+	reader.extract_haplotypes(subset, chromosome, start_position, end_position, *result);
+	return result;
+}
+// END: columnar results as NumPy arrays.
+
+string metrics_to_prometheus(const HVCFMetrics& metrics) {
+	return metrics.to_prometheus();
+}
+
+dict metrics_as_dict(const HVCFMetrics& metrics) {
+	dict result;
+	for (auto&& query : metrics.get()) {
+		dict query_result;
+		dict stages;
+		for (auto&& stage : query.second.stages) {
+			stages[stage.first] = stage.second.seconds;
+		}
+		query_result["count"] = query.second.count;
+		query_result["errors"] = query.second.errors;
+		query_result["seconds"] = query.second.seconds;
+		query_result["results"] = query.second.results;
+		query_result["reads"] = query.second.io.reads;
+		query_result["bytes_read"] = query.second.io.bytes_read;
+		query_result["raw_data_reads"] = query.second.io.raw_data_reads;
+		query_result["raw_data_bytes_read"] = query.second.io.raw_data_bytes_read;
+		query_result["haplotype_chunks_touched"] = query.second.haplotype_chunks_touched;
+		query_result["haplotype_chunks_read"] = query.second.haplotype_chunks_read;
+		query_result["chunk_cache_hit_rate"] = query.second.get_chunk_cache_hit_rate();
+		query_result["stages"] = stages;
+		result[query.first] = query_result;
+	}
+	return result;
+}
 
 BOOST_PYTHON_MODULE(PyHVCF)
 {
+	if (_import_array() < 0) { // import_array() returns from the module init function, whose return type differs between Python 2 and 3
+		throw_error_already_set();
+	}
+
 	register_exception_translator<HVCFException>(&translator);
 
 	def("get_n_all_opened_objects", HVCF::get_n_all_opened_objects);
@@ -91,30 +450,169 @@ BOOST_PYTHON_MODULE(PyHVCF)
 			.def(vector_indexing_suite<std::vector<sample_haplotypes_query_result>>())
 		;
 
+	class_<variants_columns, boost::shared_ptr<variants_columns>, boost::noncopyable>("VariantsColumns", no_init)
+			.def("__len__", &variants_columns::size)
+			.add_property("names", variants_names)
+			.add_property("refs", variants_refs)
+			.add_property("alts", variants_alts)
+			.add_property("positions", variants_positions)
+		;
+
+	class_<frequency_query_columns, boost::shared_ptr<frequency_query_columns>, boost::noncopyable>("FrequencyColumns", no_init)
+			.def("__len__", &frequency_query_columns::size)
+			.def_readonly("n_haplotypes", &frequency_query_columns::n_haplotypes)
+			.add_property("names", frequencies_names)
+			.add_property("refs", frequencies_refs)
+			.add_property("alts", frequencies_alts)
+			.add_property("positions", frequencies_positions)
+			.add_property("ref_af", frequencies_ref_af)
+			.add_property("alt_af", frequencies_alt_af)
+			.add_property("alt_counts", frequencies_alt_counts)
+		;
+
+	class_<ld_query_columns, boost::shared_ptr<ld_query_columns>, boost::noncopyable>("LDColumns", no_init)
+			.def("get_n_rows", &ld_query_columns::get_n_rows)
+			.def("get_n_columns", &ld_query_columns::get_n_columns)
+			.add_property("names", ld_names)
+			.add_property("positions", ld_positions)
+			.add_property("rows", ld_rows)
+			.add_property("r", ld_r)
+			.add_property("rsquare", ld_rsquare)
+		;
+
+	class_<ld_options>("LDOptions")
+			.def(init<bool, double, unsigned long long int>())
+			.def_readwrite("upper_triangle", &LDOptions::upper_triangle)
+			.def_readwrite("min_rsquare", &LDOptions::min_rsquare)
+			.def_readwrite("max_distance", &LDOptions::max_distance)
+		;
+
+	class_<ld_window>("LDWindow")
+			.def(init<unsigned long long int>())
+			.def(init<unsigned long long int, unsigned long long int, unsigned long long int>())
+			.def_readwrite("flank", &LDWindow::flank)
+			.def_readwrite("start_position", &LDWindow::start_position)
+			.def_readwrite("end_position", &LDWindow::end_position)
+		;
+
+	class_<ld_batch_columns, boost::shared_ptr<ld_batch_columns>, boost::noncopyable>("LDBatchColumns", no_init)
+			.def("get_n_leads", &ld_batch_columns::get_n_leads)
+			.def("get_window_size", &ld_batch_columns::get_window_size)
+			.add_property("names", ld_batch_names)
+			.add_property("positions", ld_batch_positions)
+			.add_property("leads", ld_batch_leads)
+			.add_property("requests", ld_batch_requests)
+			.add_property("window_starts", ld_batch_window_starts)
+			.add_property("offsets", ld_batch_offsets)
+			.add_property("r", ld_batch_r)
+			.add_property("rsquare", ld_batch_rsquare)
+		;
+
+	class_<ld_pairs_columns, boost::shared_ptr<ld_pairs_columns>, boost::noncopyable>("LDPairsColumns", no_init)
+			.def("__len__", &ld_pairs_columns::size)
+			.add_property("names", ld_pairs_names)
+			.add_property("positions", ld_pairs_positions)
+			.add_property("index1", ld_pairs_index1)
+			.add_property("index2", ld_pairs_index2)
+			.add_property("r", ld_pairs_r)
+			.add_property("rsquare", ld_pairs_rsquare)
+		;
+
+	class_<haplotypes_query_columns, boost::shared_ptr<haplotypes_query_columns>, boost::noncopyable>("HaplotypesColumns", no_init)
+			.def("__len__", &haplotypes_query_columns::size)
+			.def_readonly("n_haplotypes", &haplotypes_query_columns::n_haplotypes)
+			.add_property("names", haplotypes_names)
+			.add_property("positions", haplotypes_positions)
+			.add_property("haplotypes", haplotypes_matrix)
+		;
+
+	class_<sample_table, boost::shared_ptr<sample_table>, boost::noncopyable>("SampleTable", no_init)
+			.def("__len__", &sample_table::size)
+			.def("get_offset", sample_table_get_offset)
+			.def("get_subset_offsets", sample_table_subset_offsets)
+			.add_property("names", sample_table_names)
+			.add_property("subsets", sample_table_subsets)
+		;
+
+	class_<HVCFMetrics>("Metrics")
+			.def("to_prometheus", metrics_to_prometheus)
+			.def("as_dict", metrics_as_dict)
+			.def("reset", &HVCFMetrics::reset)
+		;
+
 	class_<HVCF, boost::noncopyable>("HVCF")
-			.def("create", &HVCF::create)
-			.def("open", &HVCF::open)
-			.def("close", &HVCF::close)
-			.def("import_vcf", &HVCF::import_vcf)
-			.def("create_sample_subset", &HVCF::create_sample_subset)
-			.def("get_n_samples", &HVCF::get_n_samples)
-			.def("get_samples", &HVCF::get_samples, return_value_policy<return_by_value>())
-			.def("get_n_sample_subsets", &HVCF::get_n_sample_subsets)
-			.def("get_sample_subsets", &HVCF::get_sample_subsets, return_value_policy<return_by_value>())
-			.def("get_n_samples_in_subset", &HVCF::get_n_samples_in_subset)
-			.def("get_samples_in_subset", &HVCF::get_samples_in_subset, return_value_policy<return_by_value>())
-			.def("get_chromosomes", &HVCF::get_chromosomes, return_value_policy<return_by_value>())
-			.def("has_chromosome", &HVCF::has_chromosome)
-			.def("get_chromosome_start", &HVCF::get_chromosome_start)
-			.def("get_chromosome_end", &HVCF::get_chromosome_end)
-			.def("get_n_variants", &HVCF::get_n_variants)
-			.def("get_n_variants_in_chromosome", &HVCF::get_n_variants_in_chromosome)
-			.def("compute_ld", compute_region_ld)
-			.def("compute_ld", compute_lead_ld)
-			.def("compute_frequencies", &HVCF::compute_frequencies)
-			.def("extract_variants", &HVCF::extract_variants)
-			.def("extract_haplotypes", extract_haplotypes_for_variant)
-			.def("extract_haplotypes", extract_haplotypes_for_sample)
+			.def("create", GIL_RELEASED(decltype(&HVCF::create), &HVCF::create))
+			.def("open", GIL_RELEASED(decltype(&HVCF::open), &HVCF::open))
+			.def("close", GIL_RELEASED(decltype(&HVCF::close), &HVCF::close))
+			.def("import_vcf", GIL_RELEASED(import_vcf_type, &HVCF::import_vcf))
+			.def("import_vcf", GIL_RELEASED(import_vcf_in_sample_order_type, &HVCF::import_vcf))
+			.def("create_sample_subset", GIL_RELEASED(decltype(&HVCF::create_sample_subset), &HVCF::create_sample_subset))
+			.def("create_ld_store", GIL_RELEASED(decltype(&HVCF::create_ld_store), &HVCF::create_ld_store))
+			.def("get_n_samples", GIL_RELEASED(decltype(&HVCF::get_n_samples), &HVCF::get_n_samples))
+			.def("get_samples", GIL_RELEASED(decltype(&HVCF::get_samples), &HVCF::get_samples), return_value_policy<return_by_value>())
+			.def("get_sample_table", get_sample_table<HVCF>)
+			.def("get_n_sample_subsets", GIL_RELEASED(decltype(&HVCF::get_n_sample_subsets), &HVCF::get_n_sample_subsets))
+			.def("get_sample_subsets", GIL_RELEASED(decltype(&HVCF::get_sample_subsets), &HVCF::get_sample_subsets), return_value_policy<return_by_value>())
+			.def("get_n_samples_in_subset", GIL_RELEASED(decltype(&HVCF::get_n_samples_in_subset), &HVCF::get_n_samples_in_subset))
+			.def("get_samples_in_subset", GIL_RELEASED(decltype(&HVCF::get_samples_in_subset), &HVCF::get_samples_in_subset), return_value_policy<return_by_value>())
+			.def("get_chromosomes", GIL_RELEASED(decltype(&HVCF::get_chromosomes), &HVCF::get_chromosomes), return_value_policy<return_by_value>())
+			.def("has_chromosome", GIL_RELEASED(decltype(&HVCF::has_chromosome), &HVCF::has_chromosome))
+			.def("get_chromosome_start", GIL_RELEASED(decltype(&HVCF::get_chromosome_start), &HVCF::get_chromosome_start))
+			.def("get_chromosome_end", GIL_RELEASED(decltype(&HVCF::get_chromosome_end), &HVCF::get_chromosome_end))
+			.def("get_n_variants", GIL_RELEASED(decltype(&HVCF::get_n_variants), &HVCF::get_n_variants))
+			.def("get_n_variants_in_chromosome", GIL_RELEASED(decltype(&HVCF::get_n_variants_in_chromosome), &HVCF::get_n_variants_in_chromosome))
+			.def("compute_ld", GIL_RELEASED(compute_region_ld_type, &HVCF::compute_ld))
+			.def("compute_ld", GIL_RELEASED(compute_lead_ld_type, &HVCF::compute_ld))
+			.def("compute_ld", GIL_RELEASED(compute_region_ld_pairs_type, &HVCF::compute_ld))
+			.def("compute_ld", GIL_RELEASED(compute_batch_ld_type, &HVCF::compute_ld))
+			.def("compute_frequencies", GIL_RELEASED(compute_frequencies_type, &HVCF::compute_frequencies))
+			.def("extract_variants", GIL_RELEASED(extract_variants_type, &HVCF::extract_variants))
+			.def("extract_haplotypes", GIL_RELEASED(extract_haplotypes_for_variant_type, &HVCF::extract_haplotypes))
+			.def("extract_haplotypes", GIL_RELEASED(extract_haplotypes_for_sample_type, &HVCF::extract_haplotypes))
+			.def("compute_ld_columns", compute_region_ld_columns<HVCF>)
+			.def("compute_ld_columns", compute_lead_ld_columns<HVCF>)
+			.def("compute_ld_pairs_columns", compute_ld_pairs_columns<HVCF>)
+			.def("compute_ld_tiles", compute_ld_tiles<HVCF>)
+			.def("compute_ld_batch_columns", compute_ld_batch_columns<HVCF>)
+			.def("compute_frequencies_columns", compute_frequencies_columns<HVCF>)
+			.def("extract_variants_columns", extract_variants_columns<HVCF>)
+			.def("extract_haplotypes_columns", extract_haplotypes_columns<HVCF>)
 			.def("get_n_opened_objects", &HVCF::get_n_opened_objects)
+			.def("get_metrics", GIL_RELEASED(decltype(&HVCF::get_metrics), &HVCF::get_metrics))
+			.def("reset_metrics", GIL_RELEASED(decltype(&HVCF::reset_metrics), &HVCF::reset_metrics))
+		;
+
+	class_<HVCFReaderPool, boost::noncopyable>("HVCFReaderPool", init<unsigned int>())
+			.def("open", GIL_RELEASED(decltype(&HVCFReaderPool::open), &HVCFReaderPool::open))
+			.def("close", GIL_RELEASED(decltype(&HVCFReaderPool::close), &HVCFReaderPool::close))
+			.def("get_n_readers", &HVCFReaderPool::get_n_readers)
+			.def("get_metrics", GIL_RELEASED(decltype(&HVCFReaderPool::get_metrics), &HVCFReaderPool::get_metrics))
+			.def("reset_metrics", GIL_RELEASED(decltype(&HVCFReaderPool::reset_metrics), &HVCFReaderPool::reset_metrics))
+			.def("get_n_samples", GIL_RELEASED(decltype(&HVCFReaderPool::get_n_samples), &HVCFReaderPool::get_n_samples))
+			.def("get_samples", GIL_RELEASED(decltype(&HVCFReaderPool::get_samples), &HVCFReaderPool::get_samples), return_value_policy<return_by_value>())
+			.def("get_sample_table", get_sample_table<HVCFReaderPool>)
+			.def("get_sample_subsets", GIL_RELEASED(decltype(&HVCFReaderPool::get_sample_subsets), &HVCFReaderPool::get_sample_subsets), return_value_policy<return_by_value>())
+			.def("get_samples_in_subset", GIL_RELEASED(decltype(&HVCFReaderPool::get_samples_in_subset), &HVCFReaderPool::get_samples_in_subset), return_value_policy<return_by_value>())
+			.def("get_chromosomes", GIL_RELEASED(decltype(&HVCFReaderPool::get_chromosomes), &HVCFReaderPool::get_chromosomes), return_value_policy<return_by_value>())
+			.def("has_chromosome", GIL_RELEASED(decltype(&HVCFReaderPool::has_chromosome), &HVCFReaderPool::has_chromosome))
+			.def("get_chromosome_start", GIL_RELEASED(decltype(&HVCFReaderPool::get_chromosome_start), &HVCFReaderPool::get_chromosome_start))
+			.def("get_chromosome_end", GIL_RELEASED(decltype(&HVCFReaderPool::get_chromosome_end), &HVCFReaderPool::get_chromosome_end))
+			.def("get_n_variants_in_chromosome", GIL_RELEASED(decltype(&HVCFReaderPool::get_n_variants_in_chromosome), &HVCFReaderPool::get_n_variants_in_chromosome))
+			.def("compute_ld", GIL_RELEASED(pool_compute_region_ld_type, &HVCFReaderPool::compute_ld))
+			.def("compute_ld", GIL_RELEASED(pool_compute_lead_ld_type, &HVCFReaderPool::compute_ld))
+			.def("compute_ld", GIL_RELEASED(pool_compute_region_ld_pairs_type, &HVCFReaderPool::compute_ld))
+			.def("compute_ld", GIL_RELEASED(pool_compute_batch_ld_type, &HVCFReaderPool::compute_ld))
+			.def("compute_frequencies", GIL_RELEASED(pool_compute_frequencies_type, &HVCFReaderPool::compute_frequencies))
+			.def("extract_variants", GIL_RELEASED(pool_extract_variants_type, &HVCFReaderPool::extract_variants))
+			.def("extract_haplotypes", GIL_RELEASED(pool_extract_haplotypes_for_variant_type, &HVCFReaderPool::extract_haplotypes))
+			.def("extract_haplotypes", GIL_RELEASED(pool_extract_haplotypes_for_sample_type, &HVCFReaderPool::extract_haplotypes))
+			.def("compute_ld_columns", compute_region_ld_columns<HVCFReaderPool>)
+			.def("compute_ld_columns", compute_lead_ld_columns<HVCFReaderPool>)
+			.def("compute_ld_pairs_columns", compute_ld_pairs_columns<HVCFReaderPool>)
+			.def("compute_ld_tiles", compute_ld_tiles<HVCFReaderPool>)
+			.def("compute_ld_batch_columns", compute_ld_batch_columns<HVCFReaderPool>)
+			.def("compute_frequencies_columns", compute_frequencies_columns<HVCFReaderPool>)
+			.def("extract_variants_columns", extract_variants_columns<HVCFReaderPool>)
+			.def("extract_haplotypes_columns", extract_haplotypes_columns<HVCFReaderPool>)
 		;
 }
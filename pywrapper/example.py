@@ -37,4 +37,32 @@ if __name__ == '__main__':
    for pair in pairs:
       print pair.name1, pair.position1, pair.name2, pair.position2, pair.r, pair.rsquare   
 
+   # same query, but R and R^2 are NumPy arrays (1 x n) backed by the C++ result
+   ld = hvcf.compute_ld_columns("EUR", "20", "20:11650214_G/A", 14403183, 55378791)
+   print 'POSITION R R^2'
+   for position, r, rsquare in zip(ld.positions, ld.r[0], ld.rsquare[0]):
+      print position, r, rsquare
+
+   # same query for ad-hoc samples: offsets (or boolean mask over all samples) instead of subset name
+   table = hvcf.get_sample_table()
+   ld = hvcf.compute_ld_columns(table.get_subset_offsets("EUR")[::2], "20", "20:11650214_G/A", 14403183, 55378791)
+   print 'R^2 in half of EUR:', ld.rsquare[0]
+
+   # region LD streamed tile by tile; callback is called from worker threads (one at a time)
+   def print_tile(row_start, column_start, r):
+      print 'TILE', row_start, column_start, r.shape
+
+   variants = hvcf.compute_ld_tiles("EUR", "20", 11650214, 60759931, print_tile)
+   print len(variants), 'variants in region'
+
+   # LD of several lead variants with their +/- 1 Mbp windows; haplotypes of overlapping windows are read once
+   window = PyHVCF.LDWindow(1000000)
+   ld = hvcf.compute_ld_batch_columns("EUR", "20", ["20:11650214_G/A", "20:46211051_A/G"], window)
+   for i in xrange(ld.get_n_leads()):
+      lead = ld.leads[i]
+      print 'LEAD', ld.names[lead], ld.get_window_size(i), 'variants in window'
+      r = ld.r[ld.offsets[i]:ld.offsets[i + 1]]
+      for j in xrange(ld.get_window_size(i)):
+         print ld.names[ld.window_starts[i] + j], r[j]
+
    hvcf.close()
@@ -5,15 +5,20 @@ import time
 argparser = argparse.ArgumentParser(description = 'Creates HVCF file from provided VCF file.')
 argparser.add_argument('--import-gzvcf', metavar = 'file', dest = 'importGZVCFs', nargs = '+', required = True, help = 'Input VCF compressed with gzip.')
 argparser.add_argument('--import-populations', metavar = 'file', dest = 'importPopulations', required = False, help = 'Input file with tab-delimited columns sample, pop, super_pop, gender')
+argparser.add_argument('--group-by-population', dest = 'groupByPopulation', action = 'store_true', help = 'Store haplotypes of samples grouped by super population and population from --import-populations file, so that every population is contiguous on disk.')
 argparser.add_argument('--out-hvcf', metavar = 'file', dest = 'outHVCF', required = True, help = 'Output HVCF.')
+argparser.add_argument('--ld-max-distance', metavar = 'bp', dest = 'ldMaxDistance', type = long, required = False, help = 'Precompute LD of every population for variants at most this many bp apart.')
+argparser.add_argument('--ld-min-rsquare', metavar = 'value', dest = 'ldMinRsquare', type = float, default = 0.0, required = False, help = 'Store only precomputed LD with r^2 not less than this value (default: 0, i.e. all pairs; lead variant queries are served from store only in this case).')
 
 populations = dict()
+population_members = list()
 
 def load_populations(file_name):
    with open(file_name) as infile:
       line = infile.readline()
       for line in infile:
          sample, subpop, pop, gender = line.rstrip().split('\t')
+         population_members.append((pop, subpop, sample))
          if subpop not in populations:
             populations[subpop] = PyHVCF.NamesVector()
          populations.get(subpop).append(sample)         
@@ -28,12 +33,18 @@ if __name__ == '__main__':
    if args.importPopulations:
       load_populations(args.importPopulations)
 
+   # samples of every super population and of every population within it are contiguous; order within population follows populations file
+   sample_order = PyHVCF.NamesVector()
+   if args.groupByPopulation:
+      for pop, subpop, sample in sorted(population_members, key = lambda member: (member[0], member[1])):
+         sample_order.append(sample)
+
    hvcf = PyHVCF.HVCF()
    hvcf.create(args.outHVCF)
 
    for importGZVCF in args.importGZVCFs:
       start_time = time.time()
-      hvcf.import_vcf(importGZVCF)
+      hvcf.import_vcf(importGZVCF, sample_order)
       elapsed_time = time.time() - start_time   
       print 'Imported %s (%f sec)' % (importGZVCF, elapsed_time)
 
@@ -41,4 +52,11 @@ if __name__ == '__main__':
       hvcf.create_sample_subset(pop, samples)
       print 'Population imported: %s (%d samples)' % (pop, len(samples))
 
+   if args.ldMaxDistance is not None:
+      for pop in sorted(populations.iterkeys()):
+         start_time = time.time()
+         hvcf.create_ld_store(pop, args.ldMaxDistance, args.ldMinRsquare)
+         elapsed_time = time.time() - start_time
+         print 'LD precomputed: %s (%f sec)' % (pop, elapsed_time)
+
    hvcf.close()
@@ -1,12 +1,14 @@
-from flask import Flask, request, abort, jsonify
+from flask import Flask, Response, request, abort, jsonify
 import PyHVCF
+import numpy
 import time
 
 app = Flask(__name__)
 
 hvcf_file = 'test.h5'
+hvcf_readers = 8
 
-hvcf = PyHVCF.HVCF()
+hvcf = PyHVCF.HVCFReaderPool(hvcf_readers)
 hvcf.open(hvcf_file)
 
 @app.route('/', methods = ['GET'])
@@ -77,9 +79,7 @@ def get_frequencies():
    start_bp = request.args['startbp']
    end_bp = request.args['endbp']
 
-   frequencies = PyHVCF.Frequencies()
-
-   hvcf.compute_frequencies(str(population), str(chromosome), long(start_bp), long(end_bp), frequencies)
+   frequencies = hvcf.compute_frequencies_columns(str(population), str(chromosome), long(start_bp), long(end_bp))
 
    result = {
       'population': str(population),
@@ -87,19 +87,18 @@ def get_frequencies():
       'region_start_bp': long(start_bp),
       'region_end_bp': long(end_bp),
       'number_of_variants': len(frequencies),
-      'variants': [None] * len(frequencies)
+      'variants': [
+         {
+            'name': name,
+            'position': position,
+            'reference_allele': ref,
+            'alternate_allele': alt,
+            'reference_frequency': ref_af,
+            'alternate_frequency': alt_af
+         } for name, position, ref, alt, ref_af, alt_af in zip(frequencies.names, frequencies.positions.tolist(), frequencies.refs, frequencies.alts, frequencies.ref_af.tolist(), frequencies.alt_af.tolist())
+      ]
    }
 
-   for i, variant in enumerate(frequencies):
-      result['variants'][i] = {
-         'name': variant.name,
-         'position': variant.position,
-         'reference_allele': variant.ref,
-         'alternate_allele': variant.alt,
-         'reference_frequency': variant.ref_af,
-         'alternate_frequency': variant.alt_af
-      }
-
    j = jsonify(result)
 
    return j
@@ -112,54 +111,124 @@ def get_ld():
    end_bp = request.args['endbp']
    lead_variant = request.args.get('variant', None)
    compact = request.args.get('compact', None)
+   upper_triangle = request.args.get('upper_triangle', None)
+   min_rsquare = request.args.get('min_rsquare', None)
+   max_distance = request.args.get('max_distance', None)
 
-   pairs = PyHVCF.Pairs()
-
+   # pairs as columns: variant ordinals (index1, index2) into names and positions, r and r^2
    start_time = time.time()
    if not lead_variant:
-      hvcf.compute_ld(str(population), str(chromosome), long(start_bp), long(end_bp), pairs)
+      options = PyHVCF.LDOptions() # defaults keep all pairs
+      options.upper_triangle = upper_triangle is not None and upper_triangle.lower() in ('1', 'true', 'yes')
+      if min_rsquare is not None:
+         options.min_rsquare = float(min_rsquare)
+      if max_distance is not None:
+         options.max_distance = long(max_distance)
+      ld = hvcf.compute_ld_pairs_columns(str(population), str(chromosome), long(start_bp), long(end_bp), options)
+      index1 = ld.index1
+      index2 = ld.index2
+      r = ld.r
+      rsquare = ld.rsquare
    else:
-      hvcf.compute_ld(str(population), str(chromosome), str(lead_variant), long(start_bp), long(end_bp), pairs)
+      ld = hvcf.compute_ld_columns(str(population), str(chromosome), str(lead_variant), long(start_bp), long(end_bp))
+      if ld.get_n_rows() > 0:
+         lead = ld.rows[0]
+         index2 = numpy.flatnonzero(numpy.arange(ld.get_n_columns()) != lead) # lead variant is not paired with itself
+         r = ld.r[0][index2]
+         rsquare = ld.rsquare[0][index2]
+      else:
+         lead = 0
+         index2 = numpy.empty(0, dtype = numpy.intp)
+         r = numpy.empty(0)
+         rsquare = numpy.empty(0)
+      index1 = numpy.full(len(index2), lead, dtype = numpy.intp)
+   names = ld.names
+   positions = ld.positions
+   n_pairs = len(r)
    elapsed_time = time.time() - start_time
-   print 'HVCF request executed in ', elapsed_time, ' sec (', len(pairs), ')'
+   print 'HVCF request executed in ', elapsed_time, ' sec (', n_pairs, ')'
 
    start_time = time.time()
+   names2 = [names[i] for i in index2.tolist()]
+   positions2 = positions[index2].tolist()
    if compact is None:
+      names1 = [names[i] for i in index1.tolist()]
+      positions1 = positions[index1].tolist()
       result = {
          'population': str(population),
          'chromosome': str(chromosome),
          'region_start_bp': long(start_bp),
          'region_end_bp': long(end_bp),
-         'number_of_pairs': len(pairs),
-         'pairs': [None] * len(pairs)
+         'number_of_pairs': n_pairs,
+         'pairs': [
+            {
+               'name1': name1,
+               'position1': position1,
+               'name2': name2,
+               'position2': position2,
+               'r': pair_r,
+               'rsquare': pair_rsquare
+            } for name1, position1, name2, position2, pair_r, pair_rsquare in zip(names1, positions1, names2, positions2, r.tolist(), rsquare.tolist())
+         ]
       }
-
-      for i, pair in enumerate(pairs):
-         result['pairs'][i] = { 
-            'name1': pair.name1,
-            'position1': pair.position1,
-            'name2': pair.name2,
-            'position2': pair.position2,
-            'r': pair.r,
-            'rsquare': pair.rsquare
-         }
    else:
       result = {
-         'chromosome': [str(chromosome)] * len(pairs),
-         'variant': [None] * len(pairs),
-         'position': [None] * len(pairs),
-         'r': [None] * len(pairs),
-         'rsquare': [None] * len(pairs)
+         'chromosome': [str(chromosome)] * n_pairs,
+         'variant': names2,
+         'position': positions2,
+         'r': r.tolist(),
+         'rsquare': rsquare.tolist()
+      }
+
+   j = jsonify(result)
+   elapsed_time = time.time() - start_time
+   print 'Response formatting executed in ', elapsed_time, ' sec (', n_pairs, ')'
+
+   return j
+
+@app.route('/ld/leads', methods = ['GET'])
+def get_ld_leads():
+   population = request.args['population']
+   chromosome = request.args['chromosome']
+   lead_variants = request.args['variants'].split(',')
+   flank = request.args.get('flank', None)
+
+   window = PyHVCF.LDWindow()
+   if flank is not None:
+      window.flank = long(flank)
+
+   start_time = time.time()
+   ld = hvcf.compute_ld_batch_columns(str(population), str(chromosome), [str(v) for v in lead_variants], window)
+   elapsed_time = time.time() - start_time
+   print 'HVCF request executed in ', elapsed_time, ' sec (', ld.get_n_leads(), ' lead variants)'
+
+   start_time = time.time()
+   names = ld.names
+   positions = ld.positions
+   r = ld.r
+   rsquare = ld.rsquare
+   result = {
+      'population': str(population),
+      'chromosome': str(chromosome),
+      'number_of_leads': ld.get_n_leads(),
+      'leads': [None] * ld.get_n_leads()
+   }
+   for i in xrange(ld.get_n_leads()):
+      first = ld.window_starts[i]
+      last = first + ld.get_window_size(i)
+      offset = ld.offsets[i]
+      result['leads'][i] = {
+         'variant': names[ld.leads[i]],
+         'position': long(positions[ld.leads[i]]),
+         'variants': names[first:last],
+         'positions': positions[first:last].tolist(),
+         'r': r[offset:offset + last - first].tolist(),
+         'rsquare': rsquare[offset:offset + last - first].tolist()
       }
-      for i, pair in enumerate(pairs):
-         result['variant'][i] = pair.name2
-         result['position'][i] = pair.position2
-         result['r'][i] = pair.r
-         result['rsquare'][i] = pair.rsquare
 
    j = jsonify(result)
    elapsed_time = time.time() - start_time
-   print 'Response formatting executed in ', elapsed_time, ' sec (', len(pairs), ')'
+   print 'Response formatting executed in ', elapsed_time, ' sec (', len(r), ')'
 
    return j
 
@@ -222,5 +291,9 @@ def get_sample_haplotypes():
    j = jsonify(result)
    return j
 
+@app.route('/metrics', methods = ['GET'])
+def get_metrics():
+   return Response(hvcf.get_metrics().to_prometheus(), mimetype = 'text/plain; version=0.0.4')
+
 if __name__ == '__main__':
-   app.run(host='0.0.0.0', port=5000)
+   app.run(host='0.0.0.0', port=5000, threaded=True)
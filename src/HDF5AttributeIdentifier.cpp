@@ -0,0 +1,26 @@
+#include "include/HDF5AttributeIdentifier.h"
+
+namespace sph_umich_edu {
+
+HDF5AttributeIdentifier::HDF5AttributeIdentifier() {
+
+}
+
+HDF5AttributeIdentifier::~HDF5AttributeIdentifier() noexcept {
+	try {
+		close();
+	} catch (std::exception &e) {
+		// do not propagate any exceptions
+	}
+}
+
+void HDF5AttributeIdentifier::close() throw (HVCFException) {
+	if (identifier >= 0) {
+		if (H5Aclose(identifier) < 0) {
+			throw HVCFException(__FILE__, __FUNCTION__, __LINE__, "Error while closing HDF5 attribute identifier.");
+		}
+		this->identifier = numeric_limits<hid_t>::min();
+	}
+}
+
+}
@@ -6,8 +6,19 @@ constexpr char HVCF::CHROMOSOMES_GROUP[];
 constexpr char HVCF::SAMPLES_GROUP[];
 constexpr char HVCF::VARIANTS_DATASET[];
 constexpr char HVCF::HAPLOTYPES_DATASET[];
+constexpr char HVCF::HAPLOTYPES_BY_SAMPLE_DATASET[];
+constexpr char HVCF::HAPLOTYPE_ENDS_DATASET[];
+constexpr char HVCF::HAPLOTYPE_CHECKPOINTS_DATASET[];
+constexpr char HVCF::VARIANT_COLUMNS_GROUP[];
+constexpr char HVCF::VARIANT_POSITIONS_DATASET[];
+constexpr char HVCF::VARIANT_POSITION_ANCHORS_DATASET[];
+constexpr char HVCF::VARIANT_ALLELES_DATASET[];
+constexpr char HVCF::VARIANT_ALLELE_ENDS_DATASET[];
+constexpr char HVCF::VARIANT_ALLELE_BYTES_DATASET[];
 constexpr char HVCF::SAMPLE_NAMES_DATASET[];
 constexpr char HVCF::SAMPLE_SUBSETS_DATASET[];
+constexpr char HVCF::SAMPLE_COLUMNS_DATASET[];
+constexpr char HVCF::ALLELE_COUNTS_GROUP[];
 constexpr char HVCF::VARIABLE_LENGTH_STRING_TYPE[];
 constexpr char HVCF::VARIANTS_ENTRY_TYPE[];
 constexpr char HVCF::SUBSETS_ENTRY_TYPE[];
@@ -20,6 +31,21 @@ constexpr char HVCF::INTERVALS_INDEX_GROUP[];
 constexpr char HVCF::INTERVALS_INDEX[];
 constexpr char HVCF::HASH_INDEX[];
 constexpr char HVCF::INDEX_BUCKETS[];
+constexpr char HVCF::FINGERPRINTS_DATASET[];
+constexpr char HVCF::FINGERPRINT_BUCKETS_DATASET[];
+constexpr char HVCF::HAPLOTYPES_STORAGE_ATTRIBUTE[];
+constexpr char HVCF::PBWT_CHECKPOINT_INTERVAL_ATTRIBUTE[];
+constexpr char HVCF::LD_STORE_GROUP[];
+constexpr char HVCF::LD_STORE_OFFSETS_DATASET[];
+constexpr char HVCF::LD_STORE_COLUMNS_DATASET[];
+constexpr char HVCF::LD_STORE_R_DATASET[];
+constexpr char HVCF::LD_STORE_MAX_DISTANCE_ATTRIBUTE[];
+constexpr char HVCF::LD_STORE_MIN_RSQUARE_ATTRIBUTE[];
+constexpr char HVCF::NUCLEOTIDES[];
+constexpr unsigned char HVCF::BLOB_ALLELES;
+constexpr hsize_t HVCF::PBWT_CHUNK_SIZE;
+
+recursive_mutex HVCF::hdf5_mutex;
 
 
 HVCF::HVCF() : HVCF(HVCFConfiguration()) {
@@ -33,16 +59,37 @@ HVCF::HVCF(const HVCFConfiguration& configuration) {
 	N_VARIANTS_HASH_BUCKETS = configuration.n_variants_hash_buckets;
 	N_SAMPLES_HASH_BUCKETS = configuration.n_samples_hash_buckets;
 	MAX_VARIANTS_IN_INTERVAL_BUCKET = configuration.max_variants_in_interval_bucket;
+	MAX_CACHED_INTERVAL_BUCKETS = configuration.max_cached_interval_buckets;
 	VARIANTS_CHUNK_SIZE = configuration.variants_chunk_size;
 	SAMPLES_CHUNK_SIZE = configuration.samples_chunk_size;
 	COMPRESSION = configuration.compression;
 	COMPRESSION_LEVEL = configuration.compression_level;
+	HAPLOTYPES_STORAGE = configuration.haplotypes_storage;
+	PBWT_CHECKPOINT_INTERVAL = configuration.pbwt_checkpoint_interval;
+	VARIANTS_STORAGE = configuration.variants_storage;
+	HAPLOTYPES_BY_SAMPLE = configuration.haplotypes_by_sample && (strcmp(HAPLOTYPES_STORAGE, HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE) != 0); // PBWT columns are decoded whole, so there is nothing to gain from sample-major copy
+	HAPLOTYPES_BY_SAMPLE_CHUNK_SIZE = configuration.haplotypes_by_sample_chunk_size;
+	HAPLOTYPES_BY_SAMPLE_MAX_SAMPLES = configuration.haplotypes_by_sample_max_samples;
+	GATHER_MAX_GAP = configuration.gather_max_gap;
+	LD_ENGINE = configuration.ld_engine;
+	CHUNK_READER = configuration.chunk_reader;
+	READ_THREADS = configuration.read_threads;
+	IMPORT_THREADS = configuration.import_threads;
+	LD_THREADS = configuration.ld_threads;
+	LD_TILE_SIZE = configuration.ld_tile_size;
+	LD_STORE_CHUNK_SIZE = configuration.ld_store_chunk_size;
 	METADATA_CACHE_INITIAL_SIZE = configuration.metadata_cache_initial_size;
 	METADATA_CACHE_MIN_SIZE = configuration.metadata_cache_min_size;
 	METADATA_CACHE_MAX_SIZE = configuration.metadata_cache_max_size;
 	SIEVE_BUFFER_MAX_SIZE = configuration.sieve_buffer_max_size;
 	CHUNK_CACHE_N_SLOTS = configuration.chunk_cache_n_slots;
 	CHUNK_CACHE_SIZE = configuration.chunk_cache_size;
+	HAPLOTYPE_CACHE_SIZE = configuration.haplotype_cache_size;
+
+	haplotype_cache = shared_ptr<HaplotypeBlockCache>(new HaplotypeBlockCache(HAPLOTYPE_CACHE_SIZE));
+	worker_pool = unique_ptr<WorkerPool>(new WorkerPool(std::max(
+			(READ_THREADS > 0u) ? READ_THREADS : std::max(1u, thread::hardware_concurrency()),
+			(LD_THREADS > 0u) ? LD_THREADS : std::max(1u, thread::hardware_concurrency()))));
 
 //  Register Blosc
 	if (strcmp(COMPRESSION, HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION) == 0) {
@@ -261,232 +308,47 @@ void HVCF::initialize_ull_index_buckets(hid_t group_id, const char* index_group_
 	}
 }
 
-void HVCF::initialize_string_index_buckets(hid_t group_id, const char* index_group_name) throw (HVCFWriteException) {
+void HVCF::write_names_fingerprints(hid_t group_id, vector<ull_index_entry_type>& fingerprints, unsigned int n_buckets) throw (HVCFWriteException) {
 	HDF5GroupIdentifier index_group_id;
-	HDF5DataspaceIdentifier dataspace_id;
-	HDF5DatasetIdentifier dataset_id;
-	HDF5PropertyIdentifier dataset_property_id;
 	HDF5DatatypeIdentifier index_entry_type_id;
-
-	hsize_t initial_dims[1]{0};
-	hsize_t maximum_dims[1]{H5S_UNLIMITED};
-	hsize_t chunk_dims[1]{1000};
-
-	if ((index_entry_type_id = H5Topen(file_id, STRING_INDEX_ENTRY_TYPE, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening datatype.");
-	}
-
-	if ((index_group_id = H5Gopen(group_id, index_group_name, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
-	}
-
-	if ((dataspace_id = H5Screate_simple(1, initial_dims, maximum_dims)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataspace.");
-	}
-
-	if ((dataset_property_id = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset property.");
-	}
-
-	if (strcmp(COMPRESSION, HVCFConfiguration::GZIP_COMPRESSION) == 0) {
-		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_deflate(dataset_property_id, COMPRESSION_LEVEL) < 0)) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
-		}
-	} else if (strcmp(COMPRESSION, HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION) == 0) {
-		unsigned int cd_values[7];
-		cd_values[4] = COMPRESSION_LEVEL;
-		// 0 -- shuffle not active, 1 -- shuffle active
-		cd_values[5] = 1;
-		// Compressor to use
-		cd_values[6] = BLOSC_LZ4HC; // does better but slower compression. decompression is still very fast.
-		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_filter(dataset_property_id, FILTER_BLOSC, H5Z_FLAG_OPTIONAL, 7, cd_values) < 0)) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
-		}
-	} else {
-		if (H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
-		}
-	}
-
-	if ((dataset_id = H5Dcreate(index_group_id, INDEX_BUCKETS, index_entry_type_id, dataspace_id, H5P_DEFAULT, dataset_property_id, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
-	}
-}
-
-void HVCF::cache_names_index_bucket(hid_t group_id, hash_index_entry_type& hash_index_entry, vector<string_index_entry_type>& bucket, vector<string_index_entry_type>& buckets_cache) throw (HVCFWriteException) {
-	HDF5GroupIdentifier index_group_id;
 	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-
-	hsize_t file_dims[1]{0};
-	hsize_t mem_dims[1]{bucket.size()};
 
-	// BEGIN: sort bucket.
-	sort(bucket.begin(), bucket.end(),
-			[] (const string_index_entry_type& f, const string_index_entry_type& s) -> bool {
-				return (strcmp(f.string_value, s.string_value) < 0);
+	n_buckets = std::max(1u, n_buckets); // lookup takes fingerprint modulo number of buckets
+	vector<unsigned long long int> buckets(n_buckets + 1u, 0ull);
+
+	// every bucket is a contiguous range sorted by fingerprint, so that lookup reads one range and binary searches it
+	sort(fingerprints.begin(), fingerprints.end(),
+			[n_buckets] (const ull_index_entry_type& f, const ull_index_entry_type& s) -> bool {
+				unsigned long long int f_bucket = f.ull_value % n_buckets;
+				unsigned long long int s_bucket = s.ull_value % n_buckets;
+				if (f_bucket != s_bucket) {
+					return f_bucket < s_bucket;
+				}
+				return (f.ull_value < s.ull_value) || ((f.ull_value == s.ull_value) && (f.offset < s.offset));
 	});
-	// END: sort bucket.
-
-	// BEGIN: get file offset.
-	if ((index_group_id = H5Gopen(group_id, NAMES_INDEX_GROUP, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
-	}
-
-	if ((dataset_id = H5Dopen(index_group_id, INDEX_BUCKETS, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-	}
-
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-	// END: get file offset.
-
-	// BEGIN: set bucket location and write to buffer
-	hash_index_entry.bucket_offset = file_dims[0] + buckets_cache.size();
-	hash_index_entry.bucket_size = mem_dims[0];
-
-	buckets_cache.insert(buckets_cache.end(), bucket.begin(), bucket.end());
-	// END: set bucket location and write to buffer
-}
-
-void HVCF::write_names_index_buckets(hid_t group_id, vector<string_index_entry_type>& buckets_cache) throw (HVCFWriteException) {
-	if (buckets_cache.size() == 0u) {
-		return;
-	}
-
-	HDF5GroupIdentifier index_group_id;
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t file_dims[1]{0};
-	hsize_t mem_dims[1]{buckets_cache.size()};
-	hsize_t offset[1]{0};
-
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
-
-	// BEGIN: get file offset.
-	if ((index_group_id = H5Gopen(group_id, NAMES_INDEX_GROUP, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
-	}
-
-	if ((dataset_id = H5Dopen(index_group_id, INDEX_BUCKETS, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-	}
-
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	file_dataspace_id.close();
-	// END: get file offset.
-
-	offset[0] = file_dims[0];
-	file_dims[0] += mem_dims[0];
-
-	// BEGIN: set new file extent and write
-	if (H5Dset_extent(dataset_id, file_dims) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset dimensions.");
-	}
-
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, offset, nullptr, mem_dims, nullptr) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
-
-	if (H5Dwrite(dataset_id, string_index_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buckets_cache.data()) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing to dataset.");
-	}
-	// END: set new file extent and write
-
-	// BEGIN: deallocate char* allocated by HDF5
-	if (H5Dvlen_reclaim(string_index_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, buckets_cache.data()) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	for (auto&& fingerprint : fingerprints) {
+		++buckets[fingerprint.ull_value % n_buckets + 1u];
 	}
-	// END: deallocate char* allocated by HDF5
-
-	buckets_cache.clear();
-}
-
-void HVCF::write_names_index(hid_t group_id, const hash_index_entry_type* hash_index_entries, unsigned int n_hash_index_entries) throw (HVCFWriteException) {
-	if (n_hash_index_entries == 0u) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Empty list of offsets");
-	}
-
-	HDF5DatatypeIdentifier hash_index_entry_type_id;
-
-	HDF5GroupIdentifier index_group_id;
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-	HDF5PropertyIdentifier dataset_property_id;
-
-	hsize_t dims[1]{n_hash_index_entries};
-	hsize_t chunk_dims[1]{100};
-
-	if (dims[0] < chunk_dims[0]) {
-		chunk_dims[0] = dims[0];
+	for (unsigned int i = 1u; i <= n_buckets; ++i) {
+		buckets[i] += buckets[i - 1u];
 	}
 
-	// BEGIN: open comitted datatype.
-	if ((hash_index_entry_type_id = H5Topen(file_id, HASH_INDEX_ENTRY_TYPE, H5P_DEFAULT)) < 0) {
+	if ((index_entry_type_id = H5Topen(file_id, ULL_INDEX_ENTRY_TYPE, H5P_DEFAULT)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening datatype.");
 	}
-	// END: open comitted datatype.
 
 	if ((index_group_id = H5Gopen(group_id, NAMES_INDEX_GROUP, H5P_DEFAULT)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
 	}
 
-	if ((file_dataspace_id = H5Screate_simple(1, dims, NULL)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataspace.");
-	}
-
-	if ((dataset_property_id = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset property.");
-	}
-
-	if (strcmp(COMPRESSION, HVCFConfiguration::GZIP_COMPRESSION) == 0) {
-		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_deflate(dataset_property_id, COMPRESSION_LEVEL) < 0)) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
-		}
-	} else if (strcmp(COMPRESSION, HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION) == 0) {
-		unsigned int cd_values[7];
-		cd_values[4] = COMPRESSION_LEVEL;
-		// 0 -- shuffle not active, 1 -- shuffle active
-		cd_values[5] = 1;
-		// Compressor to use
-		cd_values[6] = BLOSC_LZ4HC; // does better but slower compression. decompression is still very fast.
-		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_filter(dataset_property_id, FILTER_BLOSC, H5Z_FLAG_OPTIONAL, 7, cd_values) < 0)) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
-		}
-	} else {
-		if (H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
-		}
-	}
-
-	if ((dataset_id = H5Dcreate(index_group_id, HASH_INDEX, hash_index_entry_type_id, file_dataspace_id, H5P_DEFAULT, dataset_property_id, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
-	}
+	dataset_id = create_column_dataset(index_group_id, FINGERPRINTS_DATASET, index_entry_type_id, 1000);
+	dataset_id.close();
+	dataset_id = create_column_dataset(index_group_id, FINGERPRINT_BUCKETS_DATASET, H5T_STD_U64LE, 10000);
+	dataset_id.close();
 
-	if (H5Dwrite(dataset_id, hash_index_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, hash_index_entries) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing to dataset.");
-	}
+	append_column(index_group_id, FINGERPRINTS_DATASET, ull_index_entry_memory_datatype_id, fingerprints.data(), fingerprints.size());
+	append_column(index_group_id, FINGERPRINT_BUCKETS_DATASET, H5T_NATIVE_ULLONG, buckets.data(), buckets.size());
 }
 
 void HVCF::cache_intervals_index_bucket(hid_t group_id, interval_index_entry_type& interval_index_entry, vector<ull_index_entry_type>& bucket, vector<ull_index_entry_type>& buckets_cache) throw (HVCFWriteException) {
@@ -671,63 +533,123 @@ void HVCF::write_intervals_index(hid_t chromosome_group_id, const interval_index
 	}
 }
 
-void HVCF::read_variant_names_into_bucket(hid_t chromosome_group_id, const vector<hsize_t>& offsets, vector<string_index_entry_type>& bucket) throw (HVCFWriteException) {
-	if (offsets.size() == 0u) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Empty list of offsets");
+unsigned int HVCF::compress_haplotypes_chunk(const unsigned char* chunk, size_t chunk_size, vector<unsigned char>& compressed) throw (HVCFWriteException) {
+	// Produces exactly what the dataset filter would produce, so that chunks can be written directly with H5DOwrite_chunk.
+	// Returns filter mask: as in HDF5, if the (optional) filter fails or doesn't shrink the chunk, then the chunk is stored as is.
+	if (strcmp(COMPRESSION, HVCFConfiguration::GZIP_COMPRESSION) == 0) {
+		uLongf compressed_size = compressBound(chunk_size);
+		compressed.resize(compressed_size);
+		if ((compress2(compressed.data(), &compressed_size, chunk, chunk_size, COMPRESSION_LEVEL) == Z_OK) && (compressed_size < chunk_size)) {
+			compressed.resize(compressed_size);
+			return 0u;
+		}
+	} else if (strcmp(COMPRESSION, HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION) == 0) {
+		compressed.resize(chunk_size);
+		int compressed_size = blosc_compress_ctx(COMPRESSION_LEVEL, 1, sizeof(unsigned char), chunk_size, chunk, compressed.data(), chunk_size, BLOSC_LZ4HC_COMPNAME, 0, 1);
+		if (compressed_size > 0) {
+			compressed.resize(compressed_size);
+			return 0u;
+		}
+	} else {
+		compressed.assign(chunk, chunk + chunk_size);
+		return 0u;
 	}
 
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t mem_dims[1]{offsets.size()};
-
-	variants_entry_type variants_buffer[offsets.size()];
-
-	// BEGIN: read variants.
-	if ((dataset_id = H5Dopen(chromosome_group_id, VARIANTS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-	}
+	compressed.assign(chunk, chunk + chunk_size);
+	return 1u;
+}
 
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+void HVCF::write_haplotypes_chunks(hid_t dataset_id, const unsigned char* buffer, hsize_t variant_offset, unsigned int n_variants, unsigned int n_columns, const hsize_t* chunk_dims) throw (HVCFWriteException) {
+	hsize_t n_column_chunks = (n_columns + chunk_dims[1] - 1u) / chunk_dims[1];
+	hsize_t n_chunks = ((n_variants + chunk_dims[0] - 1u) / chunk_dims[0]) * n_column_chunks;
+	size_t chunk_size = chunk_dims[0] * chunk_dims[1];
+
+	unsigned int n_threads = (IMPORT_THREADS > 0u) ? IMPORT_THREADS : std::max(1u, thread::hardware_concurrency());
+	if (n_threads > n_chunks) {
+		n_threads = n_chunks;
+	}
+
+	vector<vector<unsigned char>> compressed(n_chunks);
+	vector<unsigned int> filter_masks(n_chunks, 0u);
+	vector<bool> compressed_ready(n_chunks, false);
+	atomic<hsize_t> next_chunk(0u);
+	atomic<bool> stop(false);
+	bool failed = false;
+	mutex ready_mutex;
+	condition_variable ready_condition;
+
+	// BEGIN: compress chunks in parallel. Workers don't touch HDF5.
+	auto compress = [&]() -> void {
+		unique_ptr<unsigned char[]> chunk(new unsigned char[chunk_size]);
+		hsize_t c = 0u;
+		try {
+			while (!stop && ((c = next_chunk++) < n_chunks)) {
+				hsize_t first_variant = (c / n_column_chunks) * chunk_dims[0];
+				hsize_t first_column = (c % n_column_chunks) * chunk_dims[1];
+				hsize_t chunk_n_variants = std::min(chunk_dims[0], n_variants - first_variant);
+				hsize_t chunk_n_columns = std::min(chunk_dims[1], n_columns - first_column);
+				if ((chunk_n_variants < chunk_dims[0]) || (chunk_n_columns < chunk_dims[1])) { // edge chunks are stored padded to the full chunk size
+					memset(chunk.get(), 0, chunk_size);
+				}
+				for (hsize_t v = 0u; v < chunk_n_variants; ++v) {
+					memcpy(chunk.get() + v * chunk_dims[1], buffer + (first_variant + v) * n_columns + first_column, chunk_n_columns);
+				}
+				filter_masks[c] = compress_haplotypes_chunk(chunk.get(), chunk_size, compressed[c]);
+				lock_guard<mutex> ready_lock(ready_mutex);
+				compressed_ready[c] = true;
+				ready_condition.notify_all();
+			}
+		} catch (...) {
+			lock_guard<mutex> ready_lock(ready_mutex);
+			failed = true;
+			ready_condition.notify_all();
+			throw;
+		}
+	};
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	vector<future<void>> workers;
+	for (unsigned int i = 0u; i < n_threads; ++i) {
+		workers.emplace_back(async(std::launch::async, compress));
 	}
+	// END: compress chunks in parallel.
 
-	if (H5Sselect_elements(file_dataspace_id, H5S_SELECT_SET, offsets.size(), offsets.data()) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	// BEGIN: write chunks in order, as soon as they are compressed.
+	hsize_t chunk_offset[2]{0, 0};
+	for (hsize_t c = 0u; c < n_chunks; ++c) {
+		unique_lock<mutex> ready_lock(ready_mutex);
+		ready_condition.wait(ready_lock, [&]() -> bool { return compressed_ready[c] || failed; });
+		if (!compressed_ready[c]) {
+			break;
+		}
+		ready_lock.unlock();
 
-	if (H5Dread(dataset_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+		chunk_offset[0] = variant_offset + (c / n_column_chunks) * chunk_dims[0];
+		chunk_offset[1] = (c % n_column_chunks) * chunk_dims[1];
+		if (H5DOwrite_chunk(dataset_id, H5P_DEFAULT, filter_masks[c], chunk_offset, compressed[c].size(), compressed[c].data()) < 0) {
+			stop = true;
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing chunk to dataset.");
+		}
+		vector<unsigned char>().swap(compressed[c]);
 	}
-	// END: read variants.
 
-	bucket.resize(offsets.size());
-	for (unsigned int i = 0u; i < offsets.size(); ++i) {
-		bucket[i].string_value = variants_buffer[i].name;
-		bucket[i].offset = offsets[i];
+	for (auto&& worker : workers) {
+		worker.get();
 	}
+	// END: write chunks in order.
 }
 
-void HVCF::read_sample_names_into_bucket(hid_t samples_group_id, const vector<hsize_t>& offsets, vector<string_index_entry_type>& bucket) throw (HVCFWriteException) {
-	if (offsets.size() == 0u) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Empty list of offsets");
-	}
-
+void HVCF::write_haplotypes(hid_t group_id, const char* name, const unsigned char* buffer, unsigned int n_variants, unsigned int n_columns) throw (HVCFWriteException) {
 	HDF5DatasetIdentifier dataset_id;
 	HDF5DataspaceIdentifier file_dataspace_id;
 	HDF5DataspaceIdentifier memory_dataspace_id;
+	HDF5PropertyIdentifier dataset_property_id;
 
-	hsize_t mem_dims[1]{offsets.size()};
-
-	char* sample_names_buffer[offsets.size()];
+	hsize_t mem_dims[2]{n_variants, n_columns};
+	hsize_t file_dims[2]{0, 0};
+	hsize_t file_offset[2]{0, 0};
+	hsize_t chunk_dims[2]{0, 0};
 
-	// BEGIN: read samples.
-	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_NAMES_DATASET, H5P_DEFAULT)) < 0) {
+	if ((dataset_id = H5Dopen(group_id, name, H5P_DEFAULT)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
 	}
 
@@ -735,78 +657,135 @@ void HVCF::read_sample_names_into_bucket(hid_t samples_group_id, const vector<hs
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
 	}
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
 	}
 
-	if (H5Sselect_elements(file_dataspace_id, H5S_SELECT_SET, offsets.size(), offsets.data()) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	file_dataspace_id.close();
 
-	if (H5Dread(dataset_id, native_string_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, sample_names_buffer) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
-	// END: read samples.
+	file_offset[0] = file_dims[0];
+	file_offset[1] = 0;
+	file_dims[0] += mem_dims[0];
 
-	bucket.resize(offsets.size());
-	for (unsigned int i = 0u; i < offsets.size(); ++i) {
-		bucket[i].string_value = sample_names_buffer[i];
-		bucket[i].offset = offsets[i];
+	if (H5Dset_extent(dataset_id, file_dims) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset dimensions.");
 	}
-}
 
-void HVCF::read_positions_into_bucket(hid_t chromosome_group_id, const vector<hsize_t>& offsets, vector<ull_index_entry_type>& bucket) throw (HVCFWriteException) {
-	if (offsets.size() == 0u) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Empty list of offsets");
+	if ((dataset_property_id = H5Dget_create_plist(dataset_id)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset property.");
 	}
 
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t mem_dims[1]{offsets.size()};
-
-	variants_entry_type variants_buffer[offsets.size()];
+	if (H5Pget_chunk(dataset_property_id, 2, chunk_dims) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset chunk dimensions.");
+	}
 
-	// BEGIN: read variants.
-	if ((dataset_id = H5Dopen(chromosome_group_id, VARIANTS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	// Bypass the (single-threaded) HDF5 filter pipeline if buffer starts on a chunk boundary, i.e. it doesn't share chunks with previously written variants.
+	if (file_offset[0] % chunk_dims[0] == 0u) {
+		write_haplotypes_chunks(dataset_id, buffer, file_offset[0], n_variants, n_columns, chunk_dims);
+		return;
 	}
 
 	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
 	}
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims, nullptr)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
 	}
 
-	if (H5Sselect_elements(file_dataspace_id, H5S_SELECT_SET, offsets.size(), offsets.data()) < 0) {
+	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, nullptr, mem_dims, nullptr) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
 	}
 
-	if (H5Dread(dataset_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	if (H5Dwrite(dataset_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing to dataset.");
 	}
-	// END: read variants.
+}
 
-	bucket.resize(offsets.size());
-	for (unsigned int i = 0u; i < offsets.size(); ++i) {
-		bucket[i].ull_value = variants_buffer[i].position;
-		bucket[i].offset = offsets[i];
+void HVCF::write_pbwt_haplotypes(hid_t group_id, pbwt_builder_entry& pbwt_builder, const unsigned char* buffer, unsigned int n_variants, unsigned int n_columns) throw (HVCFWriteException) {
+	vector<unsigned int>& order = pbwt_builder.order;
+	vector<unsigned int> ones;
+	vector<unsigned char> runs;
+	vector<hsize_t> ends;
+	vector<unsigned int> checkpoints;
+
+	if (order.size() != n_columns) { // first variant of chromosome: haplotypes in column order
+		order.resize(n_columns);
+		for (unsigned int i = 0u; i < n_columns; ++i) {
+			order[i] = i;
+		}
+	}
+
+	ones.reserve(n_columns);
+	runs.reserve(n_variants * 16u);
+	ends.reserve(n_variants);
+
+	// Column of every variant lists its alleles in PBWT order of haplotypes, i.e. haplotypes sorted by alleles at previous variants (in reversed order).
+	// Haplotypes sharing long history end up next to each other, so column is few long runs of the same allele. Runs alternate, starting with a (possibly empty) run
+	// of 0 alleles, and their lengths are written as base-128 varints. Then haplotypes are stably sorted by allele of this variant, which gives order for the next one.
+	for (unsigned int v = 0u; v < n_variants; ++v) {
+		const unsigned char* row = buffer + v * n_columns;
+
+		if (pbwt_builder.n_variants % PBWT_CHECKPOINT_INTERVAL == 0u) {
+			checkpoints.insert(checkpoints.end(), order.begin(), order.end());
+		}
+
+		unsigned int n_zeros = 0u;
+		unsigned int run_length = 0u;
+		unsigned char allele = 0u;
+		ones.clear();
+		for (unsigned int i = 0u; i <= n_columns; ++i) {
+			unsigned char next_allele = (i < n_columns) ? row[order[i]] : static_cast<unsigned char>(allele ^ 1u);
+			if (next_allele > 1u) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while encoding haplotypes: non-binary allele.");
+			}
+			if (next_allele != allele) {
+				for (; run_length >= 0x80u; run_length >>= 7) {
+					runs.push_back(static_cast<unsigned char>((run_length & 0x7Fu) | 0x80u));
+				}
+				runs.push_back(static_cast<unsigned char>(run_length));
+				run_length = 0u;
+				allele = next_allele;
+			}
+			if (i < n_columns) {
+				if (allele == 0u) {
+					order[n_zeros++] = order[i];
+				} else {
+					ones.push_back(order[i]);
+				}
+				++run_length;
+			}
+		}
+		std::copy(ones.begin(), ones.end(), order.begin() + n_zeros);
+
+		ends.push_back(pbwt_builder.n_bytes + runs.size());
+		++pbwt_builder.n_variants;
+	}
+
+	append_column(group_id, HAPLOTYPES_DATASET, H5T_NATIVE_UCHAR, runs.data(), runs.size());
+	append_column(group_id, HAPLOTYPE_ENDS_DATASET, H5T_NATIVE_HSIZE, ends.data(), ends.size());
+	append_column(group_id, HAPLOTYPE_CHECKPOINTS_DATASET, H5T_NATIVE_UINT, checkpoints.data(), checkpoints.size());
+
+	pbwt_builder.n_bytes += runs.size();
+}
+
+void HVCF::write_variants(hid_t group_id, const variants_entry_type* buffer, unsigned int n_variants) throw (HVCFWriteException) {
+	if (strcmp(VARIANTS_STORAGE, HVCFConfiguration::COLUMNS_VARIANTS_STORAGE) == 0) {
+		write_variant_columns(group_id, buffer, n_variants);
+		return;
 	}
-}
 
-void HVCF::write_haplotypes(hid_t group_id, const unsigned char* buffer, unsigned int n_variants, unsigned int n_haplotypes) throw (HVCFWriteException) {
 	HDF5DatasetIdentifier dataset_id;
 	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5DatatypeIdentifier variants_entry_memory_datatype_id;
 	HDF5DataspaceIdentifier memory_dataspace_id;
 
-	hsize_t mem_dims[2]{n_variants, n_haplotypes};
-	hsize_t file_dims[2]{0, 0};
-	hsize_t file_offset[2]{0, 0};
+	hsize_t mem_dims[1]{n_variants};
+	hsize_t file_dims[1]{0};
+	hsize_t file_offset[1]{0};
 
-	if ((dataset_id = H5Dopen(group_id, HAPLOTYPES_DATASET, H5P_DEFAULT)) < 0) {
+	// BEGIN: get current dimensions.
+	if ((dataset_id = H5Dopen(group_id, VARIANTS_DATASET, H5P_DEFAULT)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
 	}
 
@@ -819,20 +798,31 @@ void HVCF::write_haplotypes(hid_t group_id, const unsigned char* buffer, unsigne
 	}
 
 	file_dataspace_id.close();
+	// END: get current dimensions.
 
+	// BEGIN: set new dimensions.
 	file_offset[0] = file_dims[0];
-	file_offset[1] = 0;
 	file_dims[0] += mem_dims[0];
 
 	if (H5Dset_extent(dataset_id, file_dims) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset dimensions.");
 	}
+	// END: set new dimensions.
+
+	// BEGIN: create memory datatype.
+	try {
+		variants_entry_memory_datatype_id = create_variants_entry_memory_datatype();
+	} catch (HVCFCreateException &e) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatypes.");
+	}
+	// END: create memory datatype.
 
+	// BEGIN: write.
 	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
 	}
 
-	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims, nullptr)) < 0) {
+	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
 	}
 
@@ -840,26 +830,180 @@ void HVCF::write_haplotypes(hid_t group_id, const unsigned char* buffer, unsigne
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
 	}
 
-	if (H5Dwrite(dataset_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
+	if (H5Dwrite(dataset_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing to dataset.");
 	}
+	// END: write.
 }
 
-void HVCF::write_variants(hid_t group_id, const variants_entry_type* buffer, unsigned int n_variants) throw (HVCFWriteException) {
+void HVCF::write_variant_columns(hid_t group_id, const variants_entry_type* buffer, unsigned int n_variants) throw (HVCFWriteException) {
+	HDF5GroupIdentifier columns_group_id;
+	HDF5DatasetIdentifier positions_id;
+	HDF5DatasetIdentifier anchors_id;
+	HDF5DatasetIdentifier allele_bytes_id;
+	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5PropertyIdentifier dataset_property_id;
+
+	hsize_t file_dims[1]{0};
+	hsize_t chunk_dims[1]{0};
+	hsize_t n_written_variants = 0;
+	unsigned long long int n_written_bytes = 0ull;
+	unsigned long long int previous_position = 0ull;
+	long long int delta = 0;
+
+	if ((columns_group_id = H5Gopen(group_id, VARIANT_COLUMNS_GROUP, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+	}
+
+	// BEGIN: get number of written variants, block size and size of alleles blob.
+	if ((positions_id = H5Dopen(columns_group_id, VARIANT_POSITIONS_DATASET, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	}
+
+	if ((file_dataspace_id = H5Dget_space(positions_id)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	}
+
+	n_written_variants = file_dims[0];
+	file_dataspace_id.close();
+
+	if ((dataset_property_id = H5Dget_create_plist(positions_id)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset property.");
+	}
+
+	if (H5Pget_chunk(dataset_property_id, 1, chunk_dims) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset chunk dimensions.");
+	}
+
+	dataset_property_id.close();
+
+	if ((allele_bytes_id = H5Dopen(columns_group_id, VARIANT_ALLELE_BYTES_DATASET, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	}
+
+	if ((file_dataspace_id = H5Dget_space(allele_bytes_id)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	}
+
+	n_written_bytes = file_dims[0];
+	file_dataspace_id.close();
+	allele_bytes_id.close();
+	// END: get number of written variants, block size and size of alleles blob.
+
+	// BEGIN: position of last written variant, if its block is not complete (i.e. next delta continues it).
+	if ((n_written_variants % chunk_dims[0]) != 0) {
+		hsize_t block_offset = n_written_variants - n_written_variants % chunk_dims[0];
+		vector<int> deltas(n_written_variants - block_offset);
+
+		if ((anchors_id = H5Dopen(columns_group_id, VARIANT_POSITION_ANCHORS_DATASET, H5P_DEFAULT)) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		}
+
+		try {
+			read_column(anchors_id, H5T_NATIVE_ULLONG, block_offset / chunk_dims[0], 1, &previous_position);
+			read_column(positions_id, H5T_NATIVE_INT, block_offset, deltas.size(), deltas.data());
+		} catch (HVCFReadException &e) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while reading positions of written variants.");
+		}
+
+		for (unsigned int i = 1u; i < deltas.size(); ++i) {
+			previous_position += deltas[i];
+		}
+
+		anchors_id.close();
+	}
+
+	positions_id.close();
+	// END: position of last written variant.
+
+	// BEGIN: encode columns.
+	vector<int> deltas(n_variants, 0);
+	vector<unsigned long long int> anchors;
+	vector<unsigned char> alleles(n_variants, 0u);
+	vector<unsigned long long int> allele_ends(n_variants, 0ull);
+	vector<char> allele_bytes;
+
+	auto encode_nucleotide = [](const char* allele) -> int {
+		if ((allele[0] == '\0') || (allele[1] != '\0')) {
+			return -1;
+		}
+		const char* nucleotide = strchr(NUCLEOTIDES, allele[0]);
+		return nucleotide != nullptr ? nucleotide - NUCLEOTIDES : -1;
+	};
+
+	for (unsigned int i = 0u; i < n_variants; ++i) {
+		if (((n_written_variants + i) % chunk_dims[0]) == 0) {
+			anchors.push_back(buffer[i].position);
+		} else {
+			delta = static_cast<long long int>(buffer[i].position) - static_cast<long long int>(previous_position);
+			if ((delta < numeric_limits<int>::min()) || (delta > numeric_limits<int>::max())) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Distance between consecutive variants doesn't fit into 32 bits.");
+			}
+			deltas[i] = static_cast<int>(delta);
+		}
+		previous_position = buffer[i].position;
+
+		int ref_code = encode_nucleotide(buffer[i].ref);
+		int alt_code = encode_nucleotide(buffer[i].alt);
+
+		if ((ref_code >= 0) && (alt_code >= 0)) {
+			alleles[i] = static_cast<unsigned char>(ref_code | (alt_code << 2));
+		} else {
+			alleles[i] = BLOB_ALLELES;
+			allele_bytes.insert(allele_bytes.end(), buffer[i].ref, buffer[i].ref + strlen(buffer[i].ref) + 1u);
+			allele_bytes.insert(allele_bytes.end(), buffer[i].alt, buffer[i].alt + strlen(buffer[i].alt) + 1u);
+		}
+		allele_ends[i] = n_written_bytes + allele_bytes.size();
+	}
+	// END: encode columns.
+
+	// positions are appended last: their size is the number of variants in chromosome
+	append_column(columns_group_id, VARIANT_ALLELE_BYTES_DATASET, H5T_NATIVE_CHAR, allele_bytes.data(), allele_bytes.size());
+	append_column(columns_group_id, VARIANT_ALLELE_ENDS_DATASET, H5T_NATIVE_ULLONG, allele_ends.data(), n_variants);
+	append_column(columns_group_id, VARIANT_ALLELES_DATASET, H5T_NATIVE_UCHAR, alleles.data(), n_variants);
+	append_column(columns_group_id, VARIANT_POSITION_ANCHORS_DATASET, H5T_NATIVE_ULLONG, anchors.data(), anchors.size());
+	append_column(columns_group_id, VARIANT_POSITIONS_DATASET, H5T_NATIVE_INT, deltas.data(), n_variants);
+}
+
+void HVCF::write_allele_counts(hid_t group_id, const string& subset, const unsigned int* buffer, unsigned int n_variants) throw (HVCFWriteException) {
+	HDF5GroupIdentifier allele_counts_group_id;
 	HDF5DatasetIdentifier dataset_id;
 	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DatatypeIdentifier variants_entry_memory_datatype_id;
 	HDF5DataspaceIdentifier memory_dataspace_id;
 
 	hsize_t mem_dims[1]{n_variants};
 	hsize_t file_dims[1]{0};
 	hsize_t file_offset[1]{0};
 
-	// BEGIN: get current dimensions.
-	if ((dataset_id = H5Dopen(group_id, VARIANTS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	// BEGIN: open or create dataset.
+	if (H5Lexists(group_id, ALLELE_COUNTS_GROUP, H5P_DEFAULT) > 0) {
+		if ((allele_counts_group_id = H5Gopen(group_id, ALLELE_COUNTS_GROUP, H5P_DEFAULT)) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+		}
+	} else {
+		if ((allele_counts_group_id = H5Gcreate(group_id, ALLELE_COUNTS_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
+		}
+	}
+
+	if (H5Lexists(allele_counts_group_id, subset.c_str(), H5P_DEFAULT) > 0) {
+		if ((dataset_id = H5Dopen(allele_counts_group_id, subset.c_str(), H5P_DEFAULT)) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		}
+	} else {
+		dataset_id = create_allele_counts_dataset(allele_counts_group_id, subset, VARIANTS_CHUNK_SIZE);
 	}
+	// END: open or create dataset.
 
+	// BEGIN: get current dimensions.
 	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
 	}
@@ -880,13 +1024,62 @@ void HVCF::write_variants(hid_t group_id, const variants_entry_type* buffer, uns
 	}
 	// END: set new dimensions.
 
-	// BEGIN: create memory datatype.
-	try {
-		variants_entry_memory_datatype_id = create_variants_entry_memory_datatype();
-	} catch (HVCFCreateException &e) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatypes.");
+	// BEGIN: write.
+	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	}
+
+	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, nullptr, mem_dims, nullptr) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dwrite(dataset_id, H5T_NATIVE_UINT, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing to dataset.");
+	}
+	// END: write.
+}
+
+void HVCF::append_column(hid_t group_id, const char* name, hid_t memory_datatype_id, const void* buffer, hsize_t n) throw (HVCFWriteException) {
+	HDF5DatasetIdentifier dataset_id;
+	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5DataspaceIdentifier memory_dataspace_id;
+
+	hsize_t mem_dims[1]{n};
+	hsize_t file_dims[1]{0};
+	hsize_t file_offset[1]{0};
+
+	if (n == 0) {
+		return;
+	}
+
+	if ((dataset_id = H5Dopen(group_id, name, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	}
+
+	// BEGIN: get current dimensions.
+	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
 	}
-	// END: create memory datatype.
+
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	}
+
+	file_dataspace_id.close();
+	// END: get current dimensions.
+
+	// BEGIN: set new dimensions.
+	file_offset[0] = file_dims[0];
+	file_dims[0] += mem_dims[0];
+
+	if (H5Dset_extent(dataset_id, file_dims) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset dimensions.");
+	}
+	// END: set new dimensions.
 
 	// BEGIN: write.
 	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
@@ -901,12 +1094,28 @@ void HVCF::write_variants(hid_t group_id, const variants_entry_type* buffer, uns
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
 	}
 
-	if (H5Dwrite(dataset_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
+	if (H5Dwrite(dataset_id, memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing to dataset.");
 	}
 	// END: write.
 }
 
+void HVCF::delete_ld_store(hid_t chromosome_group_id, const string& subset) throw (HVCFWriteException) {
+	HDF5GroupIdentifier ld_store_group_id;
+
+	if (H5Lexists(chromosome_group_id, LD_STORE_GROUP, H5P_DEFAULT) <= 0) {
+		return;
+	}
+
+	if ((ld_store_group_id = H5Gopen(chromosome_group_id, LD_STORE_GROUP, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+	}
+
+	if ((H5Lexists(ld_store_group_id, subset.c_str(), H5P_DEFAULT) > 0) && (H5Ldelete(ld_store_group_id, subset.c_str(), H5P_DEFAULT) < 0)) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while deleting group.");
+	}
+}
+
 hid_t HVCF::create_sample_names_dataset(hid_t group_id, hsize_t chunk_size) throw (HVCFWriteException) {
 	HDF5DataspaceIdentifier dataspace_id;
 	HDF5DatasetIdentifier dataset_id;
@@ -1005,21 +1214,21 @@ hid_t HVCF::create_sample_subsets_dataset(hid_t group_id, hsize_t chunk_size) th
 	return dataset_id.release();
 }
 
-hid_t HVCF::create_haplotypes_dataset(hid_t group_id, hsize_t variants_chunk_size, hsize_t samples_chunk_size) throw (HVCFWriteException) {
+hid_t HVCF::create_haplotypes_matrix_dataset(hid_t group_id, const char* name, bool packed, hsize_t variants_chunk_size, hsize_t samples_chunk_size) throw (HVCFWriteException) {
 	HDF5DataspaceIdentifier dataspace_id;
 	HDF5DatasetIdentifier dataset_id;
 	HDF5PropertyIdentifier dataset_property_id;
 
 	hsize_t n_samples = get_n_samples();
-	hsize_t n_haplotypes = 2 * n_samples;
-	hsize_t haplotypes_chunk_size = 2 * samples_chunk_size;
+	hsize_t n_columns = packed ? (2 * n_samples + 7) / 8 : 2 * n_samples;
+	hsize_t haplotypes_chunk_size = packed ? (2 * samples_chunk_size + 7) / 8 : 2 * samples_chunk_size;
 
-	if (haplotypes_chunk_size > n_haplotypes) {
-		haplotypes_chunk_size = n_haplotypes;
+	if (haplotypes_chunk_size > n_columns) {
+		haplotypes_chunk_size = n_columns;
 	}
 
-	hsize_t initial_dims[2]{0, n_haplotypes};
-	hsize_t maximum_dims[2]{H5S_UNLIMITED, n_haplotypes};
+	hsize_t initial_dims[2]{0, n_columns};
+	hsize_t maximum_dims[2]{H5S_UNLIMITED, n_columns};
 	hsize_t chunk_dims[2]{variants_chunk_size, haplotypes_chunk_size};
 
 	if ((dataspace_id = H5Screate_simple(2, initial_dims, maximum_dims)) < 0) {
@@ -1050,13 +1259,77 @@ hid_t HVCF::create_haplotypes_dataset(hid_t group_id, hsize_t variants_chunk_siz
 		}
 	}
 
-	if ((dataset_id = H5Dcreate(group_id, HAPLOTYPES_DATASET, H5T_NATIVE_UCHAR, dataspace_id, H5P_DEFAULT, dataset_property_id, H5P_DEFAULT)) < 0) {
+	if ((dataset_id = H5Dcreate(group_id, name, H5T_NATIVE_UCHAR, dataspace_id, H5P_DEFAULT, dataset_property_id, H5P_DEFAULT)) < 0) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
 	}
 
 	return dataset_id.release();
 }
 
+hid_t HVCF::create_haplotypes_dataset(hid_t group_id, const char* name, hsize_t variants_chunk_size, hsize_t samples_chunk_size) throw (HVCFWriteException) {
+	HDF5DatasetIdentifier dataset_id;
+	HDF5DataspaceIdentifier attribute_dataspace_id;
+	HDF5DatatypeIdentifier attribute_datatype_id;
+	HDF5AttributeIdentifier attribute_id;
+
+	if (strcmp(HAPLOTYPES_STORAGE, HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE) == 0) {
+		// BEGIN: PBWT storage: run-length encoded columns of all variants one after another (see write_pbwt_haplotypes), end of every variant's column and PBWT order of all haplotypes at checkpoints.
+		if (PBWT_CHECKPOINT_INTERVAL == 0u) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset: PBWT checkpoint interval must be positive.");
+		}
+
+		dataset_id = create_column_dataset(group_id, name, H5T_STD_U8LE, PBWT_CHUNK_SIZE);
+
+		HDF5DatasetIdentifier column_dataset_id;
+		column_dataset_id = create_column_dataset(group_id, HAPLOTYPE_ENDS_DATASET, H5T_STD_U64LE, variants_chunk_size);
+		column_dataset_id.close();
+		column_dataset_id = create_column_dataset(group_id, HAPLOTYPE_CHECKPOINTS_DATASET, H5T_STD_U32LE, std::max(static_cast<hsize_t>(2u * get_n_samples()), static_cast<hsize_t>(1u))); // one checkpoint per chunk
+		column_dataset_id.close();
+
+		if ((attribute_dataspace_id = H5Screate(H5S_SCALAR)) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataspace.");
+		}
+
+		if ((attribute_id = H5Acreate(dataset_id, PBWT_CHECKPOINT_INTERVAL_ATTRIBUTE, H5T_STD_U32LE, attribute_dataspace_id, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating attribute.");
+		}
+
+		if (H5Awrite(attribute_id, H5T_NATIVE_UINT, &PBWT_CHECKPOINT_INTERVAL) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing attribute.");
+		}
+
+		attribute_id.close();
+		attribute_dataspace_id.close();
+		// END: PBWT storage.
+	} else {
+		dataset_id = create_haplotypes_matrix_dataset(group_id, name, strcmp(HAPLOTYPES_STORAGE, HVCFConfiguration::BIT_HAPLOTYPES_STORAGE) == 0, variants_chunk_size, samples_chunk_size);
+	}
+
+	// BEGIN: record storage layout, so that readers know how to unpack haplotypes.
+	if ((attribute_dataspace_id = H5Screate(H5S_SCALAR)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataspace.");
+	}
+
+	if ((attribute_datatype_id = H5Tcopy(H5T_C_S1)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating datatype.");
+	}
+
+	if (H5Tset_size(attribute_datatype_id, strlen(HAPLOTYPES_STORAGE)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting datatype size.");
+	}
+
+	if ((attribute_id = H5Acreate(dataset_id, HAPLOTYPES_STORAGE_ATTRIBUTE, attribute_datatype_id, attribute_dataspace_id, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating attribute.");
+	}
+
+	if (H5Awrite(attribute_id, attribute_datatype_id, HAPLOTYPES_STORAGE) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing attribute.");
+	}
+	// END: record storage layout.
+
+	return dataset_id.release();
+}
+
 hid_t HVCF::create_variants_dataset(hid_t group_id, hsize_t chunk_size) throw (HVCFWriteException) {
 	HDF5DatatypeIdentifier datatype_id;
 	HDF5DataspaceIdentifier dataspace_id;
@@ -1106,154 +1379,160 @@ hid_t HVCF::create_variants_dataset(hid_t group_id, hsize_t chunk_size) throw (H
 	return dataset_id.release();
 }
 
-void HVCF::create_chromosome_indices(hid_t chromosome_group_id) throw (HVCFWriteException) {
-	if ((H5Lexists(chromosome_group_id, NAMES_INDEX_GROUP, H5P_DEFAULT) > 0) ||
-			(H5Lexists(chromosome_group_id, INTERVALS_INDEX_GROUP, H5P_DEFAULT) > 0)) {
-		return;
-	}
-
-	HDF5GroupIdentifier names_index_group_id;
-	HDF5GroupIdentifier intervals_index_group_id;
+void HVCF::create_variant_columns(hid_t group_id, hsize_t chunk_size) throw (HVCFWriteException) {
+	HDF5GroupIdentifier columns_group_id;
 	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DatatypeIdentifier memory_datatype_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	const unsigned int read_chunk_size = 100000;
-
-	hsize_t file_dims[1]{0};
-	hsize_t file_offset[1]{0};
-	hsize_t mem_dims[1]{read_chunk_size};
 
-	variants_entry_type buffer[read_chunk_size];
+	if ((columns_group_id = H5Gcreate(group_id, VARIANT_COLUMNS_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
+	}
 
-	unordered_map<unsigned int, vector<hsize_t>> names_index_buckets;
-	auto names_index_buckets_it = names_index_buckets.end();
+	dataset_id = create_column_dataset(columns_group_id, VARIANT_POSITIONS_DATASET, H5T_STD_I32LE, chunk_size);
+	dataset_id.close();
+	dataset_id = create_column_dataset(columns_group_id, VARIANT_POSITION_ANCHORS_DATASET, H5T_STD_U64LE, chunk_size);
+	dataset_id.close();
+	dataset_id = create_column_dataset(columns_group_id, VARIANT_ALLELES_DATASET, H5T_STD_U8LE, chunk_size);
+	dataset_id.close();
+	dataset_id = create_column_dataset(columns_group_id, VARIANT_ALLELE_ENDS_DATASET, H5T_STD_U64LE, chunk_size);
+	dataset_id.close();
+	dataset_id = create_column_dataset(columns_group_id, VARIANT_ALLELE_BYTES_DATASET, H5T_STD_I8LE, chunk_size * 16u);
+	dataset_id.close();
+}
 
-	// index construction for positions is based on assumption that variants dataset are already ordered by position.
-	// we group positions into intervals. every interval will have not more than MAX_VARIANTS_PER_INTERVAL positions.
-	vector<vector<hsize_t>> intervals;
+hid_t HVCF::create_allele_counts_dataset(hid_t group_id, const string& subset, hsize_t chunk_size) throw (HVCFWriteException) {
+	HDF5DataspaceIdentifier dataspace_id;
+	HDF5DatasetIdentifier dataset_id;
+	HDF5PropertyIdentifier dataset_property_id;
 
-	std::hash<string> hash_function;
-	size_t hash_value;
+	hsize_t initial_dims[1]{0};
+	hsize_t maximum_dims[1]{H5S_UNLIMITED};
+	hsize_t chunk_dims[1]{chunk_size};
 
-	// BEGIN: create groups for indices.
-	if ((names_index_group_id = H5Gcreate(chromosome_group_id, NAMES_INDEX_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
+	if ((dataspace_id = H5Screate_simple(1, initial_dims, maximum_dims)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataspace.");
 	}
 
-	if ((intervals_index_group_id = H5Gcreate(chromosome_group_id, INTERVALS_INDEX_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
+	if ((dataset_property_id = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset property.");
 	}
-	// END: create groups for indices.
 
-	// BEGIN: get dataset dimensions.
-	if ((dataset_id = H5Dopen(chromosome_group_id, VARIANTS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	if (strcmp(COMPRESSION, HVCFConfiguration::GZIP_COMPRESSION) == 0) {
+		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_deflate(dataset_property_id, COMPRESSION_LEVEL) < 0)) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
+		}
+	} else if (strcmp(COMPRESSION, HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION) == 0) {
+		unsigned int cd_values[7];
+		cd_values[4] = COMPRESSION_LEVEL;
+		// 0 -- shuffle not active, 1 -- shuffle active
+		cd_values[5] = 1;
+		// Compressor to use
+		cd_values[6] = BLOSC_LZ4HC; // does better but slower compression. decompression is still very fast.
+		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_filter(dataset_property_id, FILTER_BLOSC, H5Z_FLAG_OPTIONAL, 7, cd_values) < 0)) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
+		}
+	} else {
+		if (H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
+		}
 	}
 
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	if ((dataset_id = H5Dcreate(group_id, subset.c_str(), H5T_STD_U32LE, dataspace_id, H5P_DEFAULT, dataset_property_id, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
 	}
 
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-	// END: get dataset dimensions.
+	return dataset_id.release();
+}
 
-	// BEGIN: create memory datatype.
-	try {
-		memory_datatype_id = create_variants_entry_memory_datatype();
-	} catch (HVCFCreateException &e) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatypes.");
+hid_t HVCF::create_column_dataset(hid_t group_id, const char* name, hid_t datatype_id, hsize_t chunk_size) throw (HVCFWriteException) {
+	HDF5DataspaceIdentifier dataspace_id;
+	HDF5DatasetIdentifier dataset_id;
+	HDF5PropertyIdentifier dataset_property_id;
+
+	hsize_t initial_dims[1]{0};
+	hsize_t maximum_dims[1]{H5S_UNLIMITED};
+	hsize_t chunk_dims[1]{chunk_size};
+
+	if ((dataspace_id = H5Screate_simple(1, initial_dims, maximum_dims)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataspace.");
 	}
-	// END: create memory datatype.
 
-	// BEGIN: read data in chunks.
-	while (file_offset[0] < file_dims[0]) {
-		if (file_offset[0] + read_chunk_size > file_dims[0]) {
-			mem_dims[0] = file_dims[0] - file_offset[0];
-		} else {
-			mem_dims[0] = read_chunk_size;
-		}
+	if ((dataset_property_id = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset property.");
+	}
 
-		if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	if (strcmp(COMPRESSION, HVCFConfiguration::GZIP_COMPRESSION) == 0) {
+		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_shuffle(dataset_property_id) < 0) || (H5Pset_deflate(dataset_property_id, COMPRESSION_LEVEL) < 0)) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
 		}
-
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, NULL, mem_dims, NULL) < 0) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	} else if (strcmp(COMPRESSION, HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION) == 0) {
+		unsigned int cd_values[7];
+		cd_values[4] = COMPRESSION_LEVEL;
+		// 0 -- shuffle not active, 1 -- shuffle active
+		cd_values[5] = 1;
+		// Compressor to use
+		cd_values[6] = BLOSC_LZ4HC;
+		if ((H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) || (H5Pset_filter(dataset_property_id, FILTER_BLOSC, H5Z_FLAG_OPTIONAL, 7, cd_values) < 0)) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
 		}
-
-		if (H5Dread(dataset_id, memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	} else {
+		if (H5Pset_chunk(dataset_property_id, 1, chunk_dims) < 0) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting dataset properties.");
 		}
+	}
 
-		for (unsigned int i = 0; i < mem_dims[0]; ++i) {
-			hash_value = hash_function(buffer[i].name) % N_VARIANTS_HASH_BUCKETS;
-			names_index_buckets_it = names_index_buckets.find(hash_value);
-			if (names_index_buckets_it == names_index_buckets.end()) {
-				names_index_buckets_it = names_index_buckets.emplace(hash_value, vector<hsize_t>()).first;
-			}
-			names_index_buckets_it->second.push_back(file_offset[0]);
-
-			if ((intervals.size() == 0) || (intervals.back().size() >= MAX_VARIANTS_IN_INTERVAL_BUCKET)) {
-				intervals.emplace_back();
-			}
-			intervals.back().push_back(file_offset[0]);
-
-			file_offset[0] += 1;
-		}
+	if ((dataset_id = H5Dcreate(group_id, name, datatype_id, dataspace_id, H5P_DEFAULT, dataset_property_id, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
+	}
 
-		if (H5Dvlen_reclaim(memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, buffer) < 0) {
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-		}
+	return dataset_id.release();
+}
 
-		memory_dataspace_id.close();
+void HVCF::create_chromosome_indices(hid_t chromosome_group_id, indices_builder_entry& indices_builder) throw (HVCFWriteException) {
+	if ((H5Lexists(chromosome_group_id, NAMES_INDEX_GROUP, H5P_DEFAULT) > 0) ||
+			(H5Lexists(chromosome_group_id, INTERVALS_INDEX_GROUP, H5P_DEFAULT) > 0)) {
+		return;
 	}
-	// END: read data in chunks.
 
-	// BEGIN: write indices on disk.
-	initialize_string_index_buckets(chromosome_group_id, NAMES_INDEX_GROUP);
+	HDF5GroupIdentifier names_index_group_id;
+	HDF5GroupIdentifier intervals_index_group_id;
 
-	hash_index_entry_type hash_index_keys[N_VARIANTS_HASH_BUCKETS];
-	vector<string_index_entry_type> hash_bucket;
-	vector<string_index_entry_type> hash_buckets_cache;
+	// index construction for positions is based on assumption that variants are written ordered by position.
+	// we group positions into intervals. every interval will have not more than MAX_VARIANTS_PER_INTERVAL positions.
+	hsize_t n_intervals = (indices_builder.positions.size() + MAX_VARIANTS_IN_INTERVAL_BUCKET - 1u) / MAX_VARIANTS_IN_INTERVAL_BUCKET;
 
-	for (unsigned int i = 0u; i < N_VARIANTS_HASH_BUCKETS; ++i) {
-		hash_index_keys[i].bucket_offset = 0;
-		hash_index_keys[i].bucket_size = 0;
+	// BEGIN: create groups for indices.
+	if ((names_index_group_id = H5Gcreate(chromosome_group_id, NAMES_INDEX_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
 	}
-	hash_bucket.reserve(1000);
-	hash_buckets_cache.reserve(200000);
 
-	for (auto&& bucket_offsets : names_index_buckets) {
-		read_variant_names_into_bucket(chromosome_group_id, bucket_offsets.second, hash_bucket);
-		cache_names_index_bucket(chromosome_group_id, hash_index_keys[bucket_offsets.first], hash_bucket, hash_buckets_cache);
-		if (hash_buckets_cache.size() > 100000) {
-			write_names_index_buckets(chromosome_group_id, hash_buckets_cache);
-		}
+	if ((intervals_index_group_id = H5Gcreate(chromosome_group_id, INTERVALS_INDEX_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
 	}
-	write_names_index_buckets(chromosome_group_id, hash_buckets_cache);
-	write_names_index(chromosome_group_id, hash_index_keys, N_VARIANTS_HASH_BUCKETS);
+	// END: create groups for indices.
+
+	// BEGIN: write indices on disk. Bucket contents were collected by index_variants() while variants were written.
+	write_names_fingerprints(chromosome_group_id, indices_builder.names_fingerprints, N_VARIANTS_HASH_BUCKETS);
 
 	initialize_ull_index_buckets(chromosome_group_id, INTERVALS_INDEX_GROUP);
 
-	interval_index_entry_type interval_index_keys[intervals.size()];
+	vector<interval_index_entry_type> interval_index_keys(n_intervals);
 	vector<ull_index_entry_type> intervals_bucket;
 	vector<ull_index_entry_type> intervals_buckets_cache;
 	intervals_bucket.reserve(1000);
 	intervals_buckets_cache.reserve(200000);
 
-	for (unsigned int i = 0; i < intervals.size(); ++i) {
-		read_positions_into_bucket(chromosome_group_id, intervals[i], intervals_bucket);
+	auto positions_it = indices_builder.positions.begin();
+	for (hsize_t i = 0u; i < n_intervals; ++i) {
+		auto interval_end_it = (static_cast<hsize_t>(indices_builder.positions.end() - positions_it) > MAX_VARIANTS_IN_INTERVAL_BUCKET) ? positions_it + MAX_VARIANTS_IN_INTERVAL_BUCKET : indices_builder.positions.end();
+		intervals_bucket.assign(positions_it, interval_end_it);
+		positions_it = interval_end_it;
 		cache_intervals_index_bucket(chromosome_group_id, interval_index_keys[i], intervals_bucket, intervals_buckets_cache);
 		if (intervals_buckets_cache.size() > 100000) {
 			write_intervals_index_buckets(chromosome_group_id, intervals_buckets_cache);
 		}
 	}
 	write_intervals_index_buckets(chromosome_group_id, intervals_buckets_cache);
-	write_intervals_index(chromosome_group_id, interval_index_keys, intervals.size());
+	write_intervals_index(chromosome_group_id, interval_index_keys.data(), n_intervals);
 	// END: write indices on disk.
 }
 
@@ -1290,63 +1569,86 @@ void HVCF::create_samples_indices() throw (HVCFWriteException) {
 
 	char* buffer[file_dims[0]];
 
-	unordered_map<unsigned int, vector<hsize_t>> names_index_buckets;
-	auto names_index_buckets_it = names_index_buckets.end();
-
-	std::hash<string> hash_function;
-	size_t hash_value;
+	vector<ull_index_entry_type> fingerprints;
 
 	if (H5Dread(samples_all_dataset_id, native_string_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer) < 0) {
 		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
 	}
 
-	for (unsigned int i = 0; i < file_dims[0]; ++i) {
-		hash_value = hash_function(buffer[i]) % N_SAMPLES_HASH_BUCKETS;
-		names_index_buckets_it = names_index_buckets.find(hash_value);
-		if (names_index_buckets_it == names_index_buckets.end()) {
-			names_index_buckets_it = names_index_buckets.emplace(hash_value, vector<hsize_t>()).first;
-		}
-		names_index_buckets_it->second.push_back(i);
+	fingerprints.reserve(file_dims[0]);
+	for (hsize_t i = 0u; i < file_dims[0]; ++i) {
+		fingerprints.push_back(ull_index_entry_type{NameHash::hash(buffer[i], strlen(buffer[i])), i});
 	}
 
 	if (H5Dvlen_reclaim(native_string_datatype_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
 		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
 	}
 
-	// BEGIN: write indices on disk.
-	initialize_string_index_buckets(samples_group_id, NAMES_INDEX_GROUP);
+	write_names_fingerprints(samples_group_id, fingerprints, N_SAMPLES_HASH_BUCKETS);
+}
 
-	hash_index_entry_type hash_index_keys[N_SAMPLES_HASH_BUCKETS];
+void HVCF::create_indices() throw (HVCFWriteException) {
+	create_samples_indices();
+	for (auto&& chromosome : chromosomes) {
+		create_chromosome_indices(chromosome.second->get(), indices_builders[chromosome.first]);
+	}
+	indices_builders.clear();
+}
 
-	vector<string_index_entry_type> bucket;
-	vector<string_index_entry_type> buckets_buffer;
+void HVCF::create_allele_counts(const string& subset) throw (HVCFWriteException) {
+	HDF5GroupIdentifier allele_counts_group_id;
 
-	for (unsigned int i = 0u; i < N_SAMPLES_HASH_BUCKETS; ++i) {
-		hash_index_keys[i].bucket_offset = 0;
-		hash_index_keys[i].bucket_size = 0;
+	auto subsets_cache_it = samples_cache.subsets.find(subset);
+	if (subsets_cache_it == samples_cache.subsets.end()) {
+		return;
 	}
-	bucket.reserve(100);
-	buckets_buffer.reserve(100);
 
-	for (auto&& bucket_offsets : names_index_buckets) {
-		read_sample_names_into_bucket(samples_group_id, bucket_offsets.second, bucket);
-		cache_names_index_bucket(samples_group_id, hash_index_keys[bucket_offsets.first], bucket, buckets_buffer);
-		if (buckets_buffer.size() > 100) {
-			write_names_index_buckets(samples_group_id, buckets_buffer);
-		}
-	}
-	write_names_index_buckets(samples_group_id, buckets_buffer);
-	write_names_index(samples_group_id, hash_index_keys, N_SAMPLES_HASH_BUCKETS);
-}
+	hsize_t n_haplotypes = 2 * subsets_cache_it->second.n_samples;
+	hsize_t n_variants = 0;
+	hsize_t n_block_variants = 0;
 
-void HVCF::create_indices() throw (HVCFWriteException) {
-	create_samples_indices();
-	for (auto&& chromosome : chromosomes) {
-		create_chromosome_indices(chromosome.second->get());
+	unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[VARIANTS_CHUNK_SIZE * n_haplotypes]);
+	unique_ptr<unsigned int[]> alt_counts = unique_ptr<unsigned int[]>(new unsigned int[VARIANTS_CHUNK_SIZE]);
+
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+
+	try {
+		for (auto&& chromosome_cache : chromosomes_cache) {
+			hid_t chromosome_group_id = chromosomes.find(chromosome_cache.first)->second->get();
+
+			// BEGIN: drop counts materialized for the previous definition of this subset.
+			if (H5Lexists(chromosome_group_id, ALLELE_COUNTS_GROUP, H5P_DEFAULT) > 0) {
+				if ((allele_counts_group_id = H5Gopen(chromosome_group_id, ALLELE_COUNTS_GROUP, H5P_DEFAULT)) < 0) {
+					throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+				}
+				if ((H5Lexists(allele_counts_group_id, subset.c_str(), H5P_DEFAULT) > 0) && (H5Ldelete(allele_counts_group_id, subset.c_str(), H5P_DEFAULT) < 0)) {
+					throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while deleting dataset.");
+				}
+				allele_counts_group_id.close();
+			}
+			// END: drop counts.
+
+			// BEGIN: count alternate alleles reading one row of haplotype chunks at a time.
+			n_variants = get_n_variants_in_chromosome(chromosome_cache.first);
+			for (hsize_t offset = 0; offset < n_variants; offset += n_block_variants) {
+				n_block_variants = std::min(static_cast<hsize_t>(VARIANTS_CHUNK_SIZE), n_variants - offset);
+				read_haplotypes(*chromosome_cache.second, subsets_cache_it->second.chunks, offset, n_block_variants, haplotypes.get(), hdf5_lock);
+				for (hsize_t i = 0; i < n_block_variants; ++i) {
+					alt_counts[i] = 0u;
+					for (hsize_t j = i * n_haplotypes; j < i * n_haplotypes + n_haplotypes; ++j) {
+						alt_counts[i] += haplotypes[j];
+					}
+				}
+				write_allele_counts(chromosome_group_id, subset, alt_counts.get(), n_block_variants);
+			}
+			// END: count alternate alleles.
+		}
+	} catch (HVCFReadException &e) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while computing allele counts.");
 	}
 }
 
-void HVCF::write_samples(const vector<string>& samples) throw (HVCFWriteException) {
+void HVCF::write_samples(const vector<string>& samples, const vector<string>& sample_order) throw (HVCFWriteException) {
 	if (H5Lexists(samples_group_id, SAMPLE_NAMES_DATASET, H5P_DEFAULT) > 0) {
 		return;
 	}
@@ -1398,6 +1700,38 @@ void HVCF::write_samples(const vector<string>& samples) throw (HVCFWriteExceptio
 	memory_dataspace_id.close();
 	file_dataspace_id.close();
 
+	// BEGIN: columns of samples along haplotypes axis: listed samples first, in the given order, then the rest in VCF order. Stored only if it isn't VCF order.
+	vector<hsize_t> columns(samples.size(), samples.size()); // samples.size() -- not placed yet
+	hsize_t n_placed = 0u;
+	bool permuted = false;
+
+	if (!sample_order.empty()) {
+		unordered_map<string, hsize_t> offsets;
+		for (hsize_t i = 0u; i < samples.size(); ++i) {
+			offsets.emplace(samples[i], i);
+		}
+		for (auto&& sample : sample_order) {
+			auto offsets_it = offsets.find(sample);
+			if ((offsets_it != offsets.end()) && (columns[offsets_it->second] == samples.size())) {
+				columns[offsets_it->second] = n_placed++;
+			}
+		}
+	}
+
+	for (hsize_t i = 0u; i < samples.size(); ++i) {
+		if (columns[i] == samples.size()) {
+			columns[i] = n_placed++;
+		}
+		permuted |= (columns[i] != i);
+	}
+
+	if (permuted) {
+		dataset_id = create_column_dataset(samples_group_id, SAMPLE_COLUMNS_DATASET, H5T_STD_U64LE, 1000);
+		dataset_id.close();
+		append_column(samples_group_id, SAMPLE_COLUMNS_DATASET, H5T_NATIVE_HSIZE, columns.data(), columns.size());
+	}
+	// END: columns of samples.
+
 	mem_dims[0] = 1;
 	file_offset[0] = 0;
 	file_dims[0] = 1;
@@ -1447,12 +1781,33 @@ void HVCF::flush_write_buffer(future<void>& async_write) throw (HVCFWriteExcepti
 				async_write.wait();
 			}
 			auto flushed = buffers_it->second->flush();
-			write_haplotypes(entry.second->get(), std::get<0>(flushed), std::get<2>(flushed), std::get<3>(flushed));
+			index_variants(entry.first, std::get<1>(flushed), std::get<2>(flushed));
+			if (strcmp(HAPLOTYPES_STORAGE, HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE) == 0) {
+				write_pbwt_haplotypes(entry.second->get(), pbwt_builders[entry.first], std::get<0>(flushed), std::get<2>(flushed), std::get<3>(flushed));
+			} else {
+				write_haplotypes(entry.second->get(), HAPLOTYPES_DATASET, std::get<0>(flushed), std::get<2>(flushed), std::get<3>(flushed));
+			}
+			if (HAPLOTYPES_BY_SAMPLE) {
+				write_haplotypes(entry.second->get(), HAPLOTYPES_BY_SAMPLE_DATASET, std::get<0>(flushed), std::get<2>(flushed), std::get<3>(flushed));
+			}
 			write_variants(entry.second->get(), std::get<1>(flushed), std::get<2>(flushed));
+			write_allele_counts(entry.second->get(), "ALL", std::get<4>(flushed), std::get<2>(flushed));
 		}
 	}
 }
 
+void HVCF::index_variants(const string& chromosome, const variants_entry_type* variants, unsigned int n_variants) {
+	indices_builder_entry& indices_builder = indices_builders[chromosome];
+	hsize_t offset = indices_builder.positions.size(); // flushed buffers are written in order, so the next offset equals the number of variants indexed so far
+
+	indices_builder.names_fingerprints.reserve(indices_builder.names_fingerprints.size() + n_variants);
+	indices_builder.positions.reserve(indices_builder.positions.size() + n_variants);
+	for (unsigned int i = 0u; i < n_variants; ++i, ++offset) {
+		indices_builder.names_fingerprints.push_back(ull_index_entry_type{NameHash::hash(variants[i].name, strlen(variants[i].name)), offset});
+		indices_builder.positions.push_back(ull_index_entry_type{variants[i].position, offset});
+	}
+}
+
 void HVCF::write_variant(const Variant& variant, future<void>& async_write) throw (HVCFWriteException) {
 	const string& chromosome = variant.get_chrom().get_value();
 	auto chromosomes_it = chromosomes.end();
@@ -1464,7 +1819,7 @@ void HVCF::write_variant(const Variant& variant, future<void>& async_write) thro
 
 	if (chromosomes.count(chromosome) == 0) {
 		chromosomes_it = chromosomes.emplace(chromosome, std::move(unique_ptr<HDF5GroupIdentifier>(new HDF5GroupIdentifier()))).first;
-		buffers_it = write_buffers.emplace(chromosome, std::move(unique_ptr<WriteBuffer>(new WriteBuffer(100000, get_n_samples())))).first;
+		buffers_it = write_buffers.emplace(chromosome, std::move(unique_ptr<WriteBuffer>(new WriteBuffer(100000, get_n_samples(), strcmp(HAPLOTYPES_STORAGE, HVCFConfiguration::BIT_HAPLOTYPES_STORAGE) == 0, samples_cache.table->columns)))).first;
 		chromosomes_it->second->set(create_chromosome_group(chromosome));
 	} else {
 		chromosomes_it = chromosomes.find(chromosome);
@@ -1478,18 +1833,32 @@ void HVCF::write_variant(const Variant& variant, future<void>& async_write) thro
 
 		auto write = [&](
 				hid_t group_id,
+				pbwt_builder_entry* pbwt_builder,
 				const unsigned char* haplotypes,
 				const variants_entry_type* variants,
 				unsigned int n_variants,
-				unsigned int n_haplotypes) -> void {
-			write_haplotypes(group_id, haplotypes, n_variants, n_haplotypes);
+				unsigned int n_columns,
+				const unsigned int* alt_counts) -> void {
+			if (pbwt_builder != nullptr) {
+				write_pbwt_haplotypes(group_id, *pbwt_builder, haplotypes, n_variants, n_columns);
+			} else {
+				write_haplotypes(group_id, HAPLOTYPES_DATASET, haplotypes, n_variants, n_columns);
+			}
+			if (HAPLOTYPES_BY_SAMPLE) {
+				write_haplotypes(group_id, HAPLOTYPES_BY_SAMPLE_DATASET, haplotypes, n_variants, n_columns);
+			}
 			write_variants(group_id, variants, n_variants);
+			write_allele_counts(group_id, "ALL", alt_counts, n_variants);
 		};
 
 		auto flushed = buffers_it->second->flush();
+		index_variants(chromosome, std::get<1>(flushed), std::get<2>(flushed));
+
+		// PBWT state is looked up here, so that writing thread touches only its entry and never the map itself
+		pbwt_builder_entry* pbwt_builder = (strcmp(HAPLOTYPES_STORAGE, HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE) == 0) ? &pbwt_builders[chromosome] : nullptr;
 
 		async_write = async(std::launch::async,
-				write, chromosomes_it->second->get(), std::get<0>(flushed), std::get<1>(flushed), std::get<2>(flushed), std::get<3>(flushed));
+				write, chromosomes_it->second->get(), pbwt_builder, std::get<0>(flushed), std::get<1>(flushed), std::get<2>(flushed), std::get<3>(flushed), std::get<4>(flushed));
 	}
 
 	buffers_it->second->add_variant(variant);
@@ -1507,34 +1876,59 @@ hid_t HVCF::create_chromosome_group(const string& name) throw (HVCFWriteExceptio
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
 	}
 
-	dataset_id = create_haplotypes_dataset(group_id, VARIANTS_CHUNK_SIZE, SAMPLES_CHUNK_SIZE);
+	dataset_id = create_haplotypes_dataset(group_id, HAPLOTYPES_DATASET, VARIANTS_CHUNK_SIZE, SAMPLES_CHUNK_SIZE);
 	dataset_id.close();
 
-	dataset_id = create_variants_dataset(group_id, VARIANTS_CHUNK_SIZE);
-	dataset_id.close();
+	if (HAPLOTYPES_BY_SAMPLE) {
+		dataset_id = create_haplotypes_matrix_dataset(group_id, HAPLOTYPES_BY_SAMPLE_DATASET, strcmp(HAPLOTYPES_STORAGE, HVCFConfiguration::BIT_HAPLOTYPES_STORAGE) == 0, HAPLOTYPES_BY_SAMPLE_CHUNK_SIZE, 1); // always variants x haplotypes, written with write_haplotypes()
+		dataset_id.close();
+	}
+
+	if (strcmp(VARIANTS_STORAGE, HVCFConfiguration::COLUMNS_VARIANTS_STORAGE) == 0) {
+		create_variant_columns(group_id, VARIANTS_CHUNK_SIZE);
+	} else {
+		dataset_id = create_variants_dataset(group_id, VARIANTS_CHUNK_SIZE);
+		dataset_id.close();
+	}
 
 	return group_id.release();
 }
 
 void HVCF::load_chromosomes_cache() throw (HVCFReadException) {
 	HDF5GroupIdentifier index_group_id;
+	HDF5GroupIdentifier columns_group_id;
+	HDF5DataspaceIdentifier dataspace_id;
+	HDF5AttributeIdentifier attribute_id;
+	HDF5DatatypeIdentifier attribute_datatype_id;
+	HDF5PropertyIdentifier dataset_property_id;
+	htri_t attribute_exists = 0;
+	size_t attribute_size = 0;
+	hsize_t file_dims[1]{0};
+	int n_filters = 0;
+	H5Z_filter_t filter = H5Z_FILTER_ERROR;
+	unsigned int filter_flags = 0u;
+	size_t filter_cd_nelmts = 8u;
+	unsigned int filter_cd_values[8];
 	auto chromosomes_cache_it = chromosomes_cache.end();
 
 	chromosomes_cache.clear();
 
 	for (auto&& chromosome : chromosomes) {
 		chromosomes_cache_it = chromosomes_cache.emplace(chromosome.first, std::move(unique_ptr<chromosomes_cache_entry>(new chromosomes_cache_entry()))).first;
+		chromosomes_cache_it->second->name = chromosome.first;
 
 		if ((index_group_id = H5Gopen(chromosome.second->get(), NAMES_INDEX_GROUP, H5P_DEFAULT)) < 0) {
 			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
 		}
-		chromosomes_cache_it->second->names_index_id.set(H5Dopen(index_group_id, HASH_INDEX, H5P_DEFAULT));
-		if (chromosomes_cache_it->second->names_index_id.get() < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-		}
-		chromosomes_cache_it->second->names_index_buckets_id.set(H5Dopen(index_group_id, INDEX_BUCKETS, H5P_DEFAULT));
-		if (chromosomes_cache_it->second->names_index_buckets_id.get() < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		if (!load_names_fingerprints(index_group_id, chromosomes_cache_it->second->names_fingerprints_id, chromosomes_cache_it->second->names_fingerprint_buckets)) {
+			chromosomes_cache_it->second->names_index_id.set(H5Dopen(index_group_id, HASH_INDEX, H5P_DEFAULT));
+			if (chromosomes_cache_it->second->names_index_id.get() < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+			}
+			chromosomes_cache_it->second->names_index_buckets_id.set(H5Dopen(index_group_id, INDEX_BUCKETS, H5P_DEFAULT));
+			if (chromosomes_cache_it->second->names_index_buckets_id.get() < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+			}
 		}
 		index_group_id.close();
 
@@ -1551,126 +1945,1379 @@ void HVCF::load_chromosomes_cache() throw (HVCFReadException) {
 		}
 		index_group_id.close();
 
-		chromosomes_cache_it->second->variants_id.set(H5Dopen(chromosome.second->get(), VARIANTS_DATASET, H5P_DEFAULT));
-		if (chromosomes_cache_it->second->variants_id.get() < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		// BEGIN: keep whole top-level intervals index in memory (buckets are read on demand).
+		if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_id)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
 		}
 
-		chromosomes_cache_it->second->haplotypes_id.set(H5Dopen(chromosome.second->get(), HAPLOTYPES_DATASET, H5P_DEFAULT));
-		if (chromosomes_cache_it->second->haplotypes_id.get() < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		if (H5Sget_simple_extent_dims(dataspace_id, file_dims, NULL) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
 		}
-	}
-}
 
-void HVCF::load_samples_cache() throw (HVCFReadException) {
-	HDF5GroupIdentifier index_group_id;
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-	HDF5DatatypeIdentifier subsets_entry_memory_datatype_id;
+		chromosomes_cache_it->second->intervals_index.resize(file_dims[0]);
 
-	hsize_t file_dims[1]{0};
+		if ((file_dims[0] > 0) && (H5Dread(chromosomes_cache_it->second->intervals_index_id, interval_index_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, chromosomes_cache_it->second->intervals_index.data()) < 0)) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
+		}
 
-	samples_cache.names_index_id.close();
-	samples_cache.names_index_buckets_id.close();
-	samples_cache.subsets.clear();
+		dataspace_id.close();
+		// END: keep whole top-level intervals index in memory.
 
-	if ((index_group_id = H5Gopen(samples_group_id, NAMES_INDEX_GROUP, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
-	}
+		// BEGIN: open variant columns or (in files written with compound variants storage) variants dataset.
+		chromosomes_cache_it->second->variant_columns = (H5Lexists(chromosome.second->get(), VARIANT_COLUMNS_GROUP, H5P_DEFAULT) > 0);
 
-	if ((samples_cache.names_index_id = H5Dopen(index_group_id, HASH_INDEX, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-	}
+		if (chromosomes_cache_it->second->variant_columns) {
+			if ((columns_group_id = H5Gopen(chromosome.second->get(), VARIANT_COLUMNS_GROUP, H5P_DEFAULT)) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+			}
+			chromosomes_cache_it->second->variant_positions_id.set(H5Dopen(columns_group_id, VARIANT_POSITIONS_DATASET, H5P_DEFAULT));
+			chromosomes_cache_it->second->variant_position_anchors_id.set(H5Dopen(columns_group_id, VARIANT_POSITION_ANCHORS_DATASET, H5P_DEFAULT));
+			chromosomes_cache_it->second->variant_alleles_id.set(H5Dopen(columns_group_id, VARIANT_ALLELES_DATASET, H5P_DEFAULT));
+			chromosomes_cache_it->second->variant_allele_ends_id.set(H5Dopen(columns_group_id, VARIANT_ALLELE_ENDS_DATASET, H5P_DEFAULT));
+			chromosomes_cache_it->second->variant_allele_bytes_id.set(H5Dopen(columns_group_id, VARIANT_ALLELE_BYTES_DATASET, H5P_DEFAULT));
+			if ((chromosomes_cache_it->second->variant_positions_id.get() < 0) ||
+					(chromosomes_cache_it->second->variant_position_anchors_id.get() < 0) ||
+					(chromosomes_cache_it->second->variant_alleles_id.get() < 0) ||
+					(chromosomes_cache_it->second->variant_allele_ends_id.get() < 0) ||
+					(chromosomes_cache_it->second->variant_allele_bytes_id.get() < 0)) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+			}
+			columns_group_id.close();
 
-	if ((samples_cache.names_index_buckets_id = H5Dopen(index_group_id, INDEX_BUCKETS, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-	}
+			if ((dataset_property_id = H5Dget_create_plist(chromosomes_cache_it->second->variant_positions_id)) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset property.");
+			}
 
-	try {
-		subsets_entry_memory_datatype_id  = create_subsets_entry_memory_datatype();
-	} catch (HVCFCreateException &e) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatype.");
-	}
+			if (H5Pget_chunk(dataset_property_id, 1, &chromosomes_cache_it->second->variant_positions_block) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset chunk dimensions.");
+			}
 
-	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_SUBSETS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
-	}
+			dataset_property_id.close();
+		} else {
+			chromosomes_cache_it->second->variants_id.set(H5Dopen(chromosome.second->get(), VARIANTS_DATASET, H5P_DEFAULT));
+			if (chromosomes_cache_it->second->variants_id.get() < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+			}
+		}
+		// END: open variant columns or variants dataset.
 
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+		chromosomes_cache_it->second->haplotypes_id.set(H5Dopen(chromosome.second->get(), HAPLOTYPES_DATASET, H5P_DEFAULT));
+		if (chromosomes_cache_it->second->haplotypes_id.get() < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		}
 
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
+		// BEGIN: detect haplotypes storage layout (files without attribute store one allele per byte).
+		chromosomes_cache_it->second->haplotypes_packed = false;
+		chromosomes_cache_it->second->haplotypes_pbwt = false;
+		chromosomes_cache_it->second->haplotypes_pbwt_order_variant = 0u;
 
-	subsets_entry_type subsets_entry_buffer[file_dims[0]];
+		if ((attribute_exists = H5Aexists(chromosomes_cache_it->second->haplotypes_id, HAPLOTYPES_STORAGE_ATTRIBUTE)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while checking attribute.");
+		}
 
-	if (H5Dread(dataset_id, subsets_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+		if (attribute_exists > 0) {
+			if ((attribute_id = H5Aopen(chromosomes_cache_it->second->haplotypes_id, HAPLOTYPES_STORAGE_ATTRIBUTE, H5P_DEFAULT)) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening attribute.");
+			}
 
-	auto subsets_cache_it = samples_cache.subsets.end();
-	hsize_t offset_1 = 0;
-	hsize_t offset_2 = 0;
-	hsize_t size = 0;
-	for (hsize_t i = 0; i < file_dims[0]; ++i) {
-		subsets_cache_it = samples_cache.subsets.emplace(subsets_entry_buffer[i].name, subsets_cache_entry()).first;
-		offset_1 = subsets_entry_buffer[i].offset_1;
-		offset_2 = subsets_entry_buffer[i].offset_2;
-		size = offset_2 - offset_1 + 1u;
-		subsets_cache_it->second.chunks.emplace_back(offset_1, offset_2, size);
-		subsets_cache_it->second.n_samples += size;
-	}
+			if ((attribute_datatype_id = H5Aget_type(attribute_id)) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting attribute datatype.");
+			}
 
-	if (H5Dvlen_reclaim(subsets_entry_memory_datatype_id, file_dataspace_id, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-	}
-}
+			if ((attribute_size = H5Tget_size(attribute_datatype_id)) == 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting attribute datatype size.");
+			}
 
-void HVCF::load_cache() throw (HVCFReadException) {
-	load_samples_cache();
-	load_chromosomes_cache();
-}
+			char attribute_value[attribute_size + 1];
 
-void HVCF::create(const string& name) throw (HVCFWriteException) {
-	HDF5DatatypeIdentifier datatype_id;
-	HDF5PropertyIdentifier file_access_property_id;
-	H5AC_cache_config_t config;
-	size_t native_string_datatype_size = 0;
+			if (H5Aread(attribute_id, attribute_datatype_id, attribute_value) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading attribute.");
+			}
+			attribute_value[attribute_size] = '\0';
 
-	this->name = name;
+			chromosomes_cache_it->second->haplotypes_packed = (strcmp(attribute_value, HVCFConfiguration::BIT_HAPLOTYPES_STORAGE) == 0);
+			chromosomes_cache_it->second->haplotypes_pbwt = (strcmp(attribute_value, HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE) == 0);
 
-	if ((file_access_property_id = H5Pcreate(H5P_FILE_ACCESS)) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating file access property.");
-	}
+			attribute_datatype_id.close();
+			attribute_id.close();
+		}
+		// END: detect haplotypes storage layout.
 
-	config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
-	if (H5Pget_mdc_config(file_access_property_id, &config) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting metadata cache configuration.");
-	}
+		// BEGIN: PBWT storage: open ends of encoded columns and checkpoints; haplotypes dataset is one-dimensional, so its chunk size is in the first dimension.
+		if (chromosomes_cache_it->second->haplotypes_pbwt) {
+			if ((attribute_id = H5Aopen(chromosomes_cache_it->second->haplotypes_id, PBWT_CHECKPOINT_INTERVAL_ATTRIBUTE, H5P_DEFAULT)) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening attribute.");
+			}
 
-	config.set_initial_size = true;
-	config.initial_size = METADATA_CACHE_INITIAL_SIZE;
-	config.min_size = METADATA_CACHE_MIN_SIZE;
-	config.max_size = METADATA_CACHE_MAX_SIZE;
+			if (H5Aread(attribute_id, H5T_NATIVE_HSIZE, &chromosomes_cache_it->second->haplotypes_pbwt_interval) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading attribute.");
+			}
 
-	if (H5Pset_mdc_config(file_access_property_id, &config) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting metadata cache configuration.");
-	}
+			if (chromosomes_cache_it->second->haplotypes_pbwt_interval == 0u) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading attribute: PBWT checkpoint interval must be positive.");
+			}
 
-	if (H5Pset_sieve_buf_size(file_access_property_id, SIEVE_BUFFER_MAX_SIZE) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting sieve buffer size.");
-	}
+			attribute_id.close();
 
-	if (H5Pset_cache(file_access_property_id, 0, CHUNK_CACHE_N_SLOTS, CHUNK_CACHE_SIZE, 0.75) < 0) {
-		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Error while setting cache parameters.");
-	}
+			chromosomes_cache_it->second->haplotype_ends_id.set(H5Dopen(chromosome.second->get(), HAPLOTYPE_ENDS_DATASET, H5P_DEFAULT));
+			chromosomes_cache_it->second->haplotype_checkpoints_id.set(H5Dopen(chromosome.second->get(), HAPLOTYPE_CHECKPOINTS_DATASET, H5P_DEFAULT));
+			if ((chromosomes_cache_it->second->haplotype_ends_id.get() < 0) || (chromosomes_cache_it->second->haplotype_checkpoints_id.get() < 0)) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+			}
+		}
+		// END: PBWT storage.
 
-	if ((file_id = H5Fcreate(this->name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, file_access_property_id)) < 0) {
-		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Error while creating file.");
+		if ((dataset_property_id = H5Dget_create_plist(chromosomes_cache_it->second->haplotypes_id)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset property.");
+		}
+
+		if (H5Pget_chunk(dataset_property_id, 2, chromosomes_cache_it->second->haplotypes_chunk_dims) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset chunk dimensions.");
+		}
+
+		// BEGIN: detect compression of haplotypes chunks. Chunks can be read directly and decompressed outside HDF5 only if there is at most one known filter.
+		if ((n_filters = H5Pget_nfilters(dataset_property_id)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting number of dataset filters.");
+		}
+
+		chromosomes_cache_it->second->haplotypes_filter = H5Z_FILTER_ERROR;
+		if (n_filters == 0) {
+			chromosomes_cache_it->second->haplotypes_filter = H5Z_FILTER_NONE;
+		} else if (n_filters == 1) {
+			filter_cd_nelmts = 8u;
+			if ((filter = H5Pget_filter2(dataset_property_id, 0, &filter_flags, &filter_cd_nelmts, filter_cd_values, 0, nullptr, nullptr)) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset filter.");
+			}
+			if ((filter == H5Z_FILTER_DEFLATE) || (filter == FILTER_BLOSC)) {
+				chromosomes_cache_it->second->haplotypes_filter = filter;
+			}
+		}
+		// END: detect compression.
+
+		dataset_property_id.close();
+
+		if (H5Lexists(chromosome.second->get(), HAPLOTYPES_BY_SAMPLE_DATASET, H5P_DEFAULT) > 0) {
+			chromosomes_cache_it->second->haplotypes_by_sample_id.set(H5Dopen(chromosome.second->get(), HAPLOTYPES_BY_SAMPLE_DATASET, H5P_DEFAULT));
+			if (chromosomes_cache_it->second->haplotypes_by_sample_id.get() < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+			}
+
+			if ((dataset_property_id = H5Dget_create_plist(chromosomes_cache_it->second->haplotypes_by_sample_id)) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset property.");
+			}
+
+			if (H5Pget_chunk(dataset_property_id, 2, chromosomes_cache_it->second->haplotypes_by_sample_chunk_dims) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataset chunk dimensions.");
+			}
+
+			dataset_property_id.close();
+		}
+
+		load_ld_stores_cache(chromosome.second->get(), *chromosomes_cache_it->second);
+	}
+}
+
+void HVCF::load_ld_stores_cache(hid_t chromosome_group_id, chromosomes_cache_entry& chromosome_cache) throw (HVCFReadException) {
+	HDF5GroupIdentifier ld_store_group_id;
+	HDF5GroupIdentifier subset_group_id;
+	HDF5DataspaceIdentifier dataspace_id;
+	HDF5AttributeIdentifier attribute_id;
+	H5G_info_t group_info;
+	hsize_t file_dims[1]{0};
+	hsize_t n_variants = 0;
+	ssize_t subset_name_length = 0;
+	unique_ptr<char[]> subset_name = nullptr;
+	unique_ptr<ld_store_cache_entry> ld_store = nullptr;
+
+	chromosome_cache.ld_stores.clear();
+
+	if (H5Lexists(chromosome_group_id, LD_STORE_GROUP, H5P_DEFAULT) <= 0) {
+		return;
+	}
+
+	n_variants = get_n_variants_in_chromosome(chromosome_cache.name);
+
+	if ((ld_store_group_id = H5Gopen(chromosome_group_id, LD_STORE_GROUP, H5P_DEFAULT)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+	}
+
+	if (H5Gget_info(ld_store_group_id, &group_info) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting group information.");
+	}
+
+	for (hsize_t i = 0; i < group_info.nlinks; ++i) {
+		if ((subset_name_length = H5Lget_name_by_idx(ld_store_group_id, ".", H5_INDEX_NAME, H5_ITER_INC, i, NULL, 0, H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting group name size.");
+		}
+
+		subset_name = unique_ptr<char[]>(new char[subset_name_length + 1]{});
+
+		if (H5Lget_name_by_idx(ld_store_group_id, ".", H5_INDEX_NAME, H5_ITER_INC, i, subset_name.get(), subset_name_length + 1, H5P_DEFAULT) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting group name.");
+		}
+
+		if ((subset_group_id = H5Gopen(ld_store_group_id, subset_name.get(), H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+		}
+
+		ld_store = unique_ptr<ld_store_cache_entry>(new ld_store_cache_entry());
+
+		if ((attribute_id = H5Aopen(subset_group_id, LD_STORE_MAX_DISTANCE_ATTRIBUTE, H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening attribute.");
+		}
+
+		if (H5Aread(attribute_id, H5T_NATIVE_ULLONG, &ld_store->max_distance) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading attribute.");
+		}
+
+		attribute_id.close();
+
+		if ((attribute_id = H5Aopen(subset_group_id, LD_STORE_MIN_RSQUARE_ATTRIBUTE, H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening attribute.");
+		}
+
+		if (H5Aread(attribute_id, H5T_NATIVE_DOUBLE, &ld_store->min_rsquare) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading attribute.");
+		}
+
+		attribute_id.close();
+
+		if ((ld_store->offsets_id = H5Dopen(subset_group_id, LD_STORE_OFFSETS_DATASET, H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		}
+
+		if ((ld_store->columns_id = H5Dopen(subset_group_id, LD_STORE_COLUMNS_DATASET, H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		}
+
+		if ((ld_store->r_id = H5Dopen(subset_group_id, LD_STORE_R_DATASET, H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		}
+
+		if ((dataspace_id = H5Dget_space(ld_store->offsets_id)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+		}
+
+		if (H5Sget_simple_extent_dims(dataspace_id, file_dims, nullptr) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+		}
+
+		dataspace_id.close();
+		subset_group_id.close();
+
+		// store is used only if it has a row for every variant, e.g. it is ignored if variants were appended after it was built (or its build was interrupted)
+		ld_store->n_variants = file_dims[0] > 0 ? file_dims[0] - 1 : 0;
+		if ((file_dims[0] > 0) && (ld_store->n_variants == n_variants)) {
+			chromosome_cache.ld_stores.emplace(subset_name.get(), std::move(ld_store));
+		}
+	}
+}
+
+bool HVCF::load_names_fingerprints(hid_t index_group_id, HDF5DatasetIdentifier& fingerprints_id, vector<hsize_t>& buckets) throw (HVCFReadException) {
+	HDF5DatasetIdentifier dataset_id;
+	HDF5DataspaceIdentifier file_dataspace_id;
+
+	hsize_t file_dims[1]{0};
+
+	if (H5Lexists(index_group_id, FINGERPRINTS_DATASET, H5P_DEFAULT) <= 0) { // written before names were fingerprinted
+		return false;
+	}
+
+	if ((fingerprints_id = H5Dopen(index_group_id, FINGERPRINTS_DATASET, H5P_DEFAULT)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	}
+
+	// BEGIN: keep whole buckets directory in memory, so that lookup reads only one bucket of fingerprints.
+	if ((dataset_id = H5Dopen(index_group_id, FINGERPRINT_BUCKETS_DATASET, H5P_DEFAULT)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	}
+
+	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	}
+
+	if (file_dims[0] < 2u) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Corrupted names index.");
+	}
+
+	buckets.resize(file_dims[0]);
+	read_column(dataset_id, H5T_NATIVE_HSIZE, 0u, file_dims[0], buckets.data());
+	// END: keep whole buckets directory in memory, so that lookup reads only one bucket of fingerprints.
+
+	return true;
+}
+
+void HVCF::load_samples_cache() throw (HVCFReadException) {
+	HDF5DatasetIdentifier dataset_id;
+	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5DatatypeIdentifier subsets_entry_memory_datatype_id;
+
+	hsize_t file_dims[1]{0};
+
+	shared_ptr<sample_table> table(new sample_table());
+
+	samples_cache.table.reset();
+	samples_cache.subsets.clear();
+
+	// BEGIN: intern sample names.
+	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_NAMES_DATASET, H5P_DEFAULT)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	}
+
+	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	}
+
+	if (file_dims[0] > 0u) {
+		vector<char*> names_buffer(file_dims[0], nullptr); // on heap: panels may have hundreds of thousands of samples
+
+		if (H5Dread(dataset_id, native_string_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, names_buffer.data()) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+		}
+
+		table->name_offsets.reserve(file_dims[0]);
+		for (auto&& name : names_buffer) {
+			table->name_offsets.push_back(table->names.size());
+			table->names.insert(table->names.end(), name, name + strlen(name) + 1u);
+		}
+
+		if (H5Dvlen_reclaim(native_string_datatype_id, file_dataspace_id, H5P_DEFAULT, names_buffer.data()) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+		}
+	}
+
+	table->lookup.reserve(table->size());
+	for (hsize_t i = 0u; i < table->size(); ++i) {
+		table->lookup.emplace(table->get_name(i), i); // duplicated name resolves to first sample
+	}
+
+	file_dataspace_id.close();
+	dataset_id.close();
+	// END: intern sample names.
+
+	// BEGIN: columns of samples along haplotypes axis, if samples were permuted at import. Subsets in file are runs of columns.
+	vector<hsize_t> column_samples; // sample at every column
+
+	if (H5Lexists(samples_group_id, SAMPLE_COLUMNS_DATASET, H5P_DEFAULT) > 0) {
+		if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_COLUMNS_DATASET, H5P_DEFAULT)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+		}
+
+		table->columns.resize(table->size());
+		read_column(dataset_id, H5T_NATIVE_HSIZE, 0u, table->size(), table->columns.data());
+
+		column_samples.resize(table->size());
+		for (hsize_t i = 0u; i < table->size(); ++i) {
+			if (table->columns[i] >= table->size()) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Corrupted sample columns.");
+			}
+			column_samples[table->columns[i]] = i;
+		}
+
+		dataset_id.close();
+	}
+	// END: columns of samples.
+
+	try {
+		subsets_entry_memory_datatype_id  = create_subsets_entry_memory_datatype();
+	} catch (HVCFCreateException &e) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatype.");
+	}
+
+	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_SUBSETS_DATASET, H5P_DEFAULT)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
+	}
+
+	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	}
+
+	subsets_entry_type subsets_entry_buffer[file_dims[0]];
+
+	if (H5Dread(dataset_id, subsets_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, subsets_entry_buffer) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	}
+
+	auto subsets_cache_it = samples_cache.subsets.end();
+	hsize_t offset_1 = 0;
+	hsize_t offset_2 = 0;
+	hsize_t size = 0;
+	for (hsize_t i = 0; i < file_dims[0]; ++i) {
+		subsets_cache_it = samples_cache.subsets.emplace(subsets_entry_buffer[i].name, subsets_cache_entry()).first;
+		offset_1 = subsets_entry_buffer[i].offset_1;
+		offset_2 = subsets_entry_buffer[i].offset_2;
+		size = offset_2 - offset_1 + 1u;
+		subsets_cache_it->second.chunks.emplace_back(offset_1, offset_2, size);
+		subsets_cache_it->second.n_samples += size;
+
+		vector<hsize_t>& subset_offsets = table->subsets[subsets_entry_buffer[i].name];
+		for (hsize_t offset = offset_1; offset <= offset_2; ++offset) {
+			subset_offsets.push_back(column_samples.empty() ? offset : column_samples[offset]);
+		}
+	}
+
+	// BEGIN: if samples were permuted, list subset samples in sample order and map them to haplotypes, which are read in column order.
+	if (!column_samples.empty()) {
+		vector<hsize_t> subset_columns;
+		for (auto&& subset : table->subsets) {
+			std::sort(subset.second.begin(), subset.second.end());
+
+			subset_columns.clear();
+			for (auto offset : subset.second) {
+				subset_columns.push_back(table->columns[offset]);
+			}
+			std::sort(subset_columns.begin(), subset_columns.end());
+
+			vector<hsize_t>& order = samples_cache.subsets[subset.first].order;
+			order.reserve(subset.second.size());
+			for (auto offset : subset.second) {
+				order.push_back(std::lower_bound(subset_columns.begin(), subset_columns.end(), table->columns[offset]) - subset_columns.begin());
+			}
+		}
+	}
+	// END: subset samples in sample order.
+
+	if (H5Dvlen_reclaim(subsets_entry_memory_datatype_id, file_dataspace_id, H5P_DEFAULT, subsets_entry_buffer) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	}
+
+	samples_cache.table = std::move(table);
+}
+
+void HVCF::load_cache() throw (HVCFReadException) {
+	load_samples_cache();
+	load_chromosomes_cache();
+}
+
+const vector<ull_index_entry_type>& HVCF::read_intervals_index_bucket(chromosomes_cache_entry& chromosome_cache, const interval_index_entry_type& interval_index_entry, vector<ull_index_entry_type>& bucket) throw (HVCFReadException) {
+	auto lookup_it = chromosome_cache.intervals_index_buckets_lookup.find(interval_index_entry.bucket_offset);
+	if (lookup_it != chromosome_cache.intervals_index_buckets_lookup.end()) {
+		chromosome_cache.intervals_index_buckets.splice(chromosome_cache.intervals_index_buckets.begin(), chromosome_cache.intervals_index_buckets, lookup_it->second);
+		return lookup_it->second->second;
+	}
+
+	HDF5DataspaceIdentifier dataspace_id;
+	HDF5DataspaceIdentifier memory_dataspace_id;
+
+	hsize_t offset[1]{interval_index_entry.bucket_offset};
+	hsize_t mem_dims[1]{interval_index_entry.bucket_size};
+
+	bucket.resize(interval_index_entry.bucket_size);
+
+	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	}
+
+	if ((dataspace_id = H5Dget_space(chromosome_cache.intervals_index_buckets_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dread(chromosome_cache.intervals_index_buckets_id, ull_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, bucket.data()) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
+	}
+
+	if (MAX_CACHED_INTERVAL_BUCKETS == 0u) {
+		return bucket;
+	}
+
+	// BEGIN: cache decoded bucket and evict least recently used one.
+	if (chromosome_cache.intervals_index_buckets.size() >= MAX_CACHED_INTERVAL_BUCKETS) {
+		chromosome_cache.intervals_index_buckets_lookup.erase(chromosome_cache.intervals_index_buckets.back().first);
+		chromosome_cache.intervals_index_buckets.pop_back();
+	}
+
+	chromosome_cache.intervals_index_buckets.emplace_front(interval_index_entry.bucket_offset, std::move(bucket));
+	chromosome_cache.intervals_index_buckets_lookup.emplace(interval_index_entry.bucket_offset, chromosome_cache.intervals_index_buckets.begin());
+	// END: cache decoded bucket.
+
+	return chromosome_cache.intervals_index_buckets.front().second;
+}
+
+void HVCF::read_haplotypes_chunks(const chromosomes_cache_entry& chromosome_cache, bool by_sample, hsize_t variant_offset, hsize_t n_variants, const vector<tuple<hsize_t, hsize_t, hsize_t>>& column_ranges, hsize_t n_columns, unsigned char* buffer, unique_lock<recursive_mutex>& hdf5_lock) throw (HVCFReadException) {
+	hid_t haplotypes_id = by_sample ? chromosome_cache.haplotypes_by_sample_id.get() : chromosome_cache.haplotypes_id.get();
+	const hsize_t* chunk_dims = by_sample ? chromosome_cache.haplotypes_by_sample_chunk_dims : chromosome_cache.haplotypes_chunk_dims;
+	size_t chunk_size = chunk_dims[0] * chunk_dims[1];
+	string cache_key = by_sample ? chromosome_cache.name + "/" + HAPLOTYPES_BY_SAMPLE_DATASET : chromosome_cache.name;
+
+	// BEGIN: chunks overlapping selection, in file order.
+	vector<pair<hsize_t, hsize_t>> chunks; // first variant, first column
+	set<hsize_t> column_chunks;
+	for (auto& range : column_ranges) {
+		for (hsize_t c = get<0>(range) / chunk_dims[1]; c <= get<1>(range) / chunk_dims[1]; ++c) {
+			column_chunks.insert(c);
+		}
+	}
+	for (hsize_t v = variant_offset / chunk_dims[0]; v <= (variant_offset + n_variants - 1) / chunk_dims[0]; ++v) {
+		for (auto c : column_chunks) {
+			chunks.emplace_back(v * chunk_dims[0], c * chunk_dims[1]);
+		}
+	}
+	// END: chunks overlapping selection.
+
+	hsize_t n_chunks = chunks.size();
+	unsigned int n_threads = (READ_THREADS > 0u) ? READ_THREADS : std::max(1u, thread::hardware_concurrency());
+	if (n_threads > n_chunks) {
+		n_threads = n_chunks;
+	}
+
+	vector<vector<unsigned char>> compressed(n_chunks);
+	vector<HaplotypeBlockCache::block> cached(n_chunks); // decoded chunks found in cache
+	bool use_cache = haplotype_cache->is_enabled();
+	vector<uint32_t> filter_masks(n_chunks, 0u);
+	vector<bool> compressed_ready(n_chunks, false);
+	atomic<hsize_t> next_chunk(0u);
+	bool failed = false;
+	mutex ready_mutex;
+	condition_variable ready_condition;
+
+	// BEGIN: decoded chunks from cache don't need to be read.
+	if (use_cache) {
+		for (hsize_t c = 0u; c < n_chunks; ++c) {
+			cached[c] = haplotype_cache->get(cache_key, chunks[c].first / chunk_dims[0], chunks[c].second / chunk_dims[1]);
+			compressed_ready[c] = static_cast<bool>(cached[c]);
+		}
+	}
+	// END: decoded chunks from cache.
+
+	// BEGIN: decompress chunks in parallel, as soon as they are read, and copy selected rows and columns into buffer (chunks don't overlap in buffer). Workers don't touch HDF5.
+	// Decompressed chunks are put into decoded chunks cache (if enabled), which has its own lock.
+	auto decompress = [&]() -> void {
+		unique_ptr<unsigned char[]> chunk_buffer(new unsigned char[use_cache ? 0u : chunk_size]);
+		shared_ptr<vector<unsigned char>> block;
+		unsigned char* chunk = chunk_buffer.get();
+		const unsigned char* decompressed = nullptr;
+		hsize_t c = 0u;
+		while ((c = next_chunk++) < n_chunks) {
+			unique_lock<mutex> ready_lock(ready_mutex);
+			ready_condition.wait(ready_lock, [&]() -> bool { return compressed_ready[c] || failed; });
+			if (!compressed_ready[c]) {
+				return;
+			}
+			ready_lock.unlock();
+
+			if (cached[c]) {
+				decompressed = cached[c]->data();
+			} else {
+				if (use_cache) {
+					block = shared_ptr<vector<unsigned char>>(new vector<unsigned char>(chunk_size));
+					chunk = block->data();
+				}
+				decompressed = chunk;
+				if (compressed[c].empty()) { // chunk was never written: fill value
+					memset(chunk, 0, chunk_size);
+				} else if ((filter_masks[c] != 0u) || (chromosome_cache.haplotypes_filter == H5Z_FILTER_NONE)) { // optional filter was skipped when chunk was written
+					if (compressed[c].size() < chunk_size) {
+						throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while decompressing chunk.");
+					}
+					if (use_cache) {
+						memcpy(chunk, compressed[c].data(), chunk_size);
+					} else {
+						decompressed = compressed[c].data();
+					}
+				} else if (chromosome_cache.haplotypes_filter == H5Z_FILTER_DEFLATE) {
+					uLongf decompressed_size = chunk_size;
+					if ((uncompress(chunk, &decompressed_size, compressed[c].data(), compressed[c].size()) != Z_OK) || (decompressed_size != chunk_size)) {
+						throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while decompressing chunk.");
+					}
+				} else {
+					if (blosc_decompress_ctx(compressed[c].data(), chunk, chunk_size, 1) != static_cast<int>(chunk_size)) {
+						throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while decompressing chunk.");
+					}
+				}
+				if (use_cache) {
+					haplotype_cache->put(cache_key, chunks[c].first / chunk_dims[0], chunks[c].second / chunk_dims[1], block);
+				}
+			}
+
+			hsize_t first_variant = std::max(chunks[c].first, variant_offset);
+			hsize_t last_variant = std::min(chunks[c].first + chunk_dims[0], variant_offset + n_variants) - 1;
+			for (auto& range : column_ranges) {
+				hsize_t first_column = std::max(chunks[c].second, get<0>(range));
+				hsize_t last_column = std::min(chunks[c].second + chunk_dims[1] - 1, get<1>(range));
+				if (first_column > last_column) {
+					continue;
+				}
+				for (hsize_t v = first_variant; v <= last_variant; ++v) {
+					memcpy(buffer + (v - variant_offset) * n_columns + get<2>(range) + (first_column - get<0>(range)),
+							decompressed + (v - chunks[c].first) * chunk_dims[1] + (first_column - chunks[c].second),
+							last_column - first_column + 1);
+				}
+			}
+			vector<unsigned char>().swap(compressed[c]);
+			cached[c].reset();
+		}
+	};
+
+	WorkerPool::batch workers; // single chunk is decompressed by calling thread after it is read
+	if (n_chunks > 1u) {
+		workers = worker_pool->submit(n_threads, decompress);
+	}
+	// END: decompress chunks in parallel.
+
+	// BEGIN: read compressed chunks in file order.
+	hsize_t chunk_offset[2]{0, 0};
+	hsize_t chunk_storage_size = 0;
+	try {
+		for (hsize_t c = 0u; c < n_chunks; ++c) {
+			if (compressed_ready[c]) { // found in cache
+				continue;
+			}
+
+			chunk_offset[0] = chunks[c].first;
+			chunk_offset[1] = chunks[c].second;
+
+#if H5_VERSION_GE(1,10,3)
+			if (H5Dget_chunk_storage_size(haplotypes_id, chunk_offset, &chunk_storage_size) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting chunk size.");
+			}
+
+			compressed[c].resize(chunk_storage_size);
+
+			if ((chunk_storage_size > 0) && (H5Dread_chunk(haplotypes_id, H5P_DEFAULT, chunk_offset, &filter_masks[c], compressed[c].data()) < 0)) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading chunk from dataset.");
+			}
+#else
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading chunk from dataset: direct chunk reads require HDF5 1.10.3 or later.");
+#endif
+
+			lock_guard<mutex> ready_lock(ready_mutex);
+			compressed_ready[c] = true;
+			ready_condition.notify_all();
+		}
+	} catch (HVCFReadException& e) {
+		{
+			lock_guard<mutex> ready_lock(ready_mutex);
+			failed = true;
+			ready_condition.notify_all();
+		}
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
+		if (workers) {
+			try {
+				worker_pool->wait(workers);
+			} catch (...) { // reading error is reported instead
+			}
+		}
+		throw;
+	}
+	// END: read compressed chunks.
+
+	// BEGIN: all chunks were read, so other queries can use HDF5 while workers finish decompression.
+	HDF5LockRelease hdf5_unlock(hdf5_lock);
+
+	try {
+		if (workers) {
+			worker_pool->wait(workers);
+		} else {
+			decompress();
+		}
+	} catch (HVCFReadException& e) {
+		throw;
+	} catch (exception& e) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while decompressing chunks.");
+	}
+	// END: all chunks were read.
+}
+
+void HVCF::read_pbwt_haplotypes(chromosomes_cache_entry& chromosome_cache, const vector<tuple<hsize_t, hsize_t, hsize_t>>& sample_chunks, hsize_t variant_offset, hsize_t n_variants, unsigned char* buffer, unique_lock<recursive_mutex>& hdf5_lock) throw (HVCFReadException) {
+	hsize_t n_all_haplotypes = 2 * get_n_samples();
+	hsize_t checkpoint = variant_offset / chromosome_cache.haplotypes_pbwt_interval;
+	hsize_t first_variant = checkpoint * chromosome_cache.haplotypes_pbwt_interval; // decoding starts at the last checkpoint before the first requested variant
+	hsize_t n_decoded_variants = 0u;
+
+	// BEGIN: continue from the order left by the previous read, if it is closer to the first requested variant than the checkpoint (e.g. consecutive windows or single variants in ascending order).
+	vector<unsigned int> order;
+	if ((chromosome_cache.haplotypes_pbwt_order.size() == n_all_haplotypes) &&
+			(chromosome_cache.haplotypes_pbwt_order_variant > first_variant) && (chromosome_cache.haplotypes_pbwt_order_variant <= variant_offset)) {
+		first_variant = chromosome_cache.haplotypes_pbwt_order_variant;
+		order.swap(chromosome_cache.haplotypes_pbwt_order);
+	}
+	n_decoded_variants = variant_offset + n_variants - first_variant;
+	// END: continue from the order left by the previous read.
+
+	// BEGIN: selected haplotype columns, in ascending order (as they are returned from other storage layouts).
+	vector<tuple<hsize_t, hsize_t, hsize_t>> sorted_chunks(sample_chunks);
+	std::sort(sorted_chunks.begin(), sorted_chunks.end());
+
+	vector<hsize_t> columns;
+	for (auto& chunk : sorted_chunks) {
+		for (hsize_t h = 2 * get<0>(chunk); h <= 2 * get<1>(chunk) + 1; ++h) {
+			columns.push_back(h);
+		}
+	}
+	hsize_t n_haplotypes = columns.size();
+	// END: selected haplotype columns.
+
+	// BEGIN: read PBWT order at checkpoint (unless decoding continues from the previous read) and encoded columns of all variants from first decoded to the last requested variant.
+	vector<hsize_t> ends(n_decoded_variants + 1u, 0u); // ends[0] is start of the first decoded column
+	vector<unsigned char> runs;
+
+	if (order.empty()) {
+		order.resize(n_all_haplotypes);
+		read_column(chromosome_cache.haplotype_checkpoints_id, H5T_NATIVE_UINT, checkpoint * n_all_haplotypes, n_all_haplotypes, order.data());
+	}
+
+	if (first_variant > 0u) {
+		read_column(chromosome_cache.haplotype_ends_id, H5T_NATIVE_HSIZE, first_variant - 1u, n_decoded_variants + 1u, ends.data());
+	} else {
+		read_column(chromosome_cache.haplotype_ends_id, H5T_NATIVE_HSIZE, 0u, n_decoded_variants, ends.data() + 1);
+	}
+
+	runs.resize(ends.back() - ends.front());
+
+	HVCFMetrics::io_counters io_before = HVCFMetrics::get_thread_io_counters();
+	read_column(chromosome_cache.haplotypes_id, H5T_NATIVE_UCHAR, ends.front(), runs.size(), runs.data());
+	HVCFMetrics::io_counters io_after = HVCFMetrics::get_thread_io_counters();
+	HVCFQueryTrace::add_haplotype_chunks(runs.empty() ? 0u : (ends.back() - 1u) / chromosome_cache.haplotypes_chunk_dims[0] - ends.front() / chromosome_cache.haplotypes_chunk_dims[0] + 1u, io_after.raw_data_reads - io_before.raw_data_reads);
+	// END: read PBWT order and encoded columns.
+
+	// BEGIN: decode columns (see write_pbwt_haplotypes): runs of alleles are assigned to haplotypes in current PBWT order, which is then stably sorted by allele.
+	// Decoding doesn't touch HDF5 or chromosome cache, so other queries can use HDF5 meanwhile.
+	{
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
+
+		vector<unsigned char> row(n_all_haplotypes);
+		vector<unsigned int> ones;
+		ones.reserve(n_all_haplotypes);
+
+		const unsigned char* run = runs.data();
+		for (hsize_t v = 0u; v < n_decoded_variants; ++v) {
+			const unsigned char* runs_end = runs.data() + (ends[v + 1u] - ends.front());
+			hsize_t n_zeros = 0u;
+			unsigned char allele = 0u;
+
+			ones.clear();
+			for (hsize_t i = 0u; i < n_all_haplotypes; allele ^= 1u) {
+				hsize_t run_length = 0u;
+				unsigned int shift = 0u;
+				do {
+					if ((run >= runs_end) || (shift > 56u)) {
+						throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while decoding haplotypes.");
+					}
+					run_length |= static_cast<hsize_t>(*run & 0x7Fu) << shift;
+					shift += 7u;
+				} while (*run++ & 0x80u);
+
+				if (run_length > n_all_haplotypes - i) {
+					throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while decoding haplotypes.");
+				}
+
+				for (hsize_t run_end = i + run_length; i < run_end; ++i) {
+					row[order[i]] = allele;
+					if (allele == 0u) {
+						order[n_zeros++] = order[i];
+					} else {
+						ones.push_back(order[i]);
+					}
+				}
+			}
+
+			if (run != runs_end) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while decoding haplotypes.");
+			}
+
+			std::copy(ones.begin(), ones.end(), order.begin() + n_zeros);
+
+			if (first_variant + v >= variant_offset) {
+				unsigned char* buffer_row = buffer + (first_variant + v - variant_offset) * n_haplotypes;
+				for (hsize_t h = 0u; h < n_haplotypes; ++h) {
+					buffer_row[h] = row[columns[h]];
+				}
+			}
+		}
+	}
+	// END: decode columns.
+
+	chromosome_cache.haplotypes_pbwt_order.swap(order);
+	chromosome_cache.haplotypes_pbwt_order_variant = variant_offset + n_variants;
+}
+
+void HVCF::read_haplotypes(chromosomes_cache_entry& chromosome_cache, const vector<tuple<hsize_t, hsize_t, hsize_t>>& sample_chunks, hsize_t variant_offset, hsize_t n_variants, unsigned char* buffer, unique_lock<recursive_mutex>& hdf5_lock) throw (HVCFReadException) {
+	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5DataspaceIdentifier memory_dataspace_id;
+
+	hsize_t n_haplotypes = 0;
+	for (auto& chunk : sample_chunks) {
+		n_haplotypes += 2 * get<2>(chunk);
+	}
+
+	if ((n_variants == 0) || (n_haplotypes == 0)) {
+		return;
+	}
+
+	if (chromosome_cache.haplotypes_pbwt) { // columns are decoded whole, so any selection is gathered from them
+		read_pbwt_haplotypes(chromosome_cache, sample_chunks, variant_offset, n_variants, buffer, hdf5_lock);
+		return;
+	}
+
+	// BEGIN: fragmented selection (many short runs of samples, e.g. ad-hoc list of samples). Runs at most GATHER_MAX_GAP samples apart are merged into blocks,
+	// blocks are read as any other selection (few hyperslabs or column ranges instead of one per run) and selected haplotype columns are gathered from them.
+	if ((GATHER_MAX_GAP > 0u) && (sample_chunks.size() > 1u)) {
+		vector<tuple<hsize_t, hsize_t, hsize_t>> runs(sample_chunks);
+		std::sort(runs.begin(), runs.end());
+
+		vector<tuple<hsize_t, hsize_t, hsize_t>> blocks;
+		for (auto& run : runs) {
+			if (!blocks.empty() && (get<0>(run) <= get<1>(blocks.back()) + GATHER_MAX_GAP + 1u)) {
+				if (get<1>(run) > get<1>(blocks.back())) {
+					get<1>(blocks.back()) = get<1>(run);
+					get<2>(blocks.back()) = get<1>(run) - get<0>(blocks.back()) + 1u;
+				}
+			} else {
+				blocks.push_back(run);
+			}
+		}
+
+		if (2u * blocks.size() <= runs.size()) { // blocks are never merged again, so nested call reads them directly
+			hsize_t n_block_haplotypes = 0u;
+			for (auto& block : blocks) {
+				n_block_haplotypes += 2 * get<2>(block);
+			}
+
+			vector<uint32_t> columns; // column of every selected haplotype in blocks
+			columns.reserve(n_haplotypes);
+			auto block_it = blocks.begin();
+			hsize_t block_column = 0u;
+			for (auto& run : runs) {
+				while (get<1>(run) > get<1>(*block_it)) {
+					block_column += 2 * get<2>(*block_it);
+					++block_it;
+				}
+				for (hsize_t h = 2 * get<0>(run); h <= 2 * get<1>(run) + 1; ++h) {
+					columns.push_back(static_cast<uint32_t>(block_column + h - 2 * get<0>(*block_it)));
+				}
+			}
+
+			unique_ptr<unsigned char[]> block_haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_variants * n_block_haplotypes]);
+
+			read_haplotypes(chromosome_cache, blocks, variant_offset, n_variants, block_haplotypes.get(), hdf5_lock);
+
+			HaplotypeGather::gather(block_haplotypes.get(), n_block_haplotypes, n_variants, columns.data(), n_haplotypes, buffer);
+
+			return;
+		}
+	}
+	// END: fragmented selection.
+
+	hsize_t file_offset[2]{variant_offset, 0};
+	hsize_t counts[2]{n_variants, 0};
+	hsize_t mem_dims[2]{n_variants, n_haplotypes};
+
+	// Few samples are read from sample-major copy (if there is one), which has the same layout, but doesn't decompress neighbouring samples.
+	bool by_sample = (chromosome_cache.haplotypes_by_sample_id.get() >= 0) && (n_haplotypes / 2 <= HAPLOTYPES_BY_SAMPLE_MAX_SAMPLES);
+	hid_t haplotypes_id = by_sample ? chromosome_cache.haplotypes_by_sample_id.get() : chromosome_cache.haplotypes_id.get();
+
+	// BEGIN: chunks overlapping selection and chunks read from file while reading it (i.e. not found in chunk cache).
+	const hsize_t* chunk_dims = by_sample ? chromosome_cache.haplotypes_by_sample_chunk_dims : chromosome_cache.haplotypes_chunk_dims;
+	set<hsize_t> column_chunks;
+	HVCFMetrics::io_counters io_before = HVCFMetrics::get_thread_io_counters();
+
+	auto count_chunks = [&]() {
+		HVCFMetrics::io_counters io_after = HVCFMetrics::get_thread_io_counters();
+		unsigned long long int n_row_chunks = (variant_offset + n_variants - 1) / chunk_dims[0] - variant_offset / chunk_dims[0] + 1;
+		HVCFQueryTrace::add_haplotype_chunks(n_row_chunks * column_chunks.size(), io_after.raw_data_reads - io_before.raw_data_reads);
+	};
+	// END: chunks overlapping selection.
+
+	if ((file_dataspace_id = H5Dget_space(haplotypes_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sselect_none(file_dataspace_id) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+#if H5_VERSION_GE(1,10,3)
+	bool direct = (strcmp(CHUNK_READER, HVCFConfiguration::DIRECT_CHUNK_READER) == 0) && (chromosome_cache.haplotypes_filter != H5Z_FILTER_ERROR);
+#else
+	bool direct = false; // H5Dread_chunk is available from HDF5 1.10.3: fall back to filtered H5Dread
+#endif
+
+	if (!chromosome_cache.haplotypes_packed && direct) {
+		// One allele per byte: haplotype columns of every chunk, in file order (as H5Dread would return them).
+		vector<tuple<hsize_t, hsize_t, hsize_t>> column_ranges; // first column, last column, offset in memory
+		for (auto& chunk : sample_chunks) {
+			column_ranges.emplace_back(2 * get<0>(chunk), 2 * get<1>(chunk) + 1, 0);
+		}
+		std::sort(column_ranges.begin(), column_ranges.end());
+		for (unsigned int i = 1u; i < column_ranges.size(); ++i) {
+			get<2>(column_ranges[i]) = get<2>(column_ranges[i - 1]) + get<1>(column_ranges[i - 1]) - get<0>(column_ranges[i - 1]) + 1;
+		}
+
+		for (auto& range : column_ranges) {
+			for (hsize_t c = get<0>(range) / chunk_dims[1]; c <= get<1>(range) / chunk_dims[1]; ++c) {
+				column_chunks.insert(c);
+			}
+		}
+
+		read_haplotypes_chunks(chromosome_cache, by_sample, variant_offset, n_variants, column_ranges, n_haplotypes, buffer, hdf5_lock);
+
+		count_chunks();
+
+		return;
+	}
+
+	if (!chromosome_cache.haplotypes_packed) {
+		// One allele per byte: select haplotype columns of every chunk and read them directly into the buffer.
+		for (auto& chunk : sample_chunks) {
+			file_offset[1] = 2 * get<0>(chunk);
+			counts[1] = 2 * get<2>(chunk);
+
+			if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset, NULL, counts, NULL) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+			}
+
+			for (hsize_t c = file_offset[1] / chunk_dims[1]; c <= (file_offset[1] + counts[1] - 1) / chunk_dims[1]; ++c) {
+				column_chunks.insert(c);
+			}
+		}
+
+		if ((memory_dataspace_id = H5Screate_simple(2, mem_dims, nullptr)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+		}
+
+		if (H5Dread(haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+		}
+
+		count_chunks();
+
+		return;
+	}
+
+	// Eight alleles per byte: select only bytes covering haplotypes of every chunk (neighbouring chunks may share bytes),
+	// read them and unpack requested bits into the buffer. HDF5 returns selected bytes in file order, so chunks are processed in ascending order.
+	vector<tuple<hsize_t, hsize_t, hsize_t>> sorted_chunks(sample_chunks);
+	std::sort(sorted_chunks.begin(), sorted_chunks.end());
+
+	vector<tuple<hsize_t, hsize_t, hsize_t>> byte_ranges; // first byte, last byte, offset in memory
+	hsize_t first_byte = 0;
+	hsize_t last_byte = 0;
+	hsize_t n_bytes = 0;
+
+	for (auto& chunk : sorted_chunks) {
+		first_byte = (2 * get<0>(chunk)) >> 3;
+		last_byte = (2 * get<1>(chunk) + 1) >> 3;
+		if (!byte_ranges.empty() && (first_byte <= get<1>(byte_ranges.back()) + 1)) {
+			if (last_byte > get<1>(byte_ranges.back())) {
+				n_bytes += last_byte - get<1>(byte_ranges.back());
+				get<1>(byte_ranges.back()) = last_byte;
+			}
+		} else {
+			byte_ranges.emplace_back(first_byte, last_byte, n_bytes);
+			n_bytes += last_byte - first_byte + 1;
+		}
+	}
+
+	for (auto& range : byte_ranges) {
+		file_offset[1] = get<0>(range);
+		counts[1] = get<1>(range) - get<0>(range) + 1;
+
+		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset, NULL, counts, NULL) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+		}
+
+		for (hsize_t c = file_offset[1] / chunk_dims[1]; c <= (file_offset[1] + counts[1] - 1) / chunk_dims[1]; ++c) {
+			column_chunks.insert(c);
+		}
+	}
+
+	mem_dims[1] = n_bytes;
+
+	unique_ptr<unsigned char[]> packed = unique_ptr<unsigned char[]>(new unsigned char[n_variants * n_bytes]);
+
+	if (direct) {
+		read_haplotypes_chunks(chromosome_cache, by_sample, variant_offset, n_variants, byte_ranges, n_bytes, packed.get(), hdf5_lock);
+	} else {
+		if ((memory_dataspace_id = H5Screate_simple(2, mem_dims, nullptr)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+		}
+
+		if (H5Dread(haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, packed.get()) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+		}
+	}
+
+	count_chunks();
+
+	auto range_it = byte_ranges.begin();
+	hsize_t haplotype_start = 0;
+	hsize_t haplotype_end = 0;
+	hsize_t column = 0;
+	for (auto& chunk : sorted_chunks) {
+		haplotype_start = 2 * get<0>(chunk);
+		haplotype_end = 2 * get<1>(chunk) + 1;
+		while ((haplotype_end >> 3) > get<1>(*range_it)) {
+			++range_it;
+		}
+		for (hsize_t v = 0; v < n_variants; ++v) {
+			const unsigned char* packed_row = packed.get() + v * n_bytes + get<2>(*range_it) - get<0>(*range_it);
+			unsigned char* row = buffer + v * n_haplotypes + column;
+			for (hsize_t h = haplotype_start; h <= haplotype_end; ++h) {
+				*row++ = (packed_row[h >> 3] >> (h & 7)) & 1;
+			}
+		}
+		column += haplotype_end - haplotype_start + 1;
+	}
+}
+
+bool HVCF::read_allele_counts(hid_t chromosome_group_id, const string& subset, hsize_t variant_offset, hsize_t n_variants, unsigned int* buffer) throw (HVCFReadException) {
+	HDF5GroupIdentifier allele_counts_group_id;
+	HDF5DatasetIdentifier dataset_id;
+	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5DataspaceIdentifier memory_dataspace_id;
+
+	hsize_t file_dims[1]{0};
+	hsize_t file_offset[1]{variant_offset};
+	hsize_t mem_dims[1]{n_variants};
+
+	// BEGIN: check if counts were materialized for this subset.
+	if (H5Lexists(chromosome_group_id, ALLELE_COUNTS_GROUP, H5P_DEFAULT) <= 0) {
+		return false;
+	}
+
+	if ((allele_counts_group_id = H5Gopen(chromosome_group_id, ALLELE_COUNTS_GROUP, H5P_DEFAULT)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+	}
+
+	if (H5Lexists(allele_counts_group_id, subset.c_str(), H5P_DEFAULT) <= 0) {
+		return false;
+	}
+
+	if ((dataset_id = H5Dopen(allele_counts_group_id, subset.c_str(), H5P_DEFAULT)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	}
+
+	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	}
+
+	if (file_dims[0] < variant_offset + n_variants) { // e.g. variants were appended after counts were materialized
+		return false;
+	}
+	// END: check if counts were materialized.
+
+	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	}
+
+	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, nullptr, mem_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dread(dataset_id, H5T_NATIVE_UINT, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	}
+
+	return true;
+}
+
+void HVCF::read_column(hid_t dataset_id, hid_t memory_datatype_id, hsize_t offset, hsize_t n, void* buffer) throw (HVCFReadException) {
+	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5DataspaceIdentifier memory_dataspace_id;
+
+	hsize_t file_offset[1]{offset};
+	hsize_t mem_dims[1]{n};
+
+	if (n == 0) {
+		return;
+	}
+
+	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	}
+
+	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, nullptr, mem_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dread(dataset_id, memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	}
+}
+
+void HVCF::read_variant_positions(const chromosomes_cache_entry& chromosome_cache, hsize_t variant_offset, hsize_t n_variants, unsigned long long int* positions) throw (HVCFReadException) {
+	if (n_variants == 0) {
+		return;
+	}
+
+	// BEGIN: compound variants dataset: read only position member, so that there are no variable-length strings to reclaim.
+	if (!chromosome_cache.variant_columns) {
+		HDF5DatatypeIdentifier position_memory_datatype_id;
+
+		if ((position_memory_datatype_id = H5Tcreate(H5T_COMPOUND, sizeof(unsigned long long int))) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating compound datatype.");
+		}
+
+		if (H5Tinsert(position_memory_datatype_id, "position", 0, H5T_NATIVE_ULLONG) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while adding new member to compound datatype.");
+		}
+
+		read_column(chromosome_cache.variants_id, position_memory_datatype_id, variant_offset, n_variants, positions);
+		return;
+	}
+	// END: compound variants dataset.
+
+	hsize_t block_size = chromosome_cache.variant_positions_block;
+	hsize_t first_block = variant_offset / block_size;
+	hsize_t last_block = (variant_offset + n_variants - 1) / block_size;
+	hsize_t block_offset = first_block * block_size;
+
+	vector<unsigned long long int> anchors(last_block - first_block + 1);
+	vector<int> deltas(variant_offset + n_variants - block_offset);
+
+	read_column(chromosome_cache.variant_position_anchors_id, H5T_NATIVE_ULLONG, first_block, anchors.size(), anchors.data());
+	read_column(chromosome_cache.variant_positions_id, H5T_NATIVE_INT, block_offset, deltas.size(), deltas.data());
+
+	unsigned long long int position = 0ull;
+	for (hsize_t i = 0u, offset = block_offset; i < deltas.size(); ++i, ++offset) {
+		if ((offset % block_size) == 0) {
+			position = anchors[offset / block_size - first_block];
+		} else {
+			position += deltas[i];
+		}
+		if (offset >= variant_offset) {
+			positions[offset - variant_offset] = position;
+		}
+	}
+}
+
+void HVCF::read_variants(const chromosomes_cache_entry& chromosome_cache, hsize_t variant_offset, hsize_t n_variants, variants_columns& variants) throw (HVCFReadException) {
+	if (n_variants == 0) {
+		return;
+	}
+
+	// BEGIN: compound variants dataset.
+	if (!chromosome_cache.variant_columns) {
+		HDF5DataspaceIdentifier memory_dataspace_id;
+		hsize_t mem_dims[1]{n_variants};
+
+		vector<variants_entry_type> variants_buffer(n_variants);
+
+		read_column(chromosome_cache.variants_id, variants_entry_memory_datatype_id, variant_offset, n_variants, variants_buffer.data());
+
+		for (hsize_t i = 0u; i < n_variants; ++i) {
+			variants.add(variants_buffer[i].name, variants_buffer[i].ref, variants_buffer[i].alt, variants_buffer[i].position);
+		}
+
+		if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+		}
+
+		if (H5Dvlen_reclaim(variants_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, variants_buffer.data()) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+		}
+		return;
+	}
+	// END: compound variants dataset.
+
+	size_t first = variants.positions.size();
+
+	variants.positions.resize(first + n_variants);
+	read_variant_positions(chromosome_cache, variant_offset, n_variants, variants.positions.data() + first);
+
+	vector<unsigned char> alleles(n_variants);
+	read_column(chromosome_cache.variant_alleles_id, H5T_NATIVE_UCHAR, variant_offset, n_variants, alleles.data());
+
+	// BEGIN: read slice of alleles blob, only if some alleles are not single nucleotides. allele_ends[0] is end of previous variant.
+	vector<unsigned long long int> allele_ends(n_variants + 1u, 0ull);
+	vector<char> allele_bytes;
+
+	if (any_of(alleles.begin(), alleles.end(), [](unsigned char code) { return (code & BLOB_ALLELES) != 0u; })) {
+		if (variant_offset > 0) {
+			read_column(chromosome_cache.variant_allele_ends_id, H5T_NATIVE_ULLONG, variant_offset - 1, n_variants + 1, allele_ends.data());
+		} else {
+			read_column(chromosome_cache.variant_allele_ends_id, H5T_NATIVE_ULLONG, 0, n_variants, allele_ends.data() + 1);
+		}
+		allele_bytes.resize(allele_ends.back() - allele_ends.front());
+		read_column(chromosome_cache.variant_allele_bytes_id, H5T_NATIVE_CHAR, allele_ends.front(), allele_bytes.size(), allele_bytes.data());
+	}
+	// END: read slice of alleles blob.
+
+	// BEGIN: derive names (chrom:pos_ref/alt).
+	const string& chromosome = chromosome_cache.name;
+	const char* ref = nullptr;
+	const char* alt = nullptr;
+	size_t ref_length = 0u;
+	size_t alt_length = 0u;
+	char digits[20];
+	unsigned int n_digits = 0u;
+
+	for (hsize_t i = 0u; i < n_variants; ++i) {
+		if ((alleles[i] & BLOB_ALLELES) != 0u) {
+			ref = allele_bytes.data() + (allele_ends[i] - allele_ends.front());
+			ref_length = strlen(ref);
+			alt = ref + ref_length + 1u;
+			alt_length = strlen(alt);
+		} else {
+			ref = NUCLEOTIDES + (alleles[i] & 3u);
+			ref_length = 1u;
+			alt = NUCLEOTIDES + ((alleles[i] >> 2) & 3u);
+			alt_length = 1u;
+		}
+
+		n_digits = 0u;
+		for (unsigned long long int position = variants.positions[first + i]; (n_digits == 0u) || (position > 0ull); position /= 10ull) {
+			digits[n_digits++] = static_cast<char>('0' + position % 10ull);
+		}
+
+		variants.name_offsets.push_back(variants.names.size());
+		variants.names.insert(variants.names.end(), chromosome.begin(), chromosome.end());
+		variants.names.push_back(':');
+		while (n_digits > 0u) {
+			variants.names.push_back(digits[--n_digits]);
+		}
+		variants.names.push_back('_');
+		variants.names.insert(variants.names.end(), ref, ref + ref_length);
+		variants.names.push_back('/');
+		variants.names.insert(variants.names.end(), alt, alt + alt_length);
+		variants.names.push_back('\0');
+
+		variants.ref_offsets.push_back(variants.refs.size());
+		variants.refs.insert(variants.refs.end(), ref, ref + ref_length);
+		variants.refs.push_back('\0');
+
+		variants.alt_offsets.push_back(variants.alts.size());
+		variants.alts.insert(variants.alts.end(), alt, alt + alt_length);
+		variants.alts.push_back('\0');
+	}
+	// END: derive names.
+}
+
+void HVCF::read_ld_store(const ld_store_cache_entry& ld_store, hsize_t variant_offset, hsize_t n_variants, vector<unsigned long long int>& offsets, vector<unsigned int>& columns, vector<double>& r) throw (HVCFReadException) {
+	HDF5DataspaceIdentifier file_dataspace_id;
+	HDF5DataspaceIdentifier memory_dataspace_id;
+
+	hsize_t file_offset[1]{variant_offset};
+	hsize_t mem_dims[1]{n_variants + 1};
+
+	// BEGIN: read row offsets.
+	offsets.resize(n_variants + 1);
+
+	if ((file_dataspace_id = H5Dget_space(ld_store.offsets_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	}
+
+	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, nullptr, mem_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dread(ld_store.offsets_id, H5T_NATIVE_ULLONG, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, offsets.data()) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	}
+
+	file_dataspace_id.close();
+	memory_dataspace_id.close();
+	// END: read row offsets.
+
+	// BEGIN: read pairs of all rows with one contiguous selection.
+	file_offset[0] = offsets.front();
+	mem_dims[0] = offsets.back() - offsets.front();
+
+	columns.resize(mem_dims[0]);
+	r.resize(mem_dims[0]);
+
+	if (mem_dims[0] == 0) {
+		return;
+	}
+
+	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	}
+
+	if ((file_dataspace_id = H5Dget_space(ld_store.columns_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, nullptr, mem_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dread(ld_store.columns_id, H5T_NATIVE_UINT, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, columns.data()) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	}
+
+	file_dataspace_id.close();
+
+	if ((file_dataspace_id = H5Dget_space(ld_store.r_id)) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	}
+
+	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, nullptr, mem_dims, nullptr) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dread(ld_store.r_id, H5T_NATIVE_DOUBLE, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, r.data()) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	}
+	// END: read pairs.
+}
+
+void HVCF::create(const string& name) throw (HVCFWriteException) {
+	HDF5DatatypeIdentifier datatype_id;
+	HDF5PropertyIdentifier file_access_property_id;
+	H5AC_cache_config_t config;
+	size_t native_string_datatype_size = 0;
+
+	this->name = name;
+
+	haplotype_cache->clear();
+
+	if ((file_access_property_id = H5Pcreate(H5P_FILE_ACCESS)) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating file access property.");
+	}
+
+	config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+	if (H5Pget_mdc_config(file_access_property_id, &config) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while getting metadata cache configuration.");
+	}
+
+	config.set_initial_size = true;
+	config.initial_size = METADATA_CACHE_INITIAL_SIZE;
+	config.min_size = METADATA_CACHE_MIN_SIZE;
+	config.max_size = METADATA_CACHE_MAX_SIZE;
+
+	if (H5Pset_mdc_config(file_access_property_id, &config) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting metadata cache configuration.");
+	}
+
+	if (H5Pset_sieve_buf_size(file_access_property_id, SIEVE_BUFFER_MAX_SIZE) < 0) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while setting sieve buffer size.");
+	}
+
+	if (H5Pset_cache(file_access_property_id, 0, CHUNK_CACHE_N_SLOTS, CHUNK_CACHE_SIZE, 0.75) < 0) {
+		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Error while setting cache parameters.");
+	}
+
+	if ((file_id = H5Fcreate(this->name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, file_access_property_id)) < 0) {
+		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Error while creating file.");
 	}
 
 //	VERBOSE
@@ -1870,6 +3517,8 @@ void HVCF::create(const string& name) throw (HVCFWriteException) {
 }
 
 void HVCF::open(const string& name) throw (HVCFOpenException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
 	HDF5PropertyIdentifier file_access_property_id;
 	H5AC_cache_config_t config;
 
@@ -1901,6 +3550,10 @@ void HVCF::open(const string& name) throw (HVCFOpenException) {
 		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Error while setting cache parameters.");
 	}
 
+	if (H5Pset_driver(file_access_property_id, HVCFMetrics::get_counting_driver(), nullptr) < 0) {
+		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Error while setting file driver.");
+	}
+
 	if ((file_id = H5Fopen(this->name.c_str(), H5F_ACC_RDONLY, file_access_property_id)) < 0) {
 		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Error while opening file.");
 	}
@@ -1988,10 +3641,12 @@ void HVCF::open(const string& name) throw (HVCFOpenException) {
 }
 
 void HVCF::close() throw (HVCFCloseException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
 	samples_cache.subsets.clear();
-	samples_cache.names_index_id.close();
-	samples_cache.names_index_buckets_id.close();
+	samples_cache.table.reset();
 	chromosomes_cache.clear();
+	haplotype_cache->clear();
 	chromosomes.clear();
 	chromosomes_group_id.close();
 	samples_group_id.close();
@@ -2006,17 +3661,30 @@ void HVCF::close() throw (HVCFCloseException) {
 }
 
 void HVCF::import_vcf(const string& name) throw (HVCFWriteException) {
+	import_vcf(name, vector<string>());
+}
+
+void HVCF::import_vcf(const string& name, const vector<string>& sample_order) throw (HVCFWriteException) {
 	VCFReader vcf;
 
 	try {
 		future<void> async_write;
 
 		vcf.open(name);
-		write_samples(std::move(vcf.get_variant().get_samples()));
+		write_samples(std::move(vcf.get_variant().get_samples()), sample_order);
+
+		// write buffers take number of samples and their columns from sample table
+		try {
+			load_samples_cache();
+		} catch (HVCFReadException &e) {
+			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating samples cache.");
+		}
+
 		while (vcf.read_next_variant()) {
 			write_variant(vcf.get_variant(), async_write);
 		}
 		flush_write_buffer(async_write);
+		pbwt_builders.clear();
 
 		vcf.close();
 	} catch (ReaderException &e) {
@@ -2035,22 +3703,16 @@ void HVCF::create_sample_subset(const string& name, const std::vector<string>& s
 	HDF5DataspaceIdentifier memory_dataspace_id;
 	HDF5DatatypeIdentifier subsets_entry_memory_datatype_id;
 
-	map<string, unsigned int> all_samples;
-	auto all_samples_it = all_samples.end();
+	long long int sample_offset = 0;
 
 	hsize_t offests_buffer[samples.size()];
 	vector<tuple<hsize_t, hsize_t>> squeezed_offsets;
 
-	for (auto&& sample : get_samples()) {
-		all_samples.emplace(std::move(sample), all_samples.size());
-	}
-
 	for (unsigned int i = 0u; i < samples.size(); ++i) {
-		all_samples_it = all_samples.find(samples[i]);
-		if (all_samples_it == all_samples.end()) {
+		if ((sample_offset = get_sample_offset(samples[i])) < 0) {
 			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Sample not found.");
 		}
-		offests_buffer[i] = static_cast<hsize_t>(all_samples_it->second);
+		offests_buffer[i] = samples_cache.table->get_column(static_cast<hsize_t>(sample_offset)); // subsets in file are runs of columns
 	}
 
 	std::sort(offests_buffer, offests_buffer + samples.size(), std::less_equal<hsize_t>());
@@ -2128,303 +3790,273 @@ void HVCF::create_sample_subset(const string& name, const std::vector<string>& s
 	} catch (HVCFReadException &e) {
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating subset cache.");
 	}
-}
-
-hsize_t HVCF::get_n_samples() throw (HVCFReadException) {
-	HDF5DatasetIdentifier samples_all_dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	hsize_t file_dims[1]{0};
 
-	if ((samples_all_dataset_id = H5Dopen(samples_group_id, SAMPLE_NAMES_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-	}
+	create_allele_counts(name);
 
-	if ((file_dataspace_id = H5Dget_space(samples_all_dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+	// BEGIN: drop LD precomputed for the previous definition of this subset.
+	for (auto&& chromosome : chromosomes) {
+		delete_ld_store(chromosome.second->get(), name);
 	}
-
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
+	for (auto&& chromosome_cache : chromosomes_cache) {
+		chromosome_cache.second->ld_stores.erase(name);
 	}
-
-	return file_dims[0];
+	// END: drop LD.
 }
 
-vector<string> HVCF::get_samples() throw (HVCFReadException) {
-	HDF5DatasetIdentifier samples_all_dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DatatypeIdentifier native_string_datatype_id;
-	hsize_t file_dims[1]{0};
-
-	if ((native_string_datatype_id = H5Topen(file_id, VARIABLE_LENGTH_STRING_TYPE, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening datatype.");
-	}
+void HVCF::create_ld_store(const string& subset, unsigned long long int max_distance, double min_rsquare) throw (HVCFWriteException) {
+	HDF5GroupIdentifier ld_store_group_id;
+	HDF5GroupIdentifier subset_group_id;
+	HDF5DatasetIdentifier dataset_id;
+	HDF5DataspaceIdentifier attribute_dataspace_id;
+	HDF5AttributeIdentifier attribute_id;
 
-	if ((samples_all_dataset_id = H5Dopen(samples_group_id, SAMPLE_NAMES_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
+	auto subsets_cache_it = samples_cache.subsets.find(subset);
+	if (subsets_cache_it == samples_cache.subsets.end()) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Subset not found.");
 	}
 
-	if ((file_dataspace_id = H5Dget_space(samples_all_dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+	ld_options options(false, min_rsquare, max_distance);
 
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
+	hsize_t n_haplotypes = 2 * subsets_cache_it->second.n_samples;
+	hsize_t block_size = std::max(static_cast<hsize_t>(1u), static_cast<hsize_t>(VARIANTS_CHUNK_SIZE));
+	hsize_t n_variants = 0;
+	hsize_t n_block_variants = 0;
+	unsigned int n_threads = (LD_THREADS > 0u) ? LD_THREADS : std::max(1u, thread::hardware_concurrency());
 
-	char* buffer[file_dims[0]];
-	vector<string> samples;
+	unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[block_size * n_haplotypes]);
 
-	if (H5Dread(samples_all_dataset_id, native_string_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	for (unsigned int i = 0; i < file_dims[0]; ++i) {
-		samples.emplace_back(buffer[i]);
-	}
+	try {
+		for (auto&& chromosome_cache : chromosomes_cache) {
+			hid_t chromosome_group_id = chromosomes.find(chromosome_cache.first)->second->get();
 
-	if (H5Dvlen_reclaim(native_string_datatype_id, file_dataspace_id, H5P_DEFAULT, buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-	}
+			delete_ld_store(chromosome_group_id, subset);
 
-	return samples;
-}
+			n_variants = get_n_variants_in_chromosome(chromosome_cache.first);
+			if (n_variants == 0) {
+				continue;
+			}
 
-unsigned int HVCF::get_n_sample_subsets() throw (HVCFReadException) {
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-	HDF5DatatypeIdentifier populations_entry_memory_datatype_id;
+			// BEGIN: create group with parameters as attributes and empty datasets.
+			if (H5Lexists(chromosome_group_id, LD_STORE_GROUP, H5P_DEFAULT) > 0) {
+				if ((ld_store_group_id = H5Gopen(chromosome_group_id, LD_STORE_GROUP, H5P_DEFAULT)) < 0) {
+					throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while opening group.");
+				}
+			} else {
+				if ((ld_store_group_id = H5Gcreate(chromosome_group_id, LD_STORE_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+					throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
+				}
+			}
 
-	hsize_t file_dims[1]{0};
+			if ((subset_group_id = H5Gcreate(ld_store_group_id, subset.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating group.");
+			}
 
-	try {
-		populations_entry_memory_datatype_id  = create_subsets_entry_memory_datatype();
-	} catch (HVCFCreateException &e) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatype.");
-	}
+			if ((attribute_dataspace_id = H5Screate(H5S_SCALAR)) < 0) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataspace.");
+			}
 
-	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_SUBSETS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
-	}
+			if ((attribute_id = H5Acreate(subset_group_id, LD_STORE_MAX_DISTANCE_ATTRIBUTE, H5T_STD_U64LE, attribute_dataspace_id, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating attribute.");
+			}
 
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+			if (H5Awrite(attribute_id, H5T_NATIVE_ULLONG, &max_distance) < 0) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing attribute.");
+			}
 
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
+			attribute_id.close();
 
-	subsets_entry_type populations_entry_buffer[file_dims[0]];
+			if ((attribute_id = H5Acreate(subset_group_id, LD_STORE_MIN_RSQUARE_ATTRIBUTE, H5T_IEEE_F64LE, attribute_dataspace_id, H5P_DEFAULT, H5P_DEFAULT)) < 0) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating attribute.");
+			}
 
-	if (H5Dread(dataset_id, populations_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, populations_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+			if (H5Awrite(attribute_id, H5T_NATIVE_DOUBLE, &min_rsquare) < 0) {
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing attribute.");
+			}
 
-	set<string> populations;
+			attribute_id.close();
+			attribute_dataspace_id.close();
+
+			dataset_id = create_column_dataset(subset_group_id, LD_STORE_OFFSETS_DATASET, H5T_STD_U64LE, VARIANTS_CHUNK_SIZE);
+			dataset_id.close();
+			dataset_id = create_column_dataset(subset_group_id, LD_STORE_COLUMNS_DATASET, H5T_STD_U32LE, LD_STORE_CHUNK_SIZE);
+			dataset_id.close();
+			dataset_id = create_column_dataset(subset_group_id, LD_STORE_R_DATASET, H5T_IEEE_F64LE, LD_STORE_CHUNK_SIZE); // r is not rounded: served queries return the same values as computed ones
+			dataset_id.close();
+			// END: create group.
+
+			// BEGIN: positions of all variants in chromosome.
+			vector<unsigned long long int> positions(n_variants);
+
+			read_variant_positions(*chromosome_cache.second, 0, n_variants, positions.data());
+			// END: positions of all variants.
+
+			unsigned long long int n_pairs = 0ull;
+			append_column(subset_group_id, LD_STORE_OFFSETS_DATASET, H5T_NATIVE_ULLONG, &n_pairs, 1);
+
+			// BEGIN: compute one block of rows at a time. Columns of block are all variants within max_distance from any of its rows.
+			hsize_t column_start = 0;
+			hsize_t column_end = 0;
+			hsize_t n_rows = 0;
+
+			for (hsize_t row_start = 0; row_start < n_variants; row_start += n_rows) {
+				n_rows = std::min(block_size, n_variants - row_start);
+
+				while (positions[row_start] - positions[column_start] > max_distance) {
+					++column_start;
+				}
+				column_end = std::max(column_end, row_start + n_rows - 1);
+				while ((column_end + 1 < n_variants) && (positions[column_end + 1] - positions[row_start + n_rows - 1] <= max_distance)) {
+					++column_end;
+				}
+
+				hsize_t n_columns = column_end - column_start + 1;
+				PopcountLD popcount_ld(n_columns, n_haplotypes);
+
+				for (hsize_t offset = 0; offset < n_columns; offset += n_block_variants) {
+					n_block_variants = std::min(block_size, n_columns - offset);
+					read_haplotypes(*chromosome_cache.second, subsets_cache_it->second.chunks, column_start + offset, n_block_variants, haplotypes.get(), hdf5_lock);
+					for (hsize_t v = 0; v < n_block_variants; ++v) {
+						popcount_ld.load(offset + v, haplotypes.get() + v * n_haplotypes);
+					}
+				}
+
+				// rows are computed in parallel: workers take next row from shared counter, and each row keeps its pairs in column order
+				vector<vector<unsigned int>> row_columns(n_rows);
+				vector<vector<double>> row_r(n_rows);
+				atomic<hsize_t> next_row(0u);
+
+				auto compute = [&]() -> void {
+					hsize_t i = 0;
+					hsize_t row = 0;
+					double r = 0.0;
+					while ((i = next_row++) < n_rows) {
+						row = row_start + i;
+						for (hsize_t column = column_start; column <= column_end; ++column) {
+							if ((column < row ? positions[row] - positions[column] : positions[column] - positions[row]) > max_distance) {
+								continue;
+							}
+							// same pruning as in region LD queries with threshold
+							if ((min_rsquare > 0.0) && (popcount_ld.get_max_rsquare(row - column_start, column - column_start) + 1e-9 < min_rsquare)) {
+								continue;
+							}
+							r = popcount_ld.compute_r(row - column_start, column - column_start);
+							if (options.keep(r * r)) {
+								row_columns[i].push_back(column);
+								row_r[i].push_back(r);
+							}
+						}
+					}
+				};
+
+				try {
+					worker_pool->wait(worker_pool->submit(std::min(static_cast<hsize_t>(n_threads), n_rows), compute));
+				} catch (exception& e) {
+					throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while computing LD.");
+				}
+
+				vector<unsigned long long int> block_offsets(n_rows);
+				vector<unsigned int> block_columns;
+				vector<double> block_r;
+				for (hsize_t i = 0; i < n_rows; ++i) {
+					block_columns.insert(block_columns.end(), row_columns[i].begin(), row_columns[i].end());
+					block_r.insert(block_r.end(), row_r[i].begin(), row_r[i].end());
+					n_pairs += row_columns[i].size();
+					block_offsets[i] = n_pairs;
+				}
+
+				append_column(subset_group_id, LD_STORE_COLUMNS_DATASET, H5T_NATIVE_UINT, block_columns.data(), block_columns.size());
+				append_column(subset_group_id, LD_STORE_R_DATASET, H5T_NATIVE_DOUBLE, block_r.data(), block_r.size());
+				append_column(subset_group_id, LD_STORE_OFFSETS_DATASET, H5T_NATIVE_ULLONG, block_offsets.data(), block_offsets.size()); // offsets last: row is complete only when its end offset is written
+			}
+			// END: compute one block of rows at a time.
 
-	for (hsize_t i = 0; i < file_dims[0]; ++i) {
-		populations.emplace(populations_entry_buffer[i].name);
+			subset_group_id.close();
+			ld_store_group_id.close();
+		}
+	} catch (HVCFReadException &e) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while computing LD.");
 	}
 
-	if (H5Dvlen_reclaim(populations_entry_memory_datatype_id, file_dataspace_id, H5P_DEFAULT, populations_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	try {
+		load_chromosomes_cache();
+	} catch (HVCFReadException &e) {
+		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while creating chromosomes cache.");
 	}
+}
 
-	return populations.size();
+hsize_t HVCF::get_n_samples() throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
+	return samples_cache.table ? samples_cache.table->size() : 0u;
 }
 
-vector<string> HVCF::get_sample_subsets() throw (HVCFReadException) {
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-	HDF5DatatypeIdentifier subsets_entry_memory_datatype_id;
+vector<string> HVCF::get_samples() throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	hsize_t file_dims[1]{0};
+	vector<string> samples;
 
-	try {
-		subsets_entry_memory_datatype_id  = create_subsets_entry_memory_datatype();
-	} catch (HVCFCreateException &e) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatype.");
+	if (samples_cache.table) {
+		samples.reserve(samples_cache.table->size());
+		for (size_t i = 0u; i < samples_cache.table->size(); ++i) {
+			samples.emplace_back(samples_cache.table->get_name(i));
+		}
 	}
 
-	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_SUBSETS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
-	}
+	return samples;
+}
 
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+shared_ptr<const sample_table> HVCF::get_sample_table() throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
+	return samples_cache.table;
+}
 
-	subsets_entry_type subsets_entry_buffer[file_dims[0]];
+unsigned int HVCF::get_n_sample_subsets() throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	if (H5Dread(dataset_id, subsets_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+	return samples_cache.subsets.size();
+}
 
-	set<string> subsets;
+vector<string> HVCF::get_sample_subsets() throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	for (hsize_t i = 0; i < file_dims[0]; ++i) {
-		subsets.emplace(subsets_entry_buffer[i].name);
-	}
+	vector<string> result;
 
-	if (H5Dvlen_reclaim(subsets_entry_memory_datatype_id, file_dataspace_id, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	result.reserve(samples_cache.subsets.size());
+	for (auto&& subset : samples_cache.subsets) {
+		result.push_back(subset.first);
 	}
-
-	vector<string> result(subsets.begin(), subsets.end());
+	std::sort(result.begin(), result.end());
 
 	return result;
 }
 
 unsigned int HVCF::get_n_samples_in_subset(const string& name) throw (HVCFReadException) {
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-	HDF5DatatypeIdentifier subsets_entry_memory_datatype_id;
-
-	hsize_t file_dims[1]{0};
-
-	try {
-		subsets_entry_memory_datatype_id  = create_subsets_entry_memory_datatype();
-	} catch (HVCFCreateException &e) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatype.");
-	}
-
-	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_SUBSETS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
-	}
-
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	subsets_entry_type subsets_entry_buffer[file_dims[0]];
-
-	if (H5Dread(dataset_id, subsets_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
-
-	unsigned int n_samples = 0u;
-
-	for (hsize_t i = 0; i < file_dims[0]; ++i) {
-		if (strcmp(subsets_entry_buffer[i].name, name.c_str()) == 0) {
-			n_samples += subsets_entry_buffer[i].offset_2 - subsets_entry_buffer[i].offset_1 + 1u;
-		}
-	}
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	if (H5Dvlen_reclaim(subsets_entry_memory_datatype_id, file_dataspace_id, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	auto subsets_cache_it = samples_cache.subsets.find(name);
+	if (subsets_cache_it == samples_cache.subsets.end()) {
+		return 0u;
 	}
 
-	return n_samples;
+	return subsets_cache_it->second.n_samples;
 }
 
 vector<string> HVCF::get_samples_in_subset(const string& name) throw (HVCFReadException) {
-	HDF5DatasetIdentifier dataset_id;
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-	HDF5DatatypeIdentifier subsets_entry_memory_datatype_id;
-	HDF5DatatypeIdentifier native_string_datatype_id;
-
-	hsize_t file_dims[1]{0};
-
-	try {
-		subsets_entry_memory_datatype_id  = create_subsets_entry_memory_datatype();
-	} catch (HVCFCreateException &e) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory datatype.");
-	}
-
-	if ((native_string_datatype_id = H5Topen(file_id, VARIABLE_LENGTH_STRING_TYPE, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening datatype.");
-	}
-
-	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_SUBSETS_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating dataset.");
-	}
-
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(file_dataspace_id, file_dims, nullptr) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	subsets_entry_type subsets_entry_buffer[file_dims[0]];
-
-	if (H5Dread(dataset_id, subsets_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
-
-	vector<tuple<hsize_t, hsize_t>> population_offsets;
-	unsigned int n_samples = 0u;
-
-	for (hsize_t i = 0; i < file_dims[0]; ++i) {
-		if (strcmp(subsets_entry_buffer[i].name, name.c_str()) == 0) {
-			population_offsets.emplace_back(subsets_entry_buffer[i].offset_1, subsets_entry_buffer[i].offset_2);
-			n_samples += subsets_entry_buffer[i].offset_2 - subsets_entry_buffer[i].offset_1 + 1u;
-		}
-	}
-
-	if (H5Dvlen_reclaim(subsets_entry_memory_datatype_id, file_dataspace_id, H5P_DEFAULT, subsets_entry_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-	}
-
-	file_dataspace_id.close();
-	dataset_id.close();
-
-	hsize_t mem_dims[1]{n_samples};
-	hsize_t file_offset[1]{0};
-	hsize_t counts[1]{0};
-	char* samples_buffer[n_samples];
-
-	if ((dataset_id = H5Dopen(samples_group_id, SAMPLE_NAMES_DATASET, H5P_DEFAULT)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
-	}
-
-	if ((file_dataspace_id = H5Dget_space(dataset_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
-
-	if (H5Sselect_none(file_dataspace_id) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
-
-	for (unsigned int i = 0; i < population_offsets.size(); ++i) {
-		file_offset[0] = get<0>(population_offsets[i]);
-		counts[0] = get<1>(population_offsets[i]) - get<0>(population_offsets[i]) + 1u;
-
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset, NULL, counts, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-		}
-	}
-
-	if (H5Dread(dataset_id, native_string_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, samples_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
 	vector<string> samples;
 
-	for (unsigned int i = 0; i < n_samples; ++i) {
-		samples.emplace_back(samples_buffer[i]);
+	const vector<hsize_t>* subset_offsets = samples_cache.table ? samples_cache.table->get_subset(name) : nullptr;
+	if (subset_offsets == nullptr) {
+		return samples;
 	}
 
-	if (H5Dvlen_reclaim(native_string_datatype_id, memory_dataspace_id, H5P_DEFAULT, samples_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	samples.reserve(subset_offsets->size());
+	for (auto&& offset : *subset_offsets) {
+		samples.emplace_back(samples_cache.table->get_name(offset));
 	}
 
 	return samples;
@@ -2448,58 +4080,20 @@ bool HVCF::has_chromosome(const string& chromosome) const {
 
 unsigned long long int HVCF::get_chromosome_start(const string& chromosome) const throw (HVCFReadException) {
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
-	if (chromosomes_cache_it == chromosomes_cache.end()) {
+	if ((chromosomes_cache_it == chromosomes_cache.end()) || (chromosomes_cache_it->second->intervals_index.empty())) {
 		return 0;
 	}
 
-	HDF5DataspaceIdentifier dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t file_dims[1]{0};
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(dataspace_id, file_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	interval_index_entry_type interval_index_entries_buffer[file_dims[0]];
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_id, interval_index_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, interval_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
-
-	return interval_index_entries_buffer[0].ull_value_1;
+	return chromosomes_cache_it->second->intervals_index.front().ull_value_1;
 }
 
 unsigned long long int HVCF::get_chromosome_end(const string& chromosome) const throw (HVCFReadException) {
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
-	if (chromosomes_cache_it == chromosomes_cache.end()) {
+	if ((chromosomes_cache_it == chromosomes_cache.end()) || (chromosomes_cache_it->second->intervals_index.empty())) {
 		return 0;
 	}
 
-	HDF5DataspaceIdentifier dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t file_dims[1]{0};
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(dataspace_id, file_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	interval_index_entry_type interval_index_entries_buffer[file_dims[0]];
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_id, interval_index_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, interval_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
-
-	return interval_index_entries_buffer[file_dims[0] - 1].ull_value_2;
+	return chromosomes_cache_it->second->intervals_index.back().ull_value_2;
 }
 
 hsize_t HVCF::get_n_variants() const throw (HVCFReadException) {
@@ -2513,6 +4107,8 @@ hsize_t HVCF::get_n_variants() const throw (HVCFReadException) {
 }
 
 hsize_t HVCF::get_n_variants_in_chromosome(const string& chromosome) const throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
 	auto chromosomes_it = chromosomes.find(chromosome);
 
 	if (chromosomes_it == chromosomes.end()) {
@@ -2524,7 +4120,13 @@ hsize_t HVCF::get_n_variants_in_chromosome(const string& chromosome) const throw
 
 	hsize_t file_dims[1]{0};
 
-	if ((dataset_id = H5Dopen(chromosomes_it->second->get(), VARIANTS_DATASET, H5P_DEFAULT)) < 0) {
+	if (H5Lexists(chromosomes_it->second->get(), VARIANT_COLUMNS_GROUP, H5P_DEFAULT) > 0) {
+		dataset_id = H5Dopen(chromosomes_it->second->get(), (string(VARIANT_COLUMNS_GROUP) + "/" + VARIANT_POSITIONS_DATASET).c_str(), H5P_DEFAULT);
+	} else {
+		dataset_id = H5Dopen(chromosomes_it->second->get(), VARIANTS_DATASET, H5P_DEFAULT);
+	}
+
+	if (dataset_id < 0) {
 		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while opening dataset.");
 	}
 
@@ -2540,41 +4142,25 @@ hsize_t HVCF::get_n_variants_in_chromosome(const string& chromosome) const throw
 }
 
 long long int HVCF::get_variant_offset_by_position_eq(const string& chromosome, unsigned long long int position) throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return -1;
 	}
 
-	HDF5DataspaceIdentifier dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t file_dims[1]{0};
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(dataspace_id, file_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	interval_index_entry_type interval_index_entries_buffer[file_dims[0]];
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_id, interval_index_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, interval_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
-
-	dataspace_id.close();
+	const vector<interval_index_entry_type>& intervals_index = chromosomes_cache_it->second->intervals_index;
+	vector<ull_index_entry_type> bucket_buffer;
 
 	interval_index_entry_type search_interval_index_entry;
 	search_interval_index_entry.ull_value_2 = position;
 
-	auto interval_index_entry = lower_bound(interval_index_entries_buffer, interval_index_entries_buffer + file_dims[0], search_interval_index_entry,
+	auto interval_index_entry = lower_bound(intervals_index.begin(), intervals_index.end(), search_interval_index_entry,
 			[] (const interval_index_entry_type& f, const interval_index_entry_type& s) -> bool {
 				return (f.ull_value_2 < s.ull_value_2);
 			});
 
-	if (interval_index_entry == interval_index_entries_buffer + file_dims[0]) {
+	if (interval_index_entry == intervals_index.end()) {
 		return -1;
 	}
 
@@ -2582,36 +4168,17 @@ long long int HVCF::get_variant_offset_by_position_eq(const string& chromosome,
 		return -1;
 	}
 
-	hsize_t mem_dims[1] {interval_index_entry->bucket_size};
-	hsize_t offset[1] {interval_index_entry->bucket_offset};
-
-	ull_index_entry_type ull_index_entries_buffer[interval_index_entry->bucket_size];
-
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_buckets_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
-		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_buckets_id, ull_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, ull_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
+	const vector<ull_index_entry_type>& bucket = read_intervals_index_bucket(*chromosomes_cache_it->second, *interval_index_entry, bucket_buffer);
 
 	ull_index_entry_type search_ull_index_entry;
 	search_ull_index_entry.ull_value = position;
 
-	auto ull_index_entry = lower_bound(ull_index_entries_buffer, ull_index_entries_buffer + mem_dims[0], search_ull_index_entry,
+	auto ull_index_entry = lower_bound(bucket.begin(), bucket.end(), search_ull_index_entry,
 			[] (const ull_index_entry_type& f, const ull_index_entry_type& s) -> bool {
 				return (f.ull_value < s.ull_value);
 			});
 
-	if ((ull_index_entry == ull_index_entries_buffer + mem_dims[0]) || (ull_index_entry->ull_value != position)) {
+	if ((ull_index_entry == bucket.end()) || (ull_index_entry->ull_value != position)) {
 		return -1;
 	}
 
@@ -2619,41 +4186,25 @@ long long int HVCF::get_variant_offset_by_position_eq(const string& chromosome,
 }
 
 long long int HVCF::get_variant_offset_by_position_ge(const string& chromosome, unsigned long long int position) throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return -1;
 	}
 
-	HDF5DataspaceIdentifier dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t file_dims[1]{0};
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(dataspace_id, file_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	interval_index_entry_type interval_index_entries_buffer[file_dims[0]];
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_id, interval_index_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, interval_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
-
-	dataspace_id.close();
+	const vector<interval_index_entry_type>& intervals_index = chromosomes_cache_it->second->intervals_index;
+	vector<ull_index_entry_type> bucket_buffer;
 
 	interval_index_entry_type search_interval_index_entry;
 	search_interval_index_entry.ull_value_2 = position;
 
-	auto interval_index_entry = lower_bound(interval_index_entries_buffer, interval_index_entries_buffer + file_dims[0], search_interval_index_entry,
+	auto interval_index_entry = lower_bound(intervals_index.begin(), intervals_index.end(), search_interval_index_entry,
 			[] (const interval_index_entry_type& f, const interval_index_entry_type& s) -> bool {
 				return (f.ull_value_2 < s.ull_value_2);
 			});
 
-	if (interval_index_entry == interval_index_entries_buffer + file_dims[0]) {
+	if (interval_index_entry == intervals_index.end()) {
 		return -1;
 	}
 
@@ -2661,36 +4212,17 @@ long long int HVCF::get_variant_offset_by_position_ge(const string& chromosome,
 		return interval_index_entry->offset_1;
 	}
 
-	hsize_t offset[1] {interval_index_entry->bucket_offset};
-	hsize_t mem_dims[1] {interval_index_entry->bucket_size};
-
-	ull_index_entry_type ull_index_entries_buffer[interval_index_entry->bucket_size];
-
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_buckets_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_buckets_id, ull_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, ull_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
+	const vector<ull_index_entry_type>& bucket = read_intervals_index_bucket(*chromosomes_cache_it->second, *interval_index_entry, bucket_buffer);
 
 	ull_index_entry_type search_ull_index_entry;
 	search_ull_index_entry.ull_value = position;
 
-	auto ull_index_entry = lower_bound(ull_index_entries_buffer, ull_index_entries_buffer + mem_dims[0], search_ull_index_entry,
+	auto ull_index_entry = lower_bound(bucket.begin(), bucket.end(), search_ull_index_entry,
 			[] (const ull_index_entry_type& f, const ull_index_entry_type& s) -> bool {
 				return (f.ull_value < s.ull_value);
 			});
 
-	if (ull_index_entry == ull_index_entries_buffer + mem_dims[0]) {
+	if (ull_index_entry == bucket.end()) {
 		return -1;
 	}
 
@@ -2698,46 +4230,30 @@ long long int HVCF::get_variant_offset_by_position_ge(const string& chromosome,
 }
 
 long long int HVCF::get_variant_offset_by_position_le(const string& chromosome, unsigned long long int position) throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return -1;
 	}
 
-	HDF5DataspaceIdentifier dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t file_dims[1]{0};
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sget_simple_extent_dims(dataspace_id, file_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace dimensions.");
-	}
-
-	interval_index_entry_type interval_index_entries_buffer[file_dims[0]];
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_id, interval_index_entry_memory_datatype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, interval_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
-
-	dataspace_id.close();
+	const vector<interval_index_entry_type>& intervals_index = chromosomes_cache_it->second->intervals_index;
+	vector<ull_index_entry_type> bucket_buffer;
 
 	interval_index_entry_type search_interval_index_entry;
 	search_interval_index_entry.ull_value_2 = position;
 
-	auto interval_index_entry = lower_bound(interval_index_entries_buffer, interval_index_entries_buffer + file_dims[0], search_interval_index_entry,
+	auto interval_index_entry = lower_bound(intervals_index.begin(), intervals_index.end(), search_interval_index_entry,
 			[] (const interval_index_entry_type& f, const interval_index_entry_type& s) -> bool {
 				return (f.ull_value_2 < s.ull_value_2);
 			});
 
-	if ((interval_index_entry == interval_index_entries_buffer) && (position < interval_index_entry->ull_value_1)) {
+	if ((interval_index_entry == intervals_index.begin()) && ((interval_index_entry == intervals_index.end()) || (position < interval_index_entry->ull_value_1))) {
 		return -1;
 	}
 
-	if (interval_index_entry == interval_index_entries_buffer + file_dims[0]) {
-		return interval_index_entries_buffer[file_dims[0] - 1].offset_2;
+	if (interval_index_entry == intervals_index.end()) {
+		return intervals_index.back().offset_2;
 	}
 
 	if (position < interval_index_entry->ull_value_1) {
@@ -2748,41 +4264,22 @@ long long int HVCF::get_variant_offset_by_position_le(const string& chromosome,
 		return interval_index_entry->offset_1;
 	}
 
-	hsize_t offset[1] {interval_index_entry->bucket_offset};
-	hsize_t mem_dims[1] {interval_index_entry->bucket_size};
-
-	ull_index_entry_type ull_index_entries_buffer[interval_index_entry->bucket_size];
-
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
-
-	if ((dataspace_id = H5Dget_space(chromosomes_cache_it->second->intervals_index_buckets_id.get())) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
-
-	if (H5Dread(chromosomes_cache_it->second->intervals_index_buckets_id.get(), ull_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, ull_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
+	const vector<ull_index_entry_type>& bucket = read_intervals_index_bucket(*chromosomes_cache_it->second, *interval_index_entry, bucket_buffer);
 
 	ull_index_entry_type search_ull_index_entry;
 	search_ull_index_entry.ull_value = position;
 
-	auto ull_index_entry = lower_bound(ull_index_entries_buffer, ull_index_entries_buffer + mem_dims[0], search_ull_index_entry,
+	auto ull_index_entry = lower_bound(bucket.begin(), bucket.end(), search_ull_index_entry,
 			[] (const ull_index_entry_type& f, const ull_index_entry_type& s) -> bool {
 				return (f.ull_value < s.ull_value);
 			});
 
-	if ((ull_index_entry == ull_index_entries_buffer) && (position < ull_index_entry->ull_value)) {
+	if ((ull_index_entry == bucket.begin()) && (position < ull_index_entry->ull_value)) {
 		return -1;
 	}
 
-	if (ull_index_entry == ull_index_entries_buffer + mem_dims[0]) {
-		return ull_index_entries_buffer[mem_dims[0] - 1].offset;
+	if (ull_index_entry == bucket.end()) {
+		return bucket.back().offset;
 	}
 
 	if (position < ull_index_entry->ull_value) {
@@ -2792,12 +4289,55 @@ long long int HVCF::get_variant_offset_by_position_le(const string& chromosome,
 	return ull_index_entry->offset;
 }
 
+void HVCF::find_names_fingerprints(hid_t fingerprints_id, const vector<hsize_t>& buckets, const string& name, vector<hsize_t>& offsets) throw (HVCFReadException) {
+	unsigned long long int fingerprint = NameHash::hash(name);
+	hsize_t bucket = fingerprint % (buckets.size() - 1u);
+
+	offsets.clear();
+
+	if (buckets[bucket] == buckets[bucket + 1u]) { // no name has fingerprint in this bucket: nothing to read
+		return;
+	}
+
+	vector<ull_index_entry_type> entries(buckets[bucket + 1u] - buckets[bucket]);
+
+	read_column(fingerprints_id, ull_index_entry_memory_datatype_id, buckets[bucket], entries.size(), entries.data());
+
+	auto range = equal_range(entries.begin(), entries.end(), ull_index_entry_type{fingerprint, 0u},
+			[] (const ull_index_entry_type& f, const ull_index_entry_type& s) -> bool {
+				return f.ull_value < s.ull_value;
+			});
+
+	for (auto entries_it = range.first; entries_it != range.second; ++entries_it) {
+		offsets.push_back(entries_it->offset);
+	}
+}
+
 long long int HVCF::get_variant_offset_by_name(const string& chromosome, const string& name) throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return -1;
 	}
 
+	// BEGIN: fingerprints index.
+	if (chromosomes_cache_it->second->names_fingerprint_buckets.size() >= 2u) { // directory of n buckets has n + 1 bounds
+		vector<hsize_t> candidates;
+		variants_columns variants;
+
+		find_names_fingerprints(chromosomes_cache_it->second->names_fingerprints_id, chromosomes_cache_it->second->names_fingerprint_buckets, name, candidates);
+		for (auto&& candidate : candidates) { // different names may share fingerprint
+			variants.clear();
+			read_variants(*chromosomes_cache_it->second, candidate, 1u, variants);
+			if (strcmp(variants.get_name(0u), name.c_str()) == 0) {
+				return candidate;
+			}
+		}
+		return -1;
+	}
+	// END: fingerprints index.
+
 	HDF5DataspaceIdentifier dataspace_id;
 	HDF5DataspaceIdentifier memory_dataspace_id;
 
@@ -2846,118 +4386,401 @@ long long int HVCF::get_variant_offset_by_name(const string& chromosome, const s
 		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
 	}
 
-	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	}
+
+	if (H5Dread(chromosomes_cache_it->second->names_index_buckets_id, string_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, string_index_entries_buffer) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
+	}
+
+	string_index_entry_type search_string_index_entry;
+	search_string_index_entry.string_value = (char*)name.c_str();
+
+	auto string_index_entry = lower_bound(string_index_entries_buffer, string_index_entries_buffer + mem_dims[0], search_string_index_entry,
+			[] (const string_index_entry_type& f, const string_index_entry_type& s) -> bool {
+				return (strcmp(f.string_value, s.string_value) < 0);
+			});
+
+	long long int variant_offset = 0;
+
+	if ((string_index_entry == string_index_entries_buffer + mem_dims[0]) || (strcmp(string_index_entry->string_value, name.c_str())) != 0) {
+		variant_offset = -1;
+	} else {
+		variant_offset = string_index_entry->offset;
+	}
+
+	if (H5Dvlen_reclaim(string_index_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, string_index_entries_buffer) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	}
+
+	return variant_offset;
+}
+
+long long int HVCF::get_sample_offset(const string& name) throw (HVCFReadException) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
+	return samples_cache.table ? samples_cache.table->get_offset(name.c_str()) : -1;
+}
+
+HVCF::TransientSubset::TransientSubset(HVCF& hvcf, const sample_selection& samples) throw (HVCFReadException) : hvcf(hvcf) {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
+	hsize_t n_samples = hvcf.samples_cache.table ? hvcf.samples_cache.table->size() : 0u;
+
+	vector<hsize_t> columns;
+	columns.reserve(samples.offsets.size());
+	for (auto offset : samples.offsets) {
+		if (offset >= n_samples) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Sample offset is out of range.");
+		}
+		columns.push_back(hvcf.samples_cache.table->get_column(offset));
+	}
+	std::sort(columns.begin(), columns.end());
+	columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+	// BEGIN: runs of consecutive columns, as in subsets read from file.
+	subsets_cache_entry subset = subsets_cache_entry();
+	subset.transient = true;
+	for (auto column : columns) {
+		if (!subset.chunks.empty() && (get<1>(subset.chunks.back()) + 1u == column)) {
+			get<1>(subset.chunks.back()) = column;
+			get<2>(subset.chunks.back()) += 1u;
+		} else {
+			subset.chunks.emplace_back(column, column, 1u);
+		}
+	}
+	subset.n_samples = columns.size();
+	// END: runs of consecutive columns.
+
+	// Generated name never clashes with subsets in file or with selections of concurrent queries.
+	unsigned long long int i = 0u;
+	do {
+		name = "#selection" + to_string(i++);
+	} while ((hvcf.samples_cache.subsets.count(name) > 0u) || (hvcf.transient_subsets.count(name) > 0u));
+
+	if (!columns.empty()) { // nothing is registered for empty selection, so queries return empty results
+		hvcf.transient_subsets.emplace(name, std::move(subset));
+	}
+}
+
+HVCF::TransientSubset::~TransientSubset() {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
+
+	hvcf.transient_subsets.erase(name);
+}
+
+// Returned entry stays valid while HDF5 lock is released: entries are never erased from subsets cache by queries, and transient subset lives until its query returns.
+const subsets_cache_entry* HVCF::find_subset(const string& subset) const {
+	auto subsets_cache_it = samples_cache.subsets.find(subset);
+	if (subsets_cache_it != samples_cache.subsets.end()) {
+		return &subsets_cache_it->second;
+	}
+
+	auto transient_subsets_it = transient_subsets.find(subset);
+	return (transient_subsets_it == transient_subsets.end()) ? nullptr : &transient_subsets_it->second;
+}
+
+void HVCF::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, ld_query_columns& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld");
+
+	// Popcount engine computes region in tiles on all cores; matrix is assembled from tiles.
+	if (strcmp(LD_ENGINE, HVCFConfiguration::POPCOUNT_LD_ENGINE) == 0) {
+		class MatrixSink : public HVCFLDSink {
+		private:
+			ld_query_columns& result;
+		public:
+			MatrixSink(ld_query_columns& result) : result(result) {}
+
+			void begin(const variants_columns& variants) {
+				result.clear();
+				result.variants = variants;
+				for (unsigned int i = 0u; i < variants.size(); ++i) {
+					result.rows.push_back(i);
+				}
+				result.r.resize(variants.size() * variants.size());
+				result.rsquare.resize(variants.size() * variants.size());
+			}
+
+			void consume(const ld_tile& tile) {
+				size_t n_variants = result.variants.size();
+				size_t ij = 0u, ji = 0u;
+				double r = 0.0;
+				for (unsigned int i = 0u; i < tile.n_rows; ++i) {
+					for (unsigned int j = 0u; j < tile.n_columns; ++j) {
+						r = tile.get_r(i, j);
+						ij = (tile.row_start + i) * n_variants + tile.column_start + j;
+						ji = (tile.column_start + j) * n_variants + tile.row_start + i;
+						result.r[ij] = result.r[ji] = r;
+						result.rsquare[ij] = result.rsquare[ji] = pow(r, 2.0);
+					}
+				}
+			}
+		} sink(result);
+
+		compute_ld(subset, chromosome, start_position, end_position, sink);
+		HVCFQueryTrace::set_results(result.r.size());
+		return;
+	}
+
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
+	result.clear();
+
+	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
+	if (chromosomes_cache_it == chromosomes_cache.end()) {
+		return;
+	}
+
+	if (end_position < start_position) {
+		return;
+	}
+
+	long long int start_position_offset = 0;
+	long long int end_position_offset = 0;
+
+	if ((start_position_offset = get_variant_offset_by_position_eq(chromosome, start_position)) < 0) {
+		return;
+	}
+
+	if ((end_position_offset = get_variant_offset_by_position_eq(chromosome, end_position)) < 0) {
+		return;
+	}
+
+	const subsets_cache_entry* subset_entry = find_subset(subset);
+
+	if (subset_entry == nullptr) {
+		return;
+	}
+
+	hsize_t n_samples = subset_entry->n_samples;
+	hsize_t n_haplotypes = 2 * n_samples;
+
+	hsize_t n_variants = end_position_offset - start_position_offset + 1;
+
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
+
+	unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
+
+	read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_variants, reinterpret_cast<unsigned char*>(haplotypes.get()), hdf5_lock);
+
+	HVCFQueryTrace::stage(HVCFQueryTrace::CONVERT_STAGE);
+
+	if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
+	}
+
+	HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+
+	{
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
+
+		Mat<double> S(haplotypes.get(), n_haplotypes, n_variants, false, false); // this call doesn't copy matrix.
+		Row<double> J(n_haplotypes, fill::ones);
+
+		Mat<double> C1(J * S);
+		Mat<double> C2(n_haplotypes - C1);
+		Mat<double> M1(C1.t() * C1);
+
+		Mat<double> R((n_haplotypes * S.t() * S - M1) / sqrt(M1 % (C2.t() * C2)));
 
-	if (H5Dread(chromosomes_cache_it->second->names_index_buckets_id, string_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, string_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
+		result.r.assign(R.memptr(), R.memptr() + n_variants * n_variants); // R is symmetric, so column-major order of Armadillo doesn't matter.
 	}
 
-	string_index_entry_type search_string_index_entry;
-	search_string_index_entry.string_value = (char*)name.c_str();
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
 
-	auto string_index_entry = lower_bound(string_index_entries_buffer, string_index_entries_buffer + mem_dims[0], search_string_index_entry,
-			[] (const string_index_entry_type& f, const string_index_entry_type& s) -> bool {
-				return (strcmp(f.string_value, s.string_value) < 0);
-			});
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_variants, result.variants);
 
-	long long int variant_offset = 0;
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(result.r.size());
 
-	if ((string_index_entry == string_index_entries_buffer + mem_dims[0]) || (strcmp(string_index_entry->string_value, name.c_str())) != 0) {
-		variant_offset = -1;
-	} else {
-		variant_offset = string_index_entry->offset;
-	}
+	{
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-	if (H5Dvlen_reclaim(string_index_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, string_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-	}
+		for (unsigned int i = 0u; i < n_variants; ++i) {
+			result.rows.push_back(i);
+		}
 
-	return variant_offset;
+		result.rsquare.resize(result.r.size());
+		for (unsigned int i = 0u; i < result.r.size(); ++i) {
+			result.rsquare[i] = pow(result.r[i], 2.0);
+		}
+	}
 }
 
-long long int HVCF::get_sample_offset(const string& name) throw (HVCFReadException) {
-	HDF5DataspaceIdentifier dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
+void HVCF::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld");
+	ld_query_columns columns;
 
-	std::hash<string> hash_function;
+	compute_ld(subset, chromosome, start_position, end_position, columns);
 
-	hsize_t hash_value = hash_function(name) % N_SAMPLES_HASH_BUCKETS;
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
 
-	hsize_t offset[1]{hash_value};
-	hsize_t mem_dims[1]{1};
+	hsize_t n_variants = columns.get_n_columns();
+	if (n_variants == 0u) {
+		return;
+	}
 
-	hash_index_entry_type hash_index_entry;
+	result.resize(n_variants * n_variants);
+	unsigned int i_offset = 0u;
+	unsigned int j_offset = 0u;
+	for (unsigned int i = 0u; i < n_variants; ++i) {
+		i_offset = i * n_variants;
+		for (unsigned int j = 0u; j < n_variants; ++j) {
+			j_offset = i_offset + j;
+			result[j_offset].name1 = columns.variants.get_name(i);
+			result[j_offset].position1 = columns.variants.get_position(i);
+			result[j_offset].name2 = columns.variants.get_name(j);
+			result[j_offset].position2 = columns.variants.get_position(j);
+			result[j_offset].r = columns.r[j_offset];
+			result[j_offset].rsquare = columns.rsquare[j_offset];
+		}
+	}
+}
 
-	if ((dataspace_id = H5Dget_space(samples_cache.names_index_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+void HVCF::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, HVCFLDSink& sink) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld_tiled");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
+	variants_columns variants;
+
+	auto empty = [&]() -> void {
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
+		sink.begin(variants);
+	};
+
+	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
+	if (chromosomes_cache_it == chromosomes_cache.end()) {
+		return empty();
 	}
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	if (end_position < start_position) {
+		return empty();
 	}
 
-	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	long long int start_position_offset = 0;
+	long long int end_position_offset = 0;
+
+	if ((start_position_offset = get_variant_offset_by_position_eq(chromosome, start_position)) < 0) {
+		return empty();
 	}
 
-	if (H5Dread(samples_cache.names_index_id, hash_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, &hash_index_entry) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	if ((end_position_offset = get_variant_offset_by_position_eq(chromosome, end_position)) < 0) {
+		return empty();
 	}
 
-	dataspace_id.close();
-	memory_dataspace_id.close();
+	const subsets_cache_entry* subset_entry = find_subset(subset);
 
-	if ((hash_index_entry.bucket_offset == 0) && (hash_index_entry.bucket_size == 0)) {
-		return -1;
+	if (subset_entry == nullptr) {
+		return empty();
 	}
 
-	offset[0] = hash_index_entry.bucket_offset;
-	mem_dims[0] = hash_index_entry.bucket_size;
+	hsize_t n_samples = subset_entry->n_samples;
+	hsize_t n_haplotypes = 2 * n_samples;
 
-	string_index_entry_type string_index_entries_buffer[hash_index_entry.bucket_size];
+	hsize_t n_variants = end_position_offset - start_position_offset + 1;
+	hsize_t tile_size = std::max(1u, LD_TILE_SIZE);
 
-	if ((dataspace_id = H5Dget_space(samples_cache.names_index_buckets_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_variants, variants);
 
-	if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, mem_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	// BEGIN: read haplotypes one tile of variants at a time and pack them into bitsets (1 bit per haplotype), so that unpacked haplotypes of the whole region are never in memory.
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
 
-	if (H5Dread(samples_cache.names_index_buckets_id, string_index_entry_memory_datatype_id, memory_dataspace_id, dataspace_id, H5P_DEFAULT, string_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset.");
-	}
+	PopcountLD popcount_ld(n_variants, n_haplotypes);
+	unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[tile_size * n_haplotypes]);
+	hsize_t n_block_variants = 0u;
 
-	string_index_entry_type search_string_index_entry;
-	search_string_index_entry.string_value = (char*)name.c_str();
+	for (hsize_t offset = 0u; offset < n_variants; offset += n_block_variants) {
+		n_block_variants = std::min(tile_size, n_variants - offset);
+		read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset + offset, n_block_variants, haplotypes.get(), hdf5_lock);
 
-	auto string_index_entry = lower_bound(string_index_entries_buffer, string_index_entries_buffer + mem_dims[0], search_string_index_entry,
-			[] (const string_index_entry_type& f, const string_index_entry_type& s) -> bool {
-				return (strcmp(f.string_value, s.string_value) < 0);
-			});
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
+		for (hsize_t v = 0u; v < n_block_variants; ++v) {
+			popcount_ld.load(offset + v, haplotypes.get() + v * n_haplotypes);
+		}
+	}
+	haplotypes.reset();
+	// END: read haplotypes.
 
-	long long int variant_offset = 0;
+	HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+	HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-	if ((string_index_entry == string_index_entries_buffer + mem_dims[0]) || (strcmp(string_index_entry->string_value, name.c_str())) != 0) {
-		variant_offset = -1;
-	} else {
-		variant_offset = string_index_entry->offset;
+	sink.begin(variants);
+
+	// BEGIN: compute tiles of upper block triangle in parallel. Workers take next tile from shared counter, so faster workers take more tiles.
+	hsize_t n_blocks = (n_variants + tile_size - 1u) / tile_size;
+	vector<pair<hsize_t, hsize_t>> tiles;
+	for (hsize_t row_block = 0u; row_block < n_blocks; ++row_block) {
+		for (hsize_t column_block = row_block; column_block < n_blocks; ++column_block) {
+			tiles.emplace_back(row_block, column_block);
+		}
 	}
 
-	if (H5Dvlen_reclaim(string_index_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, string_index_entries_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	unsigned int n_threads = (LD_THREADS > 0u) ? LD_THREADS : std::max(1u, thread::hardware_concurrency());
+	if (n_threads > tiles.size()) {
+		n_threads = tiles.size();
+	}
+
+	atomic<size_t> next_tile(0u);
+	atomic<bool> stop(false);
+	atomic<unsigned long long int> n_results(0ull);
+	mutex sink_mutex;
+
+	auto compute = [&]() -> void {
+		unique_ptr<double[]> r(new double[tile_size * tile_size]);
+		ld_tile tile;
+		size_t t = 0u;
+		try {
+			while (!stop && ((t = next_tile++) < tiles.size())) {
+				tile.row_start = tiles[t].first * tile_size;
+				tile.n_rows = std::min(tile_size, n_variants - tile.row_start);
+				tile.column_start = tiles[t].second * tile_size;
+				tile.n_columns = std::min(tile_size, n_variants - tile.column_start);
+				tile.r = r.get();
+				for (unsigned int i = 0u; i < tile.n_rows; ++i) {
+					for (unsigned int j = 0u; j < tile.n_columns; ++j) {
+						if ((tile.row_start == tile.column_start) && (j < i)) { // diagonal tile is symmetric
+							r[i * tile.n_columns + j] = r[j * tile.n_columns + i];
+						} else {
+							r[i * tile.n_columns + j] = popcount_ld.compute_r(tile.row_start + i, tile.column_start + j);
+						}
+					}
+				}
+				lock_guard<mutex> sink_lock(sink_mutex);
+				if (!stop) {
+					sink.consume(tile);
+					n_results += tile.n_rows * tile.n_columns;
+				}
+			}
+		} catch (...) {
+			stop = true;
+			throw;
+		}
+	};
+
+	try {
+		worker_pool->wait(worker_pool->submit(n_threads, compute)); // reader's threads, shared with chunk decompression
+	} catch (HVCFReadException& e) {
+		throw;
+	} catch (exception& e) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while computing LD tiles.");
 	}
+	// END: compute tiles.
 
-	return variant_offset;
+	HVCFQueryTrace::set_results(n_results);
 }
 
-void HVCF::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+void HVCF::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld_pairs");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
+	result.clear();
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return;
@@ -2978,120 +4801,166 @@ void HVCF::compute_ld(const string& subset, const string& chromosome, unsigned l
 		return;
 	}
 
-	auto subsets_cache_it = samples_cache.subsets.find(subset);
+	const subsets_cache_entry* subset_entry = find_subset(subset);
 
-	if (subsets_cache_it == samples_cache.subsets.end()) {
+	if (subset_entry == nullptr) {
 		return;
 	}
 
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t n_samples = subsets_cache_it->second.n_samples;
+	hsize_t n_samples = subset_entry->n_samples;
 	hsize_t n_haplotypes = 2 * n_samples;
 
 	hsize_t n_variants = end_position_offset - start_position_offset + 1;
 
-	hsize_t file_offset_2D[2]{static_cast<hsize_t>(start_position_offset), 0};
-	hsize_t counts_2D[2]{n_variants, 0};
-	hsize_t mem_dims_2D[2]{n_variants, n_haplotypes};
+	// Variants are read first: their positions are needed to skip pairs, which are too far apart.
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
 
-	unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_variants, result.variants);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->haplotypes_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+	// BEGIN: columns of each row allowed by max_distance: [first[i], last[i]] (variants are sorted by position).
+	const vector<unsigned long long int>& positions = result.variants.positions;
+	vector<unsigned int> first(n_variants, 0u);
+	vector<unsigned int> last(n_variants, 0u);
 
-	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims_2D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+	for (unsigned int i = 0u, f = 0u, l = 0u; i < n_variants; ++i) {
+		while (positions[i] - positions[f] > options.max_distance) {
+			++f;
+		}
+		l = max(l, i);
+		while ((l + 1u < n_variants) && (positions[l + 1u] - positions[i] <= options.max_distance)) {
+			++l;
+		}
+		first[i] = options.upper_triangle ? i + 1u : f;
+		last[i] = l;
+	}
+	// END: columns of each row.
+
+	// BEGIN: serve from precomputed LD, if it has every pair this query can keep.
+	auto ld_stores_it = subset_entry->transient ? chromosomes_cache_it->second->ld_stores.end() : chromosomes_cache_it->second->ld_stores.find(subset);
+	if ((ld_stores_it != chromosomes_cache_it->second->ld_stores.end()) && (options.max_distance <= ld_stores_it->second->max_distance) &&
+			((ld_stores_it->second->min_rsquare <= 0.0) || (options.min_rsquare >= ld_stores_it->second->min_rsquare))) {
+		HVCFQueryTrace::stage(HVCFQueryTrace::READ_LD_STORE_STAGE);
+
+		vector<unsigned long long int> ld_offsets;
+		vector<unsigned int> ld_columns;
+		vector<double> ld_r;
+
+		read_ld_store(*ld_stores_it->second, start_position_offset, n_variants, ld_offsets, ld_columns, ld_r);
+
+		HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
+
+		unsigned long long int ld_offset = ld_offsets[0];
+		hsize_t column = 0;
+		for (unsigned int i = 0u; i < n_variants; ++i) {
+			for (unsigned long long int k = ld_offsets[i] - ld_offset; k < ld_offsets[i + 1] - ld_offset; ++k) {
+				if (ld_columns[k] < start_position_offset + first[i]) { // stored row may have columns outside region
+					continue;
+				}
+				column = ld_columns[k] - start_position_offset;
+				if (column > last[i]) {
+					break;
+				}
+				if (options.keep(ld_r[k] * ld_r[k])) {
+					result.add(i, column, ld_r[k]);
+				}
+			}
+		}
 
-	if (H5Sselect_none(file_dataspace_id) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+		HVCFQueryTrace::set_results(result.size());
+		return;
 	}
+	// END: serve from precomputed LD.
 
-	for (auto& chunk : subsets_cache_it->second.chunks) {
-		file_offset_2D[1] = 2 * get<0>(chunk);
-		counts_2D[1] = 2 * get<2>(chunk);
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
 
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset_2D, NULL, counts_2D, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-		}
-	}
+	if (strcmp(LD_ENGINE, HVCFConfiguration::POPCOUNT_LD_ENGINE) == 0) {
+		unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_variants * n_haplotypes]);
 
-	if (H5Dread(chromosomes_cache_it->second->haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, haplotypes.get()) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+		read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_variants, haplotypes.get(), hdf5_lock);
 
-	file_dataspace_id.close();
-	memory_dataspace_id.close();
+		HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-	if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
-	}
+		PopcountLD popcount_ld(n_variants, n_haplotypes);
+		popcount_ld.load(haplotypes.get());
 
-	Mat<double> S(haplotypes.get(), n_haplotypes, n_variants, false, false); // this call doesn't copy matrix.
-	Row<double> J(n_haplotypes, fill::ones);
+		double r = 0.0;
+		for (unsigned int i = 0u; i < n_variants; ++i) {
+			for (unsigned int j = first[i]; j <= last[i]; ++j) {
+				// pairs, which can't reach threshold given allele frequencies, are skipped without scanning haplotypes. Small margin absorbs rounding differences.
+				if ((options.min_rsquare > 0.0) && (popcount_ld.get_max_rsquare(i, j) + 1e-9 < options.min_rsquare)) {
+					continue;
+				}
+				r = popcount_ld.compute_r(i, j);
+				if (options.keep(r * r)) {
+					result.add(i, j, r);
+				}
+			}
+		}
+	} else {
+		unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
 
-	Mat<double> C1(J * S);
-	Mat<double> C2(n_haplotypes - C1);
-	Mat<double> M1(C1.t() * C1);
+		read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_variants, reinterpret_cast<unsigned char*>(haplotypes.get()), hdf5_lock);
 
-	Mat<double> R((n_haplotypes * S.t() * S - M1) / sqrt(M1 % (C2.t() * C2)));
+		HVCFQueryTrace::stage(HVCFQueryTrace::CONVERT_STAGE);
 
-//	cout << "R:" << endl;
-//	R.raw_print();
+		if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
+		}
 
-//	cout << "Rsq:" << endl;
-//	cout << square(R) << endl;
+		HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-	hsize_t file_offset_1D[1]{static_cast<hsize_t>(start_position_offset)};
-	hsize_t mem_dims_1D[1]{n_variants};
+		Mat<double> S(haplotypes.get(), n_haplotypes, n_variants, false, false); // this call doesn't copy matrix.
+		Row<double> J(n_haplotypes, fill::ones);
 
-	variants_entry_type variants_buffer[n_variants];
+		Mat<double> C1(J * S);
+		Mat<double> C2(n_haplotypes - C1);
+		Mat<double> M1(C1.t() * C1);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->variants_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+		Mat<double> R((n_haplotypes * S.t() * S - M1) / sqrt(M1 % (C2.t() * C2)));
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims_1D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+		double r = 0.0;
+		for (unsigned int i = 0u; i < n_variants; ++i) {
+			for (unsigned int j = first[i]; j <= last[i]; ++j) {
+				r = R(i, j);
+				if (options.keep(r * r)) {
+					result.add(i, j, r);
+				}
+			}
+		}
 	}
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset_1D, NULL, mem_dims_1D, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	HVCFQueryTrace::set_results(result.size());
+}
 
-	if (H5Dread(chromosomes_cache_it->second->variants_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+void HVCF::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long end_position, const ld_options& options, vector<ld_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld_pairs");
+	ld_pairs_columns columns;
 
-	result.resize(n_variants * n_variants);
-	unsigned int i_offset = 0u;
-	unsigned int j_offset = 0u;
-	for (unsigned int i = 0u; i < n_variants; ++i) {
-		i_offset = i * n_variants;
-		for (unsigned int j = 0u; j < n_variants; ++j) {
-			j_offset = i_offset + j;
-			result[j_offset].name1 = variants_buffer[i].name;
-			result[j_offset].position1 = variants_buffer[i].position;
-			result[j_offset].name2 = variants_buffer[j].name;
-			result[j_offset].position2 = variants_buffer[j].position;
-			result[j_offset].r = R(i, j);
-			result[j_offset].rsquare = pow(R(i, j), 2.0);
-//			result.emplace_back(
-//				variants_buffer[i].name, variants_buffer[i].position,
-//				variants_buffer[j].name, variants_buffer[j].position,
-//				R(i, j), pow(R(i, j), 2.0));
-		}
-	}
+	compute_ld(subset, chromosome, start_position, end_position, options, columns);
 
-	if (H5Dvlen_reclaim(variants_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+
+	result.resize(columns.size());
+	for (unsigned int k = 0u; k < columns.size(); ++k) {
+		result[k].name1 = columns.variants.get_name(columns.index1[k]);
+		result[k].position1 = columns.variants.get_position(columns.index1[k]);
+		result[k].name2 = columns.variants.get_name(columns.index2[k]);
+		result[k].position2 = columns.variants.get_position(columns.index2[k]);
+		result[k].r = columns.r[k];
+		result[k].rsquare = columns.rsquare[k];
 	}
 }
 
-void HVCF::compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+void HVCF::compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, ld_query_columns& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld_lead");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
+	result.clear();
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return;
@@ -3117,16 +4986,13 @@ void HVCF::compute_ld(const string& subset, const string& chromosome, const stri
 		return;
 	}
 
-	auto subsets_cache_it = samples_cache.subsets.find(subset);
+	const subsets_cache_entry* subset_entry = find_subset(subset);
 
-	if (subsets_cache_it == samples_cache.subsets.end()) {
+	if (subset_entry == nullptr) {
 		return;
 	}
 
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t n_samples = subsets_cache_it->second.n_samples;
+	hsize_t n_samples = subset_entry->n_samples;
 	hsize_t n_haplotypes = 2 * n_samples;
 
 	hsize_t n_variants = 0;
@@ -3144,121 +5010,343 @@ void HVCF::compute_ld(const string& subset, const string& chromosome, const stri
 		}
 	}
 
-	hsize_t file_offset1_2D[2]{static_cast<hsize_t>(lead_variant_offset), 0};
-	hsize_t counts1_2D[2]{1, n_haplotypes};
-	hsize_t file_offset2_2D[2]{static_cast<hsize_t>(start_position_offset), 0};
-	hsize_t counts2_2D[2]{static_cast<hsize_t>(end_position_offset - start_position_offset + 1), n_haplotypes};
-	hsize_t mem_dims_2D[2]{n_variants, n_haplotypes};
+	hsize_t n_range_variants = end_position_offset - start_position_offset + 1;
 
-	unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
+	// BEGIN: serve from precomputed LD, if it has all pairs and region is within max_distance of lead variant.
+	auto ld_stores_it = subset_entry->transient ? chromosomes_cache_it->second->ld_stores.end() : chromosomes_cache_it->second->ld_stores.find(subset);
+	if ((ld_stores_it != chromosomes_cache_it->second->ld_stores.end()) && (ld_stores_it->second->min_rsquare <= 0.0)) {
+		HVCFQueryTrace::stage(HVCFQueryTrace::READ_LD_STORE_STAGE);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->haplotypes_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
+		vector<unsigned long long int> ld_offsets;
+		vector<unsigned int> ld_columns;
+		vector<double> ld_r;
+
+		read_ld_store(*ld_stores_it->second, lead_variant_offset, 1, ld_offsets, ld_columns, ld_r);
+
+		// stored row has every variant within max_distance of lead variant, i.e. contiguous range of variants, which must include region
+		if (!ld_columns.empty() && (ld_columns.front() <= std::min(start_position_offset, lead_variant_offset)) && (ld_columns.back() >= std::max(end_position_offset, lead_variant_offset))) {
+			hsize_t range_local_offset = ((n_range_variants != n_variants) && (lead_variant_local_offset == 0)) ? 1 : 0;
+			result.r.resize(n_variants);
+			for (unsigned int k = 0u; k < ld_columns.size(); ++k) {
+				if (ld_columns[k] == lead_variant_offset) {
+					result.r[lead_variant_local_offset] = ld_r[k];
+				}
+				if ((ld_columns[k] >= start_position_offset) && (ld_columns[k] <= end_position_offset)) {
+					result.r[range_local_offset + ld_columns[k] - start_position_offset] = ld_r[k];
+				}
+			}
+		}
 	}
+	// END: serve from precomputed LD.
 
-	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims_2D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
+	if (result.r.empty()) {
+		HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
+
+		// Allocated as doubles, so that dense engine can convert haplotypes in place.
+		unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
+		unsigned char* haplotypes_bytes = reinterpret_cast<unsigned char*>(haplotypes.get());
+
+		if (n_range_variants == n_variants) {
+			read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_variants, haplotypes_bytes, hdf5_lock);
+		} else if (lead_variant_local_offset == 0) {
+			read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, lead_variant_offset, 1, haplotypes_bytes, hdf5_lock);
+			read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_range_variants, haplotypes_bytes + n_haplotypes, hdf5_lock);
+		} else {
+			read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_range_variants, haplotypes_bytes, hdf5_lock);
+			read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, lead_variant_offset, 1, haplotypes_bytes + n_range_variants * n_haplotypes, hdf5_lock);
+		}
+
+		if (strcmp(LD_ENGINE, HVCFConfiguration::POPCOUNT_LD_ENGINE) == 0) {
+			HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+			HDF5LockRelease hdf5_unlock(hdf5_lock);
+
+			PopcountLD popcount_ld(n_variants, n_haplotypes);
+			popcount_ld.load(haplotypes_bytes);
+
+			result.r.resize(n_variants);
+			for (unsigned int i = 0u; i < n_variants; ++i) {
+				result.r[i] = popcount_ld.compute_r(lead_variant_local_offset, i);
+			}
+		} else {
+			HVCFQueryTrace::stage(HVCFQueryTrace::CONVERT_STAGE);
+
+			if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
+				throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
+			}
+
+			HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+			HDF5LockRelease hdf5_unlock(hdf5_lock);
+
+			Mat<double> S(haplotypes.get(), n_haplotypes, n_variants, false, false); // this call doesn't copy matrix.
+			Row<double> L(S.colptr(lead_variant_local_offset), n_haplotypes);
+			Row<double> J(n_haplotypes, fill::ones);
+
+			Mat<double> LC1(J * L.t());
+			Mat<double> LC2(n_haplotypes - LC1);
+			Mat<double> SC1(J * S);
+			Mat<double> SC2(n_haplotypes - SC1);
+			Mat<double> M1(LC1 * SC1);
+
+			Mat<double> R((n_haplotypes * L * S - M1) / sqrt(M1 % (LC2 * SC2)));
+
+			result.r.assign(R.memptr(), R.memptr() + n_variants);
+		}
 	}
 
-	if (H5Sselect_none(file_dataspace_id) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
+
+	// lead variant outside of region is before or after it, i.e. variants are in file order
+	if ((n_range_variants != n_variants) && (lead_variant_local_offset == 0)) {
+		read_variants(*chromosomes_cache_it->second, lead_variant_offset, 1, result.variants);
+	}
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_range_variants, result.variants);
+	if ((n_range_variants != n_variants) && (lead_variant_local_offset != 0)) {
+		read_variants(*chromosomes_cache_it->second, lead_variant_offset, 1, result.variants);
 	}
 
-	for (auto& chunk : subsets_cache_it->second.chunks) {
-		file_offset1_2D[1] = 2 * get<0>(chunk);
-		counts1_2D[1] = 2 * get<2>(chunk);
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(result.r.size());
 
-		file_offset2_2D[1] = 2 * get<0>(chunk);
-		counts2_2D[1] = 2 * get<2>(chunk);
+	{
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset1_2D, NULL, counts1_2D, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+		result.rows.push_back(lead_variant_local_offset);
+
+		result.rsquare.resize(result.r.size());
+		for (unsigned int i = 0u; i < result.r.size(); ++i) {
+			result.rsquare[i] = pow(result.r[i], 2.0);
 		}
+	}
+}
 
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset2_2D, NULL, counts2_2D, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+void HVCF::compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld_lead");
+	ld_query_columns columns;
+
+	compute_ld(subset, chromosome, lead_variant_name, start_position, end_position, columns);
+
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+
+	if (columns.get_n_rows() == 0u) {
+		return;
+	}
+
+	unsigned int lead = columns.rows[0];
+	for (unsigned int i = 0u; i < columns.get_n_columns(); ++i) {
+		if (i != lead) {
+			result.emplace_back(
+					columns.variants.get_name(lead), columns.variants.get_position(lead),
+					columns.variants.get_name(i), columns.variants.get_position(i),
+					columns.get_r(0, i), columns.get_rsquare(0, i));
 		}
 	}
+}
+
+void HVCF::compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, ld_batch_columns& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld_batch");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
+	result.clear();
+
+	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
+	if (chromosomes_cache_it == chromosomes_cache.end()) {
+		return;
+	}
 
-	if (H5Dread(chromosomes_cache_it->second->haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, haplotypes.get()) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+	if (window.end_position < window.start_position) {
+		return;
 	}
 
-	file_dataspace_id.close();
-	memory_dataspace_id.close();
+	const subsets_cache_entry* subset_entry = find_subset(subset);
 
-	if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
+	if (subset_entry == nullptr) {
+		return;
+	}
+
+	hsize_t n_samples = subset_entry->n_samples;
+	hsize_t n_haplotypes = 2 * n_samples;
+
+	// BEGIN: find lead variants.
+	vector<hsize_t> lead_offsets;
+	long long int lead_offset = 0;
+
+	for (unsigned int i = 0u; i < lead_variant_names.size(); ++i) {
+		if ((lead_offset = get_variant_offset_by_name(chromosome, lead_variant_names[i])) >= 0) {
+			result.requests.push_back(i);
+			lead_offsets.push_back(lead_offset);
+		}
+	}
+
+	if (lead_offsets.empty()) {
+		return;
+	}
+
+	hsize_t n_leads = lead_offsets.size();
+	vector<unsigned long long int> lead_positions(n_leads);
+
+	for (unsigned int i = 0u; i < n_leads; ++i) {
+		read_variant_positions(*chromosomes_cache_it->second, lead_offsets[i], 1, &lead_positions[i]);
+	}
+	// END: find lead variants.
+
+	// BEGIN: windows of lead variants (as variant offsets; empty if first > last) and their union as sorted disjoint intervals. Lead variant itself is always in the union.
+	vector<pair<long long int, long long int>> windows(n_leads);
+	vector<pair<hsize_t, hsize_t>> intervals;
+	unsigned long long int window_start = 0ull;
+	unsigned long long int window_end = 0ull;
+
+	for (unsigned int i = 0u; i < n_leads; ++i) {
+		window_start = std::max(window.start_position, lead_positions[i] > window.flank ? lead_positions[i] - window.flank : 0ull);
+		window_end = std::min(window.end_position, numeric_limits<unsigned long long int>::max() - window.flank > lead_positions[i] ? lead_positions[i] + window.flank : numeric_limits<unsigned long long int>::max());
+		windows[i] = make_pair(0ll, -1ll);
+		if (window_start <= window_end) {
+			windows[i].first = get_variant_offset_by_position_ge(chromosome, window_start);
+			windows[i].second = get_variant_offset_by_position_le(chromosome, window_end);
+			if ((windows[i].first < 0) || (windows[i].second < windows[i].first)) {
+				windows[i] = make_pair(0ll, -1ll);
+			}
+		}
+		intervals.emplace_back(lead_offsets[i], lead_offsets[i]);
+		if (windows[i].first <= windows[i].second) {
+			intervals.emplace_back(windows[i].first, windows[i].second);
+		}
 	}
 
-	Mat<double> S(haplotypes.get(), n_haplotypes, n_variants, false, false); // this call doesn't copy matrix.
-	Row<double> L(S.colptr(lead_variant_local_offset), n_haplotypes);
-	Row<double> J(n_haplotypes, fill::ones);
+	sort(intervals.begin(), intervals.end());
+	unsigned int n_intervals = 0u;
+	for (unsigned int i = 1u; i < intervals.size(); ++i) {
+		if (intervals[i].first <= intervals[n_intervals].second + 1u) {
+			intervals[n_intervals].second = std::max(intervals[n_intervals].second, intervals[i].second);
+		} else {
+			intervals[++n_intervals] = intervals[i];
+		}
+	}
+	intervals.resize(n_intervals + 1u);
+
+	vector<hsize_t> interval_ordinals(intervals.size()); // ordinal of interval's first variant in the union
+	hsize_t n_variants = 0u;
+	for (unsigned int i = 0u; i < intervals.size(); ++i) {
+		interval_ordinals[i] = n_variants;
+		n_variants += intervals[i].second - intervals[i].first + 1u;
+	}
+
+	auto get_ordinal = [&](hsize_t offset) -> unsigned int {
+		auto interval_it = upper_bound(intervals.begin(), intervals.end(), make_pair(offset, numeric_limits<hsize_t>::max())) - 1;
+		return interval_ordinals[interval_it - intervals.begin()] + (offset - interval_it->first);
+	};
+	// END: windows of lead variants.
+
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
+
+	for (unsigned int i = 0u; i < intervals.size(); ++i) {
+		read_variants(*chromosomes_cache_it->second, intervals[i].first, intervals[i].second - intervals[i].first + 1u, result.variants);
+	}
+
+	for (unsigned int i = 0u; i < n_leads; ++i) {
+		result.leads.push_back(get_ordinal(lead_offsets[i]));
+		result.window_starts.push_back(windows[i].first <= windows[i].second ? get_ordinal(windows[i].first) : 0u);
+		result.offsets.push_back(result.offsets.back() + (windows[i].second - windows[i].first + 1));
+	}
+
+	// BEGIN: read haplotypes of the union once, one hyperslab per interval.
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
 
-	Mat<double> LC1(J * L.t());
-	Mat<double> LC2(n_haplotypes - LC1);
-	Mat<double> SC1(J * S);
-	Mat<double> SC2(n_haplotypes - SC1);
-	Mat<double> M1(LC1 * SC1);
+	// Allocated as doubles, so that dense engine can convert haplotypes in place.
+	unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
+	unsigned char* haplotypes_bytes = reinterpret_cast<unsigned char*>(haplotypes.get());
+
+	for (unsigned int i = 0u; i < intervals.size(); ++i) {
+		read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, intervals[i].first, intervals[i].second - intervals[i].first + 1u, haplotypes_bytes + interval_ordinals[i] * n_haplotypes, hdf5_lock);
+	}
+	// END: read haplotypes.
 
-	Mat<double> R((n_haplotypes * L * S - M1) / sqrt(M1 % (LC2 * SC2)));
+	result.r.resize(result.offsets.back());
 
-//	cout << "R:" << endl;
-//	R.raw_print();
+	if (strcmp(LD_ENGINE, HVCFConfiguration::POPCOUNT_LD_ENGINE) == 0) {
+		HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-//	cout << "Rsq:" << endl;
-//	cout << square(R) << endl;
+		PopcountLD popcount_ld(n_variants, n_haplotypes);
+		popcount_ld.load(haplotypes_bytes);
 
-	hsize_t file_offset1_1D[1]{static_cast<hsize_t>(lead_variant_offset)};
-	hsize_t counts1_1D[1]{1};
-	hsize_t file_offset2_1D[1]{static_cast<hsize_t>(start_position_offset)};
-	hsize_t counts2_1D[1]{static_cast<hsize_t>(end_position_offset - start_position_offset + 1)};
-	hsize_t mem_dims_1D[1]{n_variants};
+		for (unsigned int i = 0u; i < n_leads; ++i) {
+			for (unsigned int j = 0u; j < result.get_window_size(i); ++j) {
+				result.r[result.offsets[i] + j] = popcount_ld.compute_r(result.leads[i], result.window_starts[i] + j);
+			}
+		}
+	} else {
+		HVCFQueryTrace::stage(HVCFQueryTrace::CONVERT_STAGE);
 
-	variants_entry_type variants_buffer[n_variants];
+		if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
+			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
+		}
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->variants_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+		HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims_1D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+		// One k x n product for all lead variants; windows are sliced from it.
+		Mat<double> S(haplotypes.get(), n_haplotypes, n_variants, false, false); // this call doesn't copy matrix.
+		Mat<double> L(n_haplotypes, n_leads);
+		for (unsigned int i = 0u; i < n_leads; ++i) {
+			memcpy(L.colptr(i), S.colptr(result.leads[i]), n_haplotypes * sizeof(double));
+		}
+		Row<double> J(n_haplotypes, fill::ones);
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset1_1D, NULL, counts1_1D, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+		Mat<double> LC1(J * L);
+		Mat<double> LC2(n_haplotypes - LC1);
+		Mat<double> SC1(J * S);
+		Mat<double> SC2(n_haplotypes - SC1);
+		Mat<double> M1(LC1.t() * SC1);
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset2_1D, NULL, counts2_1D, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+		Mat<double> R((n_haplotypes * L.t() * S - M1) / sqrt(M1 % (LC2.t() * SC2)));
 
-	if (H5Dread(chromosomes_cache_it->second->variants_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
+		for (unsigned int i = 0u; i < n_leads; ++i) {
+			for (unsigned int j = 0u; j < result.get_window_size(i); ++j) {
+				result.r[result.offsets[i] + j] = R(i, result.window_starts[i] + j);
+			}
+		}
 	}
 
-	for (unsigned int i = 0; i < lead_variant_local_offset; ++i) {
-		result.emplace_back(
-				variants_buffer[lead_variant_local_offset].name, variants_buffer[lead_variant_local_offset].position,
-				variants_buffer[i].name, variants_buffer[i].position,
-				R.at(0, i), pow(R.at(0, i), 2.0));
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(result.r.size());
 
-	for (unsigned int i = lead_variant_local_offset + 1; i < n_variants; ++i) {
-		result.emplace_back(
-				variants_buffer[lead_variant_local_offset].name, variants_buffer[lead_variant_local_offset].position,
-				variants_buffer[i].name, variants_buffer[i].position,
-				R.at(0, i), pow(R.at(0, i), 2.0));
+	result.rsquare.resize(result.r.size());
+	for (unsigned int i = 0u; i < result.r.size(); ++i) {
+		result.rsquare[i] = pow(result.r[i], 2.0);
 	}
+}
 
-	if (H5Dvlen_reclaim(variants_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+void HVCF::compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, vector<ld_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_ld_batch");
+	ld_batch_columns columns;
+
+	compute_ld(subset, chromosome, lead_variant_names, window, columns);
+
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+
+	unsigned int lead = 0u;
+	unsigned int variant = 0u;
+	for (unsigned int i = 0u; i < columns.get_n_leads(); ++i) {
+		lead = columns.leads[i];
+		for (unsigned int j = 0u; j < columns.get_window_size(i); ++j) {
+			variant = columns.window_starts[i] + j;
+			if (variant != lead) {
+				result.emplace_back(
+						columns.variants.get_name(lead), columns.variants.get_position(lead),
+						columns.variants.get_name(variant), columns.variants.get_position(variant),
+						columns.get_r(i, j), columns.get_rsquare(i, j));
+			}
+		}
 	}
 }
 
-void HVCF::compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException) {
-	std::chrono::time_point<std::chrono::system_clock> start, end;
-	std::chrono::duration<double> elapsed_seconds;
+void HVCF::compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_frequencies");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
+	result.clear();
 
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
@@ -3280,118 +5368,88 @@ void HVCF::compute_frequencies(const string& subset, const string& chromosome, u
 		return;
 	}
 
-	start = std::chrono::system_clock::now();
+	const subsets_cache_entry* subset_entry = find_subset(subset);
 
-	auto subsets_cache_it = samples_cache.subsets.find(subset);
-
-	if (subsets_cache_it == samples_cache.subsets.end()) {
+	if (subset_entry == nullptr) {
 		return;
 	}
 
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t n_samples = subsets_cache_it->second.n_samples;
+	hsize_t n_samples = subset_entry->n_samples;
 	hsize_t n_haplotypes = 2 * n_samples;
 
 	hsize_t n_variants = end_position_offset - start_position_offset + 1;
 
-	hsize_t file_offset_2D[2]{static_cast<hsize_t>(start_position_offset), 0};
-	hsize_t counts_2D[2]{n_variants, 0};
-	hsize_t mem_dims_2D[2]{n_variants, n_haplotypes};
-
-//	unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
+	vector<double> counts;
+	counts.assign(n_variants, 0.0);
 
-	unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_variants * n_haplotypes]);
+	// BEGIN: use alternate allele counts materialized at import or subset creation; otherwise (ad-hoc subsets) sum haplotypes.
+	unique_ptr<unsigned int[]> alt_counts = unique_ptr<unsigned int[]>(new unsigned int[n_variants]);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->haplotypes_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
 
-	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims_2D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+	if (!subset_entry->transient && read_allele_counts(chromosomes.find(chromosome)->second->get(), subset, start_position_offset, n_variants, alt_counts.get())) {
+		HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+		for (unsigned int i = 0u; i < n_variants; ++i) {
+			counts[i] = static_cast<double>(alt_counts[i]);
+		}
+	} else {
+		unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_variants * n_haplotypes]);
 
-	if (H5Sselect_none(file_dataspace_id) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+		read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_variants, haplotypes.get(), hdf5_lock);
 
-	for (auto& chunk : subsets_cache_it->second.chunks) {
-		file_offset_2D[1] = 2 * get<0>(chunk);
-		counts_2D[1] = 2 * get<2>(chunk);
+		HVCFQueryTrace::stage(HVCFQueryTrace::COMPUTE_STAGE);
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset_2D, NULL, counts_2D, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+		for (unsigned int i = 0u; i < n_variants; ++i) {
+			for (unsigned int j = i * n_haplotypes; j < i * n_haplotypes + n_haplotypes; ++j) {
+				counts[i] += static_cast<double>(haplotypes[j]);
+			}
 		}
 	}
+	// END: use alternate allele counts.
 
-	if (H5Dread(chromosomes_cache_it->second->haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, haplotypes.get()) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
-
-	file_dataspace_id.close();
-	memory_dataspace_id.close();
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
 
-//	end = std::chrono::system_clock::now();
-//	elapsed_seconds = end - start;
-//	cout << "Retrieved haplotypes in " << elapsed_seconds.count() << " seconds" << endl;
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_variants, result.variants);
 
-//	start = std::chrono::system_clock::now();
-//	if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
-//		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
-//	}
-//	end = std::chrono::system_clock::now();
-//	elapsed_seconds = end - start;
-//	cout << "Type-casted haplotypes in " << elapsed_seconds.count() << " seconds" << endl;
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(n_variants);
 
-//	start = std::chrono::system_clock::now();
+	{
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-	vector<double> counts;
-	counts.assign(n_variants, 0.0);
-	for (unsigned int i = 0u; i < n_variants; ++i) {
-		for (unsigned int j = i * n_haplotypes; j < i * n_haplotypes + n_haplotypes; ++j) {
-			counts[i] += static_cast<double>(haplotypes[j]);
+		for (unsigned int i = 0u; i < n_variants; ++i) {
+			result.ref_af.push_back(counts[i] / n_haplotypes);
+			result.alt_af.push_back(1.0 - counts[i] / n_haplotypes);
+			result.alt_counts.push_back(static_cast<unsigned int>(counts[i]));
 		}
+		result.n_haplotypes = n_haplotypes;
 	}
-//	end = std::chrono::system_clock::now();
-//	elapsed_seconds = end - start;
-//	cout << "Computed counts in " << elapsed_seconds.count() << " seconds (" << n_variants << ")" << endl;
-
-	hsize_t file_offset1_1D[1]{static_cast<hsize_t>(start_position_offset)};
-	hsize_t counts1_1D[1]{n_variants};
-	hsize_t mem_dims_1D[1]{n_variants};
-
-	variants_entry_type variants_buffer[n_variants];
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->variants_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+}
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims_1D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+void HVCF::compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "compute_frequencies");
+	frequency_query_columns columns;
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset1_1D, NULL, counts1_1D, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	compute_frequencies(subset, chromosome, start_position, end_position, columns);
 
-	if (H5Dread(chromosomes_cache_it->second->variants_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
 
-	for (unsigned int i = 0u; i < n_variants; ++i) {
+	for (unsigned int i = 0u; i < columns.size(); ++i) {
 		result.emplace_back(
-				variants_buffer[i].name, variants_buffer[i].ref, variants_buffer[i].alt, variants_buffer[i].position,
-				counts[i] / n_haplotypes, 1.0 - counts[1] / n_haplotypes);
+				columns.variants.get_name(i), columns.variants.get_ref(i), columns.variants.get_alt(i), columns.variants.get_position(i),
+				columns.ref_af[i], columns.alt_af[i]);
 	}
+}
 
-	if (H5Dvlen_reclaim(variants_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-	}
+void HVCF::extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, variants_columns& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "extract_variants");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
 
-}
+	result.clear();
 
-void HVCF::extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<variant_query_result>& result) throw (HVCFReadException) {
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return;
@@ -3412,42 +5470,35 @@ void HVCF::extract_variants(const string& chromosome, unsigned long long int sta
 		return;
 	}
 
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
 	hsize_t n_variants = end_position_offset - start_position_offset + 1;
 
-	hsize_t file_offset[1]{static_cast<hsize_t>(start_position_offset)};
-	hsize_t mem_dims[1]{n_variants};
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
 
-	variants_entry_type variants_buffer[n_variants];
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_variants, result);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->variants_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(n_variants);
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+}
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, NULL, mem_dims, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+void HVCF::extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<variant_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "extract_variants");
+	variants_columns columns;
 
-	if (H5Dread(chromosomes_cache_it->second->variants_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+	extract_variants(chromosome, start_position, end_position, columns);
 
-	for (unsigned int i = 0u; i < n_variants; ++i) {
-		result.emplace_back(variants_buffer[i].name, variants_buffer[i].ref, variants_buffer[i].alt, variants_buffer[i].position);
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
 
-	if (H5Dvlen_reclaim(variants_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
+	for (unsigned int i = 0u; i < columns.size(); ++i) {
+		result.emplace_back(columns.get_name(i), columns.get_ref(i), columns.get_alt(i), columns.get_position(i));
 	}
 }
 
 void HVCF::extract_haplotypes(const string& subset, const string& chromosome, const string& variant_name, vector<variant_haplotypes_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "extract_haplotypes_variant");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return;
@@ -3465,55 +5516,37 @@ void HVCF::extract_haplotypes(const string& subset, const string& chromosome, co
 		return;
 	}
 
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
 	hsize_t n_samples = subsets_cache_it->second.n_samples;
 	hsize_t n_haplotypes = 2 * n_samples;
 	hsize_t n_variants = 1;
 
-	hsize_t file_offset[2]{static_cast<hsize_t>(variant_offset), 0};
-	hsize_t counts[2]{1, n_haplotypes};
-	hsize_t mem_dims[2]{n_variants, n_haplotypes};
-
 	unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_variants * n_haplotypes]);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->haplotypes_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
-
-	if (H5Sselect_none(file_dataspace_id) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
 
-	for (auto& chunk : subsets_cache_it->second.chunks) {
-		file_offset[1] = 2 * get<0>(chunk);
-		counts[1] = 2 * get<2>(chunk);
-
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset, NULL, counts, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-		}
-	}
+	read_haplotypes(*chromosomes_cache_it->second, subsets_cache_it->second.chunks, variant_offset, n_variants, haplotypes.get(), hdf5_lock);
 
-	if (H5Dread(chromosomes_cache_it->second->haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, haplotypes.get()) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(n_samples);
 
-	vector<string> samples = std::move(get_samples_in_subset(subset));
+	const vector<hsize_t>& subset_offsets = *samples_cache.table->get_subset(subset); // loaded together with subsets cache
 
 	result.resize(n_samples);
+	const vector<hsize_t>& order = subsets_cache_it->second.order; // empty, if haplotypes are in sample order
+	hsize_t h = 0u;
 	for (unsigned int i = 0u; i < n_samples; ++i) {
-		result[i].sample = std::move(samples[i]);
-		result[i].allele1 = haplotypes[i * 2];
-		result[i].allele2 = haplotypes[i * 2 + 1];
+		h = order.empty() ? i : order[i];
+		result[i].sample = samples_cache.table->get_name(subset_offsets[i]);
+		result[i].allele1 = haplotypes[h * 2];
+		result[i].allele2 = haplotypes[h * 2 + 1];
 	}
 }
 
 void HVCF::extract_haplotypes(const string& sample, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<sample_haplotypes_query_result>& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "extract_haplotypes_sample");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
+
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
 		return;
@@ -3539,87 +5572,43 @@ void HVCF::extract_haplotypes(const string& sample, const string& chromosome, un
 		return;
 	}
 
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
 	hsize_t n_haplotypes = 2;
 	hsize_t n_variants = end_position_offset - start_position_offset + 1;
 
-	hsize_t file_offset[2]{static_cast<hsize_t>(start_position_offset), 2 * sample_offset};
-	hsize_t counts[2]{n_variants, 2};
-	hsize_t mem_dims[2]{n_variants, n_haplotypes};
+	hsize_t sample_column = samples_cache.table->get_column(static_cast<hsize_t>(sample_offset));
+	vector<tuple<hsize_t, hsize_t, hsize_t>> sample_chunks{make_tuple(sample_column, sample_column, 1)};
 
 	unique_ptr<unsigned char[]> haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_variants * n_haplotypes]);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->haplotypes_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
-
-	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
-
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset, NULL, counts, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
-
-	if (H5Dread(chromosomes_cache_it->second->haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, haplotypes.get()) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
-
-	file_dataspace_id.close();
-	memory_dataspace_id.close();
-
-	hsize_t file_offset1_1D[1]{static_cast<hsize_t>(start_position_offset)};
-	hsize_t counts1_1D[1]{n_variants};
-	hsize_t mem_dims_1D[1]{n_variants};
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
 
-	variants_entry_type variants_buffer[n_variants];
+	read_haplotypes(*chromosomes_cache_it->second, sample_chunks, start_position_offset, n_variants, haplotypes.get(), hdf5_lock);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->variants_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims_1D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+	variants_columns variants;
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset1_1D, NULL, counts1_1D, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_variants, variants);
 
-	if (H5Dread(chromosomes_cache_it->second->variants_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(n_variants);
 
 	result.resize(n_variants);
 	for (unsigned int i = 0u; i < n_variants; ++i) {
-		result[i].name.assign(variants_buffer[i].name);
-		result[i].position = variants_buffer[i].position;
+		result[i].name.assign(variants.get_name(i));
+		result[i].position = variants.get_position(i);
 		result[i].allele1 = haplotypes[i * 2];
 		result[i].allele2 = haplotypes[i * 2 + 1];
 	}
 
-	if (H5Dvlen_reclaim(variants_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-	}
-
-}
-
-unsigned int HVCF::get_n_opened_objects() const {
-	if (file_id >= 0) {
-		return H5Fget_obj_count(file_id, H5F_OBJ_ALL);
-	}
-	return 0u;
 }
 
-unsigned int HVCF::get_n_all_opened_objects() {
-	return H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_ALL);
-}
+void HVCF::extract_haplotypes(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, haplotypes_query_columns& result) throw (HVCFReadException) {
+	HVCFQueryTrace trace(metrics, "extract_haplotypes");
+	unique_lock<recursive_mutex> hdf5_lock(hdf5_mutex);
+	HVCFQueryTrace::stage(HVCFQueryTrace::LOOKUP_STAGE);
 
-void HVCF::compute_ld_test(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
-	std::chrono::time_point<std::chrono::system_clock> start, end;
-	std::chrono::duration<double> elapsed_seconds;
+	result.clear();
 
 	auto chromosomes_cache_it = chromosomes_cache.find(chromosome);
 	if (chromosomes_cache_it == chromosomes_cache.end()) {
@@ -3630,16 +5619,9 @@ void HVCF::compute_ld_test(const string& subset, const string& chromosome, const
 		return;
 	}
 
-	long long int lead_variant_offset = 0;
 	long long int start_position_offset = 0;
 	long long int end_position_offset = 0;
 
-	start = std::chrono::system_clock::now();
-
-	if ((lead_variant_offset = get_variant_offset_by_name(chromosome, lead_variant_name)) < 0) {
-		return;
-	}
-
 	if ((start_position_offset = get_variant_offset_by_position_ge(chromosome, start_position)) < 0) {
 		return;
 	}
@@ -3648,181 +5630,127 @@ void HVCF::compute_ld_test(const string& subset, const string& chromosome, const
 		return;
 	}
 
-	end = std::chrono::system_clock::now();
-	elapsed_seconds = end - start;
-	cout << "Got offsets in " << elapsed_seconds.count() << " seconds" << endl;
-
-	start = std::chrono::system_clock::now();
-
-	auto subsets_cache_it = samples_cache.subsets.find(subset);
-
-	if (subsets_cache_it == samples_cache.subsets.end()) {
+	if (end_position_offset < start_position_offset) {
 		return;
 	}
 
-	HDF5DataspaceIdentifier file_dataspace_id;
-	HDF5DataspaceIdentifier memory_dataspace_id;
-
-	hsize_t n_samples = subsets_cache_it->second.n_samples;
-	hsize_t n_haplotypes = 2 * n_samples;
-
-	hsize_t n_variants = 0;
-	hsize_t lead_variant_local_offset = 0;
+	const subsets_cache_entry* subset_entry = find_subset(subset);
 
-	if ((lead_variant_offset >= start_position_offset) && (lead_variant_offset <= end_position_offset)) {
-		n_variants = end_position_offset - start_position_offset + 1;
-		lead_variant_local_offset  = lead_variant_offset - start_position_offset;
-	} else {
-		n_variants = end_position_offset - start_position_offset + 2;
-		if (lead_variant_offset < start_position_offset) {
-			lead_variant_local_offset = 0;
-		} else {
-			lead_variant_local_offset = n_variants - 1;
-		}
+	if (subset_entry == nullptr) {
+		return;
 	}
 
-	hsize_t file_offset1_2D[2]{static_cast<hsize_t>(lead_variant_offset), 0};
-	hsize_t counts1_2D[2]{1, n_haplotypes};
-	hsize_t file_offset2_2D[2]{static_cast<hsize_t>(start_position_offset), 0};
-	hsize_t counts2_2D[2]{static_cast<hsize_t>(end_position_offset - start_position_offset + 1), n_haplotypes};
-	hsize_t mem_dims_2D[2]{n_variants, n_haplotypes};
+	hsize_t n_samples = subset_entry->n_samples;
+	hsize_t n_haplotypes = 2 * n_samples;
+	hsize_t n_variants = end_position_offset - start_position_offset + 1;
 
-	unique_ptr<double[]> haplotypes = unique_ptr<double[]>(new double[n_variants * n_haplotypes]);
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_HAPLOTYPES_STAGE);
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->haplotypes_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+	// haplotypes are read directly into the result buffer
+	result.haplotypes.resize(n_variants * n_haplotypes);
+	result.n_haplotypes = n_haplotypes;
 
-	if ((memory_dataspace_id = H5Screate_simple(2, mem_dims_2D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+	read_haplotypes(*chromosomes_cache_it->second, subset_entry->chunks, start_position_offset, n_variants, result.haplotypes.data(), hdf5_lock);
 
-	if (H5Sselect_none(file_dataspace_id) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+	HVCFQueryTrace::stage(HVCFQueryTrace::READ_VARIANTS_STAGE);
 
-	for (auto& chunk : subsets_cache_it->second.chunks) {
-		file_offset1_2D[1] = 2 * get<0>(chunk);
-		counts1_2D[1] = 2 * get<2>(chunk);
+	read_variants(*chromosomes_cache_it->second, start_position_offset, n_variants, result.variants);
 
-		file_offset2_2D[1] = 2 * get<0>(chunk);
-		counts2_2D[1] = 2 * get<2>(chunk);
+	HVCFQueryTrace::stage(HVCFQueryTrace::FORMAT_STAGE);
+	HVCFQueryTrace::set_results(n_variants);
 
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset1_2D, NULL, counts1_2D, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-		}
+	// BEGIN: if samples were permuted at import, put haplotypes (read in column order) back into sample order.
+	if (!subset_entry->order.empty()) {
+		HDF5LockRelease hdf5_unlock(hdf5_lock);
 
-		if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset2_2D, NULL, counts2_2D, NULL) < 0) {
-			throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
+		const vector<hsize_t>& order = subset_entry->order;
+		vector<unsigned char> row(n_haplotypes);
+		for (hsize_t v = 0u; v < n_variants; ++v) {
+			unsigned char* haplotypes = result.haplotypes.data() + v * n_haplotypes;
+			memcpy(row.data(), haplotypes, n_haplotypes);
+			for (hsize_t i = 0u; i < n_samples; ++i) {
+				haplotypes[2 * i] = row[2 * order[i]];
+				haplotypes[2 * i + 1] = row[2 * order[i] + 1];
+			}
 		}
 	}
+	// END: haplotypes in sample order.
 
-	if (H5Dread(chromosomes_cache_it->second->haplotypes_id, H5T_NATIVE_UCHAR, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, haplotypes.get()) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
-
-	file_dataspace_id.close();
-	memory_dataspace_id.close();
-
-	end = std::chrono::system_clock::now();
-	elapsed_seconds = end - start;
-	cout << "Retrieved haplotypes in " << elapsed_seconds.count() << " seconds" << endl;
-
-	start = std::chrono::system_clock::now();
-
-	if (H5Tconvert(H5T_NATIVE_UCHAR, H5T_NATIVE_DOUBLE, n_variants * n_haplotypes, haplotypes.get(), nullptr, H5P_DEFAULT) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while converting datatypes.");
-	}
-
-	end = std::chrono::system_clock::now();
-	elapsed_seconds = end - start;
-	cout << "Type-casted haplotypes in " << elapsed_seconds.count() << " seconds" << endl;
-
-	start = std::chrono::system_clock::now();
-	Mat<double> S(haplotypes.get(), n_haplotypes, n_variants, false, false); // this call doesn't copy matrix.
-	Row<double> L(S.colptr(lead_variant_local_offset), n_haplotypes);
-	Row<double> J(n_haplotypes, fill::ones);
-
-	Mat<double> LC1(J * L.t());
-	Mat<double> LC2(n_haplotypes - LC1);
-	Mat<double> SC1(J * S);
-	Mat<double> SC2(n_haplotypes - SC1);
-	Mat<double> M1(LC1 * SC1);
-
-	Mat<double> R((n_haplotypes * L * S - M1) / sqrt(M1 % (LC2 * SC2)));
-
-//	cout << "R:" << endl;
-//	R.raw_print();
-
-//	cout << "Rsq:" << endl;
-//	cout << square(R) << endl;
-
-	hsize_t file_offset1_1D[1]{static_cast<hsize_t>(lead_variant_offset)};
-	hsize_t counts1_1D[1]{1};
-	hsize_t file_offset2_1D[1]{static_cast<hsize_t>(start_position_offset)};
-	hsize_t counts2_1D[1]{static_cast<hsize_t>(end_position_offset - start_position_offset + 1)};
-	hsize_t mem_dims_1D[1]{n_variants};
-
-	variants_entry_type variants_buffer[n_variants];
+}
 
-	end = std::chrono::system_clock::now();
-	elapsed_seconds = end - start;
-	cout << "Computed R in " << elapsed_seconds.count() << " seconds" << endl;
+void HVCF::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_ld(subset.get_name(), chromosome, start_position, end_position, result);
+}
 
-	start = std::chrono::system_clock::now();
+void HVCF::compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_ld(subset.get_name(), chromosome, lead_variant_name, start_position, end_position, result);
+}
 
-	if ((file_dataspace_id = H5Dget_space(chromosomes_cache_it->second->variants_id)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while getting dataspace.");
-	}
+void HVCF::compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_frequencies(subset.get_name(), chromosome, start_position, end_position, result);
+}
 
-	if ((memory_dataspace_id = H5Screate_simple(1, mem_dims_1D, nullptr)) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while creating memory dataspace.");
-	}
+void HVCF::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_ld(subset.get_name(), chromosome, start_position, end_position, result);
+}
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_SET, file_offset1_1D, NULL, counts1_1D, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+void HVCF::compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_ld(subset.get_name(), chromosome, lead_variant_name, start_position, end_position, result);
+}
 
-	if (H5Sselect_hyperslab(file_dataspace_id, H5S_SELECT_OR, file_offset2_1D, NULL, counts2_1D, NULL) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while making selection in dataspace.");
-	}
+void HVCF::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_ld(subset.get_name(), chromosome, start_position, end_position, options, result);
+}
 
-	if (H5Dread(chromosomes_cache_it->second->variants_id, variants_entry_memory_datatype_id, memory_dataspace_id, file_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reading from dataset");
-	}
+void HVCF::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, HVCFLDSink& sink) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_ld(subset.get_name(), chromosome, start_position, end_position, sink);
+}
 
-	end = std::chrono::system_clock::now();
-	elapsed_seconds = end - start;
-	cout << "Read variant names and positions in " << elapsed_seconds.count() << " seconds" << endl;
+void HVCF::compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException) {
+	TransientSubset subset(*this, samples);
+	compute_frequencies(subset.get_name(), chromosome, start_position, end_position, result);
+}
 
-	start = std::chrono::system_clock::now();
+unsigned int HVCF::get_n_opened_objects() const {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	for (unsigned int i = 0; i < lead_variant_local_offset; ++i) {
-		result.emplace_back(
-				variants_buffer[lead_variant_local_offset].name, variants_buffer[lead_variant_local_offset].position,
-				variants_buffer[i].name, variants_buffer[i].position,
-				R.at(0, i), pow(R.at(0, i), 2.0));
+	if (file_id >= 0) {
+		return H5Fget_obj_count(file_id, H5F_OBJ_ALL);
 	}
+	return 0u;
+}
 
-	for (unsigned int i = lead_variant_local_offset + 1; i < n_variants; ++i) {
-		result.emplace_back(
-				variants_buffer[lead_variant_local_offset].name, variants_buffer[lead_variant_local_offset].position,
-				variants_buffer[i].name, variants_buffer[i].position,
-				R.at(0, i), pow(R.at(0, i), 2.0));
-	}
+unsigned int HVCF::get_n_all_opened_objects() {
+	lock_guard<recursive_mutex> hdf5_lock(hdf5_mutex);
 
-	end = std::chrono::system_clock::now();
-	elapsed_seconds = end - start;
-	cout << "Formatted output in " << elapsed_seconds.count() << " seconds (" << n_variants << ")" << endl;
+	return H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_ALL);
+}
 
-	if (H5Dvlen_reclaim(variants_entry_memory_datatype_id, memory_dataspace_id, H5P_DEFAULT, variants_buffer) < 0) {
-		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error while reclaiming HDF5 memory.");
-	}
+HVCFMetrics HVCF::get_metrics() const {
+	return metrics;
+}
 
-	return;
+void HVCF::reset_metrics() {
+	metrics.reset();
 }
 
+void HVCF::set_haplotype_cache(const shared_ptr<HaplotypeBlockCache>& cache) {
+	haplotype_cache = cache;
+}
 
+HaplotypeBlockCache::statistics HVCF::get_haplotype_cache_statistics() const {
+	return haplotype_cache->get_statistics();
+}
 
+void HVCF::reset_haplotype_cache_statistics() {
+	haplotype_cache->reset_statistics();
+}
 
 }
@@ -4,22 +4,51 @@ namespace sph_umich_edu {
 
 constexpr char HVCFConfiguration::GZIP_COMPRESSION[];
 constexpr char HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION[];
+constexpr char HVCFConfiguration::BYTE_HAPLOTYPES_STORAGE[];
+constexpr char HVCFConfiguration::BIT_HAPLOTYPES_STORAGE[];
+constexpr char HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE[];
+constexpr char HVCFConfiguration::COLUMNS_VARIANTS_STORAGE[];
+constexpr char HVCFConfiguration::COMPOUND_VARIANTS_STORAGE[];
+constexpr char HVCFConfiguration::DENSE_LD_ENGINE[];
+constexpr char HVCFConfiguration::POPCOUNT_LD_ENGINE[];
+constexpr char HVCFConfiguration::HDF5_CHUNK_READER[];
+constexpr char HVCFConfiguration::DIRECT_CHUNK_READER[];
 
 HVCFConfiguration::HVCFConfiguration() {
 	n_variants_hash_buckets = 100000;
 	n_samples_hash_buckets = 10000;
 	max_variants_in_interval_bucket = 1000;
+	max_cached_interval_buckets = 1000; // per chromosome; 0 -- don't cache decoded buckets
 	variants_chunk_size = 1000;
 	samples_chunk_size = 100;
 	compression = HVCFConfiguration::GZIP_COMPRESSION;
 //	compression = HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION;
 	compression_level = 9;
+	haplotypes_storage = HVCFConfiguration::BYTE_HAPLOTYPES_STORAGE;
+//	haplotypes_storage = HVCFConfiguration::BIT_HAPLOTYPES_STORAGE;
+//	haplotypes_storage = HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE;
+	pbwt_checkpoint_interval = 1000; // variants between stored PBWT orders of haplotypes; reads decode at most this many variants before the first requested one, unless they continue from where the previous read of the chromosome stopped
+	variants_storage = HVCFConfiguration::COMPOUND_VARIANTS_STORAGE; // COLUMNS_VARIANTS_STORAGE is opt-in
+	haplotypes_by_sample = false; // if true, then import also writes sample-major copy of haplotypes (chunks of one sample and many variants); ignored with PBWT_HAPLOTYPES_STORAGE
+	haplotypes_by_sample_chunk_size = 10000; // variants per chunk in sample-major copy; divisor of write buffer size (100,000 variants) lets import write whole chunks
+	haplotypes_by_sample_max_samples = 16; // queries of at most this many samples read sample-major copy, if there is one
+	gather_max_gap = 64; // selected samples at most this many samples apart are read as one block and gathered from it (fragmented selections); 0 -- read every run of samples separately
+	ld_engine = HVCFConfiguration::POPCOUNT_LD_ENGINE;
+//	ld_engine = HVCFConfiguration::DENSE_LD_ENGINE;
+	chunk_reader = HVCFConfiguration::DIRECT_CHUNK_READER;
+//	chunk_reader = HVCFConfiguration::HDF5_CHUNK_READER;
+	read_threads = 0; // number of threads decompressing haplotype chunks read with direct chunk reader; 0 -- use all hardware threads. Reader keeps max(read_threads, ld_threads) threads for all parallel stages
+	import_threads = 0; // number of threads compressing haplotype chunks during import; 0 -- use all hardware threads
+	ld_threads = 0; // number of threads computing tiles in region LD queries; 0 -- use all hardware threads
+	ld_tile_size = 256; // variants per tile side in region LD queries: 2 tiles of bitsets (for 5,000 haplotypes) fit in L2 cache
+	ld_store_chunk_size = 65536; // pairs per chunk in precomputed LD datasets
 	metadata_cache_initial_size = 64 * 1024 * 1024;
 	metadata_cache_min_size = 8 * 1024 * 1024;
 	metadata_cache_max_size = 128 * 1024 * 1024;
 	sieve_buffer_max_size = 64 * 1024 * 1024; // assuming max hyperslab = 10000 (variants) * 5000 (variants) * sizeof(char)
 	chunk_cache_n_slots = 100000; // following HDF5 documentation, 100x more than max number of chunks in cache (i.e. 100 * 1000)
 	chunk_cache_size = 200 * 1024 * 1024; // if we want to hold up to 1000 chunks in cache for haplotypes (i.e. not less than 100 * variants_chunk_size * 2 * samples_chunk_size * sizeof(char))
+	haplotype_cache_size = 256 * 1024 * 1024; // decoded haplotype chunks shared by all queries (and readers in pool); 0 -- don't cache decoded chunks
 }
 
 HVCFConfiguration::~HVCFConfiguration() {
@@ -0,0 +1,366 @@
+#include "include/HVCFMetrics.h"
+
+namespace sph_umich_edu {
+
+const vector<double> HVCFMetrics::LATENCY_BUCKETS{0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+
+thread_local HVCFMetrics::io_counters HVCFMetrics::thread_io_counters{0ull, 0ull, 0ull, 0ull};
+
+thread_local HVCFQueryTrace* HVCFQueryTrace::current = nullptr;
+
+constexpr char HVCFQueryTrace::LOCK_STAGE[];
+constexpr char HVCFQueryTrace::LOOKUP_STAGE[];
+constexpr char HVCFQueryTrace::READ_HAPLOTYPES_STAGE[];
+constexpr char HVCFQueryTrace::CONVERT_STAGE[];
+constexpr char HVCFQueryTrace::COMPUTE_STAGE[];
+constexpr char HVCFQueryTrace::READ_VARIANTS_STAGE[];
+constexpr char HVCFQueryTrace::FORMAT_STAGE[];
+constexpr char HVCFQueryTrace::READ_LD_STORE_STAGE[];
+
+// BEGIN: pass-through file driver counting reads.
+typedef struct {
+	H5FD_t pub; // must be first: filled by HDF5 library
+	H5FD_t* file; // file opened with POSIX (sec2) driver
+} counting_file;
+
+extern "C" {
+
+static hid_t sec2_file_access_property_id = -1;
+
+static H5FD_t* counting_open(const char* name, unsigned flags, hid_t fapl, haddr_t maxaddr) {
+	H5FD_t* file = nullptr;
+	if ((file = H5FDopen(name, flags, sec2_file_access_property_id, maxaddr)) == nullptr) {
+		return nullptr;
+	}
+	counting_file* counting = static_cast<counting_file*>(calloc(1, sizeof(counting_file)));
+	if (counting == nullptr) {
+		H5FDclose(file);
+		return nullptr;
+	}
+	counting->file = file;
+	return &counting->pub;
+}
+
+static herr_t counting_close(H5FD_t* file) {
+	counting_file* counting = reinterpret_cast<counting_file*>(file);
+	herr_t status = H5FDclose(counting->file);
+	free(counting);
+	return status;
+}
+
+static int counting_cmp(const H5FD_t* file1, const H5FD_t* file2) {
+	return H5FDcmp(reinterpret_cast<const counting_file*>(file1)->file, reinterpret_cast<const counting_file*>(file2)->file);
+}
+
+static herr_t counting_query(const H5FD_t* file, unsigned long* flags) {
+	if (file == nullptr) { // library asks for driver features before any file is opened
+		*flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_AGGREGATE_SMALLDATA;
+		return 0;
+	}
+	return H5FDquery(reinterpret_cast<const counting_file*>(file)->file, flags) < 0 ? -1 : 0;
+}
+
+static haddr_t counting_get_eoa(const H5FD_t* file, H5FD_mem_t type) {
+	return H5FDget_eoa(reinterpret_cast<const counting_file*>(file)->file, type);
+}
+
+static herr_t counting_set_eoa(H5FD_t* file, H5FD_mem_t type, haddr_t addr) {
+	return H5FDset_eoa(reinterpret_cast<counting_file*>(file)->file, type, addr);
+}
+
+static haddr_t counting_get_eof(const H5FD_t* file, H5FD_mem_t type) {
+	return H5FDget_eof(reinterpret_cast<const counting_file*>(file)->file, type);
+}
+
+static herr_t counting_get_handle(H5FD_t* file, hid_t fapl, void** file_handle) {
+	return H5FDget_vfd_handle(reinterpret_cast<counting_file*>(file)->file, sec2_file_access_property_id, file_handle);
+}
+
+static herr_t counting_read(H5FD_t* file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, void* buffer) {
+	HVCFMetrics::count_read(type, size);
+	return H5FDread(reinterpret_cast<counting_file*>(file)->file, type, dxpl, addr, size, buffer);
+}
+
+static herr_t counting_write(H5FD_t* file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, const void* buffer) {
+	return H5FDwrite(reinterpret_cast<counting_file*>(file)->file, type, dxpl, addr, size, buffer);
+}
+
+static herr_t counting_flush(H5FD_t* file, hid_t dxpl, hbool_t closing) {
+	return H5FDflush(reinterpret_cast<counting_file*>(file)->file, dxpl, closing);
+}
+
+static herr_t counting_truncate(H5FD_t* file, hid_t dxpl, hbool_t closing) {
+	return H5FDtruncate(reinterpret_cast<counting_file*>(file)->file, dxpl, closing);
+}
+
+static herr_t counting_lock(H5FD_t* file, hbool_t rw) {
+	return H5FDlock(reinterpret_cast<counting_file*>(file)->file, rw);
+}
+
+static herr_t counting_unlock(H5FD_t* file) {
+	return H5FDunlock(reinterpret_cast<counting_file*>(file)->file);
+}
+
+}
+// END: pass-through file driver counting reads.
+
+HVCFMetrics::HVCFMetrics() {
+
+}
+
+HVCFMetrics::HVCFMetrics(const HVCFMetrics& metrics) {
+	lock_guard<mutex> lock(metrics.metrics_mutex);
+	queries = metrics.queries;
+}
+
+HVCFMetrics& HVCFMetrics::operator=(const HVCFMetrics& metrics) {
+	if (this != &metrics) {
+		map<string, query_metrics> copy = metrics.get();
+		lock_guard<mutex> lock(metrics_mutex);
+		queries = std::move(copy);
+	}
+	return *this;
+}
+
+HVCFMetrics::~HVCFMetrics() {
+
+}
+
+void HVCFMetrics::add(const string& query, const query_metrics& metrics) {
+	lock_guard<mutex> lock(metrics_mutex);
+
+	query_metrics& total = queries[query];
+
+	total.count += metrics.count;
+	total.errors += metrics.errors;
+	total.seconds += metrics.seconds;
+	for (unsigned int i = 0u; i < total.latency_buckets.size(); ++i) {
+		total.latency_buckets[i] += metrics.latency_buckets[i];
+	}
+	for (auto&& stage : metrics.stages) {
+		stage_metrics& total_stage = total.stages[stage.first];
+		total_stage.count += stage.second.count;
+		total_stage.seconds += stage.second.seconds;
+	}
+	total.io.reads += metrics.io.reads;
+	total.io.bytes_read += metrics.io.bytes_read;
+	total.io.raw_data_reads += metrics.io.raw_data_reads;
+	total.io.raw_data_bytes_read += metrics.io.raw_data_bytes_read;
+	total.haplotype_chunks_touched += metrics.haplotype_chunks_touched;
+	total.haplotype_chunks_read += metrics.haplotype_chunks_read;
+	total.results += metrics.results;
+}
+
+void HVCFMetrics::merge(const HVCFMetrics& metrics) {
+	for (auto&& query : metrics.get()) {
+		add(query.first, query.second);
+	}
+}
+
+void HVCFMetrics::reset() {
+	lock_guard<mutex> lock(metrics_mutex);
+	queries.clear();
+}
+
+map<string, HVCFMetrics::query_metrics> HVCFMetrics::get() const {
+	lock_guard<mutex> lock(metrics_mutex);
+	return queries;
+}
+
+string HVCFMetrics::to_prometheus(const string& prefix) const {
+	map<string, query_metrics> snapshot = get();
+	stringstream text;
+
+	text << setprecision(9);
+
+	text << "# HELP " << prefix << "_query_duration_seconds Query latency." << endl;
+	text << "# TYPE " << prefix << "_query_duration_seconds histogram" << endl;
+	for (auto&& query : snapshot) {
+		unsigned long long int cumulative = 0ull;
+		for (unsigned int i = 0u; i < LATENCY_BUCKETS.size(); ++i) {
+			cumulative += query.second.latency_buckets[i];
+			text << prefix << "_query_duration_seconds_bucket{query=\"" << query.first << "\",le=\"" << LATENCY_BUCKETS[i] << "\"} " << cumulative << endl;
+		}
+		text << prefix << "_query_duration_seconds_bucket{query=\"" << query.first << "\",le=\"+Inf\"} " << query.second.count << endl;
+		text << prefix << "_query_duration_seconds_sum{query=\"" << query.first << "\"} " << query.second.seconds << endl;
+		text << prefix << "_query_duration_seconds_count{query=\"" << query.first << "\"} " << query.second.count << endl;
+	}
+
+	text << "# HELP " << prefix << "_query_stage_seconds_total Time spent in query stages." << endl;
+	text << "# TYPE " << prefix << "_query_stage_seconds_total counter" << endl;
+	for (auto&& query : snapshot) {
+		for (auto&& stage : query.second.stages) {
+			text << prefix << "_query_stage_seconds_total{query=\"" << query.first << "\",stage=\"" << stage.first << "\"} " << stage.second.seconds << endl;
+		}
+	}
+
+	text << "# HELP " << prefix << "_query_stage_calls_total Number of times query stages were entered." << endl;
+	text << "# TYPE " << prefix << "_query_stage_calls_total counter" << endl;
+	for (auto&& query : snapshot) {
+		for (auto&& stage : query.second.stages) {
+			text << prefix << "_query_stage_calls_total{query=\"" << query.first << "\",stage=\"" << stage.first << "\"} " << stage.second.count << endl;
+		}
+	}
+
+	vector<pair<string, unsigned long long int query_metrics::*>> counters{
+		{"errors", &query_metrics::errors},
+		{"haplotype_chunks_touched", &query_metrics::haplotype_chunks_touched},
+		{"haplotype_chunks_read", &query_metrics::haplotype_chunks_read},
+		{"results", &query_metrics::results}
+	};
+
+	vector<pair<string, unsigned long long int io_counters::*>> io{
+		{"reads", &io_counters::reads},
+		{"bytes_read", &io_counters::bytes_read},
+		{"raw_data_reads", &io_counters::raw_data_reads},
+		{"raw_data_bytes_read", &io_counters::raw_data_bytes_read}
+	};
+
+	for (auto&& counter : counters) {
+		text << "# TYPE " << prefix << "_query_" << counter.first << "_total counter" << endl;
+		for (auto&& query : snapshot) {
+			text << prefix << "_query_" << counter.first << "_total{query=\"" << query.first << "\"} " << query.second.*counter.second << endl;
+		}
+	}
+
+	for (auto&& counter : io) {
+		text << "# TYPE " << prefix << "_query_" << counter.first << "_total counter" << endl;
+		for (auto&& query : snapshot) {
+			text << prefix << "_query_" << counter.first << "_total{query=\"" << query.first << "\"} " << query.second.io.*counter.second << endl;
+		}
+	}
+
+	text << "# TYPE " << prefix << "_query_chunk_cache_hit_ratio gauge" << endl;
+	for (auto&& query : snapshot) {
+		text << prefix << "_query_chunk_cache_hit_ratio{query=\"" << query.first << "\"} " << query.second.get_chunk_cache_hit_rate() << endl;
+	}
+
+	return text.str();
+}
+
+HVCFMetrics::io_counters HVCFMetrics::get_thread_io_counters() {
+	return thread_io_counters;
+}
+
+void HVCFMetrics::count_read(H5FD_mem_t type, size_t size) {
+	thread_io_counters.reads += 1ull;
+	thread_io_counters.bytes_read += size;
+	if (type == H5FD_MEM_DRAW) {
+		thread_io_counters.raw_data_reads += 1ull;
+		thread_io_counters.raw_data_bytes_read += size;
+	}
+}
+
+hid_t HVCFMetrics::get_counting_driver() {
+	static hid_t driver_id = -1;
+	static once_flag registered;
+
+	call_once(registered, []() {
+		H5FD_class_t driver;
+
+		memset(&driver, 0, sizeof(driver));
+		driver.name = "hvcf_counting";
+		driver.maxaddr = (static_cast<haddr_t>(1) << (8 * sizeof(off_t) - 1)) - 1;
+		driver.fc_degree = H5F_CLOSE_WEAK;
+		driver.open = counting_open;
+		driver.close = counting_close;
+		driver.cmp = counting_cmp;
+		driver.query = counting_query;
+		driver.get_eoa = counting_get_eoa;
+		driver.set_eoa = counting_set_eoa;
+		driver.get_eof = counting_get_eof;
+		driver.get_handle = counting_get_handle;
+		driver.read = counting_read;
+		driver.write = counting_write;
+		driver.flush = counting_flush;
+		driver.truncate = counting_truncate;
+		driver.lock = counting_lock;
+		driver.unlock = counting_unlock;
+		const H5FD_mem_t fl_map[H5FD_MEM_NTYPES] = H5FD_FLMAP_DICHOTOMY; // same as sec2 driver
+		memcpy(driver.fl_map, fl_map, sizeof(fl_map));
+
+		if ((sec2_file_access_property_id = H5Pcreate(H5P_FILE_ACCESS)) < 0) {
+			return;
+		}
+
+		if (H5Pset_fapl_sec2(sec2_file_access_property_id) < 0) {
+			return;
+		}
+
+		driver_id = H5FDregister(&driver);
+	});
+
+	return driver_id;
+}
+
+HVCFQueryTrace::HVCFQueryTrace(HVCFMetrics& metrics, const char* query) :
+		metrics(metrics), query(query), active(current == nullptr), start_io(HVCFMetrics::get_thread_io_counters()),
+		start(chrono::steady_clock::now()), stage_start(start), stage_name(LOCK_STAGE) {
+	if (active) {
+		current = this;
+	}
+}
+
+HVCFQueryTrace::~HVCFQueryTrace() {
+	if (!active) {
+		return;
+	}
+
+	current = nullptr;
+
+	if (std::uncaught_exception()) {
+		HVCFMetrics::query_metrics error_metrics;
+		error_metrics.errors = 1ull;
+		metrics.add(query, error_metrics);
+		return;
+	}
+
+	auto now = chrono::steady_clock::now();
+	close_stage(now);
+
+	chrono::duration<double> elapsed_seconds = now - start;
+	HVCFMetrics::io_counters end_io = HVCFMetrics::get_thread_io_counters();
+
+	query_metrics.count = 1ull;
+	query_metrics.seconds = elapsed_seconds.count();
+	query_metrics.latency_buckets[upper_bound(HVCFMetrics::LATENCY_BUCKETS.begin(), HVCFMetrics::LATENCY_BUCKETS.end(), query_metrics.seconds) - HVCFMetrics::LATENCY_BUCKETS.begin()] = 1ull;
+	query_metrics.io.reads = end_io.reads - start_io.reads;
+	query_metrics.io.bytes_read = end_io.bytes_read - start_io.bytes_read;
+	query_metrics.io.raw_data_reads = end_io.raw_data_reads - start_io.raw_data_reads;
+	query_metrics.io.raw_data_bytes_read = end_io.raw_data_bytes_read - start_io.raw_data_bytes_read;
+
+	metrics.add(query, query_metrics);
+}
+
+void HVCFQueryTrace::close_stage(chrono::time_point<chrono::steady_clock> now) {
+	chrono::duration<double> elapsed_seconds = now - stage_start;
+	HVCFMetrics::stage_metrics& stage = query_metrics.stages[stage_name];
+	stage.count += 1ull;
+	stage.seconds += elapsed_seconds.count();
+	stage_start = now;
+}
+
+void HVCFQueryTrace::stage(const char* name) {
+	if (current == nullptr) {
+		return;
+	}
+	current->close_stage(chrono::steady_clock::now());
+	current->stage_name = name;
+}
+
+void HVCFQueryTrace::add_haplotype_chunks(unsigned long long int touched, unsigned long long int read) {
+	if (current == nullptr) {
+		return;
+	}
+	current->query_metrics.haplotype_chunks_touched += touched;
+	current->query_metrics.haplotype_chunks_read += read;
+}
+
+void HVCFQueryTrace::set_results(unsigned long long int n) {
+	if (current == nullptr) {
+		return;
+	}
+	current->query_metrics.results = n;
+}
+
+}
@@ -0,0 +1,284 @@
+#include "include/HVCFReaderPool.h"
+
+namespace sph_umich_edu {
+
+HVCFReaderPool::HVCFReaderPool(unsigned int n_readers) : HVCFReaderPool(HVCFConfiguration(), n_readers) {
+
+}
+
+HVCFReaderPool::HVCFReaderPool(const HVCFConfiguration& configuration, unsigned int n_readers) :
+		configuration(configuration),
+		n_readers(n_readers > 0u ? n_readers : 1u),
+		haplotype_cache(new HaplotypeBlockCache(configuration.haplotype_cache_size)) {
+
+}
+
+HVCFReaderPool::~HVCFReaderPool() noexcept {
+	try {
+		close();
+	} catch (std::exception &e) {
+		// do not propagate any exceptions
+	}
+}
+
+void HVCFReaderPool::open(const string& name) throw (HVCFOpenException) {
+	lock_guard<mutex> idle_readers_lock(idle_readers_mutex);
+
+	if (!readers.empty()) {
+		throw HVCFOpenException(__FILE__, __FUNCTION__, __LINE__, "Reader pool is already opened.");
+	}
+
+	try {
+		for (unsigned int i = 0u; i < n_readers; ++i) {
+			readers.emplace_back(new HVCF(configuration));
+			readers.back()->set_haplotype_cache(haplotype_cache);
+			readers.back()->open(name);
+			idle_readers.push_back(readers.back().get());
+		}
+	} catch (HVCFOpenException &e) {
+		idle_readers.clear();
+		readers.clear();
+		throw;
+	}
+}
+
+void HVCFReaderPool::close() throw (HVCFCloseException) {
+	unique_lock<mutex> idle_readers_lock(idle_readers_mutex);
+
+	// wait until all borrowed readers are returned
+	idle_readers_condition.wait(idle_readers_lock, [this] { return idle_readers.size() == readers.size(); });
+
+	for (auto&& reader : readers) {
+		closed_readers_metrics.merge(reader->get_metrics());
+		reader->close();
+	}
+
+	idle_readers.clear();
+	readers.clear();
+}
+
+HVCF* HVCFReaderPool::acquire() throw (HVCFReadException) {
+	unique_lock<mutex> idle_readers_lock(idle_readers_mutex);
+
+	if (readers.empty()) {
+		throw HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Reader pool is not opened.");
+	}
+
+	idle_readers_condition.wait(idle_readers_lock, [this] { return !idle_readers.empty(); });
+
+	HVCF* reader = idle_readers.back();
+	idle_readers.pop_back();
+
+	return reader;
+}
+
+void HVCFReaderPool::release(HVCF* reader) {
+	{
+		lock_guard<mutex> idle_readers_lock(idle_readers_mutex);
+		idle_readers.push_back(reader);
+	}
+	idle_readers_condition.notify_all();
+}
+
+unsigned int HVCFReaderPool::get_n_readers() const {
+	return n_readers;
+}
+
+HVCFMetrics HVCFReaderPool::get_metrics() {
+	lock_guard<mutex> idle_readers_lock(idle_readers_mutex);
+
+	HVCFMetrics metrics(closed_readers_metrics);
+	for (auto&& reader : readers) {
+		metrics.merge(reader->get_metrics());
+	}
+	return metrics;
+}
+
+void HVCFReaderPool::reset_metrics() {
+	lock_guard<mutex> idle_readers_lock(idle_readers_mutex);
+
+	closed_readers_metrics.reset();
+	for (auto&& reader : readers) {
+		reader->reset_metrics();
+	}
+}
+
+HaplotypeBlockCache::statistics HVCFReaderPool::get_haplotype_cache_statistics() const {
+	return haplotype_cache->get_statistics();
+}
+
+void HVCFReaderPool::reset_haplotype_cache_statistics() {
+	haplotype_cache->reset_statistics();
+}
+
+hsize_t HVCFReaderPool::get_n_samples() throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_n_samples();
+}
+
+vector<string> HVCFReaderPool::get_samples() throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_samples();
+}
+
+shared_ptr<const sample_table> HVCFReaderPool::get_sample_table() throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_sample_table();
+}
+
+vector<string> HVCFReaderPool::get_sample_subsets() throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_sample_subsets();
+}
+
+vector<string> HVCFReaderPool::get_samples_in_subset(const string& name) throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_samples_in_subset(name);
+}
+
+vector<string> HVCFReaderPool::get_chromosomes() throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_chromosomes();
+}
+
+bool HVCFReaderPool::has_chromosome(const string& chromosome) throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->has_chromosome(chromosome);
+}
+
+unsigned long long int HVCFReaderPool::get_chromosome_start(const string& chromosome) throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_chromosome_start(chromosome);
+}
+
+unsigned long long int HVCFReaderPool::get_chromosome_end(const string& chromosome) throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_chromosome_end(chromosome);
+}
+
+hsize_t HVCFReaderPool::get_n_variants_in_chromosome(const string& chromosome) throw (HVCFReadException) {
+	Lease reader(*this);
+	return reader->get_n_variants_in_chromosome(chromosome);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, lead_variant_name, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, vector<ld_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, start_position, end_position, options, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, vector<ld_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, lead_variant_names, window, result);
+}
+
+void HVCFReaderPool::compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_frequencies(subset, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<variant_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->extract_variants(chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, lead_variant_name, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, start_position, end_position, options, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, ld_batch_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, lead_variant_names, window, result);
+}
+
+void HVCFReaderPool::compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, HVCFLDSink& sink) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(subset, chromosome, start_position, end_position, sink);
+}
+
+void HVCFReaderPool::compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_frequencies(subset, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, variants_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->extract_variants(chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::extract_haplotypes(const string& subset, const string& chromosome, const string& variant_name, vector<variant_haplotypes_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->extract_haplotypes(subset, chromosome, variant_name, result);
+}
+
+void HVCFReaderPool::extract_haplotypes(const string& sample, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<sample_haplotypes_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->extract_haplotypes(sample, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::extract_haplotypes(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, haplotypes_query_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->extract_haplotypes(subset, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(samples, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(samples, chromosome, lead_variant_name, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_frequencies(samples, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(samples, chromosome, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(samples, chromosome, lead_variant_name, start_position, end_position, result);
+}
+
+void HVCFReaderPool::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(samples, chromosome, start_position, end_position, options, result);
+}
+
+void HVCFReaderPool::compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, HVCFLDSink& sink) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_ld(samples, chromosome, start_position, end_position, sink);
+}
+
+void HVCFReaderPool::compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException) {
+	Lease reader(*this);
+	reader->compute_frequencies(samples, chromosome, start_position, end_position, result);
+}
+
+}
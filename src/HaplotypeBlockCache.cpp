@@ -0,0 +1,84 @@
+#include "include/HaplotypeBlockCache.h"
+
+namespace sph_umich_edu {
+
+HaplotypeBlockCache::HaplotypeBlockCache(size_t capacity):
+		capacity(capacity),
+		size(0u),
+		hits(0ull),
+		misses(0ull),
+		evictions(0ull) {
+
+}
+
+HaplotypeBlockCache::~HaplotypeBlockCache() {
+
+}
+
+HaplotypeBlockCache::block HaplotypeBlockCache::get(const string& dataset, hsize_t variant_chunk, hsize_t column_chunk) {
+	lock_guard<mutex> blocks_lock(blocks_mutex);
+
+	auto lookup_it = blocks_lookup.find(make_tuple(dataset, variant_chunk, column_chunk));
+	if (lookup_it == blocks_lookup.end()) {
+		++misses;
+		return block();
+	}
+
+	blocks.splice(blocks.begin(), blocks, lookup_it->second);
+	++hits;
+	return lookup_it->second->second;
+}
+
+void HaplotypeBlockCache::put(const string& dataset, hsize_t variant_chunk, hsize_t column_chunk, block decoded) {
+	if (!decoded || (decoded->size() > capacity)) {
+		return;
+	}
+
+	lock_guard<mutex> blocks_lock(blocks_mutex);
+
+	key k = make_tuple(dataset, variant_chunk, column_chunk);
+	if (blocks_lookup.count(k) > 0u) { // already cached by another reader
+		return;
+	}
+
+	// BEGIN: evict least recently used blocks.
+	while (size + decoded->size() > capacity) {
+		size -= blocks.back().second->size();
+		blocks_lookup.erase(blocks.back().first);
+		blocks.pop_back();
+		++evictions;
+	}
+	// END: evict least recently used blocks.
+
+	size += decoded->size();
+	blocks.emplace_front(k, std::move(decoded));
+	blocks_lookup.emplace(std::move(k), blocks.begin());
+}
+
+void HaplotypeBlockCache::clear() {
+	lock_guard<mutex> blocks_lock(blocks_mutex);
+
+	blocks_lookup.clear();
+	blocks.clear();
+	size = 0u;
+}
+
+bool HaplotypeBlockCache::is_enabled() const {
+	return capacity > 0u;
+}
+
+HaplotypeBlockCache::statistics HaplotypeBlockCache::get_statistics() const {
+	lock_guard<mutex> blocks_lock(blocks_mutex);
+
+	return statistics{hits, misses, evictions, blocks.size(), size, capacity};
+}
+
+void HaplotypeBlockCache::reset_statistics() {
+	lock_guard<mutex> blocks_lock(blocks_mutex);
+
+	hits = 0ull;
+	misses = 0ull;
+	evictions = 0ull;
+}
+
+}
@@ -0,0 +1,100 @@
+#include "include/HaplotypeGather.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAPLOTYPE_GATHER_X86
+#endif
+
+namespace sph_umich_edu {
+
+void HaplotypeGather::gather_row_scalar(const unsigned char* source, const uint32_t* columns, size_t n_columns, unsigned char* destination) {
+	for (size_t i = 0u; i < n_columns; ++i) {
+		destination[i] = source[columns[i]];
+	}
+}
+
+#ifdef HAPLOTYPE_GATHER_X86
+// 8 columns per iteration: gather 32-bit words at column offsets, move their lowest bytes to the first 8 bytes of register.
+__attribute__((target("avx2")))
+static void gather_row_avx2(const unsigned char* source, const uint32_t* columns, size_t n_columns, unsigned char* destination) {
+	const __m256i low_bytes = _mm256_setr_epi8(
+			0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i low_words = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+	__m256i words;
+	size_t i = 0u;
+
+	for (; i + 8u <= n_columns; i += 8u) {
+		words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(source), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + i)), 1);
+		words = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, low_bytes), low_words);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i), _mm256_castsi256_si128(words));
+	}
+
+	for (; i < n_columns; ++i) {
+		destination[i] = source[columns[i]];
+	}
+}
+
+// 16 columns per iteration: gather 32-bit words at column offsets and truncate them to bytes.
+__attribute__((target("avx512f")))
+static void gather_row_avx512(const unsigned char* source, const uint32_t* columns, size_t n_columns, unsigned char* destination) {
+	__m512i words;
+	__mmask16 mask;
+	size_t i = 0u;
+
+	for (; i + 16u <= n_columns; i += 16u) {
+		words = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFFu, _mm512_loadu_si512(columns + i), source, 1);
+		_mm512_mask_cvtepi32_storeu_epi8(destination + i, 0xFFFFu, words);
+	}
+
+	if (i < n_columns) {
+		mask = static_cast<__mmask16>((1u << (n_columns - i)) - 1u);
+		words = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), mask, _mm512_maskz_loadu_epi32(mask, columns + i), source, 1);
+		_mm512_mask_cvtepi32_storeu_epi8(destination + i, mask, words);
+	}
+}
+#endif
+
+HaplotypeGather::gather_row_function HaplotypeGather::select_gather_row(const char** name) {
+#ifdef HAPLOTYPE_GATHER_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		*name = "AVX512F";
+		return gather_row_avx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		*name = "AVX2";
+		return gather_row_avx2;
+	}
+#endif
+	*name = "SCALAR";
+	return gather_row_scalar;
+}
+
+static const char* selected_implementation = nullptr;
+
+HaplotypeGather::gather_row_function HaplotypeGather::get_gather_row() {
+	static gather_row_function function = select_gather_row(&selected_implementation); // thread-safe initialization since C++11
+	return function;
+}
+
+const char* HaplotypeGather::get_implementation() {
+	get_gather_row();
+	return selected_implementation;
+}
+
+void HaplotypeGather::gather(const unsigned char* source, size_t n_source_columns, size_t n_rows, const uint32_t* columns, size_t n_columns, unsigned char* destination) {
+	gather_row_function gather_row = get_gather_row();
+	size_t row = 0u;
+
+	// vector implementations may read up to 3 bytes past the last column of row: they must still be inside the block
+	for (; (row < n_rows) && ((n_rows - row - 1u) * n_source_columns >= 3u); ++row) {
+		gather_row(source + row * n_source_columns, columns, n_columns, destination + row * n_columns);
+	}
+
+	for (; row < n_rows; ++row) {
+		gather_row_scalar(source + row * n_source_columns, columns, n_columns, destination + row * n_columns);
+	}
+}
+
+}
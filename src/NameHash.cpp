@@ -0,0 +1,87 @@
+#include "include/NameHash.h"
+
+namespace sph_umich_edu {
+
+constexpr uint64_t NameHash::PRIME1;
+constexpr uint64_t NameHash::PRIME2;
+constexpr uint64_t NameHash::PRIME3;
+constexpr uint64_t NameHash::PRIME4;
+constexpr uint64_t NameHash::PRIME5;
+
+// little-endian reads independent of host byte order; compilers turn them into single loads on little-endian hosts
+uint64_t NameHash::read64(const unsigned char* p) {
+	return static_cast<uint64_t>(p[0]) | (static_cast<uint64_t>(p[1]) << 8) | (static_cast<uint64_t>(p[2]) << 16) | (static_cast<uint64_t>(p[3]) << 24) |
+			(static_cast<uint64_t>(p[4]) << 32) | (static_cast<uint64_t>(p[5]) << 40) | (static_cast<uint64_t>(p[6]) << 48) | (static_cast<uint64_t>(p[7]) << 56);
+}
+
+uint64_t NameHash::read32(const unsigned char* p) {
+	return static_cast<uint64_t>(p[0]) | (static_cast<uint64_t>(p[1]) << 8) | (static_cast<uint64_t>(p[2]) << 16) | (static_cast<uint64_t>(p[3]) << 24);
+}
+
+uint64_t NameHash::round(uint64_t accumulator, uint64_t input) {
+	accumulator += input * PRIME2;
+	accumulator = rotate_left(accumulator, 31u);
+	return accumulator * PRIME1;
+}
+
+uint64_t NameHash::merge_round(uint64_t accumulator, uint64_t value) {
+	accumulator ^= round(0u, value);
+	return accumulator * PRIME1 + PRIME4;
+}
+
+uint64_t NameHash::hash(const char* data, size_t length, uint64_t seed) {
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+	const unsigned char* end = p + length;
+	uint64_t h = 0u;
+
+	if (length >= 32u) {
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+
+		for (const unsigned char* limit = end - 32; p <= limit; p += 32) {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+		}
+
+		h = rotate_left(v1, 1u) + rotate_left(v2, 7u) + rotate_left(v3, 12u) + rotate_left(v4, 18u);
+		h = merge_round(h, v1);
+		h = merge_round(h, v2);
+		h = merge_round(h, v3);
+		h = merge_round(h, v4);
+	} else {
+		h = seed + PRIME5;
+	}
+
+	h += static_cast<uint64_t>(length);
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= round(0u, read64(p));
+		h = rotate_left(h, 27u) * PRIME1 + PRIME4;
+	}
+
+	if (p + 4 <= end) {
+		h ^= read32(p) * PRIME1;
+		h = rotate_left(h, 23u) * PRIME2 + PRIME3;
+		p += 4;
+	}
+
+	for (; p < end; ++p) {
+		h ^= static_cast<uint64_t>(*p) * PRIME5;
+		h = rotate_left(h, 11u) * PRIME1;
+	}
+
+	// final avalanche
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+}
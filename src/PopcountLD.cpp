@@ -0,0 +1,204 @@
+#include "include/PopcountLD.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POPCOUNT_LD_X86
+#endif
+
+namespace sph_umich_edu {
+
+uint64_t PopcountLD::and_popcount_scalar(const uint64_t* a, const uint64_t* b, size_t n_words) {
+	uint64_t count = 0u;
+	uint64_t x = 0u;
+	for (size_t i = 0u; i < n_words; ++i) {
+		x = a[i] & b[i];
+		x = x - ((x >> 1) & 0x5555555555555555ull);
+		x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+		x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+		count += (x * 0x0101010101010101ull) >> 56;
+	}
+	return count;
+}
+
+#ifdef POPCOUNT_LD_X86
+__attribute__((target("popcnt")))
+static uint64_t and_popcount_popcnt(const uint64_t* a, const uint64_t* b, size_t n_words) {
+	uint64_t count = 0u;
+	for (size_t i = 0u; i < n_words; ++i) {
+		count += __builtin_popcountll(a[i] & b[i]);
+	}
+	return count;
+}
+
+// Nibble lookup table popcount (W. Mula), 256 bits per iteration.
+__attribute__((target("avx2,popcnt")))
+static uint64_t and_popcount_avx2(const uint64_t* a, const uint64_t* b, size_t n_words) {
+	const __m256i lookup = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i total = _mm256_setzero_si256();
+	__m256i x, low, high, counts;
+	size_t i = 0u;
+
+	for (; i + 4u <= n_words; i += 4u) {
+		x = _mm256_and_si256(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+		low = _mm256_and_si256(x, low_mask);
+		high = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+		counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+	}
+
+	uint64_t count = static_cast<uint64_t>(_mm256_extract_epi64(total, 0)) +
+			static_cast<uint64_t>(_mm256_extract_epi64(total, 1)) +
+			static_cast<uint64_t>(_mm256_extract_epi64(total, 2)) +
+			static_cast<uint64_t>(_mm256_extract_epi64(total, 3));
+
+	for (; i < n_words; ++i) {
+		count += __builtin_popcountll(a[i] & b[i]);
+	}
+	return count;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static uint64_t and_popcount_avx512(const uint64_t* a, const uint64_t* b, size_t n_words) {
+	__m512i total = _mm512_setzero_si512();
+	__mmask8 mask;
+	uint64_t totals[8];
+	size_t i = 0u;
+
+	for (; i + 8u <= n_words; i += 8u) {
+		total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i))));
+	}
+
+	if (i < n_words) {
+		mask = static_cast<__mmask8>((1u << (n_words - i)) - 1u);
+		total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i))));
+	}
+
+	_mm512_storeu_si512(totals, total);
+	return totals[0] + totals[1] + totals[2] + totals[3] + totals[4] + totals[5] + totals[6] + totals[7];
+}
+#endif
+
+PopcountLD::and_popcount_function PopcountLD::select_and_popcount(const char** name) {
+#ifdef POPCOUNT_LD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512vpopcntdq")) {
+		*name = "AVX512_VPOPCNTDQ";
+		return and_popcount_avx512;
+	}
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+		*name = "AVX2";
+		return and_popcount_avx2;
+	}
+	if (__builtin_cpu_supports("popcnt")) {
+		*name = "POPCNT";
+		return and_popcount_popcnt;
+	}
+#endif
+	*name = "SCALAR";
+	return and_popcount_scalar;
+}
+
+static const char* selected_implementation = nullptr;
+
+PopcountLD::and_popcount_function PopcountLD::get_and_popcount() {
+	static and_popcount_function function = select_and_popcount(&selected_implementation); // thread-safe initialization since C++11
+	return function;
+}
+
+const char* PopcountLD::get_implementation() {
+	get_and_popcount();
+	return selected_implementation;
+}
+
+uint64_t PopcountLD::and_popcount(const uint64_t* a, const uint64_t* b, size_t n_words) {
+	return get_and_popcount()(a, b, n_words);
+}
+
+PopcountLD::PopcountLD(size_t n_variants, size_t n_haplotypes):
+		n_variants(n_variants),
+		n_haplotypes(n_haplotypes),
+		n_words((n_haplotypes + 63u) / 64u),
+		bitsets(nullptr),
+		counts(nullptr) {
+
+	bitsets = unique_ptr<uint64_t[]>(new uint64_t[n_variants * n_words]{});
+	counts = unique_ptr<uint64_t[]>(new uint64_t[n_variants]{});
+}
+
+PopcountLD::~PopcountLD() {
+
+}
+
+void PopcountLD::load(size_t variant, const unsigned char* haplotypes) {
+	uint64_t* bitset = bitsets.get() + variant * n_words;
+	uint64_t word = 0u;
+	size_t h = 0u;
+
+	for (size_t w = 0u; w < n_words; ++w) {
+		word = 0u;
+		for (size_t b = 0u; (b < 64u) && (h < n_haplotypes); ++b, ++h) {
+			word |= static_cast<uint64_t>(haplotypes[h] != 0u) << b;
+		}
+		bitset[w] = word;
+	}
+	counts[variant] = get_and_popcount()(bitset, bitset, n_words);
+}
+
+void PopcountLD::load(const unsigned char* haplotypes) {
+	for (size_t v = 0u; v < n_variants; ++v) {
+		load(v, haplotypes + v * n_haplotypes);
+	}
+}
+
+double PopcountLD::compute_r(size_t variant1, size_t variant2) const {
+	double n = static_cast<double>(n_haplotypes);
+	double c1 = static_cast<double>(counts[variant1]);
+	double c2 = static_cast<double>(counts[variant2]);
+	double c12 = static_cast<double>(get_and_popcount()(bitsets.get() + variant1 * n_words, bitsets.get() + variant2 * n_words, n_words));
+
+	// Same operations order as in dense formula (n * S'S - C1'C1) / sqrt(C1'C1 % C2'C2), so that results are bitwise identical.
+	return (n * c12 - c1 * c2) / sqrt((c1 * c2) * ((n - c1) * (n - c2)));
+}
+
+// Upper bound of r^2 given only allele counts: |D| can't exceed min(c1 * (n - c2), (n - c1) * c2) when D > 0 and min(c1 * c2, (n - c1) * (n - c2)) when D < 0.
+// Lets threshold queries skip bitset scans of pairs, which can't reach threshold. Returns NaN (i.e. never pruned by comparison) for monomorphic variants.
+double PopcountLD::get_max_rsquare(size_t variant1, size_t variant2) const {
+	double n = static_cast<double>(n_haplotypes);
+	double c1 = static_cast<double>(counts[variant1]);
+	double c2 = static_cast<double>(counts[variant2]);
+	double d_positive = min(c1 * (n - c2), (n - c1) * c2);
+	double d_negative = min(c1 * c2, (n - c1) * (n - c2));
+	double d = max(d_positive, d_negative);
+
+	return (d * d) / ((c1 * c2) * ((n - c1) * (n - c2)));
+}
+
+void PopcountLD::compute_r(double* r) const {
+	for (size_t i = 0u; i < n_variants; ++i) {
+		r[i * n_variants + i] = compute_r(i, i);
+		for (size_t j = i + 1u; j < n_variants; ++j) {
+			r[i * n_variants + j] = r[j * n_variants + i] = compute_r(i, j);
+		}
+	}
+}
+
+size_t PopcountLD::get_n_variants() const {
+	return n_variants;
+}
+
+size_t PopcountLD::get_n_haplotypes() const {
+	return n_haplotypes;
+}
+
+uint64_t PopcountLD::get_count(size_t variant) const {
+	return counts[variant];
+}
+
+}
@@ -0,0 +1,88 @@
+#include "include/WorkerPool.h"
+
+namespace sph_umich_edu {
+
+WorkerPool::WorkerPool(unsigned int n_threads):
+		n_threads(n_threads),
+		stopping(false) {
+
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		lock_guard<mutex> pool_lock(pool_mutex);
+		stopping = true;
+		queued_condition.notify_all();
+	}
+	for (auto&& t : threads) {
+		t.join();
+	}
+}
+
+void WorkerPool::run_copy(unique_lock<mutex>& pool_lock, const shared_ptr<batch_entry>& batch) {
+	if (--batch->n_queued == 0u) {
+		batches.remove(batch);
+	}
+	++batch->n_running;
+	pool_lock.unlock();
+
+	exception_ptr error = nullptr;
+	try {
+		batch->work();
+	} catch (...) {
+		error = current_exception();
+	}
+
+	pool_lock.lock();
+	if (error && !batch->error) {
+		batch->error = error;
+	}
+	if ((--batch->n_running == 0u) && (batch->n_queued == 0u)) {
+		finished_condition.notify_all();
+	}
+}
+
+void WorkerPool::work() {
+	unique_lock<mutex> pool_lock(pool_mutex);
+	while (true) {
+		queued_condition.wait(pool_lock, [&]() -> bool { return stopping || !batches.empty(); });
+		if (batches.empty()) { // stopping
+			return;
+		}
+		shared_ptr<batch_entry> batch = batches.front();
+		run_copy(pool_lock, batch);
+	}
+}
+
+WorkerPool::batch WorkerPool::submit(unsigned int n_copies, const function<void()>& work) {
+	shared_ptr<batch_entry> submitted(new batch_entry{work, n_copies, 0u, nullptr});
+
+	if (n_copies == 0u) {
+		return submitted;
+	}
+
+	lock_guard<mutex> pool_lock(pool_mutex);
+	while (threads.size() < n_threads) {
+		threads.emplace_back(&WorkerPool::work, this);
+	}
+	batches.push_back(submitted);
+	queued_condition.notify_all();
+	return submitted;
+}
+
+void WorkerPool::wait(const batch& submitted) {
+	unique_lock<mutex> pool_lock(pool_mutex);
+	while (submitted->n_queued > 0u) {
+		run_copy(pool_lock, submitted);
+	}
+	finished_condition.wait(pool_lock, [&]() -> bool { return submitted->n_running == 0u; });
+	if (submitted->error) {
+		rethrow_exception(submitted->error);
+	}
+}
+
+unsigned int WorkerPool::get_n_threads() const {
+	return n_threads;
+}
+
+}
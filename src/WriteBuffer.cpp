@@ -2,16 +2,27 @@
 
 namespace sph_umich_edu {
 
-WriteBuffer::WriteBuffer(unsigned int max_variants, unsigned int n_samples):
+constexpr size_t WriteBuffer::StringArena::BLOCK_SIZE;
+
+WriteBuffer::WriteBuffer(unsigned int max_variants, unsigned int n_samples, bool packed) : WriteBuffer(max_variants, n_samples, packed, vector<hsize_t>()) {
+
+}
+
+WriteBuffer::WriteBuffer(unsigned int max_variants, unsigned int n_samples, bool packed, const vector<hsize_t>& columns):
 		max_variants(max_variants),
 		n_samples(n_samples),
 		n_haplotypes(n_samples + n_samples),
+		packed(packed),
+		n_columns(packed ? (n_samples + n_samples + 7u) / 8u : n_samples + n_samples),
+		columns(columns),
 		haplotypes(nullptr),
 		variants(nullptr),
+		alt_counts(nullptr),
 		n_variants(0u),
 		n_flushed_variants(0u) {
 
-	haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_haplotypes * max_variants]{});
+	haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_columns * max_variants]{});
+	alt_counts = unique_ptr<unsigned int[]>(new unsigned int[max_variants]{});
 	variants = unique_ptr<variants_entry_type[]>(new variants_entry_type[max_variants]{});
 	for (unsigned int i = 0u; i < max_variants; ++i) {
 		variants[i].name = nullptr;
@@ -19,7 +30,8 @@ WriteBuffer::WriteBuffer(unsigned int max_variants, unsigned int n_samples):
 		variants[i].alt = nullptr;
 	}
 
-	flushed_haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_haplotypes * max_variants]{});
+	flushed_haplotypes = unique_ptr<unsigned char[]>(new unsigned char[n_columns * max_variants]{});
+	flushed_alt_counts = unique_ptr<unsigned int[]>(new unsigned int[max_variants]{});
 	flushed_variants = unique_ptr<variants_entry_type[]>(new variants_entry_type[max_variants]{});
 	for (unsigned int i = 0u; i < max_variants; ++i) {
 		flushed_variants[i].name = nullptr;
@@ -29,32 +41,7 @@ WriteBuffer::WriteBuffer(unsigned int max_variants, unsigned int n_samples):
 }
 
 WriteBuffer::~WriteBuffer() {
-	for (unsigned int i = 0u; i < max_variants; ++i) {
-		if (variants[i].name != nullptr) {
-			delete variants[i].name;
-			variants[i].name = nullptr;
-		}
-		if (variants[i].ref != nullptr) {
-			delete variants[i].ref;
-			variants[i].ref = nullptr;
-		}
-		if (variants[i].alt != nullptr) {
-			delete variants[i].alt;
-			variants[i].alt = nullptr;
-		}
-		if (flushed_variants[i].name != nullptr) {
-			delete flushed_variants[i].name;
-			flushed_variants[i].name = nullptr;
-		}
-		if (flushed_variants[i].ref != nullptr) {
-			delete flushed_variants[i].ref;
-			flushed_variants[i].ref = nullptr;
-		}
-		if (flushed_variants[i].alt != nullptr) {
-			delete flushed_variants[i].alt;
-			flushed_variants[i].alt = nullptr;
-		}
-	}
+
 }
 
 void WriteBuffer::add_variant(const Variant& variant) throw (HVCFWriteException) {
@@ -62,69 +49,129 @@ void WriteBuffer::add_variant(const Variant& variant) throw (HVCFWriteException)
 		throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Memory buffer overflow while writing.");
 	}
 
-	for (unsigned int s = 0u; s < variant.get_n_samples(); ++s) {
-		if (variant.get_genotype(s).get_alleles().size() != 2) { // Support only HUMAN chromosomes 1-22 (should be extened for special case of chr Y).
-			throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing variant to memory buffer.");
+	if (packed) {
+		unsigned char* row = haplotypes.get() + n_variants * n_columns;
+		unsigned int allele1 = 0u;
+		unsigned int allele2 = 0u;
+		unsigned int alt_count = 0u;
+		unsigned int c = 0u;
+
+		memset(row, 0, n_columns);
+		for (unsigned int s = 0u; s < variant.get_n_samples(); ++s) {
+			if (variant.get_genotype(s).get_alleles().size() != 2) { // Support only HUMAN chromosomes 1-22 (should be extened for special case of chr Y).
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing variant to memory buffer.");
+			}
+			allele1 = static_cast<unsigned int>(variant.get_genotype(s).get_alleles().at(0));
+			allele2 = static_cast<unsigned int>(variant.get_genotype(s).get_alleles().at(1));
+			if ((allele1 > 1u) || (allele2 > 1u)) { // Bit-packed storage supports only bi-allelic 0/1 haplotypes.
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while packing haplotypes: non-binary allele.");
+			}
+			c = columns.empty() ? s : static_cast<unsigned int>(columns[s]);
+			row[(2u * c) >> 3] |= static_cast<unsigned char>(allele1 << ((2u * c) & 7u));
+			row[(2u * c + 1u) >> 3] |= static_cast<unsigned char>(allele2 << ((2u * c + 1u) & 7u));
+			alt_count += allele1 + allele2;
+		}
+		alt_counts[n_variants] = alt_count;
+	} else {
+		unsigned char* row = haplotypes.get() + n_variants * n_haplotypes;
+		unsigned int alt_count = 0u;
+		unsigned int c = 0u;
+
+		for (unsigned int s = 0u; s < variant.get_n_samples(); ++s) {
+			if (variant.get_genotype(s).get_alleles().size() != 2) { // Support only HUMAN chromosomes 1-22 (should be extened for special case of chr Y).
+				throw HVCFWriteException(__FILE__, __FUNCTION__, __LINE__, "Error while writing variant to memory buffer.");
+			}
+			c = columns.empty() ? s : static_cast<unsigned int>(columns[s]);
+			row[2u * c] = static_cast<unsigned char>(variant.get_genotype(s).get_alleles().at(0));
+			row[2u * c + 1u] = static_cast<unsigned char>(variant.get_genotype(s).get_alleles().at(1));
+			alt_count += row[2u * c] + row[2u * c + 1u];
 		}
-		haplotypes[n_variants * n_haplotypes + 2u * s] = static_cast<unsigned char>(variant.get_genotype(s).get_alleles().at(0));
-		haplotypes[n_variants * n_haplotypes + 2u * s + 1u] = static_cast<unsigned char>(variant.get_genotype(s).get_alleles().at(1));
+		alt_counts[n_variants] = alt_count;
 	}
 
-	unique_ptr<char[]> name = unique_ptr<char[]>(
-			new char[variant.get_chrom().get_text().length() +
-					 variant.get_pos().get_text().length() +
-					 variant.get_ref().get_text().length() +
-					 variant.get_alt().get_text().length() + 4u]{});
-
-	unique_ptr<char[]> ref = unique_ptr<char[]>(new char[variant.get_ref().get_text().length() + 1u]{});
-	unique_ptr<char[]> alt = unique_ptr<char[]>(new char[variant.get_alt().get_text().length() + 1u]{});
-
-	name[0] = '\0';
-	strcat(name.get(), variant.get_chrom().get_text().c_str());
-	strcat(name.get(), ":");
-	strcat(name.get(), variant.get_pos().get_text().c_str());
-	strcat(name.get(), "_");
-	strcat(name.get(), variant.get_ref().get_text().c_str());
-	strcat(name.get(), "/");
-	strcat(name.get(), variant.get_alt().get_text().c_str());
-
-	ref[0] = '\0';
-	strcat(ref.get(), variant.get_ref().get_text().c_str());
-
-	alt[0] = '\0';
-	strcat(alt.get(), variant.get_alt().get_text().c_str());
-
-	variants[n_variants].name = name.release();
-	variants[n_variants].ref = ref.release();
-	variants[n_variants].alt = alt.release();
+	// BEGIN: name (chrom:pos_ref/alt), ref and alt, built in one pass into a single arena allocation.
+	const string& chrom = variant.get_chrom().get_text();
+	const string& pos = variant.get_pos().get_text();
+	const string& ref = variant.get_ref().get_text();
+	const string& alt = variant.get_alt().get_text();
+
+	size_t name_length = chrom.length() + pos.length() + ref.length() + alt.length() + 3u;
+	char* name = strings.allocate(name_length + ref.length() + alt.length() + 3u);
+	char* p = name;
+
+	memcpy(p, chrom.data(), chrom.length());
+	p += chrom.length();
+	*p++ = ':';
+	memcpy(p, pos.data(), pos.length());
+	p += pos.length();
+	*p++ = '_';
+	memcpy(p, ref.data(), ref.length());
+	p += ref.length();
+	*p++ = '/';
+	memcpy(p, alt.data(), alt.length());
+	p += alt.length();
+	*p++ = '\0';
+
+	variants[n_variants].ref = p;
+	memcpy(p, ref.data(), ref.length());
+	p += ref.length();
+	*p++ = '\0';
+
+	variants[n_variants].alt = p;
+	memcpy(p, alt.data(), alt.length());
+	p += alt.length();
+	*p = '\0';
+
+	variants[n_variants].name = name;
+	// END: name, ref and alt.
+
 	variants[n_variants].position = variant.get_pos().get_value();
 
 	++n_variants;
 }
 
-tuple<const unsigned char*, const variants_entry_type*, unsigned int, unsigned int> WriteBuffer::flush() {
-	for (unsigned int i = 0u; i < n_flushed_variants; ++i) {
-		if (flushed_variants[i].name != nullptr) {
-			delete flushed_variants[i].name;
-			flushed_variants[i].name = nullptr;
-		}
-		if (flushed_variants[i].ref != nullptr) {
-			delete flushed_variants[i].ref;
-			flushed_variants[i].ref = nullptr;
-		}
-		if (flushed_variants[i].alt != nullptr) {
-			delete flushed_variants[i].alt;
-			flushed_variants[i].alt = nullptr;
-		}
-	}
-
+tuple<const unsigned char*, const variants_entry_type*, unsigned int, unsigned int, const unsigned int*> WriteBuffer::flush() {
 	n_flushed_variants = n_variants;
 	flushed_haplotypes.swap(haplotypes);
 	flushed_variants.swap(variants);
+	flushed_alt_counts.swap(alt_counts);
+	// strings of previously flushed variants are released in bulk and their blocks are reused by the next generation
+	swap(flushed_strings, strings);
+	strings.reset();
 
 	n_variants = 0u;
 
-	return std::make_tuple(flushed_haplotypes.get(), flushed_variants.get(), n_flushed_variants, n_haplotypes);
+	return std::make_tuple(flushed_haplotypes.get(), flushed_variants.get(), n_flushed_variants, n_columns, static_cast<const unsigned int*>(flushed_alt_counts.get()));
+}
+
+WriteBuffer::StringArena::StringArena() : block(0u), used(0u) {
+
+}
+
+char* WriteBuffer::StringArena::allocate(size_t size) {
+	if (blocks.empty() || (used + size > blocks[block].second)) {
+		if (!blocks.empty()) {
+			++block;
+		}
+		while ((block < blocks.size()) && (blocks[block].second < size)) {
+			++block;
+		}
+		if (block >= blocks.size()) {
+			size_t capacity = std::max(BLOCK_SIZE, size);
+			blocks.emplace_back(unique_ptr<char[]>(new char[capacity]), capacity);
+			block = blocks.size() - 1u;
+		}
+		used = 0u;
+	}
+
+	char* memory = blocks[block].first.get() + used;
+	used += size;
+	return memory;
+}
+
+void WriteBuffer::StringArena::reset() {
+	block = 0u;
+	used = 0u;
 }
 
 unsigned int WriteBuffer::get_max_variants() const {
@@ -135,6 +182,14 @@ unsigned int WriteBuffer::get_n_samples() const {
 	return n_samples;
 }
 
+unsigned int WriteBuffer::get_n_columns() const {
+	return n_columns;
+}
+
+bool WriteBuffer::is_packed() const {
+	return packed;
+}
+
 bool WriteBuffer::is_full() const {
 	return (n_variants >= max_variants);
 }
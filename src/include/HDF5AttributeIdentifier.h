@@ -0,0 +1,22 @@
+#ifndef SRC_HDF5ATTRIBUTEIDENTIFIER_H_
+#define SRC_HDF5ATTRIBUTEIDENTIFIER_H_
+
+#include "HDF5Identifier.h"
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+class HDF5AttributeIdentifier: public HDF5Identifier {
+public:
+	HDF5AttributeIdentifier();
+	virtual ~HDF5AttributeIdentifier() noexcept;
+
+	using HDF5Identifier::operator=;
+
+	void close() throw (HVCFException);
+};
+
+}
+
+#endif
@@ -13,11 +13,17 @@
 #include <cstdlib>
 #include <chrono>
 #include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <zlib.h>
 
 #define ARMA_NO_DEBUG
 #include <armadillo>
 
 #include "hdf5.h"
+#include "hdf5_hl.h"
 
 #include "Types.h"
 #include "HVCFOpenException.h"
@@ -31,9 +37,17 @@
 #include "HDF5DatatypeIdentifier.h"
 #include "HDF5DataspaceIdentifier.h"
 #include "HDF5PropertyIdentifier.h"
+#include "HDF5AttributeIdentifier.h"
 #include "HVCFConfiguration.h"
 #include "../../../auxc/MiniVCF/src/include/VCFReader.h"
 #include "WriteBuffer.h"
+#include "PopcountLD.h"
+#include "HaplotypeGather.h"
+#include "NameHash.h"
+#include "HaplotypeBlockCache.h"
+#include "WorkerPool.h"
+#include "HVCFMetrics.h"
+#include "HVCFLDSink.h"
 #include "../blosc/blosc_filter.h"
 
 using namespace std;
@@ -58,23 +72,50 @@ private:
 	unsigned int N_VARIANTS_HASH_BUCKETS;
 	unsigned int N_SAMPLES_HASH_BUCKETS;
 	unsigned int MAX_VARIANTS_IN_INTERVAL_BUCKET;
+	unsigned int MAX_CACHED_INTERVAL_BUCKETS;
 	unsigned int VARIANTS_CHUNK_SIZE;
 	unsigned int SAMPLES_CHUNK_SIZE;
 	const char* COMPRESSION;
 	unsigned int COMPRESSION_LEVEL;
+	const char* HAPLOTYPES_STORAGE;
+	unsigned int PBWT_CHECKPOINT_INTERVAL;
+	const char* VARIANTS_STORAGE;
+	bool HAPLOTYPES_BY_SAMPLE;
+	hsize_t HAPLOTYPES_BY_SAMPLE_CHUNK_SIZE;
+	unsigned int HAPLOTYPES_BY_SAMPLE_MAX_SAMPLES;
+	unsigned int GATHER_MAX_GAP;
+	const char* LD_ENGINE;
+	const char* CHUNK_READER;
+	unsigned int READ_THREADS;
+	unsigned int IMPORT_THREADS;
+	unsigned int LD_THREADS;
+	unsigned int LD_TILE_SIZE;
+	hsize_t LD_STORE_CHUNK_SIZE;
 	size_t METADATA_CACHE_INITIAL_SIZE;
 	size_t METADATA_CACHE_MIN_SIZE;
 	size_t METADATA_CACHE_MAX_SIZE;
 	size_t SIEVE_BUFFER_MAX_SIZE;
 	size_t CHUNK_CACHE_N_SLOTS;
 	size_t CHUNK_CACHE_SIZE;
+	size_t HAPLOTYPE_CACHE_SIZE;
 
 	static constexpr char CHROMOSOMES_GROUP[] = "chromosomes";
 	static constexpr char SAMPLES_GROUP[] = "samples";
 	static constexpr char VARIANTS_DATASET[] = "variants";
 	static constexpr char HAPLOTYPES_DATASET[] = "haplotypes";
+	static constexpr char HAPLOTYPES_BY_SAMPLE_DATASET[] = "haplotypes_by_sample";
+	static constexpr char HAPLOTYPE_ENDS_DATASET[] = "haplotype_ends";
+	static constexpr char HAPLOTYPE_CHECKPOINTS_DATASET[] = "haplotype_checkpoints";
+	static constexpr char VARIANT_COLUMNS_GROUP[] = "variant_columns";
+	static constexpr char VARIANT_POSITIONS_DATASET[] = "positions";
+	static constexpr char VARIANT_POSITION_ANCHORS_DATASET[] = "position_anchors";
+	static constexpr char VARIANT_ALLELES_DATASET[] = "alleles";
+	static constexpr char VARIANT_ALLELE_ENDS_DATASET[] = "allele_ends";
+	static constexpr char VARIANT_ALLELE_BYTES_DATASET[] = "allele_bytes";
 	static constexpr char SAMPLE_NAMES_DATASET[] = "names";
 	static constexpr char SAMPLE_SUBSETS_DATASET[] = "subsets";
+	static constexpr char SAMPLE_COLUMNS_DATASET[] = "columns";
+	static constexpr char ALLELE_COUNTS_GROUP[] = "allele_counts";
 
 	static constexpr char VARIABLE_LENGTH_STRING_TYPE[] = "variable_length_string_type";
 	static constexpr char VARIANTS_ENTRY_TYPE[] = "variants_entry_type";
@@ -88,11 +129,55 @@ private:
 	static constexpr char INTERVALS_INDEX[] = "intervals";
 	static constexpr char HASH_INDEX[] = "hashes";
 	static constexpr char INDEX_BUCKETS[] = "buckets";
+	static constexpr char FINGERPRINTS_DATASET[] = "fingerprints";
+	static constexpr char FINGERPRINT_BUCKETS_DATASET[] = "fingerprint_buckets";
+	static constexpr char HAPLOTYPES_STORAGE_ATTRIBUTE[] = "storage";
+	static constexpr char PBWT_CHECKPOINT_INTERVAL_ATTRIBUTE[] = "checkpoint_interval";
+	static constexpr char LD_STORE_GROUP[] = "ld";
+	static constexpr char LD_STORE_OFFSETS_DATASET[] = "offsets";
+	static constexpr char LD_STORE_COLUMNS_DATASET[] = "columns";
+	static constexpr char LD_STORE_R_DATASET[] = "r";
+	static constexpr char LD_STORE_MAX_DISTANCE_ATTRIBUTE[] = "max_distance";
+	static constexpr char LD_STORE_MIN_RSQUARE_ATTRIBUTE[] = "min_rsquare";
+
+	static constexpr char NUCLEOTIDES[] = "ACGT"; // 2-bit codes of SNV alleles
+	static constexpr unsigned char BLOB_ALLELES = 0x10u; // alleles code flag: ref and alt are in allele bytes blob
+	static constexpr hsize_t PBWT_CHUNK_SIZE = 65536u; // bytes of run-length encoded PBWT columns per chunk
+
+	HVCFMetrics metrics;
+
+	shared_ptr<HaplotypeBlockCache> haplotype_cache; // decoded haplotype chunks; used by direct chunk reader
+	unique_ptr<WorkerPool> worker_pool; // threads decompressing chunks and computing LD tiles and LD store rows; started on first use
+
+	static recursive_mutex hdf5_mutex; // HDF5 library is not re-entrant: all read-path calls to it from any HVCF instance are serialized
+
+	// Releases HDF5 lock for CPU-only work (LD math, formatting results) and reacquires it on scope exit.
+	class HDF5LockRelease {
+	private:
+		unique_lock<recursive_mutex>& lock;
+	public:
+		HDF5LockRelease(unique_lock<recursive_mutex>& lock) : lock(lock) { lock.unlock(); }
+		~HDF5LockRelease() { lock.lock(); }
+	};
+
+	// Registers ad-hoc sample selection as transient subset for the duration of one query, so that query finds it by name like any other subset.
+	class TransientSubset {
+	private:
+		HVCF& hvcf;
+		string name;
+	public:
+		TransientSubset(HVCF& hvcf, const sample_selection& samples) throw (HVCFReadException);
+		~TransientSubset();
+		const string& get_name() const { return name; }
+	};
 
 	unordered_map<string, unique_ptr<HDF5GroupIdentifier>> chromosomes;
 	unordered_map<string, unique_ptr<WriteBuffer>> write_buffers;
+	unordered_map<string, indices_builder_entry> indices_builders; // filled while variants are written; consumed by create_indices()
+	unordered_map<string, pbwt_builder_entry> pbwt_builders; // PBWT state of every chromosome while variants are written
 
 	samples_cache_entry samples_cache;
+	unordered_map<string, subsets_cache_entry> transient_subsets; // ad-hoc sample selections of running queries, keyed by generated names
 	unordered_map<string, unique_ptr<chromosomes_cache_entry>> chromosomes_cache;
 
 	hid_t create_variants_entry_memory_datatype() throw (HVCFCreateException);
@@ -104,39 +189,59 @@ private:
 
 	hid_t create_sample_names_dataset(hid_t group_id, hsize_t chunk_size) throw (HVCFWriteException);
 	hid_t create_sample_subsets_dataset(hid_t group_id, hsize_t chunk_size) throw (HVCFWriteException);
-	hid_t create_haplotypes_dataset(hid_t group_id, hsize_t variants_chunk_size, hsize_t samples_chunk_size) throw (HVCFWriteException);
+	hid_t create_haplotypes_matrix_dataset(hid_t group_id, const char* name, bool packed, hsize_t variants_chunk_size, hsize_t samples_chunk_size) throw (HVCFWriteException);
+	hid_t create_haplotypes_dataset(hid_t group_id, const char* name, hsize_t variants_chunk_size, hsize_t samples_chunk_size) throw (HVCFWriteException);
 	hid_t create_variants_dataset(hid_t group_id, hsize_t chunk_size) throw (HVCFWriteException);
+	void create_variant_columns(hid_t group_id, hsize_t chunk_size) throw (HVCFWriteException);
+	hid_t create_allele_counts_dataset(hid_t group_id, const string& subset, hsize_t chunk_size) throw (HVCFWriteException);
+	hid_t create_column_dataset(hid_t group_id, const char* name, hid_t datatype_id, hsize_t chunk_size) throw (HVCFWriteException);
 	hid_t create_chromosome_group(const string& name) throw (HVCFWriteException);
 
 	void initialize_ull_index_buckets(hid_t chromosome_group_id, const char* index_group_name) throw (HVCFWriteException);
-	void initialize_string_index_buckets(hid_t chromosome_group_id, const char* index_group_name) throw (HVCFWriteException);
 
-	void cache_names_index_bucket(hid_t group_id, hash_index_entry_type& hash_index_entry, vector<string_index_entry_type>& bucket, vector<string_index_entry_type>& buckets_cache) throw (HVCFWriteException);
-	void write_names_index_buckets(hid_t group_id, vector<string_index_entry_type>& buckets_cache) throw (HVCFWriteException);
-	void write_names_index(hid_t chromosome_group_id, const hash_index_entry_type* hash_index_entries, unsigned int n_hash_index_entries) throw (HVCFWriteException);
+	void write_names_fingerprints(hid_t group_id, vector<ull_index_entry_type>& fingerprints, unsigned int n_buckets) throw (HVCFWriteException);
 
 	void cache_intervals_index_bucket(hid_t group_id, interval_index_entry_type& interval_index_entry, vector<ull_index_entry_type>& bucket, vector<ull_index_entry_type>& buckets_cache) throw (HVCFWriteException);
 	void write_intervals_index_buckets(hid_t group_id, vector<ull_index_entry_type>& buckets_cache) throw (HVCFWriteException);
 	void write_intervals_index(hid_t chromosome_group_id, const interval_index_entry_type* interval_index_entries, unsigned int n_interval_index_entries) throw (HVCFWriteException);
 
-	void read_variant_names_into_bucket(hid_t chromosome_group_id, const vector<hsize_t>& offsets, vector<string_index_entry_type>& bucket) throw (HVCFWriteException);
-	void read_sample_names_into_bucket(hid_t samples_group_id, const vector<hsize_t>& offsets, vector<string_index_entry_type>& bucket) throw (HVCFWriteException);
-	void read_positions_into_bucket(hid_t chromosome_group_id, const vector<hsize_t>& offsets, vector<ull_index_entry_type>& bucket) throw (HVCFWriteException);
-
-	void write_haplotypes(hid_t group_id, const unsigned char* buffer, unsigned int n_variants, unsigned int n_haplotypes) throw (HVCFWriteException);
+	unsigned int compress_haplotypes_chunk(const unsigned char* chunk, size_t chunk_size, vector<unsigned char>& compressed) throw (HVCFWriteException);
+	void write_haplotypes_chunks(hid_t dataset_id, const unsigned char* buffer, hsize_t variant_offset, unsigned int n_variants, unsigned int n_columns, const hsize_t* chunk_dims) throw (HVCFWriteException);
+	void write_haplotypes(hid_t group_id, const char* name, const unsigned char* buffer, unsigned int n_variants, unsigned int n_columns) throw (HVCFWriteException);
+	void write_pbwt_haplotypes(hid_t group_id, pbwt_builder_entry& pbwt_builder, const unsigned char* buffer, unsigned int n_variants, unsigned int n_columns) throw (HVCFWriteException);
 	void write_variants(hid_t group_id, const variants_entry_type* buffer, unsigned int n_variants) throw (HVCFWriteException);
+	void write_variant_columns(hid_t group_id, const variants_entry_type* buffer, unsigned int n_variants) throw (HVCFWriteException);
+	void write_allele_counts(hid_t group_id, const string& subset, const unsigned int* buffer, unsigned int n_variants) throw (HVCFWriteException);
+	void append_column(hid_t group_id, const char* name, hid_t memory_datatype_id, const void* buffer, hsize_t n) throw (HVCFWriteException);
+	void delete_ld_store(hid_t chromosome_group_id, const string& subset) throw (HVCFWriteException);
 
-	void create_chromosome_indices(hid_t chromosome_group_id) throw (HVCFWriteException);
+	void create_chromosome_indices(hid_t chromosome_group_id, indices_builder_entry& indices_builder) throw (HVCFWriteException);
 	void create_samples_indices() throw (HVCFWriteException);
 	void create_indices() throw (HVCFWriteException);
+	void create_allele_counts(const string& subset) throw (HVCFWriteException);
 
-	void write_samples(const vector<string>& samples) throw (HVCFWriteException);
+	void write_samples(const vector<string>& samples, const vector<string>& sample_order) throw (HVCFWriteException);
+	void index_variants(const string& chromosome, const variants_entry_type* variants, unsigned int n_variants);
 	void write_variant(const Variant& variant, future<void>& async_write) throw (HVCFWriteException);
 	void flush_write_buffer(future<void>& async_write) throw (HVCFWriteException);
 
+	bool load_names_fingerprints(hid_t index_group_id, HDF5DatasetIdentifier& fingerprints_id, vector<hsize_t>& buckets) throw (HVCFReadException);
 	void load_samples_cache() throw (HVCFReadException);
 	void load_chromosomes_cache() throw (HVCFReadException);
+	void load_ld_stores_cache(hid_t chromosome_group_id, chromosomes_cache_entry& chromosome_cache) throw (HVCFReadException);
 	void load_cache() throw (HVCFReadException);
+
+	const vector<ull_index_entry_type>& read_intervals_index_bucket(chromosomes_cache_entry& chromosome_cache, const interval_index_entry_type& interval_index_entry, vector<ull_index_entry_type>& bucket) throw (HVCFReadException);
+	bool read_allele_counts(hid_t chromosome_group_id, const string& subset, hsize_t variant_offset, hsize_t n_variants, unsigned int* buffer) throw (HVCFReadException);
+	void read_column(hid_t dataset_id, hid_t memory_datatype_id, hsize_t offset, hsize_t n, void* buffer) throw (HVCFReadException);
+	void read_variant_positions(const chromosomes_cache_entry& chromosome_cache, hsize_t variant_offset, hsize_t n_variants, unsigned long long int* positions) throw (HVCFReadException);
+	void read_variants(const chromosomes_cache_entry& chromosome_cache, hsize_t variant_offset, hsize_t n_variants, variants_columns& variants) throw (HVCFReadException);
+	void find_names_fingerprints(hid_t fingerprints_id, const vector<hsize_t>& buckets, const string& name, vector<hsize_t>& offsets) throw (HVCFReadException);
+	void read_ld_store(const ld_store_cache_entry& ld_store, hsize_t variant_offset, hsize_t n_variants, vector<unsigned long long int>& offsets, vector<unsigned int>& columns, vector<double>& r) throw (HVCFReadException);
+	void read_haplotypes_chunks(const chromosomes_cache_entry& chromosome_cache, bool by_sample, hsize_t variant_offset, hsize_t n_variants, const vector<tuple<hsize_t, hsize_t, hsize_t>>& column_ranges, hsize_t n_columns, unsigned char* buffer, unique_lock<recursive_mutex>& hdf5_lock) throw (HVCFReadException);
+	const subsets_cache_entry* find_subset(const string& subset) const;
+	void read_pbwt_haplotypes(chromosomes_cache_entry& chromosome_cache, const vector<tuple<hsize_t, hsize_t, hsize_t>>& sample_chunks, hsize_t variant_offset, hsize_t n_variants, unsigned char* buffer, unique_lock<recursive_mutex>& hdf5_lock) throw (HVCFReadException);
+	void read_haplotypes(chromosomes_cache_entry& chromosome_cache, const vector<tuple<hsize_t, hsize_t, hsize_t>>& sample_chunks, hsize_t variant_offset, hsize_t n_variants, unsigned char* buffer, unique_lock<recursive_mutex>& hdf5_lock) throw (HVCFReadException);
 public:
 	HVCF();
 	HVCF(const HVCFConfiguration& configuration);
@@ -148,10 +253,21 @@ public:
 
 	void import_vcf(const string& name) throw (HVCFWriteException);
 
+	// Same as above, but haplotypes are stored with samples in the given order (samples not listed follow in VCF order), e.g. grouped by population,
+	// so that every population is a contiguous range of haplotype columns and its queries decompress only its own chunks. Sample offsets,
+	// get_samples() and order of samples in query results stay as in VCF. Order is set by the first import into file; later imports follow it.
+	void import_vcf(const string& name, const vector<string>& sample_order) throw (HVCFWriteException);
+
 	void create_sample_subset(const string& name, const vector<string>& samples) throw (HVCFWriteException);
 
+	// Precomputes LD of subset for pairs at most max_distance bp apart and with r^2 >= min_rsquare (all such pairs, if min_rsquare <= 0).
+	// Region LD queries with options, whose pairs are all in the store, and lead variant queries within max_distance of the lead variant (only if all pairs are stored)
+	// are then served from it; other queries compute LD from haplotypes as before. Rebuilding replaces previous store of the subset.
+	void create_ld_store(const string& subset, unsigned long long int max_distance, double min_rsquare) throw (HVCFWriteException);
+
 	hsize_t get_n_samples() throw (HVCFReadException);
 	vector<string> get_samples() throw (HVCFReadException);
+	shared_ptr<const sample_table> get_sample_table() throw (HVCFReadException); // names and subsets served from memory; table is immutable
 	unsigned int get_n_sample_subsets() throw (HVCFReadException);
 	vector<string> get_sample_subsets() throw (HVCFReadException);
 	unsigned int get_n_samples_in_subset(const string& name) throw (HVCFReadException);
@@ -172,15 +288,50 @@ public:
 
 	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
 	void compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, vector<ld_query_result>& result) throw (HVCFReadException);
 	void compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException);
 	void extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<variant_query_result>& result) throw (HVCFReadException);
+
+	// Columnar versions: names are stored once and values in contiguous arrays. Result is cleared first, but its capacity is reused.
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException);
+
+	// Batch lead variant LD: union of lead variants and their windows is read once, and r of every lead with its window variants is computed in one pass.
+	// Lead variants not found in chromosome are skipped.
+	void compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, ld_batch_columns& result) throw (HVCFReadException);
+
+	// Tiled region LD: streams the matrix tile by tile to sink, computing tiles on ld_threads threads (popcount kernel, regardless of ld_engine).
+	// Memory is bounded by bit-packed haplotypes of the region plus one tile per thread.
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, HVCFLDSink& sink) throw (HVCFReadException);
+	void compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException);
+	void extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, variants_columns& result) throw (HVCFReadException);
 	void extract_haplotypes(const string& subset, const string& chromosome, const string& variant_name, vector<variant_haplotypes_query_result>& result) throw (HVCFReadException);
 	void extract_haplotypes(const string& sample, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<sample_haplotypes_query_result>& result) throw (HVCFReadException);
+	void extract_haplotypes(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, haplotypes_query_columns& result) throw (HVCFReadException);
+
+	// Ad-hoc sample selections: same queries over samples given by offsets or mask instead of subset name. Nothing is precomputed for them,
+	// so allele counts and LD are always computed from haplotypes. Throws if some offset is not less than number of samples.
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, HVCFLDSink& sink) throw (HVCFReadException);
+	void compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException);
 
 	unsigned int get_n_opened_objects() const;
 	static unsigned int get_n_all_opened_objects();
 
-	void compute_ld_test(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	HVCFMetrics get_metrics() const;
+	void reset_metrics();
+
+	// Replaces own decoded haplotype chunks cache with the given one, e.g. to share it between readers opened on the same file.
+	void set_haplotype_cache(const shared_ptr<HaplotypeBlockCache>& cache);
+	HaplotypeBlockCache::statistics get_haplotype_cache_statistics() const;
+	void reset_haplotype_cache_statistics();
 };
 
 }
@@ -10,19 +10,48 @@ public:
 	static constexpr char GZIP_COMPRESSION[] = "GZIP";
 	static constexpr char BLOSC_LZ4HC_COMPRESSION[] = "BLOSC_LZ4HC";
 
+	static constexpr char BYTE_HAPLOTYPES_STORAGE[] = "BYTE"; // one allele per byte
+	static constexpr char BIT_HAPLOTYPES_STORAGE[] = "BIT"; // one allele per bit (8 per byte along haplotypes axis); bi-allelic only
+	static constexpr char PBWT_HAPLOTYPES_STORAGE[] = "PBWT"; // run-length encoded columns of positional BWT (haplotypes sorted by reversed prefixes); bi-allelic only
+
+	static constexpr char COLUMNS_VARIANTS_STORAGE[] = "COLUMNS"; // delta-encoded positions, 2-bit codes of SNV alleles, other alleles in byte blob; names derived on read
+	static constexpr char COMPOUND_VARIANTS_STORAGE[] = "COMPOUND"; // compound dataset with variable-length strings for name, ref and alt
+
+	static constexpr char DENSE_LD_ENGINE[] = "DENSE"; // haplotypes converted to double and multiplied with Armadillo
+	static constexpr char POPCOUNT_LD_ENGINE[] = "POPCOUNT"; // haplotypes packed into 64-bit bitsets; counts with bit-AND and popcount
+
+	static constexpr char HDF5_CHUNK_READER[] = "HDF5"; // haplotypes are read with H5Dread, i.e. chunks are decompressed by HDF5 filter pipeline one at a time
+	static constexpr char DIRECT_CHUNK_READER[] = "DIRECT"; // compressed chunks are read with H5Dread_chunk and decompressed on read_threads threads (HDF5 1.10.3 or later, otherwise chunks are read with H5Dread)
+
 	unsigned int n_variants_hash_buckets;
 	unsigned int n_samples_hash_buckets;
 	unsigned int max_variants_in_interval_bucket;
+	unsigned int max_cached_interval_buckets;
 	hsize_t variants_chunk_size;
 	hsize_t samples_chunk_size;
 	const char* compression;
 	unsigned int compression_level;
+	const char* haplotypes_storage;
+	unsigned int pbwt_checkpoint_interval;
+	const char* variants_storage;
+	bool haplotypes_by_sample;
+	hsize_t haplotypes_by_sample_chunk_size;
+	unsigned int haplotypes_by_sample_max_samples;
+	unsigned int gather_max_gap;
+	const char* ld_engine;
+	const char* chunk_reader;
+	unsigned int read_threads;
+	unsigned int import_threads;
+	unsigned int ld_threads;
+	unsigned int ld_tile_size;
+	hsize_t ld_store_chunk_size;
 	size_t metadata_cache_initial_size;
 	size_t metadata_cache_min_size;
 	size_t metadata_cache_max_size;
 	size_t sieve_buffer_max_size;
 	size_t chunk_cache_n_slots;
 	size_t chunk_cache_size;
+	size_t haplotype_cache_size;
 
 	HVCFConfiguration();
 	virtual ~HVCFConfiguration();
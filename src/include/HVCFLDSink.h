@@ -0,0 +1,26 @@
+#ifndef SRC_INCLUDE_HVCFLDSINK_H_
+#define SRC_INCLUDE_HVCFLDSINK_H_
+
+#include "Types.h"
+
+namespace sph_umich_edu {
+
+/*
+ * Receives results of tiled region LD query tile by tile, so that whole n_variants x n_variants matrix never has to be in memory.
+ * Tiles cover upper block triangle (row block <= column block); lower triangle is the transpose. Tiles arrive in no particular order
+ * and from worker threads, but calls are never concurrent. Exception thrown by consume() stops the query: HVCFReadException is rethrown
+ * as is, any other std::exception is reported as HVCFReadException.
+ */
+class HVCFLDSink {
+public:
+	virtual ~HVCFLDSink() {}
+
+	// Called once before any tile. Tiles refer to variants by ordinals.
+	virtual void begin(const variants_columns& variants) = 0;
+
+	virtual void consume(const ld_tile& tile) = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef SRC_INCLUDE_HVCFMETRICS_H_
+#define SRC_INCLUDE_HVCFMETRICS_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <exception>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#include "hdf5.h"
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+/*
+ * Query metrics of a single HVCF reader: per query type latency histogram, per stage timers, I/O counters and result sizes.
+ * I/O counters come from a pass-through (POSIX) file driver, which is called in the thread calling H5Dread, so they are kept
+ * per thread and attributed to the query running on that thread. Chunk of a filtered dataset is read from file with one raw data
+ * read, and only if it is not in chunk cache.
+ */
+class HVCFMetrics {
+public:
+	static const vector<double> LATENCY_BUCKETS; // upper bounds in seconds; last implicit bucket is +Inf
+
+	typedef struct {
+		unsigned long long int reads; // all file reads: metadata and raw data
+		unsigned long long int bytes_read;
+		unsigned long long int raw_data_reads;
+		unsigned long long int raw_data_bytes_read;
+	} io_counters;
+
+	typedef struct {
+		unsigned long long int count;
+		double seconds;
+	} stage_metrics;
+
+	typedef struct QueryMetrics {
+		unsigned long long int count;
+		unsigned long long int errors;
+		double seconds;
+		vector<unsigned long long int> latency_buckets; // non-cumulative; LATENCY_BUCKETS.size() + 1 entries
+		map<string, stage_metrics> stages;
+		io_counters io;
+		unsigned long long int haplotype_chunks_touched; // chunks of haplotypes dataset overlapping read selections
+		unsigned long long int haplotype_chunks_read; // ... of which were not in chunk cache
+		unsigned long long int results;
+
+		QueryMetrics() : count(0ull), errors(0ull), seconds(0.0), latency_buckets(LATENCY_BUCKETS.size() + 1u, 0ull), io{0ull, 0ull, 0ull, 0ull},
+				haplotype_chunks_touched(0ull), haplotype_chunks_read(0ull), results(0ull) {
+		}
+
+		double get_chunk_cache_hit_rate() const {
+			return haplotype_chunks_touched > 0ull ? 1.0 - static_cast<double>(haplotype_chunks_read) / haplotype_chunks_touched : 0.0;
+		}
+	} query_metrics;
+
+private:
+	mutable mutex metrics_mutex;
+	map<string, query_metrics> queries;
+
+	static thread_local io_counters thread_io_counters;
+
+public:
+	HVCFMetrics();
+	HVCFMetrics(const HVCFMetrics& metrics);
+	HVCFMetrics& operator=(const HVCFMetrics& metrics);
+	virtual ~HVCFMetrics();
+
+	void add(const string& query, const query_metrics& metrics);
+	void merge(const HVCFMetrics& metrics);
+	void reset();
+
+	map<string, query_metrics> get() const;
+	string to_prometheus(const string& prefix = "hvcf") const;
+
+	static io_counters get_thread_io_counters();
+	static void count_read(H5FD_mem_t type, size_t size);
+
+	// Returns identifier of file driver, which passes all calls to POSIX (sec2) driver and counts reads. Registered on first call.
+	static hid_t get_counting_driver();
+};
+
+/*
+ * Measures query running on the current thread. Traces constructed while another trace is active on the same thread
+ * (e.g. in vector-based query adapters calling columnar queries) are inactive, and static functions record into the outer one.
+ * Query is recorded when trace is destroyed; if it is destroyed by exception, only error count is incremented.
+ */
+class HVCFQueryTrace {
+private:
+	HVCFMetrics& metrics;
+	string query;
+	bool active;
+	HVCFMetrics::query_metrics query_metrics;
+	HVCFMetrics::io_counters start_io;
+	chrono::time_point<chrono::steady_clock> start;
+	chrono::time_point<chrono::steady_clock> stage_start;
+	const char* stage_name;
+
+	static thread_local HVCFQueryTrace* current;
+
+	void close_stage(chrono::time_point<chrono::steady_clock> now);
+
+public:
+	static constexpr char LOCK_STAGE[] = "lock";
+	static constexpr char LOOKUP_STAGE[] = "lookup";
+	static constexpr char READ_HAPLOTYPES_STAGE[] = "read_haplotypes";
+	static constexpr char CONVERT_STAGE[] = "convert";
+	static constexpr char COMPUTE_STAGE[] = "compute";
+	static constexpr char READ_VARIANTS_STAGE[] = "read_variants";
+	static constexpr char FORMAT_STAGE[] = "format";
+	static constexpr char READ_LD_STORE_STAGE[] = "read_ld_store";
+
+	HVCFQueryTrace(HVCFMetrics& metrics, const char* query);
+	virtual ~HVCFQueryTrace();
+
+	HVCFQueryTrace(const HVCFQueryTrace& trace) = delete;
+	HVCFQueryTrace& operator=(const HVCFQueryTrace& trace) = delete;
+
+	static void stage(const char* name);
+	static void add_haplotype_chunks(unsigned long long int touched, unsigned long long int read);
+	static void set_results(unsigned long long int n);
+};
+
+}
+
+#endif
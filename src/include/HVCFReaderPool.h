@@ -0,0 +1,106 @@
+#ifndef SRC_INCLUDE_HVCFREADERPOOL_H_
+#define SRC_INCLUDE_HVCFREADERPOOL_H_
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "HVCF.h"
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+/*
+ * Pool of HVCF readers opened on the same file, so that read queries can be served from many threads.
+ * Every query borrows an idle reader (waiting if there is none) and returns it when done. Readers share decoded haplotype chunks cache, but not other caches,
+ * and all their HDF5 calls are serialized by HVCF, while LD math and result formatting run concurrently.
+ */
+class HVCFReaderPool {
+private:
+	HVCFConfiguration configuration;
+	unsigned int n_readers;
+
+	vector<unique_ptr<HVCF>> readers;
+	vector<HVCF*> idle_readers;
+	mutex idle_readers_mutex;
+	condition_variable idle_readers_condition;
+
+	HVCFMetrics closed_readers_metrics; // metrics of readers from before the last close()
+
+	shared_ptr<HaplotypeBlockCache> haplotype_cache; // shared by all readers
+
+	HVCF* acquire() throw (HVCFReadException);
+	void release(HVCF* reader);
+
+	// Borrows reader from the pool for a single query.
+	class Lease {
+	private:
+		HVCFReaderPool& pool;
+		HVCF* reader;
+	public:
+		Lease(HVCFReaderPool& pool) throw (HVCFReadException) : pool(pool), reader(pool.acquire()) {}
+		~Lease() { pool.release(reader); }
+		HVCF* operator->() const { return reader; }
+	};
+
+public:
+	HVCFReaderPool(unsigned int n_readers);
+	HVCFReaderPool(const HVCFConfiguration& configuration, unsigned int n_readers);
+	virtual ~HVCFReaderPool() noexcept;
+
+	HVCFReaderPool(const HVCFReaderPool& pool) = delete;
+	HVCFReaderPool& operator=(const HVCFReaderPool& pool) = delete;
+
+	void open(const string& name) throw (HVCFOpenException);
+	void close() throw (HVCFCloseException);
+
+	unsigned int get_n_readers() const;
+
+	HVCFMetrics get_metrics(); // summed over all readers
+	void reset_metrics();
+
+	HaplotypeBlockCache::statistics get_haplotype_cache_statistics() const;
+	void reset_haplotype_cache_statistics();
+
+	hsize_t get_n_samples() throw (HVCFReadException);
+	vector<string> get_samples() throw (HVCFReadException);
+	shared_ptr<const sample_table> get_sample_table() throw (HVCFReadException);
+	vector<string> get_sample_subsets() throw (HVCFReadException);
+	vector<string> get_samples_in_subset(const string& name) throw (HVCFReadException);
+	vector<string> get_chromosomes() throw (HVCFReadException);
+	bool has_chromosome(const string& chromosome) throw (HVCFReadException);
+	unsigned long long int get_chromosome_start(const string& chromosome) throw (HVCFReadException);
+	unsigned long long int get_chromosome_end(const string& chromosome) throw (HVCFReadException);
+	hsize_t get_n_variants_in_chromosome(const string& chromosome) throw (HVCFReadException);
+
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException);
+	void extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<variant_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, const vector<string>& lead_variant_names, const ld_window& window, ld_batch_columns& result) throw (HVCFReadException);
+	void compute_ld(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, HVCFLDSink& sink) throw (HVCFReadException);
+	void compute_frequencies(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException);
+	void extract_variants(const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, variants_columns& result) throw (HVCFReadException);
+	void extract_haplotypes(const string& subset, const string& chromosome, const string& variant_name, vector<variant_haplotypes_query_result>& result) throw (HVCFReadException);
+	void extract_haplotypes(const string& sample, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<sample_haplotypes_query_result>& result) throw (HVCFReadException);
+	void extract_haplotypes(const string& subset, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, haplotypes_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, vector<ld_query_result>& result) throw (HVCFReadException);
+	void compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, vector<frequency_query_result>& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, const string& lead_variant_name, unsigned long long int start_position, unsigned long long int end_position, ld_query_columns& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, const ld_options& options, ld_pairs_columns& result) throw (HVCFReadException);
+	void compute_ld(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, HVCFLDSink& sink) throw (HVCFReadException);
+	void compute_frequencies(const sample_selection& samples, const string& chromosome, unsigned long long int start_position, unsigned long long int end_position, frequency_query_columns& result) throw (HVCFReadException);
+};
+
+}
+
+#endif
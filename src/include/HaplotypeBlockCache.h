@@ -0,0 +1,83 @@
+#ifndef SRC_INCLUDE_HAPLOTYPEBLOCKCACHE_H_
+#define SRC_INCLUDE_HAPLOTYPEBLOCKCACHE_H_
+
+#include <string>
+#include <vector>
+#include <list>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+#include "hdf5.h"
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+/*
+ * LRU cache of decoded (decompressed) chunks of haplotypes datasets, keyed by dataset (chromosome name, followed by "/" and dataset name
+ * for copies of haplotypes), variant chunk and column chunk.
+ * Blocks are kept in the layout they have in file, i.e. bit-packed if haplotypes are stored 8 per byte. Total size of cached
+ * blocks never exceeds capacity (in bytes). Thread-safe, so that it can be shared by several readers opened on the same file.
+ * Blocks are immutable and reference counted: evicted block stays valid while some query still uses it.
+ */
+class HaplotypeBlockCache {
+public:
+	typedef shared_ptr<const vector<unsigned char>> block;
+
+	typedef struct {
+		unsigned long long int hits;
+		unsigned long long int misses;
+		unsigned long long int evictions;
+		unsigned long long int n_blocks;
+		unsigned long long int size; // bytes in cached blocks
+		unsigned long long int capacity;
+	} statistics;
+
+private:
+	typedef tuple<string, hsize_t, hsize_t> key; // dataset, variant chunk, column chunk
+
+	struct key_hash {
+		size_t operator()(const key& k) const {
+			size_t h = hash<string>()(std::get<0>(k));
+			h ^= hash<hsize_t>()(std::get<1>(k)) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+			h ^= hash<hsize_t>()(std::get<2>(k)) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	size_t capacity;
+	size_t size;
+
+	list<pair<key, block>> blocks; // most recently used first
+	unordered_map<key, list<pair<key, block>>::iterator, key_hash> blocks_lookup;
+
+	unsigned long long int hits;
+	unsigned long long int misses;
+	unsigned long long int evictions;
+
+	mutable mutex blocks_mutex;
+
+public:
+	HaplotypeBlockCache(size_t capacity);
+	virtual ~HaplotypeBlockCache();
+
+	HaplotypeBlockCache(const HaplotypeBlockCache& cache) = delete;
+	HaplotypeBlockCache& operator=(const HaplotypeBlockCache& cache) = delete;
+
+	// Returns cached block or empty pointer; counts hit or miss.
+	block get(const string& dataset, hsize_t variant_chunk, hsize_t column_chunk);
+	// Caches block, evicting least recently used ones until it fits. Blocks larger than capacity are not cached.
+	void put(const string& dataset, hsize_t variant_chunk, hsize_t column_chunk, block decoded);
+	void clear();
+
+	bool is_enabled() const;
+	statistics get_statistics() const;
+	void reset_statistics();
+};
+
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef SRC_INCLUDE_HAPLOTYPEGATHER_H_
+#define SRC_INCLUDE_HAPLOTYPEGATHER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+/*
+ * Gathers selected haplotype columns from rows of a wider block of haplotypes (one byte per haplotype), i.e. compresses fragmented sample selections.
+ * Vector implementations gather 4 bytes per selected column and keep the lowest one, so they are used only for rows followed by at least 3 more bytes of block.
+ * Gather implementation (AVX-512 VPGATHERDD, AVX2 VPGATHERDD or portable scalar) is selected at runtime based on CPU features.
+ */
+class HaplotypeGather {
+private:
+	typedef void (*gather_row_function)(const unsigned char* source, const uint32_t* columns, size_t n_columns, unsigned char* destination);
+
+	static gather_row_function select_gather_row(const char** name);
+	static gather_row_function get_gather_row();
+
+public:
+	static void gather(const unsigned char* source, size_t n_source_columns, size_t n_rows, const uint32_t* columns, size_t n_columns, unsigned char* destination);
+	static void gather_row_scalar(const unsigned char* source, const uint32_t* columns, size_t n_columns, unsigned char* destination);
+	static const char* get_implementation();
+};
+
+}
+
+#endif
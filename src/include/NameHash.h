@@ -0,0 +1,38 @@
+#ifndef SRC_INCLUDE_NAMEHASH_H_
+#define SRC_INCLUDE_NAMEHASH_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+/*
+ * Portable 64-bit hash of variant and sample names (XXH64 algorithm). Unlike std::hash, values don't depend on standard library,
+ * compiler or byte order, so that name indices written on one platform can be read on any other.
+ * Input is consumed in 32-byte stripes by four independent accumulators, which compilers keep in registers and vectorize.
+ */
+class NameHash {
+private:
+	static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+	static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+	static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+	static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+	static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+	static uint64_t rotate_left(uint64_t x, unsigned int r) { return (x << r) | (x >> (64u - r)); }
+	static uint64_t read64(const unsigned char* p);
+	static uint64_t read32(const unsigned char* p);
+	static uint64_t round(uint64_t accumulator, uint64_t input);
+	static uint64_t merge_round(uint64_t accumulator, uint64_t value);
+
+public:
+	static uint64_t hash(const char* data, size_t length, uint64_t seed = 0u);
+	static uint64_t hash(const string& value) { return hash(value.data(), value.length()); }
+};
+
+}
+
+#endif
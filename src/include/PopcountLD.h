@@ -0,0 +1,54 @@
+#ifndef SRC_INCLUDE_POPCOUNTLD_H_
+#define SRC_INCLUDE_POPCOUNTLD_H_
+
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+/*
+ * Computes LD (Pearson r between haplotype vectors) using bit-AND and popcount on 64-bit haplotype bitsets.
+ * Produces the same values as the dense matrix formula: r = (n * c_ij - c_i * c_j) / sqrt(c_i * c_j * (n - c_i) * (n - c_j)).
+ * Popcount implementation (AVX-512 VPOPCNTQ, AVX2, POPCNT or portable scalar) is selected at runtime based on CPU features.
+ */
+class PopcountLD {
+private:
+	typedef uint64_t (*and_popcount_function)(const uint64_t* a, const uint64_t* b, size_t n_words);
+
+	size_t n_variants;
+	size_t n_haplotypes;
+	size_t n_words;
+
+	unique_ptr<uint64_t[]> bitsets; // n_variants x n_words
+	unique_ptr<uint64_t[]> counts; // number of alternate alleles per variant
+
+	static and_popcount_function select_and_popcount(const char** name);
+	static and_popcount_function get_and_popcount();
+
+public:
+	PopcountLD(size_t n_variants, size_t n_haplotypes);
+	virtual ~PopcountLD();
+
+	void load(size_t variant, const unsigned char* haplotypes);
+	void load(const unsigned char* haplotypes);
+
+	double compute_r(size_t variant1, size_t variant2) const;
+	double get_max_rsquare(size_t variant1, size_t variant2) const;
+	void compute_r(double* r) const;
+
+	size_t get_n_variants() const;
+	size_t get_n_haplotypes() const;
+	uint64_t get_count(size_t variant) const;
+
+	static uint64_t and_popcount(const uint64_t* a, const uint64_t* b, size_t n_words);
+	static uint64_t and_popcount_scalar(const uint64_t* a, const uint64_t* b, size_t n_words);
+	static const char* get_implementation();
+};
+
+}
+
+#endif
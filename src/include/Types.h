@@ -2,10 +2,18 @@
 #define SRC_INCLUDE_TYPES_H_
 
 #include <string>
+#include <cstring>
+#include <vector>
+#include <list>
+#include <tuple>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <limits>
 #include "hdf5.h"
 
 #include "HDF5DatasetIdentifier.h"
+#include "NameHash.h"
 
 using namespace std;
 
@@ -51,21 +59,122 @@ typedef struct {
 typedef struct {
 	vector<tuple<hsize_t, hsize_t, hsize_t>> chunks; // offset_1 (start), offset_2 (end), size (offset_2 - offset_1 + 1)
 	hsize_t n_samples;
+	bool transient; // ad-hoc selection of samples registered for one query: it has no precomputed allele counts or LD
+	vector<hsize_t> order; // if samples were permuted at import: position in read haplotypes (column order) of every sample in sample order; empty otherwise
 } subsets_cache_entry;
 
+// Ad-hoc set of samples for queries, given either by sample offsets (in any order, duplicates are ignored) or by mask over all samples
+// (i-th element selects sample with offset i).
+typedef struct SampleSelection {
+	vector<hsize_t> offsets;
+
+	SampleSelection() {}
+	SampleSelection(const vector<hsize_t>& offsets) : offsets(offsets) {}
+	SampleSelection(const vector<bool>& mask) {
+		for (size_t i = 0u; i < mask.size(); ++i) {
+			if (mask[i]) {
+				offsets.push_back(i);
+			}
+		}
+	}
+} sample_selection;
+
+// Sample names and subsets of opened file, read once when file is opened. Names are interned in one buffer and lookup keys point into it.
+// Not copyable: handed out only as shared_ptr<const sample_table>.
+typedef struct SampleTable {
+	struct name_hash {
+		size_t operator()(const char* name) const { return static_cast<size_t>(NameHash::hash(name, strlen(name))); }
+	};
+
+	struct name_equal {
+		bool operator()(const char* f, const char* s) const { return strcmp(f, s) == 0; }
+	};
+
+	vector<char> names; // '\0'-terminated names in file order; must not grow after lookup is built
+	vector<size_t> name_offsets; // offset of i-th sample's name in names
+	unordered_map<const char*, hsize_t, name_hash, name_equal> lookup; // name -> sample offset
+	unordered_map<string, vector<hsize_t>> subsets; // subset -> increasing sample offsets
+	vector<hsize_t> columns; // if samples were permuted at import: position of i-th sample along haplotypes axis; empty otherwise
+
+	SampleTable() {}
+	SampleTable(const SampleTable& table) = delete; // copied lookup keys would still point into names of original table
+	SampleTable& operator=(const SampleTable& table) = delete;
+
+	size_t size() const { return name_offsets.size(); }
+	const char* get_name(size_t i) const { return names.data() + name_offsets[i]; }
+	hsize_t get_column(hsize_t i) const { return columns.empty() ? i : columns[i]; }
+
+	long long int get_offset(const char* name) const {
+		auto lookup_it = lookup.find(name);
+		return (lookup_it == lookup.end()) ? -1 : static_cast<long long int>(lookup_it->second);
+	}
+
+	const vector<hsize_t>* get_subset(const string& name) const {
+		auto subsets_it = subsets.find(name);
+		return (subsets_it == subsets.end()) ? nullptr : &subsets_it->second;
+	}
+} sample_table;
+
 typedef struct {
-	HDF5DatasetIdentifier names_index_id;
-	HDF5DatasetIdentifier names_index_buckets_id;
+	shared_ptr<const sample_table> table; // shared, so that table handed out to callers stays valid after cache is reloaded or file is closed
 	unordered_map<string, subsets_cache_entry> subsets;
 } samples_cache_entry;
 
 typedef struct {
-	HDF5DatasetIdentifier names_index_id;
+	vector<ull_index_entry_type> names_fingerprints; // (NameHash of variant name, variant offset)
+	vector<ull_index_entry_type> positions; // (position, variant offset) in the order variants were written
+} indices_builder_entry;
+
+// PBWT state of one chromosome, carried over from one flushed write buffer to the next.
+typedef struct {
+	vector<unsigned int> order; // haplotype columns sorted by reversed prefixes of variants written so far (PBWT positional prefix array)
+	hsize_t n_variants; // variants written so far
+	hsize_t n_bytes; // bytes of run-length encoded columns written so far
+} pbwt_builder_entry;
+
+// Precomputed LD of one sample subset in one chromosome: pairs within max_distance bp and with r^2 >= min_rsquare (all pairs, if min_rsquare <= 0),
+// stored row by row for every variant (both triangles and diagonal), i.e. sparse rows in CSR layout.
+typedef struct {
+	HDF5DatasetIdentifier offsets_id; // n_variants + 1 entries: row i is [offsets[i], offsets[i + 1]) in columns and r
+	HDF5DatasetIdentifier columns_id; // variant offsets in chromosome, increasing within each row
+	HDF5DatasetIdentifier r_id;
+	unsigned long long int max_distance;
+	double min_rsquare;
+	hsize_t n_variants;
+} ld_store_cache_entry;
+
+typedef struct {
+	string name;
+	HDF5DatasetIdentifier names_index_id; // legacy string index; opened only if there is no fingerprints index
 	HDF5DatasetIdentifier names_index_buckets_id;
+	HDF5DatasetIdentifier names_fingerprints_id; // (NameHash of variant name, variant offset) sorted by bucket and fingerprint
+	vector<hsize_t> names_fingerprint_buckets; // bucket i is [buckets[i], buckets[i + 1]) in fingerprints; empty if there is no fingerprints index
 	HDF5DatasetIdentifier intervals_index_id;
 	HDF5DatasetIdentifier intervals_index_buckets_id;
-	HDF5DatasetIdentifier variants_id;
+	HDF5DatasetIdentifier variants_id; // compound variants dataset; opened only if there are no variant columns
+	bool variant_columns; // true if variants are stored in columns (see HVCF::write_variant_columns)
+	HDF5DatasetIdentifier variant_positions_id; // position minus position of previous variant; 0 for first variant of every block
+	HDF5DatasetIdentifier variant_position_anchors_id; // absolute position of first variant of every block
+	hsize_t variant_positions_block; // variants per block (i.e. chunk size of positions)
+	HDF5DatasetIdentifier variant_alleles_id; // 2-bit codes of ref (bits 0-1) and alt (bits 2-3) or HVCF::BLOB_ALLELES flag
+	HDF5DatasetIdentifier variant_allele_ends_id; // end of variant's "ref\0alt\0" in allele bytes blob
+	HDF5DatasetIdentifier variant_allele_bytes_id;
 	HDF5DatasetIdentifier haplotypes_id;
+	bool haplotypes_packed; // true if haplotypes are stored 8 per byte
+	hsize_t haplotypes_chunk_dims[2]; // variants x columns (bytes, if haplotypes are packed); bytes of encoded columns in first dimension, if haplotypes are stored in PBWT order
+	bool haplotypes_pbwt; // true if haplotypes are stored as run-length encoded PBWT columns (see HVCF::write_pbwt_haplotypes)
+	hsize_t haplotypes_pbwt_interval; // variants between PBWT checkpoints
+	HDF5DatasetIdentifier haplotype_ends_id; // end of every variant's encoded column in haplotypes dataset
+	HDF5DatasetIdentifier haplotype_checkpoints_id; // PBWT order of all haplotypes before every haplotypes_pbwt_interval-th variant, one after another
+	vector<unsigned int> haplotypes_pbwt_order; // PBWT order of all haplotypes left by the last read, i.e. before variant haplotypes_pbwt_order_variant
+	hsize_t haplotypes_pbwt_order_variant; // reads starting at or after this variant (and before the next checkpoint) continue decoding from haplotypes_pbwt_order
+	H5Z_filter_t haplotypes_filter; // H5Z_FILTER_NONE, H5Z_FILTER_DEFLATE or FILTER_BLOSC; H5Z_FILTER_ERROR if chunks can't be decompressed outside HDF5
+	HDF5DatasetIdentifier haplotypes_by_sample_id; // optional sample-major copy of haplotypes: same layout and compression, but chunks hold one sample (4, if packed) and many variants
+	hsize_t haplotypes_by_sample_chunk_dims[2];
+	vector<interval_index_entry_type> intervals_index; // whole top-level intervals index, sorted by position
+	list<pair<hsize_t, vector<ull_index_entry_type>>> intervals_index_buckets; // decoded buckets (bucket offset, entries); most recently used first
+	unordered_map<hsize_t, list<pair<hsize_t, vector<ull_index_entry_type>>>::iterator> intervals_index_buckets_lookup; // bucket offset -> entry in intervals_index_buckets
+	unordered_map<string, unique_ptr<ld_store_cache_entry>> ld_stores; // subset -> precomputed LD
 } chromosomes_cache_entry;
 
 typedef struct VariantQueryResult {
@@ -164,6 +273,207 @@ typedef struct SampleHaplotypesQueryResult {
 
 } sample_haplotypes_query_result;
 
+// Columnar query results. Strings are stored once, back to back in a single buffer, and numeric values in contiguous arrays.
+// clear() keeps allocated capacity, so that the same object can be reused across queries without reallocation.
+typedef struct VariantsColumns {
+	vector<char> names; // '\0'-terminated names, back to back
+	vector<size_t> name_offsets; // offset of i-th name in names
+	vector<char> refs;
+	vector<size_t> ref_offsets;
+	vector<char> alts;
+	vector<size_t> alt_offsets;
+	vector<unsigned long long int> positions;
+
+	void clear() {
+		names.clear();
+		name_offsets.clear();
+		refs.clear();
+		ref_offsets.clear();
+		alts.clear();
+		alt_offsets.clear();
+		positions.clear();
+	}
+
+	void add(const char* name, const char* ref, const char* alt, unsigned long long int position) {
+		name_offsets.push_back(names.size());
+		names.insert(names.end(), name, name + strlen(name) + 1u);
+		ref_offsets.push_back(refs.size());
+		refs.insert(refs.end(), ref, ref + strlen(ref) + 1u);
+		alt_offsets.push_back(alts.size());
+		alts.insert(alts.end(), alt, alt + strlen(alt) + 1u);
+		positions.push_back(position);
+	}
+
+	size_t size() const { return positions.size(); }
+	const char* get_name(size_t i) const { return names.data() + name_offsets[i]; }
+	const char* get_ref(size_t i) const { return refs.data() + ref_offsets[i]; }
+	const char* get_alt(size_t i) const { return alts.data() + alt_offsets[i]; }
+	unsigned long long int get_position(size_t i) const { return positions[i]; }
+} variants_columns;
+
+typedef struct FrequencyQueryColumns {
+	variants_columns variants;
+	vector<double> ref_af; // i-th value corresponds to i-th variant
+	vector<double> alt_af;
+	vector<unsigned int> alt_counts;
+	unsigned int n_haplotypes;
+
+	FrequencyQueryColumns() : n_haplotypes(0u) {
+
+	}
+
+	void clear() {
+		variants.clear();
+		ref_af.clear();
+		alt_af.clear();
+		alt_counts.clear();
+		n_haplotypes = 0u;
+	}
+
+	size_t size() const { return variants.size(); }
+} frequency_query_columns;
+
+typedef struct LDQueryColumns {
+	variants_columns variants; // column variants
+	vector<unsigned int> rows; // ordinals (in variants) of row variants: all variants for region queries, lead variant for lead variant queries
+	vector<double> r; // rows.size() x variants.size(), row-major
+	vector<double> rsquare;
+
+	void clear() {
+		variants.clear();
+		rows.clear();
+		r.clear();
+		rsquare.clear();
+	}
+
+	size_t get_n_rows() const { return rows.size(); }
+	size_t get_n_columns() const { return variants.size(); }
+	double get_r(size_t row, size_t column) const { return r[row * variants.size() + column]; }
+	double get_rsquare(size_t row, size_t column) const { return rsquare[row * variants.size() + column]; }
+} ld_query_columns;
+
+// Pruning options for region LD queries. Defaults keep all pairs, i.e. the full symmetric matrix including diagonal.
+typedef struct LDOptions {
+	bool upper_triangle; // keep only pairs (i, j) with i < j
+	double min_rsquare; // keep only pairs with r^2 >= min_rsquare (pairs with undefined r are dropped if min_rsquare > 0)
+	unsigned long long int max_distance; // keep only pairs at most max_distance bp apart
+
+	LDOptions() : upper_triangle(false), min_rsquare(0.0), max_distance(numeric_limits<unsigned long long int>::max()) {
+
+	}
+
+	LDOptions(bool upper_triangle, double min_rsquare, unsigned long long int max_distance) :
+		upper_triangle(upper_triangle), min_rsquare(min_rsquare), max_distance(max_distance) {
+
+	}
+
+	bool keep(double rsquare) const { return (min_rsquare <= 0.0) || (rsquare >= min_rsquare); }
+} ld_options;
+
+typedef struct LDPairsColumns {
+	variants_columns variants; // all variants in region
+	vector<unsigned int> index1; // ordinals (in variants) of the first and second variant in pair; pairs are sorted by (index1, index2)
+	vector<unsigned int> index2;
+	vector<double> r;
+	vector<double> rsquare;
+
+	void clear() {
+		variants.clear();
+		index1.clear();
+		index2.clear();
+		r.clear();
+		rsquare.clear();
+	}
+
+	void add(unsigned int i, unsigned int j, double value) {
+		index1.push_back(i);
+		index2.push_back(j);
+		r.push_back(value);
+		rsquare.push_back(value * value);
+	}
+
+	size_t size() const { return r.size(); }
+} ld_pairs_columns;
+
+// Window rule of batch lead variant LD queries: window of each lead variant is [position - flank, position + flank], clipped to [start_position, end_position].
+typedef struct LDWindow {
+	unsigned long long int flank;
+	unsigned long long int start_position;
+	unsigned long long int end_position;
+
+	LDWindow() : flank(numeric_limits<unsigned long long int>::max()), start_position(0ull), end_position(numeric_limits<unsigned long long int>::max()) {
+
+	}
+
+	LDWindow(unsigned long long int flank) : flank(flank), start_position(0ull), end_position(numeric_limits<unsigned long long int>::max()) {
+
+	}
+
+	LDWindow(unsigned long long int flank, unsigned long long int start_position, unsigned long long int end_position) :
+		flank(flank), start_position(start_position), end_position(end_position) {
+
+	}
+} ld_window;
+
+typedef struct LDBatchColumns {
+	variants_columns variants; // union of lead variants and their windows, in chromosome order
+	vector<unsigned int> leads; // ordinals (in variants) of lead variants found in chromosome
+	vector<unsigned int> requests; // i-th found lead variant is requests[i]-th requested name
+	vector<unsigned int> window_starts; // ordinal (in variants) of the first variant in i-th lead's window
+	vector<size_t> offsets; // leads.size() + 1 entries: r of i-th lead and its window variants are r[offsets[i]], ..., r[offsets[i + 1] - 1]
+	vector<double> r;
+	vector<double> rsquare;
+
+	LDBatchColumns() : offsets(1u, 0u) {
+
+	}
+
+	void clear() {
+		variants.clear();
+		leads.clear();
+		requests.clear();
+		window_starts.clear();
+		offsets.assign(1u, 0u);
+		r.clear();
+		rsquare.clear();
+	}
+
+	size_t get_n_leads() const { return leads.size(); }
+	size_t get_window_size(size_t lead) const { return offsets[lead + 1u] - offsets[lead]; }
+	double get_r(size_t lead, size_t i) const { return r[offsets[lead] + i]; }
+	double get_rsquare(size_t lead, size_t i) const { return rsquare[offsets[lead] + i]; }
+} ld_batch_columns;
+
+// Block of region LD matrix. Valid only during HVCFLDSink::consume() call.
+typedef struct LDTile {
+	unsigned int row_start; // ordinal of the first row variant
+	unsigned int n_rows;
+	unsigned int column_start; // ordinal of the first column variant
+	unsigned int n_columns;
+	const double* r; // n_rows x n_columns, row-major
+
+	double get_r(unsigned int row, unsigned int column) const { return r[row * n_columns + column]; }
+} ld_tile;
+
+typedef struct HaplotypesQueryColumns {
+	variants_columns variants;
+	vector<unsigned char> haplotypes; // variants.size() x n_haplotypes, row-major; haplotypes 2i and 2i + 1 belong to i-th sample in subset
+	unsigned int n_haplotypes;
+
+	HaplotypesQueryColumns() : n_haplotypes(0u) {
+
+	}
+
+	void clear() {
+		variants.clear();
+		haplotypes.clear();
+		n_haplotypes = 0u;
+	}
+
+	size_t size() const { return variants.size(); }
+	unsigned char get_allele(size_t variant, size_t haplotype) const { return haplotypes[variant * n_haplotypes + haplotype]; }
+} haplotypes_query_columns;
+
 }
 
 #endif
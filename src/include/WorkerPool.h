@@ -0,0 +1,63 @@
+#ifndef SRC_INCLUDE_WORKERPOOL_H_
+#define SRC_INCLUDE_WORKERPOOL_H_
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <exception>
+
+using namespace std;
+
+namespace sph_umich_edu {
+
+/*
+ * Fixed set of threads shared by all parallel stages of one reader (decompression of haplotype chunks, LD tiles, LD store rows), so that
+ * queries don't start threads. Threads are started on first use and live until pool is destroyed.
+ * Work is submitted as batch of copies of one function (copies usually take items from shared counter). Caller waits for its batch and, while
+ * waiting, runs copies which no pool thread has taken yet: batch always completes, even if all pool threads are busy (e.g. nested batches).
+ */
+class WorkerPool {
+private:
+	typedef struct {
+		function<void()> work;
+		unsigned int n_queued; // copies not taken by any thread yet
+		unsigned int n_running;
+		exception_ptr error; // first exception thrown by any copy
+	} batch_entry;
+
+	unsigned int n_threads;
+	vector<thread> threads;
+	list<shared_ptr<batch_entry>> batches; // batches with queued copies, oldest first
+	bool stopping;
+
+	mutex pool_mutex;
+	condition_variable queued_condition;
+	condition_variable finished_condition;
+
+	void run_copy(unique_lock<mutex>& pool_lock, const shared_ptr<batch_entry>& batch);
+	void work();
+
+public:
+	typedef shared_ptr<batch_entry> batch;
+
+	WorkerPool(unsigned int n_threads);
+	virtual ~WorkerPool();
+
+	WorkerPool(const WorkerPool& pool) = delete;
+	WorkerPool& operator=(const WorkerPool& pool) = delete;
+
+	// Queues n_copies copies of work for pool threads.
+	batch submit(unsigned int n_copies, const function<void()>& work);
+	// Runs copies of batch still queued on calling thread, waits for the rest and rethrows the first exception thrown by any copy.
+	void wait(const batch& submitted);
+
+	unsigned int get_n_threads() const;
+};
+
+}
+
+#endif
@@ -4,6 +4,10 @@
 #include <iostream>
 #include <memory>
 #include <tuple>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstring>
 
 #include "../../../auxc/MiniVCF/src/include/VCFReader.h"
 #include "HVCFWriteException.h"
@@ -15,28 +19,55 @@ namespace sph_umich_edu {
 
 class WriteBuffer {
 private:
+	// Bump-pointer arena for variant strings (name, ref, alt). Strings are placed back to back into large blocks,
+	// which are kept on reset(), so that refilling the buffer doesn't allocate once blocks are warmed up.
+	class StringArena {
+	private:
+		static constexpr size_t BLOCK_SIZE = 1024u * 1024u;
+
+		vector<pair<unique_ptr<char[]>, size_t>> blocks; // block, capacity
+		size_t block; // current block
+		size_t used; // bytes used in current block
+
+	public:
+		StringArena();
+
+		char* allocate(size_t size);
+		void reset();
+	};
+
 	unsigned int max_variants;
 	unsigned int n_samples;
 	unsigned int n_haplotypes;
+	bool packed; // if true, then haplotypes are packed 8 per byte (bit i % 8 of byte i / 8 holds haplotype i)
+	unsigned int n_columns; // number of bytes per variant
+	vector<hsize_t> columns; // position of i-th VCF sample along haplotypes axis, if samples are stored in another order; empty -- VCF order
 
 	unique_ptr<unsigned char[]> haplotypes;
 	unique_ptr<variants_entry_type[]> variants;
+	unique_ptr<unsigned int[]> alt_counts; // number of alternate alleles across all haplotypes
+	StringArena strings; // name, ref and alt of variants
 	unsigned int n_variants;
 
 	unique_ptr<unsigned char[]> flushed_haplotypes;
 	unique_ptr<variants_entry_type[]> flushed_variants;
+	unique_ptr<unsigned int[]> flushed_alt_counts;
+	StringArena flushed_strings;
 	unsigned int n_flushed_variants;
 
 public:
-	WriteBuffer(unsigned int max_variants, unsigned int n_samples);
+	WriteBuffer(unsigned int max_variants, unsigned int n_samples, bool packed);
+	WriteBuffer(unsigned int max_variants, unsigned int n_samples, bool packed, const vector<hsize_t>& columns);
 	virtual ~WriteBuffer();
 
 	void add_variant(const Variant& variant) throw (HVCFWriteException);
-	tuple<const unsigned char*, const variants_entry_type*, unsigned int, unsigned int> flush();
+	tuple<const unsigned char*, const variants_entry_type*, unsigned int, unsigned int, const unsigned int*> flush();
 
 	unsigned int get_max_variants() const;
 	unsigned int get_n_samples() const;
 	unsigned int get_n_variants() const;
+	unsigned int get_n_columns() const;
+	bool is_packed() const;
 	bool is_full() const;
 	bool is_empty() const;
 };
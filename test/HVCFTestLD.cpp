@@ -594,6 +594,220 @@ TEST_F(HVCFTestLD, LD_EUR_SUBSET) {
 	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
 }
 
+TEST_F(HVCFTestLD, LD_EUR_SUBSET_BIT_PACKED) {
+	std::chrono::time_point<std::chrono::system_clock> start, end;
+	std::chrono::duration<double> elapsed_seconds;
+	sph_umich_edu::HVCFConfiguration configuration;
+	configuration.haplotypes_storage = sph_umich_edu::HVCFConfiguration::BIT_HAPLOTYPES_STORAGE;
+	sph_umich_edu::HVCF hvcf(configuration);
+	sph_umich_edu::HVCF hvcf_bytes;
+	vector<sph_umich_edu::ld_query_result> result;
+	vector<sph_umich_edu::frequency_query_result> frequencies;
+	vector<sph_umich_edu::frequency_query_result> frequencies_bytes;
+	vector<sph_umich_edu::variant_haplotypes_query_result> variant_haplotypes;
+	vector<sph_umich_edu::variant_haplotypes_query_result> variant_haplotypes_bytes;
+	vector<sph_umich_edu::sample_haplotypes_query_result> sample_haplotypes;
+	vector<sph_umich_edu::sample_haplotypes_query_result> sample_haplotypes_bytes;
+
+	// BEGIN: create test HVCF files (bit-packed and one allele per byte).
+	ASSERT_EQ(0u, hvcf.get_n_opened_objects());
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+
+	hvcf.create("test_ld_packed.h5");
+	hvcf.import_vcf("1000G_phase3.ALL.chr20.LD_test.vcf.gz");
+	hvcf_bytes.create("test_ld.h5");
+	hvcf_bytes.import_vcf("1000G_phase3.ALL.chr20.LD_test.vcf.gz");
+
+	for (auto&& population : populations) {
+		hvcf.create_sample_subset(population.first, population.second);
+		hvcf_bytes.create_sample_subset(population.first, population.second);
+		ASSERT_EQ(13u, hvcf.get_n_opened_objects());
+	}
+
+	ASSERT_EQ(2504u, hvcf.get_n_samples());
+	ASSERT_EQ(13u, hvcf.get_n_opened_objects());
+
+	hvcf.close();
+	hvcf_bytes.close();
+	ASSERT_EQ(0u, hvcf.get_n_opened_objects());
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+	// END: create test HVCF files.
+
+	hvcf.open("test_ld_packed.h5");
+	hvcf_bytes.open("test_ld.h5");
+	ASSERT_EQ(13u, hvcf.get_n_opened_objects());
+
+	start = std::chrono::system_clock::now();
+	result.clear();
+	hvcf.compute_ld("EUR", "20", 11650214ul, 60759931ul, result);
+	end = std::chrono::system_clock::now();
+	elapsed_seconds = end - start;
+	GTEST_LOG_(INFO) << "Elapsed time = " << elapsed_seconds.count() << " sec";
+	ASSERT_EQ(81u, result.size());
+	for (auto&& pair : result) {
+		if (std::isnan(precomputed_eur_ld.at(pair.position1).at(pair.position2))) {
+			ASSERT_TRUE(pair.rsquare);
+		} else {
+			ASSERT_NEAR(pair.rsquare, precomputed_eur_ld.at(pair.position1).at(pair.position2), 0.00000001);
+		}
+	}
+	ASSERT_EQ(13u, hvcf.get_n_opened_objects());
+
+	result.clear();
+	start = std::chrono::system_clock::now();
+	hvcf.compute_ld("EUR", "20", "20:46211051_A/G", 100ul, 16600000ul, result);
+	end = std::chrono::system_clock::now();
+	elapsed_seconds = end - start;
+	GTEST_LOG_(INFO) << "Elapsed time = " << elapsed_seconds.count() << " sec";
+	ASSERT_EQ(2u, result.size());
+	for (auto&& pair : result) {
+		if (std::isnan(precomputed_eur_ld.at(pair.position1).at(pair.position2))) {
+			ASSERT_TRUE(pair.rsquare);
+		} else {
+			ASSERT_NEAR(pair.rsquare, precomputed_eur_ld.at(pair.position1).at(pair.position2), 0.00000001);
+		}
+	}
+	ASSERT_EQ(13u, hvcf.get_n_opened_objects());
+
+	result.clear();
+	start = std::chrono::system_clock::now();
+	hvcf.compute_ld("ALL", "20", "20:46211051_A/G", 14403183ul, 55378791ul, result);
+	end = std::chrono::system_clock::now();
+	elapsed_seconds = end - start;
+	GTEST_LOG_(INFO) << "Elapsed time = " << elapsed_seconds.count() << " sec";
+	ASSERT_EQ(6u, result.size());
+	for (auto&& pair : result) {
+		if (std::isnan(precomputed_all_ld.at(pair.position1).at(pair.position2))) {
+			ASSERT_TRUE(pair.rsquare);
+		} else {
+			ASSERT_NEAR(pair.rsquare, precomputed_all_ld.at(pair.position1).at(pair.position2), 0.00000001);
+		}
+	}
+	ASSERT_EQ(13u, hvcf.get_n_opened_objects());
+
+	for (auto&& population : populations) {
+		frequencies.clear();
+		frequencies_bytes.clear();
+		hvcf.compute_frequencies(population.first, "20", 11650214ul, 60759931ul, frequencies);
+		hvcf_bytes.compute_frequencies(population.first, "20", 11650214ul, 60759931ul, frequencies_bytes);
+		ASSERT_EQ(frequencies_bytes.size(), frequencies.size());
+		for (unsigned int i = 0u; i < frequencies.size(); ++i) {
+			ASSERT_EQ(frequencies_bytes[i].position, frequencies[i].position);
+			ASSERT_DOUBLE_EQ(frequencies_bytes[i].alt_af, frequencies[i].alt_af);
+		}
+
+		variant_haplotypes.clear();
+		variant_haplotypes_bytes.clear();
+		hvcf.extract_haplotypes(population.first, "20", "20:46211051_A/G", variant_haplotypes);
+		hvcf_bytes.extract_haplotypes(population.first, "20", "20:46211051_A/G", variant_haplotypes_bytes);
+		ASSERT_EQ(population.second.size(), variant_haplotypes.size());
+		ASSERT_EQ(variant_haplotypes_bytes.size(), variant_haplotypes.size());
+		for (unsigned int i = 0u; i < variant_haplotypes.size(); ++i) {
+			ASSERT_EQ(variant_haplotypes_bytes[i].sample, variant_haplotypes[i].sample);
+			ASSERT_EQ(variant_haplotypes_bytes[i].allele1, variant_haplotypes[i].allele1);
+			ASSERT_EQ(variant_haplotypes_bytes[i].allele2, variant_haplotypes[i].allele2);
+		}
+
+		sample_haplotypes.clear();
+		sample_haplotypes_bytes.clear();
+		hvcf.extract_haplotypes(population.second.back(), "20", 11650214ul, 60759931ul, sample_haplotypes);
+		hvcf_bytes.extract_haplotypes(population.second.back(), "20", 11650214ul, 60759931ul, sample_haplotypes_bytes);
+		ASSERT_EQ(sample_haplotypes_bytes.size(), sample_haplotypes.size());
+		for (unsigned int i = 0u; i < sample_haplotypes.size(); ++i) {
+			ASSERT_EQ(sample_haplotypes_bytes[i].position, sample_haplotypes[i].position);
+			ASSERT_EQ(sample_haplotypes_bytes[i].allele1, sample_haplotypes[i].allele1);
+			ASSERT_EQ(sample_haplotypes_bytes[i].allele2, sample_haplotypes[i].allele2);
+		}
+	}
+	ASSERT_EQ(13u, hvcf.get_n_opened_objects());
+
+	hvcf.close();
+	hvcf_bytes.close();
+	ASSERT_EQ(0u, hvcf.get_n_opened_objects());
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestLD, LD_EUR_SUBSET_POPCOUNT) {
+	sph_umich_edu::HVCFConfiguration dense_configuration;
+	dense_configuration.ld_engine = sph_umich_edu::HVCFConfiguration::DENSE_LD_ENGINE;
+	sph_umich_edu::HVCFConfiguration popcount_configuration;
+	popcount_configuration.ld_engine = sph_umich_edu::HVCFConfiguration::POPCOUNT_LD_ENGINE;
+	sph_umich_edu::HVCF hvcf_dense(dense_configuration);
+	sph_umich_edu::HVCF hvcf_popcount(popcount_configuration);
+	vector<sph_umich_edu::ld_query_result> result_dense;
+	vector<sph_umich_edu::ld_query_result> result_popcount;
+
+	GTEST_LOG_(INFO) << "Popcount implementation = " << sph_umich_edu::PopcountLD::get_implementation();
+
+	// BEGIN: check all popcount implementations agree with portable one.
+	uint64_t a[13];
+	uint64_t b[13];
+	for (unsigned int i = 0u; i < 13u; ++i) {
+		a[i] = 0x9e3779b97f4a7c15ull * (i + 1u);
+		b[i] = 0xc2b2ae3d27d4eb4full * (i + 7u);
+	}
+	for (unsigned int n = 0u; n <= 13u; ++n) {
+		ASSERT_EQ(sph_umich_edu::PopcountLD::and_popcount_scalar(a, b, n), sph_umich_edu::PopcountLD::and_popcount(a, b, n));
+	}
+	// END: check all popcount implementations.
+
+	// BEGIN: create test HVCF file.
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+
+	hvcf_dense.create("test_ld.h5");
+	hvcf_dense.import_vcf("1000G_phase3.ALL.chr20.LD_test.vcf.gz");
+
+	for (auto&& population : populations) {
+		hvcf_dense.create_sample_subset(population.first, population.second);
+	}
+
+	hvcf_dense.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+	// END: create test HVCF file.
+
+	hvcf_dense.open("test_ld.h5");
+	hvcf_popcount.open("test_ld.h5");
+
+	for (auto&& population : populations) {
+		result_dense.clear();
+		result_popcount.clear();
+		hvcf_dense.compute_ld(population.first, "20", 11650214ul, 60759931ul, result_dense);
+		hvcf_popcount.compute_ld(population.first, "20", 11650214ul, 60759931ul, result_popcount);
+		ASSERT_EQ(81u, result_popcount.size());
+		ASSERT_EQ(result_dense.size(), result_popcount.size());
+		for (unsigned int i = 0u; i < result_popcount.size(); ++i) {
+			ASSERT_EQ(result_dense[i].position1, result_popcount[i].position1);
+			ASSERT_EQ(result_dense[i].position2, result_popcount[i].position2);
+			if (std::isnan(result_dense[i].r)) {
+				ASSERT_TRUE(std::isnan(result_popcount[i].r));
+			} else {
+				ASSERT_DOUBLE_EQ(result_dense[i].r, result_popcount[i].r);
+				ASSERT_DOUBLE_EQ(result_dense[i].rsquare, result_popcount[i].rsquare);
+			}
+		}
+
+		result_dense.clear();
+		result_popcount.clear();
+		hvcf_dense.compute_ld(population.first, "20", "20:46211051_A/G", 100ul, 166000000ul, result_dense);
+		hvcf_popcount.compute_ld(population.first, "20", "20:46211051_A/G", 100ul, 166000000ul, result_popcount);
+		ASSERT_EQ(8u, result_popcount.size());
+		ASSERT_EQ(result_dense.size(), result_popcount.size());
+		for (unsigned int i = 0u; i < result_popcount.size(); ++i) {
+			ASSERT_EQ(result_dense[i].position2, result_popcount[i].position2);
+			if (std::isnan(result_dense[i].r)) {
+				ASSERT_TRUE(std::isnan(result_popcount[i].r));
+			} else {
+				ASSERT_DOUBLE_EQ(result_dense[i].r, result_popcount[i].r);
+				ASSERT_DOUBLE_EQ(result_dense[i].rsquare, result_popcount[i].rsquare);
+			}
+		}
+	}
+
+	hvcf_dense.close();
+	hvcf_popcount.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
 TEST_F(HVCFTestLD, LD_ALL) {
 	std::chrono::time_point<std::chrono::system_clock> start, end;
 	std::chrono::duration<double> elapsed_seconds;
@@ -847,7 +1061,7 @@ TEST_F(HVCFTestLD, LargeVCF_EUR_CHR20) {
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:61955_C/T", 61955ul, 167900ul, result);
+	hvcf.compute_ld("ALL", "20", "20:61955_C/T", 61955ul, 167900ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "1000 variants vs 1 LD = " << elapsed_seconds.count() << " sec";
@@ -865,7 +1079,7 @@ TEST_F(HVCFTestLD, LargeVCF_EUR_CHR20) {
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:3514537_T/C", 3322215ul, 4397713ul, result);
+	hvcf.compute_ld("ALL", "20", "20:3514537_T/C", 3322215ul, 4397713ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "10000 variants vs 1 LD = " << elapsed_seconds.count() << " sec";
@@ -874,7 +1088,7 @@ TEST_F(HVCFTestLD, LargeVCF_EUR_CHR20) {
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:3514537_T/C", 3322215ul, 14879114ul, result);
+	hvcf.compute_ld("ALL", "20", "20:3514537_T/C", 3322215ul, 14879114ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "100000 variants vs 1 LD = " << elapsed_seconds.count() << " sec";
@@ -911,7 +1125,7 @@ TEST_F(HVCFTestLD, LargeVCF_ALL_CHR20) {
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:61955_C/T", 61955ul, 99420ul, result);
+	hvcf.compute_ld("ALL", "20", "20:61955_C/T", 61955ul, 99420ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "1000 variants vs 1 LD = " << elapsed_seconds.count() << " sec";
@@ -929,7 +1143,7 @@ TEST_F(HVCFTestLD, LargeVCF_ALL_CHR20) {
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:16931873_G/T", 16931873ul, 17250467ul, result);
+	hvcf.compute_ld("ALL", "20", "20:16931873_G/T", 16931873ul, 17250467ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "10000 variants vs 1 LD = " << elapsed_seconds.count() << " sec";
@@ -938,7 +1152,7 @@ TEST_F(HVCFTestLD, LargeVCF_ALL_CHR20) {
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:16931873_G/T", 16931873ul, 20238526ul, result);
+	hvcf.compute_ld("ALL", "20", "20:16931873_G/T", 16931873ul, 20238526ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "100000 variants vs 1 LD = " << elapsed_seconds.count() << " sec";
@@ -948,14 +1162,14 @@ TEST_F(HVCFTestLD, LargeVCF_ALL_CHR20) {
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:3004947_C/A", 2610510ul, 3110510ul, result);
+	hvcf.compute_ld("ALL", "20", "20:3004947_C/A", 2610510ul, 3110510ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "One-to-many LD = " << elapsed_seconds.count() << " sec";
 
 	result.clear();
 	start = std::chrono::system_clock::now();
-	hvcf.compute_ld_test("ALL", "20", "20:61689460_C/T", 61591969ul, 62091969ul, result);
+	hvcf.compute_ld("ALL", "20", "20:61689460_C/T", 61591969ul, 62091969ul, result);
 	end = std::chrono::system_clock::now();
 	elapsed_seconds = end - start;
 	GTEST_LOG_(INFO) << "One-to-many LD = " << elapsed_seconds.count() << " sec";
@@ -965,3 +1179,456 @@ TEST_F(HVCFTestLD, LargeVCF_ALL_CHR20) {
 	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
 }
 
+
+TEST_F(HVCFTestLD, LD_EUR_COLUMNAR) {
+	sph_umich_edu::HVCF hvcf;
+	vector<sph_umich_edu::ld_query_result> result;
+	sph_umich_edu::ld_query_columns columns;
+
+	hvcf.create("test_ld.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.LD_test.vcf.gz");
+	hvcf.close();
+
+	hvcf.open("test_ld.h5");
+
+	// same columns object is reused across queries
+	for (unsigned int pass = 0u; pass < 2u; ++pass) {
+		result.clear();
+		hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, result);
+		hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, columns);
+		ASSERT_EQ(9u, columns.get_n_rows());
+		ASSERT_EQ(9u, columns.get_n_columns());
+		ASSERT_EQ(result.size(), columns.r.size());
+		for (unsigned int i = 0u; i < columns.get_n_rows(); ++i) {
+			for (unsigned int j = 0u; j < columns.get_n_columns(); ++j) {
+				const sph_umich_edu::ld_query_result& pair = result[i * columns.get_n_columns() + j];
+				ASSERT_EQ(pair.name1, columns.variants.get_name(columns.rows[i]));
+				ASSERT_EQ(pair.position2, columns.variants.get_position(j));
+				if (std::isnan(pair.r)) {
+					ASSERT_TRUE(std::isnan(columns.get_r(i, j)));
+				} else {
+					ASSERT_DOUBLE_EQ(pair.r, columns.get_r(i, j));
+					ASSERT_DOUBLE_EQ(pair.rsquare, columns.get_rsquare(i, j));
+				}
+			}
+		}
+
+		result.clear();
+		hvcf.compute_ld("ALL", "20", "20:46211051_A/G", 100ul, 166000000ul, result);
+		hvcf.compute_ld("ALL", "20", "20:46211051_A/G", 100ul, 166000000ul, columns);
+		ASSERT_EQ(1u, columns.get_n_rows());
+		ASSERT_EQ(result.size() + 1u, columns.get_n_columns());
+		ASSERT_STREQ("20:46211051_A/G", columns.variants.get_name(columns.rows[0]));
+		for (unsigned int i = 0u, j = 0u; j < columns.get_n_columns(); ++j) {
+			if (j == columns.rows[0]) {
+				continue;
+			}
+			ASSERT_EQ(result[i].name2, columns.variants.get_name(j));
+			if (!std::isnan(result[i].r)) {
+				ASSERT_DOUBLE_EQ(result[i].r, columns.get_r(0, j));
+			}
+			++i;
+		}
+
+		hvcf.compute_ld("ALL", "20", 160759931ul, 260759931ul, columns);
+		ASSERT_EQ(0u, columns.get_n_columns());
+		ASSERT_EQ(0u, columns.r.size());
+	}
+
+	hvcf.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestLD, LD_EUR_PRUNED) {
+	sph_umich_edu::HVCFConfiguration dense_configuration;
+	dense_configuration.ld_engine = sph_umich_edu::HVCFConfiguration::DENSE_LD_ENGINE;
+	sph_umich_edu::HVCFConfiguration popcount_configuration;
+	popcount_configuration.ld_engine = sph_umich_edu::HVCFConfiguration::POPCOUNT_LD_ENGINE;
+	sph_umich_edu::HVCF hvcf_dense(dense_configuration);
+	sph_umich_edu::HVCF hvcf_popcount(popcount_configuration);
+	vector<sph_umich_edu::ld_query_result> full;
+	vector<sph_umich_edu::ld_query_result> result;
+	sph_umich_edu::ld_pairs_columns columns;
+
+	hvcf_dense.create("test_ld.h5");
+	hvcf_dense.import_vcf("1000G_phase3.EUR.chr20.LD_test.vcf.gz");
+	hvcf_dense.close();
+
+	hvcf_dense.open("test_ld.h5");
+	hvcf_popcount.open("test_ld.h5");
+
+	hvcf_dense.compute_ld("ALL", "20", 11650214ul, 60759931ul, full);
+	ASSERT_EQ(81u, full.size());
+
+	// default options return full matrix
+	hvcf_popcount.compute_ld("ALL", "20", 11650214ul, 60759931ul, sph_umich_edu::ld_options(), result);
+	ASSERT_EQ(full.size(), result.size());
+	for (unsigned int i = 0u; i < full.size(); ++i) {
+		ASSERT_EQ(full[i].name1, result[i].name1);
+		ASSERT_EQ(full[i].name2, result[i].name2);
+	}
+
+	vector<sph_umich_edu::ld_options> all_options{
+		sph_umich_edu::ld_options(true, 0.0, numeric_limits<unsigned long long int>::max()),
+		sph_umich_edu::ld_options(false, 0.2, numeric_limits<unsigned long long int>::max()),
+		sph_umich_edu::ld_options(true, 0.2, numeric_limits<unsigned long long int>::max()),
+		sph_umich_edu::ld_options(true, 0.0, 10000000ul),
+		sph_umich_edu::ld_options(false, 0.05, 20000000ul)
+	};
+
+	for (auto&& options : all_options) {
+		// expected pairs, in the same order as in full matrix
+		vector<sph_umich_edu::ld_query_result> expected;
+		for (unsigned int k = 0u; k < full.size(); ++k) {
+			const sph_umich_edu::ld_query_result& pair = full[k];
+			if (options.upper_triangle && (k / 9u >= k % 9u)) {
+				continue;
+			}
+			if (max(pair.position1, pair.position2) - min(pair.position1, pair.position2) > options.max_distance) {
+				continue;
+			}
+			if ((options.min_rsquare > 0.0) && !(pair.rsquare >= options.min_rsquare)) {
+				continue;
+			}
+			expected.push_back(pair);
+		}
+
+		for (auto hvcf : { &hvcf_dense, &hvcf_popcount }) {
+			hvcf->compute_ld("ALL", "20", 11650214ul, 60759931ul, options, columns);
+			ASSERT_EQ(9u, columns.variants.size());
+			ASSERT_EQ(expected.size(), columns.size());
+			for (unsigned int i = 0u; i < expected.size(); ++i) {
+				ASSERT_EQ(expected[i].name1, columns.variants.get_name(columns.index1[i]));
+				ASSERT_EQ(expected[i].name2, columns.variants.get_name(columns.index2[i]));
+				if (std::isnan(expected[i].r)) {
+					ASSERT_TRUE(std::isnan(columns.r[i]));
+				} else {
+					ASSERT_NEAR(expected[i].r, columns.r[i], 0.000000001);
+					ASSERT_NEAR(expected[i].rsquare, columns.rsquare[i], 0.000000001);
+				}
+			}
+
+			result.clear();
+			hvcf->compute_ld("ALL", "20", 11650214ul, 60759931ul, options, result);
+			ASSERT_EQ(expected.size(), result.size());
+		}
+	}
+
+	hvcf_dense.compute_ld("ALL", "20", 160759931ul, 260759931ul, sph_umich_edu::ld_options(true, 0.2, 1000ul), columns);
+	ASSERT_EQ(0u, columns.size());
+
+	hvcf_dense.close();
+	hvcf_popcount.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestLD, LD_EUR_TILED) {
+	class CollectingSink : public sph_umich_edu::HVCFLDSink {
+	public:
+		unsigned int n_variants;
+		vector<double> r;
+		vector<unsigned int> visits;
+		unsigned int n_tiles;
+		unsigned int fail_after;
+
+		CollectingSink(unsigned int fail_after = numeric_limits<unsigned int>::max()) : n_variants(0u), n_tiles(0u), fail_after(fail_after) {}
+
+		void begin(const sph_umich_edu::variants_columns& variants) {
+			n_variants = variants.size();
+			r.assign(n_variants * n_variants, 0.0);
+			visits.assign(n_variants * n_variants, 0u);
+		}
+
+		void consume(const sph_umich_edu::ld_tile& tile) {
+			if (n_tiles++ >= fail_after) {
+				throw runtime_error("sink failed");
+			}
+			ASSERT_LE(tile.row_start, tile.column_start);
+			for (unsigned int i = 0u; i < tile.n_rows; ++i) {
+				for (unsigned int j = 0u; j < tile.n_columns; ++j) {
+					r[(tile.row_start + i) * n_variants + tile.column_start + j] = tile.get_r(i, j);
+					r[(tile.column_start + j) * n_variants + tile.row_start + i] = tile.get_r(i, j);
+					visits[(tile.row_start + i) * n_variants + tile.column_start + j] += 1u;
+				}
+			}
+		}
+	};
+
+	sph_umich_edu::HVCFConfiguration dense_configuration;
+	dense_configuration.ld_engine = sph_umich_edu::HVCFConfiguration::DENSE_LD_ENGINE;
+	sph_umich_edu::HVCF hvcf_dense(dense_configuration);
+	vector<sph_umich_edu::ld_query_result> expected;
+
+	hvcf_dense.create("test_ld.h5");
+	hvcf_dense.import_vcf("1000G_phase3.EUR.chr20.LD_test.vcf.gz");
+	hvcf_dense.close();
+
+	hvcf_dense.open("test_ld.h5");
+	hvcf_dense.compute_ld("ALL", "20", 11650214ul, 60759931ul, expected);
+	ASSERT_EQ(81u, expected.size());
+
+	for (unsigned int tile_size : { 1u, 2u, 4u, 9u, 16u }) {
+		for (unsigned int n_threads : { 1u, 3u }) {
+			sph_umich_edu::HVCFConfiguration configuration;
+			configuration.ld_tile_size = tile_size;
+			configuration.ld_threads = n_threads;
+			sph_umich_edu::HVCF hvcf(configuration);
+			CollectingSink sink;
+
+			hvcf.open("test_ld.h5");
+			hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, sink);
+			ASSERT_EQ(9u, sink.n_variants);
+			unsigned int n_blocks = (9u + tile_size - 1u) / tile_size;
+			ASSERT_EQ(n_blocks * (n_blocks + 1u) / 2u, sink.n_tiles);
+			for (unsigned int i = 0u; i < 9u; ++i) {
+				for (unsigned int j = 0u; j < 9u; ++j) {
+					ASSERT_EQ(i / tile_size <= j / tile_size ? 1u : 0u, sink.visits[i * 9u + j]);
+					if (std::isnan(expected[i * 9u + j].r)) {
+						ASSERT_TRUE(std::isnan(sink.r[i * 9u + j]));
+					} else {
+						ASSERT_NEAR(expected[i * 9u + j].r, sink.r[i * 9u + j], 0.000000001);
+					}
+				}
+			}
+
+			// popcount engine assembles region matrix from tiles
+			vector<sph_umich_edu::ld_query_result> result;
+			hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, result);
+			ASSERT_EQ(expected.size(), result.size());
+			for (unsigned int i = 0u; i < expected.size(); ++i) {
+				ASSERT_EQ(expected[i].name1, result[i].name1);
+				ASSERT_EQ(expected[i].name2, result[i].name2);
+			}
+
+			CollectingSink empty_sink;
+			hvcf.compute_ld("ALL", "20", 160759931ul, 260759931ul, empty_sink);
+			ASSERT_EQ(0u, empty_sink.n_variants);
+			ASSERT_EQ(0u, empty_sink.n_tiles);
+
+			CollectingSink failing_sink(0u);
+			ASSERT_THROW(hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, failing_sink), sph_umich_edu::HVCFReadException);
+
+			hvcf.close();
+		}
+	}
+
+	hvcf_dense.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestLD, LD_EUR_BATCH) {
+	sph_umich_edu::HVCFConfiguration dense_configuration;
+	dense_configuration.ld_engine = sph_umich_edu::HVCFConfiguration::DENSE_LD_ENGINE;
+	sph_umich_edu::HVCFConfiguration popcount_configuration;
+	popcount_configuration.ld_engine = sph_umich_edu::HVCFConfiguration::POPCOUNT_LD_ENGINE;
+	sph_umich_edu::HVCF hvcf_dense(dense_configuration);
+	sph_umich_edu::HVCF hvcf_popcount(popcount_configuration);
+	sph_umich_edu::variants_columns variants;
+
+	hvcf_dense.create("test_ld.h5");
+	hvcf_dense.import_vcf("1000G_phase3.EUR.chr20.LD_test.vcf.gz");
+	hvcf_dense.close();
+
+	hvcf_dense.open("test_ld.h5");
+	hvcf_popcount.open("test_ld.h5");
+
+	hvcf_dense.extract_variants("20", 11650214ul, 60759931ul, variants);
+	ASSERT_EQ(9u, variants.size());
+
+	// leads in arbitrary order, with duplicates and names not in file
+	vector<string> leads{ variants.get_name(4), "20:1_A/C", variants.get_name(0), variants.get_name(8), variants.get_name(4) };
+
+	vector<sph_umich_edu::ld_window> windows{
+		sph_umich_edu::ld_window(),
+		sph_umich_edu::ld_window(5000000ul),
+		sph_umich_edu::ld_window(20000000ul, 20000000ul, 50000000ul),
+		sph_umich_edu::ld_window(0ul)
+	};
+
+	for (auto&& window : windows) {
+		for (auto hvcf : { &hvcf_dense, &hvcf_popcount }) {
+			sph_umich_edu::ld_batch_columns batch;
+			hvcf->compute_ld("ALL", "20", leads, window, batch);
+			ASSERT_EQ(4u, batch.get_n_leads());
+			ASSERT_EQ(vector<unsigned int>({ 0u, 2u, 3u, 4u }), batch.requests);
+			ASSERT_EQ(batch.get_n_leads() + 1u, batch.offsets.size());
+			ASSERT_EQ(batch.offsets.back(), batch.r.size());
+
+			for (unsigned int i = 0u; i < batch.get_n_leads(); ++i) {
+				const string& lead = leads[batch.requests[i]];
+				ASSERT_EQ(lead, batch.variants.get_name(batch.leads[i]));
+
+				unsigned long long int lead_position = batch.variants.get_position(batch.leads[i]);
+				unsigned long long int start = std::max(window.start_position, lead_position > window.flank ? lead_position - window.flank : 0ul);
+				unsigned long long int end = std::min(window.end_position, numeric_limits<unsigned long long int>::max() - window.flank > lead_position ? lead_position + window.flank : numeric_limits<unsigned long long int>::max());
+
+				// same as single lead variant query over the window
+				sph_umich_edu::ld_query_columns single;
+				hvcf->compute_ld("ALL", "20", lead, start, end, single);
+
+				unsigned int n_expected = 0u;
+				for (unsigned int j = 0u; j < variants.size(); ++j) {
+					if ((variants.get_position(j) >= start) && (variants.get_position(j) <= end)) {
+						++n_expected;
+					}
+				}
+				ASSERT_EQ(n_expected, batch.get_window_size(i));
+
+				for (unsigned int j = 0u; j < batch.get_window_size(i); ++j) {
+					const char* name = batch.variants.get_name(batch.window_starts[i] + j);
+					ASSERT_GE(batch.variants.get_position(batch.window_starts[i] + j), start);
+					ASSERT_LE(batch.variants.get_position(batch.window_starts[i] + j), end);
+					for (unsigned int k = 0u; k < single.get_n_columns(); ++k) {
+						if (strcmp(name, single.variants.get_name(k)) == 0) {
+							if (std::isnan(single.get_r(0, k))) {
+								ASSERT_TRUE(std::isnan(batch.get_r(i, j)));
+							} else {
+								ASSERT_NEAR(single.get_r(0, k), batch.get_r(i, j), 0.000000001);
+							}
+						}
+					}
+				}
+			}
+
+			vector<sph_umich_edu::ld_query_result> pairs;
+			hvcf->compute_ld("ALL", "20", leads, window, pairs);
+			unsigned int n_pairs = 0u;
+			for (unsigned int i = 0u; i < batch.get_n_leads(); ++i) {
+				bool lead_in_window = (batch.leads[i] >= batch.window_starts[i]) && (batch.leads[i] < batch.window_starts[i] + batch.get_window_size(i));
+				n_pairs += batch.get_window_size(i) - (lead_in_window ? 1u : 0u);
+			}
+			ASSERT_EQ(n_pairs, pairs.size());
+		}
+	}
+
+	sph_umich_edu::ld_batch_columns batch;
+	hvcf_dense.compute_ld("ALL", "20", vector<string>{ "20:1_A/C" }, sph_umich_edu::ld_window(), batch);
+	ASSERT_EQ(0u, batch.get_n_leads());
+	ASSERT_EQ(0u, batch.variants.size());
+
+	hvcf_dense.close();
+	hvcf_popcount.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestLD, LD_EUR_STORE) {
+	sph_umich_edu::HVCF hvcf;
+	sph_umich_edu::HVCF hvcf_store;
+	sph_umich_edu::variants_columns variants;
+	sph_umich_edu::ld_pairs_columns expected_pairs;
+	sph_umich_edu::ld_pairs_columns pairs;
+	sph_umich_edu::ld_query_columns expected_lead;
+	sph_umich_edu::ld_query_columns lead;
+
+	hvcf.create("test_ld.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.LD_test.vcf.gz");
+	hvcf.close();
+
+	hvcf_store.create("test_ld_store.h5");
+	hvcf_store.import_vcf("1000G_phase3.EUR.chr20.LD_test.vcf.gz");
+	ASSERT_THROW(hvcf_store.create_ld_store("NOT_A_SUBSET", 20000000ul, 0.0), sph_umich_edu::HVCFWriteException);
+	hvcf_store.create_ld_store("ALL", 20000000ul, 0.0);
+	hvcf_store.close();
+
+	hvcf.open("test_ld.h5");
+	hvcf_store.open("test_ld_store.h5");
+
+	hvcf.extract_variants("20", 11650214ul, 60759931ul, variants);
+	ASSERT_EQ(9u, variants.size());
+
+	auto assert_same_pairs = [&]() {
+		ASSERT_EQ(expected_pairs.size(), pairs.size());
+		for (unsigned int k = 0u; k < expected_pairs.size(); ++k) {
+			ASSERT_EQ(expected_pairs.index1[k], pairs.index1[k]);
+			ASSERT_EQ(expected_pairs.index2[k], pairs.index2[k]);
+			if (std::isnan(expected_pairs.r[k])) {
+				ASSERT_TRUE(std::isnan(pairs.r[k]));
+			} else {
+				ASSERT_EQ(expected_pairs.r[k], pairs.r[k]);
+			}
+		}
+	};
+
+	auto assert_same_lead = [&]() {
+		ASSERT_EQ(expected_lead.rows, lead.rows);
+		ASSERT_EQ(expected_lead.get_n_columns(), lead.get_n_columns());
+		for (unsigned int k = 0u; k < expected_lead.r.size(); ++k) {
+			ASSERT_STREQ(expected_lead.variants.get_name(k), lead.variants.get_name(k));
+			if (std::isnan(expected_lead.r[k])) {
+				ASSERT_TRUE(std::isnan(lead.r[k]));
+			} else {
+				ASSERT_EQ(expected_lead.r[k], lead.r[k]);
+			}
+		}
+	};
+
+	auto served_from_store = [&](const string& query) -> bool {
+		map<string, sph_umich_edu::HVCFMetrics::query_metrics> queries = hvcf_store.get_metrics().get();
+		hvcf_store.reset_metrics();
+		return (queries[query].stages.count(sph_umich_edu::HVCFQueryTrace::READ_LD_STORE_STAGE) > 0u) && (queries[query].stages.count(sph_umich_edu::HVCFQueryTrace::READ_HAPLOTYPES_STAGE) == 0u);
+	};
+
+	// region queries: served if all pairs within max_distance are stored
+	vector<pair<sph_umich_edu::ld_options, bool>> all_options{
+		make_pair(sph_umich_edu::ld_options(), false),
+		make_pair(sph_umich_edu::ld_options(false, 0.0, 20000000ul), true),
+		make_pair(sph_umich_edu::ld_options(true, 0.0, 10000000ul), true),
+		make_pair(sph_umich_edu::ld_options(true, 0.2, 20000000ul), true),
+		make_pair(sph_umich_edu::ld_options(false, 0.05, 30000000ul), false)
+	};
+
+	for (auto&& options : all_options) {
+		hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, options.first, expected_pairs);
+		hvcf_store.compute_ld("ALL", "20", 11650214ul, 60759931ul, options.first, pairs);
+		ASSERT_EQ(options.second, served_from_store("compute_ld_pairs"));
+		assert_same_pairs();
+	}
+
+	// lead variant queries: served if region is within max_distance of lead variant
+	for (unsigned int i = 0u; i < variants.size(); ++i) {
+		unsigned long long int position = variants.get_position(i);
+
+		hvcf.compute_ld("ALL", "20", variants.get_name(i), position > 10000000ul ? position - 10000000ul : 0ul, position + 10000000ul, expected_lead);
+		hvcf_store.compute_ld("ALL", "20", variants.get_name(i), position > 10000000ul ? position - 10000000ul : 0ul, position + 10000000ul, lead);
+		ASSERT_TRUE(served_from_store("compute_ld_lead"));
+		assert_same_lead();
+
+		hvcf.compute_ld("ALL", "20", variants.get_name(i), 11650214ul, 60759931ul, expected_lead);
+		hvcf_store.compute_ld("ALL", "20", variants.get_name(i), 11650214ul, 60759931ul, lead);
+		ASSERT_FALSE(served_from_store("compute_ld_lead"));
+		assert_same_lead();
+	}
+
+	// lead variant outside of region
+	hvcf.compute_ld("ALL", "20", variants.get_name(4), variants.get_position(5), variants.get_position(6), expected_lead);
+	hvcf_store.compute_ld("ALL", "20", variants.get_name(4), variants.get_position(5), variants.get_position(6), lead);
+	assert_same_lead();
+
+	hvcf_store.close();
+
+	// store with r^2 threshold serves only region queries with the same or higher threshold
+	hvcf_store.create("test_ld_store.h5");
+	hvcf_store.import_vcf("1000G_phase3.EUR.chr20.LD_test.vcf.gz");
+	hvcf_store.create_ld_store("ALL", 20000000ul, 0.1);
+	hvcf_store.close();
+	hvcf_store.open("test_ld_store.h5");
+
+	hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, sph_umich_edu::ld_options(true, 0.2, 20000000ul), expected_pairs);
+	hvcf_store.compute_ld("ALL", "20", 11650214ul, 60759931ul, sph_umich_edu::ld_options(true, 0.2, 20000000ul), pairs);
+	ASSERT_TRUE(served_from_store("compute_ld_pairs"));
+	assert_same_pairs();
+
+	hvcf.compute_ld("ALL", "20", 11650214ul, 60759931ul, sph_umich_edu::ld_options(true, 0.05, 20000000ul), expected_pairs);
+	hvcf_store.compute_ld("ALL", "20", 11650214ul, 60759931ul, sph_umich_edu::ld_options(true, 0.05, 20000000ul), pairs);
+	ASSERT_FALSE(served_from_store("compute_ld_pairs"));
+	assert_same_pairs();
+
+	hvcf.compute_ld("ALL", "20", variants.get_name(4), variants.get_position(3), variants.get_position(5), expected_lead);
+	hvcf_store.compute_ld("ALL", "20", variants.get_name(4), variants.get_position(3), variants.get_position(5), lead);
+	ASSERT_FALSE(served_from_store("compute_ld_lead"));
+	assert_same_lead();
+
+	hvcf.close();
+	hvcf_store.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 #include <cmath>
 #include <chrono>
+#include <fstream>
 #include "../src/include/HVCF.h"
 
 class HVCFTestReadWrite : public::testing::Test {
@@ -342,6 +343,53 @@ TEST_F(HVCFTestReadWrite, DISABLED_ImportVCFbyChromosome_EUR) {
 	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
 }
 
+TEST_F(HVCFTestReadWrite, DISABLED_ImportThroughput_ALL) {
+	std::chrono::time_point<std::chrono::system_clock> start, end;
+	std::chrono::duration<double> elapsed_seconds;
+	vector<string> files{"1000G_phase3.ALL.chr20.10K.vcf.gz", "1000G_phase3.ALL.chr21.10K.vcf.gz", "1000G_phase3.ALL.chr22.10K.vcf.gz"};
+	vector<string> chromosomes{"20", "21", "22"};
+	vector<unsigned int> n_threads{1u, 2u, 4u, 0u};
+	vector<vector<sph_umich_edu::frequency_query_result>> frequencies(chromosomes.size());
+
+	for (auto&& n : n_threads) {
+		sph_umich_edu::HVCFConfiguration configuration;
+		configuration.import_threads = n;
+		sph_umich_edu::HVCF hvcf(configuration);
+		unsigned long long int n_variants = 0ul;
+
+		hvcf.create("test_import_throughput.h5");
+		start = std::chrono::system_clock::now();
+		for (auto&& file : files) {
+			hvcf.import_vcf(file);
+		}
+		end = std::chrono::system_clock::now();
+		elapsed_seconds = end - start;
+
+		for (unsigned int i = 0u; i < chromosomes.size(); ++i) {
+			n_variants += hvcf.get_n_variants_in_chromosome(chromosomes[i]);
+		}
+		ASSERT_EQ(9930u + 9941u + 9959u, n_variants);
+		GTEST_LOG_(INFO) << "Import (" << n << " threads; 0 -- all hardware threads) = " << elapsed_seconds.count() << " sec, " << (n_variants / elapsed_seconds.count()) << " variants/sec";
+
+		// all thread counts must produce identical haplotypes
+		for (unsigned int i = 0u; i < chromosomes.size(); ++i) {
+			vector<sph_umich_edu::frequency_query_result> result;
+			hvcf.compute_frequencies("ALL", chromosomes[i], 0ul, numeric_limits<unsigned long long int>::max(), result);
+			if (frequencies[i].empty()) {
+				frequencies[i] = std::move(result);
+				continue;
+			}
+			ASSERT_EQ(frequencies[i].size(), result.size());
+			for (unsigned int j = 0u; j < result.size(); ++j) {
+				ASSERT_EQ(frequencies[i][j].name, result[j].name);
+				ASSERT_EQ(frequencies[i][j].ref_af, result[j].ref_af);
+			}
+		}
+
+		hvcf.close();
+	}
+}
+
 TEST_F(HVCFTestReadWrite, DISABLED_VariantLookupByPosition) {
 	std::chrono::time_point<std::chrono::system_clock> start, end;
 	std::chrono::duration<double> elapsed_seconds;
@@ -538,6 +586,50 @@ TEST_F(HVCFTestReadWrite, DISABLED_VariantLookupByPosition) {
 	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
 }
 
+TEST_F(HVCFTestReadWrite, VariantLookupByPositionCached) {
+	sph_umich_edu::HVCFConfiguration configuration;
+	configuration.max_variants_in_interval_bucket = 100;
+	configuration.max_cached_interval_buckets = 3;
+	sph_umich_edu::HVCF hvcf(configuration);
+	sph_umich_edu::HVCFConfiguration uncached_configuration;
+	uncached_configuration.max_variants_in_interval_bucket = 100;
+	uncached_configuration.max_cached_interval_buckets = 0;
+	sph_umich_edu::HVCF hvcf_uncached(uncached_configuration);
+	vector<sph_umich_edu::variant_query_result> variants;
+
+	hvcf.create("test_lookup.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+
+	hvcf.open("test_lookup.h5");
+	hvcf_uncached.open("test_lookup.h5");
+
+	ASSERT_EQ(hvcf.get_chromosome_start("20"), hvcf_uncached.get_chromosome_start("20"));
+	ASSERT_EQ(hvcf.get_chromosome_end("20"), hvcf_uncached.get_chromosome_end("20"));
+
+	hvcf.extract_variants("20", hvcf.get_chromosome_start("20"), hvcf.get_chromosome_end("20"), variants);
+	ASSERT_EQ(hvcf.get_n_variants_in_chromosome("20"), variants.size());
+
+	// Visit buckets back and forth, so that cached buckets are both reused and evicted.
+	for (unsigned int pass = 0u; pass < 2u; ++pass) {
+		for (unsigned int i = 0u; i < variants.size(); i += 37u) {
+			unsigned long long int position = variants[pass == 0u ? i : variants.size() - 1u - i].position;
+			ASSERT_EQ(hvcf_uncached.get_variant_offset_by_position_eq("20", position), hvcf.get_variant_offset_by_position_eq("20", position));
+			ASSERT_LE(0, hvcf.get_variant_offset_by_position_eq("20", position));
+			ASSERT_EQ(hvcf_uncached.get_variant_offset_by_position_ge("20", position + 1u), hvcf.get_variant_offset_by_position_ge("20", position + 1u));
+			ASSERT_EQ(hvcf_uncached.get_variant_offset_by_position_le("20", position - 1u), hvcf.get_variant_offset_by_position_le("20", position - 1u));
+		}
+	}
+
+	ASSERT_EQ(-1, hvcf.get_variant_offset_by_position_le("20", hvcf.get_chromosome_start("20") - 1u));
+	ASSERT_EQ(-1, hvcf.get_variant_offset_by_position_ge("20", hvcf.get_chromosome_end("20") + 1u));
+
+	hvcf.close();
+	hvcf_uncached.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
 TEST_F(HVCFTestReadWrite, DISABLED_VariantLookupByName) {
 	std::chrono::time_point<std::chrono::system_clock> start, end;
 	std::chrono::duration<double> elapsed_seconds;
@@ -1023,3 +1115,892 @@ TEST_F(HVCFTestReadWrite, DISABLED_LargeVCF_ALL_CHR20) {
 	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
 }
 
+TEST_F(HVCFTestReadWrite, PrecomputedAlleleCounts) {
+	sph_umich_edu::HVCF hvcf;
+	vector<string> samples(populations["EUR"].begin(), populations["EUR"].begin() + populations["EUR"].size() / 2);
+
+	hvcf.create("test_counts.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.create_sample_subset("HALF_EUR", samples);
+	hvcf.close();
+
+	hvcf.open("test_counts.h5");
+	for (auto&& subset : vector<string>{"ALL", "HALF_EUR"}) {
+		vector<sph_umich_edu::frequency_query_result> frequencies;
+		hvcf.compute_frequencies(subset, "20", hvcf.get_chromosome_start("20"), hvcf.get_chromosome_end("20"), frequencies);
+		ASSERT_EQ(hvcf.get_n_variants_in_chromosome("20"), frequencies.size());
+
+		// counts read from the materialized dataset must match counts summed from haplotypes
+		for (unsigned int i = 0u; i < frequencies.size(); i += 97u) {
+			vector<sph_umich_edu::variant_haplotypes_query_result> haplotypes;
+			hvcf.extract_haplotypes(subset, "20", frequencies[i].name, haplotypes);
+			ASSERT_EQ(hvcf.get_n_samples_in_subset(subset), haplotypes.size());
+			double count = 0.0;
+			for (auto&& haplotype : haplotypes) {
+				count += haplotype.allele1 + haplotype.allele2;
+			}
+			ASSERT_DOUBLE_EQ(count / (2.0 * haplotypes.size()), frequencies[i].ref_af);
+			ASSERT_DOUBLE_EQ(1.0 - count / (2.0 * haplotypes.size()), frequencies[i].alt_af);
+		}
+	}
+	hvcf.close();
+}
+
+TEST_F(HVCFTestReadWrite, HaplotypesColumns) {
+	sph_umich_edu::HVCF hvcf;
+
+	hvcf.create("test_haplotypes_columns.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.close();
+
+	hvcf.open("test_haplotypes_columns.h5");
+	unsigned long long int start = hvcf.get_chromosome_start("20");
+	unsigned long long int end = hvcf.get_chromosome_end("20");
+
+	sph_umich_edu::haplotypes_query_columns haplotypes;
+	hvcf.extract_haplotypes("ALL", "20", start, end, haplotypes);
+	ASSERT_EQ(hvcf.get_n_variants_in_chromosome("20"), haplotypes.size());
+	ASSERT_EQ(2u * hvcf.get_n_samples(), haplotypes.n_haplotypes);
+	ASSERT_EQ(haplotypes.size() * haplotypes.n_haplotypes, haplotypes.haplotypes.size());
+
+	sph_umich_edu::frequency_query_columns frequencies;
+	hvcf.compute_frequencies("ALL", "20", start, end, frequencies);
+	ASSERT_EQ(haplotypes.size(), frequencies.alt_counts.size());
+	ASSERT_EQ(haplotypes.n_haplotypes, frequencies.n_haplotypes);
+
+	for (unsigned int i = 0u; i < haplotypes.size(); ++i) {
+		ASSERT_STREQ(frequencies.variants.get_name(i), haplotypes.variants.get_name(i));
+		unsigned int count = 0u;
+		for (unsigned int j = 0u; j < haplotypes.n_haplotypes; ++j) {
+			count += haplotypes.get_allele(i, j);
+		}
+		ASSERT_EQ(count, frequencies.alt_counts[i]);
+	}
+
+	// matrix rows agree with per-variant query
+	for (unsigned int i = 0u; i < haplotypes.size(); i += 101u) {
+		vector<sph_umich_edu::variant_haplotypes_query_result> variant_haplotypes;
+		hvcf.extract_haplotypes("ALL", "20", haplotypes.variants.get_name(i), variant_haplotypes);
+		ASSERT_EQ(haplotypes.n_haplotypes, 2u * variant_haplotypes.size());
+		for (unsigned int j = 0u; j < variant_haplotypes.size(); ++j) {
+			ASSERT_EQ(variant_haplotypes[j].allele1, haplotypes.get_allele(i, 2u * j));
+			ASSERT_EQ(variant_haplotypes[j].allele2, haplotypes.get_allele(i, 2u * j + 1u));
+		}
+	}
+	hvcf.close();
+}
+
+TEST_F(HVCFTestReadWrite, QueryMetrics) {
+	sph_umich_edu::HVCF hvcf;
+
+	hvcf.create("test_query_metrics.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.close();
+
+	hvcf.open("test_query_metrics.h5");
+	unsigned long long int start = hvcf.get_chromosome_start("20");
+	unsigned long long int end = hvcf.get_chromosome_end("20");
+
+	vector<sph_umich_edu::frequency_query_result> frequencies;
+	hvcf.compute_frequencies("ALL", "20", start, end, frequencies);
+	hvcf.compute_frequencies("ALL", "20", start, end, frequencies);
+
+	sph_umich_edu::ld_query_columns ld;
+	hvcf.compute_ld("ALL", "20", 60343ul, 70000ul, ld);
+
+	map<string, sph_umich_edu::HVCFMetrics::query_metrics> queries = hvcf.get_metrics().get();
+	ASSERT_EQ(2u, queries.size());
+
+	const sph_umich_edu::HVCFMetrics::query_metrics& frequencies_metrics = queries.at("compute_frequencies");
+	ASSERT_EQ(2ull, frequencies_metrics.count);
+	ASSERT_EQ(0ull, frequencies_metrics.errors);
+	ASSERT_EQ(2ull * frequencies.size(), frequencies_metrics.results);
+	ASSERT_GT(frequencies_metrics.haplotype_chunks_touched, 0ull);
+	ASSERT_LE(frequencies_metrics.haplotype_chunks_read, frequencies_metrics.haplotype_chunks_touched);
+	ASSERT_LE(frequencies_metrics.haplotype_chunks_read, frequencies_metrics.io.raw_data_reads);
+	ASSERT_EQ(1u, frequencies_metrics.stages.count(sph_umich_edu::HVCFQueryTrace::READ_HAPLOTYPES_STAGE));
+	ASSERT_EQ(1u, frequencies_metrics.stages.count(sph_umich_edu::HVCFQueryTrace::FORMAT_STAGE));
+	unsigned long long int n_buckets = 0ull;
+	for (auto&& bucket : frequencies_metrics.latency_buckets) {
+		n_buckets += bucket;
+	}
+	ASSERT_EQ(frequencies_metrics.count, n_buckets);
+
+	const sph_umich_edu::HVCFMetrics::query_metrics& ld_metrics = queries.at("compute_ld");
+	ASSERT_EQ(1ull, ld_metrics.count);
+	ASSERT_EQ(ld.get_n_rows() * ld.get_n_columns(), ld_metrics.results);
+	ASSERT_EQ(1u, ld_metrics.stages.count(sph_umich_edu::HVCFQueryTrace::COMPUTE_STAGE));
+
+	string prometheus = hvcf.get_metrics().to_prometheus();
+	ASSERT_NE(string::npos, prometheus.find("hvcf_query_duration_seconds_count{query=\"compute_frequencies\"} 2"));
+	ASSERT_NE(string::npos, prometheus.find("hvcf_query_chunk_cache_hit_ratio{query=\"compute_ld\"}"));
+
+	hvcf.reset_metrics();
+	ASSERT_EQ(0u, hvcf.get_metrics().get().size());
+	hvcf.close();
+}
+
+TEST_F(HVCFTestReadWrite, DirectChunkReads) {
+	vector<string> samples;
+	for (unsigned int i = 0u; i < populations["EUR"].size(); i += 3u) {
+		samples.push_back(populations["EUR"][i]);
+	}
+
+	for (auto&& compression : { sph_umich_edu::HVCFConfiguration::GZIP_COMPRESSION, sph_umich_edu::HVCFConfiguration::BLOSC_LZ4HC_COMPRESSION }) {
+		for (auto&& storage : { sph_umich_edu::HVCFConfiguration::BYTE_HAPLOTYPES_STORAGE, sph_umich_edu::HVCFConfiguration::BIT_HAPLOTYPES_STORAGE }) {
+			sph_umich_edu::HVCFConfiguration configuration;
+			configuration.compression = compression;
+			configuration.haplotypes_storage = storage;
+			configuration.variants_chunk_size = 100;
+			configuration.samples_chunk_size = 50;
+
+			sph_umich_edu::HVCF hvcf(configuration);
+			hvcf.create("test_direct_chunk_reads.h5");
+			hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+			hvcf.create_sample_subset("THIRD_EUR", samples);
+			hvcf.close();
+
+			configuration.chunk_reader = sph_umich_edu::HVCFConfiguration::HDF5_CHUNK_READER;
+			sph_umich_edu::HVCF hvcf_hdf5(configuration);
+			configuration.chunk_reader = sph_umich_edu::HVCFConfiguration::DIRECT_CHUNK_READER;
+			configuration.read_threads = 3;
+			sph_umich_edu::HVCF hvcf_direct(configuration);
+
+			hvcf_hdf5.open("test_direct_chunk_reads.h5");
+			hvcf_direct.open("test_direct_chunk_reads.h5");
+
+			unsigned long long int start = hvcf_hdf5.get_chromosome_start("20");
+			unsigned long long int end = hvcf_hdf5.get_chromosome_end("20");
+
+			for (auto&& subset : vector<string>{"ALL", "THIRD_EUR"}) {
+				sph_umich_edu::haplotypes_query_columns expected;
+				sph_umich_edu::haplotypes_query_columns haplotypes;
+
+				hvcf_hdf5.extract_haplotypes(subset, "20", start, end, expected);
+				hvcf_direct.extract_haplotypes(subset, "20", start, end, haplotypes);
+				ASSERT_GT(expected.size(), 0u);
+				ASSERT_EQ(expected.size(), haplotypes.size());
+				ASSERT_EQ(expected.n_haplotypes, haplotypes.n_haplotypes);
+				ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+
+				// region, which starts and ends inside of chunks
+				hvcf_hdf5.extract_haplotypes(subset, "20", expected.variants.get_position(150), expected.variants.get_position(420), expected);
+				hvcf_direct.extract_haplotypes(subset, "20", haplotypes.variants.get_position(150), haplotypes.variants.get_position(420), haplotypes);
+				ASSERT_EQ(271u, haplotypes.size());
+				ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+			}
+
+			hvcf_hdf5.close();
+			hvcf_direct.close();
+		}
+	}
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, HaplotypeBlockCache) {
+	sph_umich_edu::HVCFConfiguration configuration;
+	configuration.variants_chunk_size = 100;
+	configuration.samples_chunk_size = 100;
+
+	sph_umich_edu::HVCF hvcf(configuration);
+	hvcf.create("test_haplotype_block_cache.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.close();
+
+	configuration.haplotype_cache_size = 0;
+	sph_umich_edu::HVCF hvcf_uncached(configuration);
+	hvcf_uncached.open("test_haplotype_block_cache.h5");
+
+	hvcf.open("test_haplotype_block_cache.h5");
+	ASSERT_EQ(0u, hvcf.get_haplotype_cache_statistics().n_blocks);
+
+	sph_umich_edu::haplotypes_query_columns expected;
+	sph_umich_edu::haplotypes_query_columns haplotypes;
+	hvcf_uncached.extract_haplotypes("ALL", "20", hvcf.get_chromosome_start("20"), hvcf.get_chromosome_end("20"), expected);
+	ASSERT_EQ(0u, hvcf_uncached.get_haplotype_cache_statistics().n_blocks);
+
+	unsigned long long int start = expected.variants.get_position(150);
+	unsigned long long int end = expected.variants.get_position(420);
+
+	// 4 variant chunks x 6 column chunks (1006 haplotypes)
+	hvcf.extract_haplotypes("ALL", "20", start, end, haplotypes);
+	sph_umich_edu::HaplotypeBlockCache::statistics statistics = hvcf.get_haplotype_cache_statistics();
+	ASSERT_EQ(0u, statistics.hits);
+	ASSERT_EQ(24u, statistics.misses);
+	ASSERT_EQ(24u, statistics.n_blocks);
+	ASSERT_EQ(24u * 100u * 200u, statistics.size);
+	ASSERT_EQ(271u, haplotypes.size());
+	for (unsigned int v = 0u; v < haplotypes.size(); ++v) {
+		ASSERT_EQ(0, memcmp(expected.haplotypes.data() + (150u + v) * expected.n_haplotypes, haplotypes.haplotypes.data() + v * haplotypes.n_haplotypes, haplotypes.n_haplotypes));
+	}
+
+	// neighbouring window: overlapping chunks come from cache
+	hvcf.extract_haplotypes("ALL", "20", expected.variants.get_position(350), expected.variants.get_position(520), haplotypes);
+	statistics = hvcf.get_haplotype_cache_statistics();
+	ASSERT_EQ(12u, statistics.hits);
+	ASSERT_EQ(30u, statistics.misses);
+	for (unsigned int v = 0u; v < haplotypes.size(); ++v) {
+		ASSERT_EQ(0, memcmp(expected.haplotypes.data() + (350u + v) * expected.n_haplotypes, haplotypes.haplotypes.data() + v * haplotypes.n_haplotypes, haplotypes.n_haplotypes));
+	}
+
+	// LD queries share the same cache
+	vector<sph_umich_edu::ld_query_result> ld;
+	vector<sph_umich_edu::ld_query_result> expected_ld;
+	hvcf.reset_haplotype_cache_statistics();
+	hvcf.compute_ld("ALL", "20", start, end, ld);
+	hvcf_uncached.compute_ld("ALL", "20", start, end, expected_ld);
+	statistics = hvcf.get_haplotype_cache_statistics();
+	ASSERT_EQ(24u, statistics.hits);
+	ASSERT_EQ(0u, statistics.misses);
+	ASSERT_EQ(expected_ld.size(), ld.size());
+	for (unsigned int i = 0u; i < ld.size(); ++i) {
+		ASSERT_EQ(expected_ld[i], ld[i]);
+		ASSERT_DOUBLE_EQ(expected_ld[i].r, ld[i].r);
+	}
+
+	hvcf.close();
+	ASSERT_EQ(0u, hvcf.get_haplotype_cache_statistics().n_blocks);
+	hvcf_uncached.close();
+
+	// cache, which fits only 10 chunks, evicts least recently used ones
+	configuration.haplotype_cache_size = 10u * 100u * 200u;
+	sph_umich_edu::HVCF hvcf_small(configuration);
+	hvcf_small.open("test_haplotype_block_cache.h5");
+	hvcf_small.extract_haplotypes("ALL", "20", start, end, haplotypes);
+	statistics = hvcf_small.get_haplotype_cache_statistics();
+	ASSERT_EQ(24u, statistics.misses);
+	ASSERT_EQ(14u, statistics.evictions);
+	ASSERT_EQ(10u, statistics.n_blocks);
+	ASSERT_LE(statistics.size, statistics.capacity);
+	for (unsigned int v = 0u; v < haplotypes.size(); ++v) {
+		ASSERT_EQ(0, memcmp(expected.haplotypes.data() + (150u + v) * expected.n_haplotypes, haplotypes.haplotypes.data() + v * haplotypes.n_haplotypes, haplotypes.n_haplotypes));
+	}
+	hvcf_small.close();
+
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, HaplotypesBySample) {
+	vector<string> samples{populations["EUR"][0], populations["EUR"][17], populations["EUR"][230]};
+
+	for (auto&& storage : { sph_umich_edu::HVCFConfiguration::BYTE_HAPLOTYPES_STORAGE, sph_umich_edu::HVCFConfiguration::BIT_HAPLOTYPES_STORAGE }) {
+		sph_umich_edu::HVCFConfiguration configuration;
+		configuration.haplotypes_storage = storage;
+
+		sph_umich_edu::HVCF hvcf(configuration);
+		hvcf.create("test_haplotypes_variant_major.h5");
+		hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+		hvcf.create_sample_subset("FEW_EUR", samples);
+		hvcf.close();
+
+		configuration.haplotypes_by_sample = true;
+		configuration.haplotypes_by_sample_chunk_size = 5000;
+		sph_umich_edu::HVCF hvcf_by_sample(configuration);
+		hvcf_by_sample.create("test_haplotypes_by_sample.h5");
+		hvcf_by_sample.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+		hvcf_by_sample.create_sample_subset("FEW_EUR", samples);
+		hvcf_by_sample.close();
+
+		hvcf.open("test_haplotypes_variant_major.h5");
+		hvcf_by_sample.open("test_haplotypes_by_sample.h5");
+
+		unsigned long long int start = hvcf.get_chromosome_start("20");
+		unsigned long long int end = hvcf.get_chromosome_end("20");
+		hsize_t n_variants = hvcf.get_n_variants_in_chromosome("20");
+
+		for (auto&& sample : samples) {
+			vector<sph_umich_edu::sample_haplotypes_query_result> expected;
+			vector<sph_umich_edu::sample_haplotypes_query_result> haplotypes;
+
+			hvcf.reset_haplotype_cache_statistics();
+			hvcf_by_sample.reset_haplotype_cache_statistics();
+			hvcf.extract_haplotypes(sample, "20", start, end, expected);
+			hvcf_by_sample.extract_haplotypes(sample, "20", start, end, haplotypes);
+
+			ASSERT_EQ(n_variants, expected.size());
+			ASSERT_EQ(expected.size(), haplotypes.size());
+			for (unsigned int i = 0u; i < expected.size(); ++i) {
+				ASSERT_EQ(expected[i], haplotypes[i]);
+				ASSERT_EQ(expected[i].allele1, haplotypes[i].allele1);
+				ASSERT_EQ(expected[i].allele2, haplotypes[i].allele2);
+			}
+
+			// one chunk per 5,000 variants of sample, instead of one chunk per 1,000 variants of 100 samples
+			ASSERT_EQ((n_variants + 999u) / 1000u, hvcf.get_haplotype_cache_statistics().misses);
+			ASSERT_EQ((n_variants + 4999u) / 5000u, hvcf_by_sample.get_haplotype_cache_statistics().misses);
+		}
+
+		sph_umich_edu::haplotypes_query_columns expected;
+		sph_umich_edu::haplotypes_query_columns haplotypes;
+		hvcf.extract_haplotypes("FEW_EUR", "20", start, end, expected);
+		hvcf_by_sample.extract_haplotypes("FEW_EUR", "20", start, end, haplotypes);
+		ASSERT_EQ(n_variants, haplotypes.size());
+		ASSERT_EQ(6u, haplotypes.n_haplotypes);
+		ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+
+		// large subsets are still read from variant-major dataset
+		hvcf.extract_haplotypes("ALL", "20", start, end, expected);
+		hvcf_by_sample.reset_haplotype_cache_statistics();
+		hvcf_by_sample.extract_haplotypes("ALL", "20", start, end, haplotypes);
+		ASSERT_EQ((n_variants + 999u) / 1000u * 6u, hvcf_by_sample.get_haplotype_cache_statistics().misses);
+		ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+
+		hvcf.close();
+		hvcf_by_sample.close();
+	}
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, VariantColumns) {
+	auto get_file_size = [](const char* name) -> long long int {
+		ifstream file(name, ios::binary | ios::ate);
+		return static_cast<long long int>(file.tellg());
+	};
+
+	sph_umich_edu::HVCFConfiguration configuration;
+
+	configuration.variants_storage = sph_umich_edu::HVCFConfiguration::COMPOUND_VARIANTS_STORAGE;
+	sph_umich_edu::HVCF hvcf_compound(configuration);
+	hvcf_compound.create("test_variants_compound.h5");
+	hvcf_compound.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf_compound.close();
+
+	configuration.variants_storage = sph_umich_edu::HVCFConfiguration::COLUMNS_VARIANTS_STORAGE;
+	sph_umich_edu::HVCF hvcf_columns(configuration);
+	hvcf_columns.create("test_variants_columns.h5");
+	hvcf_columns.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf_columns.close();
+
+	ASSERT_LT(get_file_size("test_variants_columns.h5"), get_file_size("test_variants_compound.h5"));
+
+	hvcf_compound.open("test_variants_compound.h5");
+	hvcf_columns.open("test_variants_columns.h5");
+
+	unsigned long long int start = hvcf_compound.get_chromosome_start("20");
+	unsigned long long int end = hvcf_compound.get_chromosome_end("20");
+	hsize_t n_variants = hvcf_compound.get_n_variants_in_chromosome("20");
+
+	ASSERT_EQ(n_variants, hvcf_columns.get_n_variants_in_chromosome("20"));
+	ASSERT_EQ(start, hvcf_columns.get_chromosome_start("20"));
+	ASSERT_EQ(end, hvcf_columns.get_chromosome_end("20"));
+
+	// whole chromosome and windows, which start in the middle of blocks of positions
+	vector<pair<unsigned long long int, unsigned long long int>> regions{make_pair(start, end), make_pair(60522ull, 61138ull), make_pair(282218ull, 300000ull)};
+	unsigned int n_indels = 0u;
+
+	for (auto&& region : regions) {
+		sph_umich_edu::variants_columns expected;
+		sph_umich_edu::variants_columns variants;
+
+		hvcf_compound.extract_variants("20", region.first, region.second, expected);
+		hvcf_columns.extract_variants("20", region.first, region.second, variants);
+
+		ASSERT_GT(expected.size(), 0u);
+		ASSERT_EQ(expected.size(), variants.size());
+		for (unsigned int i = 0u; i < expected.size(); ++i) {
+			ASSERT_STREQ(expected.get_name(i), variants.get_name(i));
+			ASSERT_STREQ(expected.get_ref(i), variants.get_ref(i));
+			ASSERT_STREQ(expected.get_alt(i), variants.get_alt(i));
+			ASSERT_EQ(expected.get_position(i), variants.get_position(i));
+			if ((strlen(variants.get_ref(i)) > 1u) || (strlen(variants.get_alt(i)) > 1u)) {
+				++n_indels;
+			}
+		}
+	}
+	ASSERT_GT(n_indels, 0u);
+
+	ASSERT_GE(hvcf_columns.get_variant_offset_by_name("20", "20:282218_C/CATGCAAGGCCCT"), 0);
+	ASSERT_EQ(hvcf_compound.get_variant_offset_by_name("20", "20:282218_C/CATGCAAGGCCCT"), hvcf_columns.get_variant_offset_by_name("20", "20:282218_C/CATGCAAGGCCCT"));
+
+	sph_umich_edu::ld_query_columns expected_ld;
+	sph_umich_edu::ld_query_columns ld;
+
+	hvcf_compound.compute_ld("ALL", "20", "20:282218_C/CATGCAAGGCCCT", 60000ull, 70000ull, expected_ld);
+	hvcf_columns.compute_ld("ALL", "20", "20:282218_C/CATGCAAGGCCCT", 60000ull, 70000ull, ld);
+	ASSERT_GT(ld.get_n_columns(), 1u);
+	ASSERT_EQ(expected_ld.get_n_columns(), ld.get_n_columns());
+	ASSERT_EQ(expected_ld.rows, ld.rows);
+	for (unsigned int i = 0u; i < ld.get_n_columns(); ++i) {
+		ASSERT_STREQ(expected_ld.variants.get_name(i), ld.variants.get_name(i));
+		ASSERT_EQ(expected_ld.variants.get_position(i), ld.variants.get_position(i));
+	}
+
+	hvcf_compound.close();
+	hvcf_columns.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, NamesFingerprints) {
+	// reference values of XXH64 with seed 0: fingerprints must not depend on platform
+	ASSERT_EQ(0xEF46DB3751D8E999ull, sph_umich_edu::NameHash::hash(""));
+	ASSERT_EQ(0xD24EC4F1A98C6E5Bull, sph_umich_edu::NameHash::hash("a"));
+	ASSERT_EQ(0x44BC2CF5AD770999ull, sph_umich_edu::NameHash::hash("abc"));
+
+	// few buckets, so that every bucket holds many names
+	sph_umich_edu::HVCFConfiguration configuration;
+	configuration.n_variants_hash_buckets = 17u;
+	configuration.n_samples_hash_buckets = 7u;
+
+	sph_umich_edu::HVCF hvcf(configuration);
+	hvcf.create("test_names_fingerprints.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.close();
+
+	hvcf.open("test_names_fingerprints.h5");
+
+	vector<string> samples = hvcf.get_samples();
+	ASSERT_EQ(503u, samples.size());
+	for (unsigned int i = 0u; i < samples.size(); ++i) {
+		ASSERT_EQ(i, hvcf.get_sample_offset(samples[i]));
+	}
+	ASSERT_EQ(-1, hvcf.get_sample_offset("ABC"));
+	ASSERT_EQ(-1, hvcf.get_sample_offset(""));
+
+	sph_umich_edu::variants_columns variants;
+	hvcf.extract_variants("20", hvcf.get_chromosome_start("20"), hvcf.get_chromosome_end("20"), variants);
+	ASSERT_EQ(hvcf.get_n_variants_in_chromosome("20"), variants.size());
+	for (unsigned int i = 0u; i < variants.size(); ++i) {
+		long long int offset = hvcf.get_variant_offset_by_name("20", variants.get_name(i));
+		ASSERT_GE(offset, 0);
+		ASSERT_LE(offset, i); // duplicated names resolve to first variant
+		ASSERT_STREQ(variants.get_name(i), variants.get_name(offset));
+	}
+	ASSERT_EQ(-1, hvcf.get_variant_offset_by_name("20", "20:282263_T/A"));
+	ASSERT_EQ(-1, hvcf.get_variant_offset_by_name("XYZ", "20:60343_G/A"));
+
+	hvcf.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, SampleTable) {
+	sph_umich_edu::HVCF hvcf;
+	hvcf.create("test_sample_table.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+
+	vector<string> samples = hvcf.get_samples();
+	vector<string> subset_samples;
+	for (unsigned int i = 0u; i < samples.size(); i += 3u) { // not contiguous, listed in reverse order
+		subset_samples.insert(subset_samples.begin(), samples[i]);
+	}
+	hvcf.create_sample_subset("EVERY_THIRD", subset_samples);
+	hvcf.close();
+
+	hvcf.open("test_sample_table.h5");
+
+	shared_ptr<const sph_umich_edu::sample_table> table = hvcf.get_sample_table();
+	ASSERT_NE(nullptr, table);
+	ASSERT_EQ(503u, table->size());
+	ASSERT_EQ(503u, hvcf.get_n_samples());
+	ASSERT_EQ(samples, hvcf.get_samples());
+	for (unsigned int i = 0u; i < table->size(); ++i) {
+		ASSERT_STREQ(samples[i].c_str(), table->get_name(i));
+		ASSERT_EQ(i, table->get_offset(samples[i].c_str()));
+		ASSERT_EQ(i, hvcf.get_sample_offset(samples[i]));
+	}
+	ASSERT_EQ(-1, table->get_offset("ABC"));
+	ASSERT_EQ(-1, hvcf.get_sample_offset("ABC"));
+
+	ASSERT_EQ(vector<string>({"ALL", "EVERY_THIRD"}), hvcf.get_sample_subsets());
+	ASSERT_EQ(2u, hvcf.get_n_sample_subsets());
+	ASSERT_EQ(subset_samples.size(), hvcf.get_n_samples_in_subset("EVERY_THIRD"));
+	ASSERT_EQ(0u, hvcf.get_n_samples_in_subset("XYZ"));
+	ASSERT_TRUE(hvcf.get_samples_in_subset("XYZ").empty());
+
+	const vector<hsize_t>* offsets = table->get_subset("EVERY_THIRD");
+	ASSERT_NE(nullptr, offsets);
+	vector<string> expected(subset_samples.rbegin(), subset_samples.rend()); // subsets keep file order
+	ASSERT_EQ(expected, hvcf.get_samples_in_subset("EVERY_THIRD"));
+	ASSERT_EQ(expected.size(), offsets->size());
+	for (unsigned int i = 0u; i < offsets->size(); ++i) {
+		ASSERT_EQ(3u * i, (*offsets)[i]);
+	}
+
+	sph_umich_edu::variants_columns variants;
+	vector<sph_umich_edu::variant_haplotypes_query_result> haplotypes;
+	hvcf.extract_variants("20", hvcf.get_chromosome_start("20"), hvcf.get_chromosome_start("20"), variants);
+	ASSERT_GT(variants.size(), 0u);
+	hvcf.extract_haplotypes("EVERY_THIRD", "20", variants.get_name(0u), haplotypes);
+	ASSERT_EQ(expected.size(), haplotypes.size());
+	for (unsigned int i = 0u; i < haplotypes.size(); ++i) {
+		ASSERT_EQ(expected[i], haplotypes[i].sample);
+	}
+
+	hvcf.close();
+	ASSERT_EQ(503u, table->size()); // table handed out stays valid after file is closed
+	ASSERT_EQ(nullptr, hvcf.get_sample_table());
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, SampleSelection) {
+	GTEST_LOG_(INFO) << "Gather implementation = " << sph_umich_edu::HaplotypeGather::get_implementation();
+
+	// BEGIN: check gather implementation agrees with portable one, including rows at the end of block and columns at the end of rows.
+	unsigned char block[7 * 45];
+	for (unsigned int i = 0u; i < 7u * 45u; ++i) {
+		block[i] = static_cast<unsigned char>((i * 0x9e3779b9u) >> 24);
+	}
+	vector<uint32_t> columns;
+	for (uint32_t c = 0u; c < 45u; c += (c % 4u) + 1u) {
+		columns.push_back(c);
+	}
+	columns.push_back(44u);
+	for (unsigned int n = 0u; n <= columns.size(); ++n) {
+		vector<unsigned char> expected(7u * n);
+		vector<unsigned char> gathered(7u * n);
+		for (unsigned int row = 0u; row < 7u; ++row) {
+			sph_umich_edu::HaplotypeGather::gather_row_scalar(block + row * 45u, columns.data(), n, expected.data() + row * n);
+		}
+		sph_umich_edu::HaplotypeGather::gather(block, 45u, 7u, columns.data(), n, gathered.data());
+		ASSERT_TRUE(expected == gathered);
+	}
+	// END: check gather implementation.
+
+	for (auto&& storage : { sph_umich_edu::HVCFConfiguration::BYTE_HAPLOTYPES_STORAGE, sph_umich_edu::HVCFConfiguration::BIT_HAPLOTYPES_STORAGE }) {
+		sph_umich_edu::HVCFConfiguration configuration;
+		configuration.haplotypes_storage = storage;
+		configuration.variants_chunk_size = 100;
+		configuration.samples_chunk_size = 50;
+
+		sph_umich_edu::HVCF hvcf(configuration);
+		hvcf.create("test_sample_selection.h5");
+		hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+
+		vector<string> samples = hvcf.get_samples();
+		vector<string> subset_samples;
+		vector<hsize_t> offsets;
+		vector<bool> mask(samples.size(), false);
+		for (unsigned int i = 0u; i < samples.size(); i += 3u) {
+			subset_samples.push_back(samples[i]);
+			offsets.insert(offsets.begin(), i); // any order
+			mask[i] = true;
+		}
+		offsets.push_back(offsets.front()); // duplicates are ignored
+		hvcf.create_sample_subset("EVERY_THIRD", subset_samples);
+		hvcf.close();
+
+		configuration.gather_max_gap = 0u;
+		sph_umich_edu::HVCF hvcf_runs(configuration); // reads every run of samples separately
+
+		hvcf.open("test_sample_selection.h5");
+		hvcf_runs.open("test_sample_selection.h5");
+
+		sph_umich_edu::variants_columns variants;
+		hvcf.extract_variants("20", hvcf.get_chromosome_start("20"), hvcf.get_chromosome_end("20"), variants);
+		ASSERT_GT(variants.size(), 420u);
+		unsigned long long int start = variants.get_position(150);
+		unsigned long long int end = variants.get_position(420);
+		string lead = variants.get_name(300);
+
+		sph_umich_edu::frequency_query_columns expected_frequencies;
+		hvcf.compute_frequencies("EVERY_THIRD", "20", start, end, expected_frequencies);
+		ASSERT_GT(expected_frequencies.size(), 0u);
+
+		sph_umich_edu::ld_query_columns expected_ld;
+		hvcf.compute_ld("EVERY_THIRD", "20", start, end, expected_ld);
+		ASSERT_GT(expected_ld.r.size(), 0u);
+
+		sph_umich_edu::ld_query_columns expected_lead_ld;
+		hvcf.compute_ld("EVERY_THIRD", "20", lead, start, end, expected_lead_ld);
+		ASSERT_GT(expected_lead_ld.r.size(), 0u);
+
+		for (auto&& selection : { sph_umich_edu::sample_selection(offsets), sph_umich_edu::sample_selection(mask) }) {
+			for (auto reader : { &hvcf, &hvcf_runs }) {
+				sph_umich_edu::frequency_query_columns frequencies;
+				reader->compute_frequencies(selection, "20", start, end, frequencies);
+				ASSERT_EQ(expected_frequencies.size(), frequencies.size());
+				ASSERT_EQ(expected_frequencies.alt_counts, frequencies.alt_counts);
+				ASSERT_EQ(expected_frequencies.alt_af, frequencies.alt_af);
+
+				sph_umich_edu::ld_query_columns ld;
+				reader->compute_ld(selection, "20", start, end, ld);
+				ASSERT_EQ(expected_ld.get_n_columns(), ld.get_n_columns());
+				for (unsigned int i = 0u; i < ld.r.size(); ++i) {
+					ASSERT_DOUBLE_EQ(expected_ld.r[i], ld.r[i]);
+				}
+
+				reader->compute_ld(selection, "20", lead, start, end, ld);
+				ASSERT_EQ(expected_lead_ld.get_n_columns(), ld.get_n_columns());
+				for (unsigned int i = 0u; i < ld.r.size(); ++i) {
+					ASSERT_DOUBLE_EQ(expected_lead_ld.r[i], ld.r[i]);
+				}
+			}
+		}
+
+		sph_umich_edu::frequency_query_columns frequencies;
+		hvcf.compute_frequencies(sph_umich_edu::sample_selection(), "20", start, end, frequencies);
+		ASSERT_EQ(0u, frequencies.size());
+		sph_umich_edu::sample_selection out_of_range(vector<hsize_t>({0u, samples.size()}));
+		ASSERT_THROW(hvcf.compute_frequencies(out_of_range, "20", start, end, frequencies), sph_umich_edu::HVCFReadException);
+
+		hvcf.close();
+		hvcf_runs.close();
+	}
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, SampleOrder) {
+	for (auto&& storage : { sph_umich_edu::HVCFConfiguration::BYTE_HAPLOTYPES_STORAGE, sph_umich_edu::HVCFConfiguration::BIT_HAPLOTYPES_STORAGE }) {
+		sph_umich_edu::HVCFConfiguration configuration;
+		configuration.haplotypes_storage = storage;
+		configuration.variants_chunk_size = 100;
+		configuration.samples_chunk_size = 50;
+
+		sph_umich_edu::HVCF hvcf(configuration);
+		hvcf.create("test_sample_order_vcf.h5");
+		hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+
+		vector<string> samples = hvcf.get_samples();
+		vector<string> subset_samples;
+		vector<string> sample_order; // every third sample first, then the rest in reverse
+		for (unsigned int i = 0u; i < samples.size(); i += 3u) {
+			subset_samples.push_back(samples[i]);
+			sample_order.push_back(samples[i]);
+		}
+		for (unsigned int i = samples.size(); i-- > 0u; ) {
+			if (i % 3u != 0u) {
+				sample_order.push_back(samples[i]);
+			}
+		}
+		sample_order.push_back("ABC"); // unknown samples are ignored
+		hvcf.create_sample_subset("EVERY_THIRD", subset_samples);
+		hvcf.close();
+
+		sph_umich_edu::HVCF grouped(configuration);
+		grouped.create("test_sample_order_grouped.h5");
+		grouped.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz", sample_order);
+		grouped.create_sample_subset("EVERY_THIRD", subset_samples);
+		grouped.close();
+
+		hvcf.open("test_sample_order_vcf.h5");
+		grouped.open("test_sample_order_grouped.h5");
+
+		ASSERT_EQ(samples, grouped.get_samples());
+		for (unsigned int i = 0u; i < samples.size(); ++i) {
+			ASSERT_EQ(i, grouped.get_sample_offset(samples[i]));
+		}
+		ASSERT_EQ(hvcf.get_samples_in_subset("EVERY_THIRD"), grouped.get_samples_in_subset("EVERY_THIRD"));
+		ASSERT_EQ(*hvcf.get_sample_table()->get_subset("EVERY_THIRD"), *grouped.get_sample_table()->get_subset("EVERY_THIRD"));
+
+		sph_umich_edu::variants_columns variants;
+		hvcf.extract_variants("20", hvcf.get_chromosome_start("20"), hvcf.get_chromosome_end("20"), variants);
+		ASSERT_GT(variants.size(), 420u);
+		unsigned long long int start = variants.get_position(150);
+		unsigned long long int end = variants.get_position(420);
+
+		for (auto&& subset : vector<string>{"ALL", "EVERY_THIRD"}) {
+			sph_umich_edu::haplotypes_query_columns expected_haplotypes;
+			sph_umich_edu::haplotypes_query_columns haplotypes;
+			hvcf.extract_haplotypes(subset, "20", start, end, expected_haplotypes);
+			grouped.extract_haplotypes(subset, "20", start, end, haplotypes);
+			ASSERT_GT(expected_haplotypes.size(), 0u);
+			ASSERT_EQ(expected_haplotypes.n_haplotypes, haplotypes.n_haplotypes);
+			ASSERT_TRUE(expected_haplotypes.haplotypes == haplotypes.haplotypes);
+
+			vector<sph_umich_edu::variant_haplotypes_query_result> expected_variant_haplotypes;
+			vector<sph_umich_edu::variant_haplotypes_query_result> variant_haplotypes;
+			hvcf.extract_haplotypes(subset, "20", variants.get_name(300), expected_variant_haplotypes);
+			grouped.extract_haplotypes(subset, "20", variants.get_name(300), variant_haplotypes);
+			ASSERT_EQ(expected_variant_haplotypes.size(), variant_haplotypes.size());
+			for (unsigned int i = 0u; i < variant_haplotypes.size(); ++i) {
+				ASSERT_EQ(expected_variant_haplotypes[i].sample, variant_haplotypes[i].sample);
+				ASSERT_EQ(expected_variant_haplotypes[i].allele1, variant_haplotypes[i].allele1);
+				ASSERT_EQ(expected_variant_haplotypes[i].allele2, variant_haplotypes[i].allele2);
+			}
+
+			sph_umich_edu::frequency_query_columns expected_frequencies;
+			sph_umich_edu::frequency_query_columns frequencies;
+			hvcf.compute_frequencies(subset, "20", start, end, expected_frequencies);
+			grouped.compute_frequencies(subset, "20", start, end, frequencies);
+			ASSERT_EQ(expected_frequencies.alt_counts, frequencies.alt_counts);
+
+			sph_umich_edu::ld_query_columns expected_ld;
+			sph_umich_edu::ld_query_columns ld;
+			hvcf.compute_ld(subset, "20", start, end, expected_ld);
+			grouped.compute_ld(subset, "20", start, end, ld);
+			ASSERT_EQ(expected_ld.r.size(), ld.r.size());
+			for (unsigned int i = 0u; i < ld.r.size(); ++i) {
+				ASSERT_DOUBLE_EQ(expected_ld.r[i], ld.r[i]);
+			}
+		}
+
+		vector<sph_umich_edu::sample_haplotypes_query_result> expected_sample_haplotypes;
+		vector<sph_umich_edu::sample_haplotypes_query_result> sample_haplotypes;
+		hvcf.extract_haplotypes(samples[4], "20", start, end, expected_sample_haplotypes);
+		grouped.extract_haplotypes(samples[4], "20", start, end, sample_haplotypes);
+		ASSERT_EQ(expected_sample_haplotypes.size(), sample_haplotypes.size());
+		for (unsigned int i = 0u; i < sample_haplotypes.size(); ++i) {
+			ASSERT_EQ(expected_sample_haplotypes[i].allele1, sample_haplotypes[i].allele1);
+			ASSERT_EQ(expected_sample_haplotypes[i].allele2, sample_haplotypes[i].allele2);
+		}
+
+		sph_umich_edu::sample_selection selection(vector<hsize_t>({1u, 4u, 5u, 300u}));
+		sph_umich_edu::frequency_query_columns expected_frequencies;
+		sph_umich_edu::frequency_query_columns frequencies;
+		hvcf.compute_frequencies(selection, "20", start, end, expected_frequencies);
+		grouped.compute_frequencies(selection, "20", start, end, frequencies);
+		ASSERT_EQ(expected_frequencies.alt_counts, frequencies.alt_counts);
+
+		// grouped subset is one range of columns, so it touches fewer chunks
+		hvcf.reset_metrics();
+		grouped.reset_metrics();
+		sph_umich_edu::haplotypes_query_columns haplotypes;
+		hvcf.extract_haplotypes("EVERY_THIRD", "20", start, end, haplotypes);
+		grouped.extract_haplotypes("EVERY_THIRD", "20", start, end, haplotypes);
+		ASSERT_LT(grouped.get_metrics().get().at("extract_haplotypes").haplotype_chunks_touched, hvcf.get_metrics().get().at("extract_haplotypes").haplotype_chunks_touched);
+
+		hvcf.close();
+		grouped.close();
+	}
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReadWrite, PBWTHaplotypes) {
+	vector<string> samples;
+	for (unsigned int i = 0u; i < populations["EUR"].size(); i += 3u) {
+		samples.push_back(populations["EUR"][i]);
+	}
+
+	sph_umich_edu::HVCFConfiguration configuration;
+	configuration.variants_chunk_size = 100;
+	configuration.samples_chunk_size = 50;
+
+	sph_umich_edu::HVCF hvcf(configuration);
+	hvcf.create("test_pbwt_byte.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.create_sample_subset("THIRD_EUR", samples);
+	hvcf.close();
+
+	configuration.haplotypes_storage = sph_umich_edu::HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE;
+	configuration.pbwt_checkpoint_interval = 1000;
+	configuration.haplotypes_by_sample = true; // ignored: there is no sample-major copy of PBWT columns
+	sph_umich_edu::HVCF pbwt(configuration);
+	pbwt.create("test_pbwt.h5");
+	pbwt.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	pbwt.create_sample_subset("THIRD_EUR", samples);
+	pbwt.close();
+
+	vector<string> sample_order(samples.rbegin(), samples.rend());
+	sph_umich_edu::HVCF pbwt_grouped(configuration);
+	pbwt_grouped.create("test_pbwt_grouped.h5");
+	pbwt_grouped.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz", sample_order);
+	pbwt_grouped.create_sample_subset("THIRD_EUR", samples);
+	pbwt_grouped.close();
+
+	hvcf.open("test_pbwt_byte.h5");
+	pbwt.open("test_pbwt.h5");
+	pbwt_grouped.open("test_pbwt_grouped.h5");
+
+	unsigned long long int start = hvcf.get_chromosome_start("20");
+	unsigned long long int end = hvcf.get_chromosome_end("20");
+	ASSERT_GT(hvcf.get_n_variants_in_chromosome("20"), 2100u);
+
+	for (auto&& subset : vector<string>{"ALL", "THIRD_EUR"}) {
+		sph_umich_edu::haplotypes_query_columns expected;
+		sph_umich_edu::haplotypes_query_columns haplotypes;
+
+		hvcf.extract_haplotypes(subset, "20", start, end, expected);
+		pbwt.extract_haplotypes(subset, "20", start, end, haplotypes);
+		ASSERT_GT(expected.size(), 0u);
+		ASSERT_EQ(expected.size(), haplotypes.size());
+		ASSERT_EQ(expected.n_haplotypes, haplotypes.n_haplotypes);
+		ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+
+		pbwt_grouped.extract_haplotypes(subset, "20", start, end, haplotypes);
+		ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+
+		// region, which starts after the first checkpoint and spans the next one
+		unsigned long long int region_start = expected.variants.get_position(950);
+		unsigned long long int region_end = expected.variants.get_position(2100);
+		hvcf.extract_haplotypes(subset, "20", region_start, region_end, expected);
+		pbwt.extract_haplotypes(subset, "20", region_start, region_end, haplotypes);
+		ASSERT_EQ(1151u, haplotypes.size());
+		ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+
+		// consecutive single-variant windows around checkpoint continue decoding from the order left by the previous read
+		sph_umich_edu::haplotypes_query_columns expected_variant;
+		for (unsigned int i = 40u; i < 60u; ++i) {
+			unsigned long long int position = expected.variants.get_position(i);
+			hvcf.extract_haplotypes(subset, "20", position, position, expected_variant);
+			pbwt.extract_haplotypes(subset, "20", position, position, haplotypes);
+			ASSERT_EQ(expected_variant.size(), haplotypes.size());
+			ASSERT_TRUE(expected_variant.haplotypes == haplotypes.haplotypes);
+		}
+
+		sph_umich_edu::frequency_query_columns expected_frequencies;
+		sph_umich_edu::frequency_query_columns frequencies;
+		hvcf.compute_frequencies(subset, "20", region_start, region_end, expected_frequencies);
+		pbwt.compute_frequencies(subset, "20", region_start, region_end, frequencies);
+		ASSERT_EQ(expected_frequencies.alt_counts, frequencies.alt_counts);
+
+		sph_umich_edu::ld_query_columns expected_ld;
+		sph_umich_edu::ld_query_columns ld;
+		hvcf.compute_ld(subset, "20", region_start, region_end, expected_ld);
+		pbwt.compute_ld(subset, "20", region_start, region_end, ld);
+		ASSERT_EQ(expected_ld.r.size(), ld.r.size());
+		for (unsigned int i = 0u; i < ld.r.size(); ++i) {
+			ASSERT_DOUBLE_EQ(expected_ld.r[i], ld.r[i]);
+		}
+	}
+
+	vector<sph_umich_edu::sample_haplotypes_query_result> expected_sample_haplotypes;
+	vector<sph_umich_edu::sample_haplotypes_query_result> sample_haplotypes;
+	hvcf.extract_haplotypes(samples[5], "20", start, end, expected_sample_haplotypes);
+	pbwt.extract_haplotypes(samples[5], "20", start, end, sample_haplotypes);
+	ASSERT_EQ(expected_sample_haplotypes.size(), sample_haplotypes.size());
+	for (unsigned int i = 0u; i < sample_haplotypes.size(); ++i) {
+		ASSERT_EQ(expected_sample_haplotypes[i].allele1, sample_haplotypes[i].allele1);
+		ASSERT_EQ(expected_sample_haplotypes[i].allele2, sample_haplotypes[i].allele2);
+	}
+
+	hvcf.close();
+	pbwt.close();
+	pbwt_grouped.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+
+	// run-length encoded PBWT columns compress better than raw bytes
+	ifstream byte_file("test_pbwt_byte.h5", ios::binary | ios::ate);
+	ifstream pbwt_file("test_pbwt.h5", ios::binary | ios::ate);
+	ASSERT_LT(pbwt_file.tellg(), byte_file.tellg());
+}
+
+TEST_F(HVCFTestReadWrite, PBWTHaplotypesBySample) {
+	vector<string> samples{populations["EUR"][0], populations["EUR"][17], populations["EUR"][230]};
+
+	sph_umich_edu::HVCFConfiguration configuration;
+	sph_umich_edu::HVCF hvcf(configuration);
+	hvcf.create("test_pbwt_by_sample_byte.h5");
+	hvcf.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz");
+	hvcf.create_sample_subset("FEW_EUR", samples);
+	hvcf.close();
+
+	// sample-major copy is not written for PBWT storage, but asking for it doesn't break import
+	configuration.haplotypes_storage = sph_umich_edu::HVCFConfiguration::PBWT_HAPLOTYPES_STORAGE;
+	configuration.haplotypes_by_sample = true;
+	configuration.haplotypes_by_sample_chunk_size = 5000;
+	sph_umich_edu::HVCF pbwt(configuration);
+	pbwt.create("test_pbwt_by_sample.h5");
+	ASSERT_NO_THROW(pbwt.import_vcf("1000G_phase3.EUR.chr20.10K.vcf.gz"));
+	pbwt.create_sample_subset("FEW_EUR", samples);
+	pbwt.close();
+
+	hvcf.open("test_pbwt_by_sample_byte.h5");
+	pbwt.open("test_pbwt_by_sample.h5");
+
+	unsigned long long int start = hvcf.get_chromosome_start("20");
+	unsigned long long int end = hvcf.get_chromosome_end("20");
+
+	for (auto&& subset : vector<string>{"ALL", "FEW_EUR"}) {
+		sph_umich_edu::haplotypes_query_columns expected;
+		sph_umich_edu::haplotypes_query_columns haplotypes;
+
+		hvcf.extract_haplotypes(subset, "20", start, end, expected);
+		pbwt.extract_haplotypes(subset, "20", start, end, haplotypes);
+		ASSERT_GT(expected.size(), 0u);
+		ASSERT_EQ(expected.size(), haplotypes.size());
+		ASSERT_TRUE(expected.haplotypes == haplotypes.haplotypes);
+	}
+
+	hvcf.close();
+	pbwt.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
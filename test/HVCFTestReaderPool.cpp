@@ -0,0 +1,215 @@
+#include <array>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "../src/include/HVCFReaderPool.h"
+
+using namespace std;
+
+class HVCFTestReaderPool : public::testing::Test {
+protected:
+	unordered_map<string, vector<string>> populations;
+
+	void read_populations(const string& file_name) {
+		sph_umich_edu::GzipReader reader;
+		regex header_regex("^sample[[:space:]]+pop[[:space:]]+super_pop[[:space:]]+gender$");
+		regex separator_regex("[[:space:]]+");
+		const cregex_token_iterator end;
+		unsigned int i = 0u;
+		reader.set_file_name(file_name);
+		reader.open();
+		string sample;
+		string population;
+		auto populations_it = populations.end();
+		char* line = reader.get_line();
+
+		if (reader.read_line() >= 0) {
+			if (!regex_match(line, header_regex)) {
+				return;
+			}
+		}
+
+		while (reader.read_line() >= 0) {
+			cregex_token_iterator fields_iter(line, line + strlen(line), separator_regex, -1);
+			i = 0u;
+			sample.clear();
+			population.clear();
+			while (fields_iter != end) {
+				switch (i) {
+				case 0:
+					sample = fields_iter->str();
+					break;
+				case 2:
+					population = fields_iter->str();
+					break;
+				default:
+					break;
+				}
+				++fields_iter;
+				++i;
+			}
+
+			populations_it = populations.emplace(std::move(population), vector<string>()).first;
+			populations_it->second.emplace_back(std::move(sample));
+		}
+
+		reader.close();
+	}
+
+	virtual ~HVCFTestReaderPool() {
+
+	}
+
+	virtual void SetUp() {
+		read_populations("integrated_call_samples_v3.20130502.ALL.panel");
+	}
+
+	virtual void TearDown() {
+	}
+};
+
+TEST_F(HVCFTestReaderPool, StressTest) {
+	std::chrono::time_point<std::chrono::system_clock> start, end;
+	std::chrono::duration<double> elapsed_seconds;
+	const unsigned int n_threads = 8u;
+	const unsigned int n_iterations = 50u;
+	sph_umich_edu::HVCF hvcf;
+	sph_umich_edu::HVCFReaderPool pool(4u);
+	vector<string> subsets;
+	unordered_map<string, vector<sph_umich_edu::ld_query_result>> expected_region_ld;
+	unordered_map<string, vector<sph_umich_edu::ld_query_result>> expected_lead_ld;
+	vector<sph_umich_edu::variant_query_result> expected_variants;
+
+	// BEGIN: create test HVCF file.
+	hvcf.create("test_pool.h5");
+	hvcf.import_vcf("1000G_phase3.ALL.chr20.LD_test.vcf.gz");
+
+	for (auto&& population : populations) {
+		hvcf.create_sample_subset(population.first, population.second);
+	}
+
+	hvcf.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+	// END: create test HVCF file.
+
+	// BEGIN: single-threaded results.
+	hvcf.open("test_pool.h5");
+	subsets = hvcf.get_sample_subsets();
+	ASSERT_LT(0u, subsets.size());
+	for (auto&& subset : subsets) {
+		hvcf.compute_ld(subset, "20", 11650214ul, 60759931ul, expected_region_ld[subset]);
+		hvcf.compute_ld(subset, "20", "20:46211051_A/G", 100ul, 166000000ul, expected_lead_ld[subset]);
+		ASSERT_EQ(81u, expected_region_ld[subset].size());
+		ASSERT_EQ(8u, expected_lead_ld[subset].size());
+	}
+	hvcf.extract_variants("20", 11650214ul, 60759931ul, expected_variants);
+	ASSERT_EQ(9u, expected_variants.size());
+	hvcf.close();
+	// END: single-threaded results.
+
+	pool.open("test_pool.h5");
+	ASSERT_EQ(4u, pool.get_n_readers());
+
+	atomic<unsigned int> n_mismatches(0u);
+	atomic<unsigned int> n_queries(0u);
+	vector<thread> threads;
+
+	auto same_r = [] (double r1, double r2) -> bool {
+		return (std::isnan(r1) && std::isnan(r2)) || (r1 == r2);
+	};
+
+	start = std::chrono::system_clock::now();
+	for (unsigned int t = 0u; t < n_threads; ++t) {
+		threads.emplace_back([&, t] () {
+			vector<sph_umich_edu::ld_query_result> ld;
+			vector<sph_umich_edu::variant_query_result> variants;
+			for (unsigned int i = 0u; i < n_iterations; ++i) {
+				const string& subset = subsets[(t + i) % subsets.size()];
+				const vector<sph_umich_edu::ld_query_result>& expected_region = expected_region_ld.at(subset);
+				const vector<sph_umich_edu::ld_query_result>& expected_lead = expected_lead_ld.at(subset);
+
+				ld.clear();
+				pool.compute_ld(subset, "20", 11650214ul, 60759931ul, ld);
+				if (ld.size() != expected_region.size()) {
+					++n_mismatches;
+				} else {
+					for (unsigned int j = 0u; j < ld.size(); ++j) {
+						if ((ld[j].position1 != expected_region[j].position1) || (ld[j].position2 != expected_region[j].position2) ||
+								(ld[j].name1 != expected_region[j].name1) || !same_r(ld[j].r, expected_region[j].r)) {
+							++n_mismatches;
+						}
+					}
+				}
+
+				ld.clear();
+				pool.compute_ld(subset, "20", "20:46211051_A/G", 100ul, 166000000ul, ld);
+				if (ld.size() != expected_lead.size()) {
+					++n_mismatches;
+				} else {
+					for (unsigned int j = 0u; j < ld.size(); ++j) {
+						if ((ld[j].position2 != expected_lead[j].position2) || !same_r(ld[j].r, expected_lead[j].r)) {
+							++n_mismatches;
+						}
+					}
+				}
+
+				variants.clear();
+				pool.extract_variants("20", 11650214ul, 60759931ul, variants);
+				if (variants.size() != expected_variants.size()) {
+					++n_mismatches;
+				} else {
+					for (unsigned int j = 0u; j < variants.size(); ++j) {
+						if ((variants[j].position != expected_variants[j].position) || (variants[j].name != expected_variants[j].name)) {
+							++n_mismatches;
+						}
+					}
+				}
+
+				n_queries += 3u;
+			}
+		});
+	}
+
+	for (auto&& thread : threads) {
+		thread.join();
+	}
+	end = std::chrono::system_clock::now();
+	elapsed_seconds = end - start;
+	GTEST_LOG_(INFO) << n_queries << " queries from " << n_threads << " threads in " << elapsed_seconds.count() << " sec";
+
+	ASSERT_EQ(0u, n_mismatches);
+	ASSERT_EQ(3u * n_threads * n_iterations, n_queries);
+
+	pool.close();
+	ASSERT_EQ(0u, sph_umich_edu::HVCF::get_n_all_opened_objects());
+}
+
+TEST_F(HVCFTestReaderPool, WorkerPool) {
+	for (unsigned int n_threads : { 0u, 1u, 4u }) {
+		sph_umich_edu::WorkerPool workers(n_threads);
+		atomic<unsigned int> n_items(0u);
+		atomic<unsigned int> next_item(0u);
+
+		// nested batches complete even if all pool threads wait for them
+		sph_umich_edu::WorkerPool::batch outer = workers.submit(4u, [&]() -> void {
+			while (next_item++ < 50u) {
+				atomic<unsigned int> next_inner_item(0u);
+				sph_umich_edu::WorkerPool::batch inner = workers.submit(3u, [&]() -> void {
+					while (next_inner_item++ < 10u) {
+						++n_items;
+					}
+				});
+				workers.wait(inner);
+			}
+		});
+		workers.wait(outer);
+		ASSERT_EQ(500u, n_items.load());
+
+		sph_umich_edu::WorkerPool::batch failing = workers.submit(3u, [&]() -> void {
+			throw sph_umich_edu::HVCFReadException(__FILE__, __FUNCTION__, __LINE__, "Error in worker.");
+		});
+		ASSERT_THROW(workers.wait(failing), sph_umich_edu::HVCFReadException);
+	}
+}